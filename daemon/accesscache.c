@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "accesscache.h"
+
+#include "logging.h"
+
+/* ========================================================================= *
+ * Constants
+ * ========================================================================= */
+
+#define DBUS_SERVICE                   "org.freedesktop.DBus"
+#define DBUS_PATH                      "/org/freedesktop/DBus"
+#define DBUS_INTERFACE                 "org.freedesktop.DBus"
+#define DBUS_SIGNAL_NAME_OWNER_CHANGED "NameOwnerChanged"
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct accessentry_t accessentry_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * ACCESSENTRY
+ * ------------------------------------------------------------------------- */
+
+static accessentry_t *accessentry_create   (GQueue *order, const gchar *sender);
+static void           accessentry_delete   (accessentry_t *self);
+static void           accessentry_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * ACCESSCACHE
+ * ------------------------------------------------------------------------- */
+
+static void     accesscache_ctor     (accesscache_t *self, accesscache_check_fn check, gpointer aptr);
+static void     accesscache_dtor     (accesscache_t *self);
+accesscache_t  *accesscache_create   (accesscache_check_fn check, gpointer aptr);
+void            accesscache_delete   (accesscache_t *self);
+void            accesscache_delete_at(accesscache_t **pself);
+void            accesscache_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * ACCESSCACHE_ATTRIBUTES
+ * ------------------------------------------------------------------------- */
+
+void  accesscache_set_connection(accesscache_t *self, GDBusConnection *connection);
+guint accesscache_size          (const accesscache_t *self);
+
+/* ------------------------------------------------------------------------- *
+ * ACCESSCACHE_TRACKING
+ * ------------------------------------------------------------------------- */
+
+static void accesscache_subscribe  (accesscache_t *self);
+static void accesscache_unsubscribe(accesscache_t *self);
+static void accesscache_owner_cb   (GDBusConnection *connection, const gchar *sender_name, const gchar *object_path, const gchar *interface_name, const gchar *signal_name, GVariant *parameters, gpointer aptr);
+
+/* ------------------------------------------------------------------------- *
+ * ACCESSCACHE_CHECK
+ * ------------------------------------------------------------------------- */
+
+static bool           accesscache_cacheable(const gchar *sender);
+static accessentry_t *accesscache_entry    (accesscache_t *self, const gchar *sender);
+bool                  accesscache_check    (accesscache_t *self, const gchar *sender, guint policy);
+void                  accesscache_forget   (accesscache_t *self, const gchar *sender);
+void                  accesscache_flush    (accesscache_t *self);
+
+/* ========================================================================= *
+ * ACCESSENTRY
+ * ========================================================================= */
+
+struct accessentry_t
+{
+    GQueue        *ace_order;     // cache insertion order queue
+    GList          ace_link;      // node in ace_order
+    gchar         *ace_sender;
+    guint32        ace_evaluated; // bitmask of evaluated policies
+    guint32        ace_allowed;   // bitmask of allowing policies
+};
+
+static accessentry_t *
+accessentry_create(GQueue *order, const gchar *sender)
+{
+    accessentry_t *self = g_malloc0(sizeof *self);
+    self->ace_order     = order;
+    self->ace_link.data = self;
+    self->ace_sender    = g_strdup(sender);
+    self->ace_evaluated = 0;
+    self->ace_allowed   = 0;
+    return self;
+}
+
+static void
+accessentry_delete(accessentry_t *self)
+{
+    if( self ) {
+        g_queue_unlink(self->ace_order, &self->ace_link);
+        g_free(self->ace_sender);
+        g_free(self);
+    }
+}
+
+static void
+accessentry_delete_cb(void *self)
+{
+    accessentry_delete(self);
+}
+
+/* ========================================================================= *
+ * ACCESSCACHE
+ * ========================================================================= */
+
+struct accesscache_t
+{
+    accesscache_check_fn  acs_check;
+    gpointer              acs_aptr;
+    GDBusConnection      *acs_connection;
+    guint                 acs_subscription; // NameOwnerChanged subscription
+    GHashTable           *acs_entries;      // sender -> accessentry_t *
+    GQueue                acs_order;        // accessentry_t *, oldest first
+};
+
+static void
+accesscache_ctor(accesscache_t *self, accesscache_check_fn check, gpointer aptr)
+{
+    log_info("accesscache() create");
+    self->acs_check      = check;
+    self->acs_aptr       = aptr;
+    self->acs_connection   = NULL;
+    self->acs_subscription = 0;
+    self->acs_entries      = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                   NULL, accessentry_delete_cb);
+    g_queue_init(&self->acs_order);
+}
+
+static void
+accesscache_dtor(accesscache_t *self)
+{
+    log_info("accesscache() delete");
+    accesscache_set_connection(self, NULL);
+    if( self->acs_entries ) {
+        g_hash_table_unref(self->acs_entries),
+            self->acs_entries = NULL;
+    }
+}
+
+accesscache_t *
+accesscache_create(accesscache_check_fn check, gpointer aptr)
+{
+    accesscache_t *self = g_malloc0(sizeof *self);
+    accesscache_ctor(self, check, aptr);
+    return self;
+}
+
+void
+accesscache_delete(accesscache_t *self)
+{
+    if( self ) {
+        accesscache_dtor(self);
+        g_free(self);
+    }
+}
+
+void
+accesscache_delete_at(accesscache_t **pself)
+{
+    accesscache_delete(*pself), *pself = NULL;
+}
+
+void
+accesscache_delete_cb(void *self)
+{
+    accesscache_delete(self);
+}
+
+/* ========================================================================= *
+ * ACCESSCACHE_ATTRIBUTES
+ * ========================================================================= */
+
+void
+accesscache_set_connection(accesscache_t *self, GDBusConnection *connection)
+{
+    if( self->acs_connection != connection ) {
+        /* Clients on the old connection can't be tracked anymore */
+        accesscache_unsubscribe(self);
+        g_hash_table_remove_all(self->acs_entries);
+        if( self->acs_connection )
+            g_object_unref(self->acs_connection);
+        self->acs_connection = connection ? g_object_ref(connection) : NULL;
+        accesscache_subscribe(self);
+    }
+}
+
+guint
+accesscache_size(const accesscache_t *self)
+{
+    return g_hash_table_size(self->acs_entries);
+}
+
+/* ========================================================================= *
+ * ACCESSCACHE_TRACKING
+ * ========================================================================= */
+
+static void
+accesscache_subscribe(accesscache_t *self)
+{
+    /* One subscription covers all cached clients. Filtering by name
+     * would need a separate match rule in dbus-daemon for each client. */
+    if( self->acs_connection && !self->acs_subscription ) {
+        self->acs_subscription =
+            g_dbus_connection_signal_subscribe(self->acs_connection,
+                                               DBUS_SERVICE,
+                                               DBUS_INTERFACE,
+                                               DBUS_SIGNAL_NAME_OWNER_CHANGED,
+                                               DBUS_PATH,
+                                               NULL,
+                                               G_DBUS_SIGNAL_FLAGS_NONE,
+                                               accesscache_owner_cb,
+                                               self,
+                                               NULL);
+    }
+}
+
+static void
+accesscache_unsubscribe(accesscache_t *self)
+{
+    if( self->acs_subscription ) {
+        g_dbus_connection_signal_unsubscribe(self->acs_connection,
+                                             self->acs_subscription),
+            self->acs_subscription = 0;
+    }
+}
+
+static void
+accesscache_owner_cb(GDBusConnection *connection,
+                     const gchar     *sender_name,
+                     const gchar     *object_path,
+                     const gchar     *interface_name,
+                     const gchar     *signal_name,
+                     GVariant        *parameters,
+                     gpointer         aptr)
+{
+    accesscache_t *self      = aptr;
+    const gchar   *name      = NULL;
+    const gchar   *old_owner = NULL;
+    const gchar   *new_owner = NULL;
+
+    g_variant_get(parameters, "(&s&s&s)", &name, &old_owner, &new_owner);
+    if( !*new_owner && accesscache_cacheable(name) ) {
+        /* Unique names are not reused, but the entry must not
+         * outlive the client either. */
+        if( g_hash_table_remove(self->acs_entries, name) )
+            log_debug("%s: left bus", name);
+    }
+}
+
+/* ========================================================================= *
+ * ACCESSCACHE_CHECK
+ * ========================================================================= */
+
+static bool
+accesscache_cacheable(const gchar *sender)
+{
+    /* Only unique names can be tracked reliably */
+    return sender && sender[0] == ':';
+}
+
+static accessentry_t *
+accesscache_entry(accesscache_t *self, const gchar *sender)
+{
+    accessentry_t *entry = g_hash_table_lookup(self->acs_entries, sender);
+    if( !entry ) {
+        /* Make room by dropping the oldest entries */
+        while( g_hash_table_size(self->acs_entries) >= ACCESSCACHE_ENTRIES_MAX ) {
+            accessentry_t *oldest = g_queue_peek_head(&self->acs_order);
+            g_hash_table_remove(self->acs_entries, oldest->ace_sender);
+        }
+        entry = accessentry_create(&self->acs_order, sender);
+        g_hash_table_insert(self->acs_entries, entry->ace_sender, entry);
+        g_queue_push_tail_link(&self->acs_order, &entry->ace_link);
+    }
+    return entry;
+}
+
+bool
+accesscache_check(accesscache_t *self, const gchar *sender, guint policy)
+{
+    if( policy >= ACCESSCACHE_POLICY_MAX ) {
+        log_err("policy index %u out of range", policy);
+        return false;
+    }
+
+    if( !accesscache_cacheable(sender) )
+        return self->acs_check(sender, policy, self->acs_aptr);
+
+    guint32        mask  = (guint32)1 << policy;
+    accessentry_t *entry = accesscache_entry(self, sender);
+
+    if( !(entry->ace_evaluated & mask) ) {
+        if( self->acs_check(sender, policy, self->acs_aptr) )
+            entry->ace_allowed |= mask;
+        entry->ace_evaluated |= mask;
+        log_debug("%s: policy %u -> %s", sender, policy,
+                  (entry->ace_allowed & mask) ? "allow" : "deny");
+    }
+
+    return (entry->ace_allowed & mask) != 0;
+}
+
+void
+accesscache_forget(accesscache_t *self, const gchar *sender)
+{
+    if( self && sender )
+        g_hash_table_remove(self->acs_entries, sender);
+}
+
+void
+accesscache_flush(accesscache_t *self)
+{
+    /* Decisions made with previous policies are stale. Clients get
+     * re-evaluated on their next method call. */
+    if( self ) {
+        log_info("access decisions flushed");
+        g_hash_table_remove_all(self->acs_entries);
+    }
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef  ACCESSCACHE_H_
+# define ACCESSCACHE_H_
+
+# include <stdbool.h>
+# include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* ========================================================================= *
+ * Constants
+ * ========================================================================= */
+
+/* Policies are identified by index in range [0, ACCESSCACHE_POLICY_MAX) */
+# define ACCESSCACHE_POLICY_MAX 32
+
+/* Upper limit for number of clients with cached decisions */
+# define ACCESSCACHE_ENTRIES_MAX 256
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct accesscache_t accesscache_t;
+
+/** Callback for evaluating policy on cache miss */
+typedef bool (*accesscache_check_fn)(const gchar *sender, guint policy, gpointer aptr);
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * ACCESSCACHE
+ * ------------------------------------------------------------------------- */
+
+accesscache_t *accesscache_create   (accesscache_check_fn check, gpointer aptr);
+void           accesscache_delete   (accesscache_t *self);
+void           accesscache_delete_at(accesscache_t **pself);
+void           accesscache_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * ACCESSCACHE_ATTRIBUTES
+ * ------------------------------------------------------------------------- */
+
+void  accesscache_set_connection(accesscache_t *self, GDBusConnection *connection);
+guint accesscache_size          (const accesscache_t *self);
+
+/* ------------------------------------------------------------------------- *
+ * ACCESSCACHE_CHECK
+ * ------------------------------------------------------------------------- */
+
+bool accesscache_check (accesscache_t *self, const gchar *sender, guint policy);
+void accesscache_forget(accesscache_t *self, const gchar *sender);
+void accesscache_flush (accesscache_t *self);
+
+G_END_DECLS
+
+#endif /* ACCESSCACHE_H_ */
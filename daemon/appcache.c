@@ -0,0 +1,549 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "appcache.h"
+
+#include "desktop.h"
+#include "logging.h"
+#include "util.h"
+
+#include <string.h>
+
+/* ========================================================================= *
+ * Constants
+ * ========================================================================= */
+
+/* Cache file layout:
+ *
+ * +--------------------+
+ * | appcache_header_t  |  magic + version, native byte order
+ * +--------------------+
+ * | GVariant data      |  APPCACHE_DATA_TYPE, native byte order
+ * +--------------------+
+ *
+ * The file is mapped to memory as is and entries are used directly
+ * from the mapping. Caches written with different version or byte
+ * order are ignored and get replaced on the next save.
+ */
+
+#define APPCACHE_MAGIC      0x43414a53 // "SJAC"
+#define APPCACHE_VERSION    1
+
+/* (main stamp, alt stamp, [(group, [(key, raw value)])]) */
+#define APPCACHE_ENTRY_TYPE "(xttxtta(sa(ss)))"
+#define APPCACHE_GROUP_TYPE "a(sa(ss))"
+#define APPCACHE_DATA_TYPE  "a{s" APPCACHE_ENTRY_TYPE "}"
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct
+{
+    guint32 ach_magic;
+    guint32 ach_version;
+} appcache_header_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * APPCACHE_STAMP
+ * ------------------------------------------------------------------------- */
+
+void appcache_stamp_clear(appcache_stamp_t *self);
+bool appcache_stamp_equal(const appcache_stamp_t *self, const appcache_stamp_t *that);
+
+/* ------------------------------------------------------------------------- *
+ * APPCACHE
+ * ------------------------------------------------------------------------- */
+
+static void  appcache_ctor     (appcache_t *self, const char *path);
+static void  appcache_dtor     (appcache_t *self);
+appcache_t  *appcache_create   (const char *path);
+void         appcache_delete   (appcache_t *self);
+void         appcache_delete_at(appcache_t **pself);
+void         appcache_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * APPCACHE_STORAGE
+ * ------------------------------------------------------------------------- */
+
+static void appcache_clear(appcache_t *self);
+bool        appcache_load (appcache_t *self);
+bool        appcache_save (appcache_t *self);
+
+/* ------------------------------------------------------------------------- *
+ * APPCACHE_ENTRY
+ * ------------------------------------------------------------------------- */
+
+static GVariant *appcache_get_entry        (appcache_t *self, const char *appname);
+static void      appcache_adopt_entry      (appcache_t *self, const char *appname);
+static bool      appcache_entry_matches    (GVariant *entry, const appcache_stamp_t *stamps);
+static GKeyFile *appcache_entry_to_keyfile (GVariant *entry);
+static GVariant *appcache_entry_from_keyfile(const appcache_stamp_t *stamps, GKeyFile *ini);
+GKeyFile        *appcache_lookup           (appcache_t *self, const char *appname, const appcache_stamp_t *stamps);
+void             appcache_update           (appcache_t *self, const char *appname, const appcache_stamp_t *stamps, GKeyFile *ini);
+void             appcache_remove           (appcache_t *self, const char *appname);
+
+/* ========================================================================= *
+ * APPCACHE_STAMP
+ * ========================================================================= */
+
+void
+appcache_stamp_clear(appcache_stamp_t *self)
+{
+    self->acs_ctime = -1;
+    self->acs_size  = 0;
+    self->acs_inode = 0;
+}
+
+bool
+appcache_stamp_equal(const appcache_stamp_t *self, const appcache_stamp_t *that)
+{
+    return (self->acs_ctime == that->acs_ctime &&
+            self->acs_size  == that->acs_size  &&
+            self->acs_inode == that->acs_inode);
+}
+
+/* ========================================================================= *
+ * APPCACHE
+ * ========================================================================= */
+
+struct appcache_t
+{
+    gchar      *apc_path;
+
+    /* Entries that have been looked up or updated since load */
+    GHashTable *apc_entries;
+
+    /* Entries loaded from file, but not yet claimed by anyone */
+    GHashTable *apc_stale;
+
+    /* Entries differ from what is stored in the file */
+    bool        apc_dirty;
+};
+
+static void
+appcache_ctor(appcache_t *self, const char *path)
+{
+    log_info("appcache() create");
+
+    self->apc_path    = g_strdup(path);
+    self->apc_entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                              (GDestroyNotify)g_variant_unref);
+    self->apc_stale   = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                              (GDestroyNotify)g_variant_unref);
+    self->apc_dirty   = false;
+}
+
+static void
+appcache_dtor(appcache_t *self)
+{
+    log_info("appcache() delete");
+
+    if( self->apc_stale ) {
+        g_hash_table_unref(self->apc_stale),
+            self->apc_stale = NULL;
+    }
+
+    if( self->apc_entries ) {
+        g_hash_table_unref(self->apc_entries),
+            self->apc_entries = NULL;
+    }
+
+    change_string(&self->apc_path, NULL);
+}
+
+appcache_t *
+appcache_create(const char *path)
+{
+    appcache_t *self = g_malloc0(sizeof *self);
+    appcache_ctor(self, path);
+    return self;
+}
+
+void
+appcache_delete(appcache_t *self)
+{
+    if( self ) {
+        appcache_dtor(self);
+        g_free(self);
+    }
+}
+
+void
+appcache_delete_at(appcache_t **pself)
+{
+    appcache_delete(*pself), *pself = NULL;
+}
+
+void
+appcache_delete_cb(void *self)
+{
+    appcache_delete(self);
+}
+
+/* ========================================================================= *
+ * APPCACHE_STORAGE
+ * ========================================================================= */
+
+static void
+appcache_clear(appcache_t *self)
+{
+    g_hash_table_remove_all(self->apc_entries);
+    g_hash_table_remove_all(self->apc_stale);
+    self->apc_dirty = false;
+}
+
+bool
+appcache_load(appcache_t *self)
+{
+    bool          ack    = false;
+    GError       *err    = NULL;
+    GMappedFile  *mapped = NULL;
+    GBytes       *bytes  = NULL;
+    GBytes       *data   = NULL;
+    GVariant     *root   = NULL;
+
+    if( !self )
+        goto EXIT;
+
+    appcache_clear(self);
+
+    /* Note: The whole file gets mapped in one go, and cache entries
+     *       keep referring to the mapping until they are replaced.
+     */
+    if( !(mapped = g_mapped_file_new(self->apc_path, false, &err)) ) {
+        if( g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT) )
+            log_debug("%s: load failed: %s", self->apc_path, err->message);
+        else
+            log_warning("%s: load failed: %s", self->apc_path, err->message);
+        goto EXIT;
+    }
+
+    bytes = g_mapped_file_get_bytes(mapped);
+
+    gsize size = g_bytes_get_size(bytes);
+    appcache_header_t header = {};
+    if( size < sizeof header )
+        goto REJECT;
+
+    memcpy(&header, g_bytes_get_data(bytes, NULL), sizeof header);
+    if( header.ach_magic != APPCACHE_MAGIC ||
+        header.ach_version != APPCACHE_VERSION )
+        goto REJECT;
+
+    data = g_bytes_new_from_bytes(bytes, sizeof header, size - sizeof header);
+    root = g_variant_new_from_bytes(G_VARIANT_TYPE(APPCACHE_DATA_TYPE),
+                                    data, false);
+    g_variant_ref_sink(root);
+
+    GVariantIter  iter;
+    const char   *appname = NULL;
+    GVariant     *entry   = NULL;
+    g_variant_iter_init(&iter, root);
+    while( g_variant_iter_next(&iter, "{&s@" APPCACHE_ENTRY_TYPE "}",
+                               &appname, &entry) ) {
+        g_hash_table_replace(self->apc_stale, g_strdup(appname), entry);
+    }
+
+    log_info("%s: loaded %u entries", self->apc_path,
+             g_hash_table_size(self->apc_stale));
+    ack = true;
+    goto EXIT;
+
+REJECT:
+    log_notice("%s: unsupported cache format; ignored", self->apc_path);
+
+EXIT:
+    if( root )
+        g_variant_unref(root);
+    if( data )
+        g_bytes_unref(data);
+    if( bytes )
+        g_bytes_unref(bytes);
+    if( mapped )
+        g_mapped_file_unref(mapped);
+    g_clear_error(&err);
+
+    return ack;
+}
+
+bool
+appcache_save(appcache_t *self)
+{
+    bool      ack    = false;
+    GError   *err    = NULL;
+    GVariant *root   = NULL;
+    gchar    *buffer = NULL;
+
+    if( !self )
+        goto EXIT;
+
+    /* Entries nobody asked for belong to desktop
+     * files that no longer exist -> drop them */
+    if( g_hash_table_size(self->apc_stale) > 0 ) {
+        g_hash_table_remove_all(self->apc_stale);
+        self->apc_dirty = true;
+    }
+
+    if( !self->apc_dirty ) {
+        ack = true;
+        goto EXIT;
+    }
+
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE(APPCACHE_DATA_TYPE));
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, self->apc_entries);
+    while( g_hash_table_iter_next(&iter, &key, &value) )
+        g_variant_builder_add(&builder, "{s@" APPCACHE_ENTRY_TYPE "}",
+                              key, value);
+
+    root = g_variant_ref_sink(g_variant_builder_end(&builder));
+
+    appcache_header_t header = {
+        .ach_magic   = APPCACHE_MAGIC,
+        .ach_version = APPCACHE_VERSION,
+    };
+    gsize size = sizeof header + g_variant_get_size(root);
+    buffer = g_malloc(size);
+    memcpy(buffer, &header, sizeof header);
+    g_variant_store(root, buffer + sizeof header);
+
+    /* Note: Replaces the file via rename, so that mappings
+     *       held by existing entries remain valid. */
+    if( !g_file_set_contents(self->apc_path, buffer, size, &err) ) {
+        log_warning("%s: save failed: %s", self->apc_path, err->message);
+        goto EXIT;
+    }
+
+    log_info("%s: saved %u entries", self->apc_path,
+             g_hash_table_size(self->apc_entries));
+    self->apc_dirty = false;
+    ack = true;
+
+EXIT:
+    g_free(buffer);
+    if( root )
+        g_variant_unref(root);
+    g_clear_error(&err);
+
+    return ack;
+}
+
+/* ========================================================================= *
+ * APPCACHE_ENTRY
+ * ========================================================================= */
+
+static GVariant *
+appcache_get_entry(appcache_t *self, const char *appname)
+{
+    return (g_hash_table_lookup(self->apc_entries, appname) ?:
+            g_hash_table_lookup(self->apc_stale, appname));
+}
+
+static void
+appcache_adopt_entry(appcache_t *self, const char *appname)
+{
+    gpointer key   = NULL;
+    gpointer value = NULL;
+    if( g_hash_table_lookup_extended(self->apc_stale, appname, &key, &value) ) {
+        g_hash_table_steal(self->apc_stale, appname);
+        g_hash_table_replace(self->apc_entries, key, value);
+    }
+}
+
+static bool
+appcache_entry_matches(GVariant *entry, const appcache_stamp_t *stamps)
+{
+    appcache_stamp_t cached[APPCACHE_STAMP_COUNT];
+
+    g_variant_get(entry, "(xttxtt@" APPCACHE_GROUP_TYPE ")",
+                  &cached[0].acs_ctime,
+                  &cached[0].acs_size,
+                  &cached[0].acs_inode,
+                  &cached[1].acs_ctime,
+                  &cached[1].acs_size,
+                  &cached[1].acs_inode,
+                  NULL);
+
+    for( size_t i = 0; i < APPCACHE_STAMP_COUNT; ++i ) {
+        if( !appcache_stamp_equal(&cached[i], &stamps[i]) )
+            return false;
+    }
+    return true;
+}
+
+static GKeyFile *
+appcache_entry_to_keyfile(GVariant *entry)
+{
+    GKeyFile  *ini    = g_key_file_new();
+    GString   *text   = g_string_new(NULL);
+    GVariant  *groups = g_variant_get_child_value(entry, 6);
+    GError    *err    = NULL;
+
+    /* Raw values are written back as is, so that GKeyFile
+     * escaping and list semantics are retained. */
+    GVariantIter  iter;
+    const char   *group = NULL;
+    GVariantIter *keys  = NULL;
+    g_variant_iter_init(&iter, groups);
+    while( g_variant_iter_next(&iter, "(&sa(ss))", &group, &keys) ) {
+        g_string_append_printf(text, "[%s]\n", group);
+        const char *key = NULL;
+        const char *val = NULL;
+        while( g_variant_iter_next(keys, "(&s&s)", &key, &val) )
+            g_string_append_printf(text, "%s=%s\n", key, val);
+        g_variant_iter_free(keys);
+    }
+
+    if( !g_key_file_load_from_data(ini, text->str, text->len,
+                                   G_KEY_FILE_NONE, &err) ) {
+        log_warning("cached desktop data is not valid: %s", err->message);
+        g_key_file_unref(ini), ini = NULL;
+    }
+
+    g_clear_error(&err);
+    g_variant_unref(groups);
+    g_string_free(text, true);
+
+    return ini;
+}
+
+static GVariant *
+appcache_entry_from_keyfile(const appcache_stamp_t *stamps, GKeyFile *ini)
+{
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE(APPCACHE_GROUP_TYPE));
+
+    size_t count = 0;
+    const desktop_group_t *groups = desktop_groups(&count);
+    for( size_t i = 0; i < count; ++i ) {
+        const desktop_group_t *grp = &groups[i];
+
+        /* Presence of a group is significant even if
+         * none of the keys we care about are set */
+        if( !g_key_file_has_group(ini, grp->dgr_group) )
+            continue;
+
+        g_variant_builder_open(&builder, G_VARIANT_TYPE("(sa(ss))"));
+        g_variant_builder_add(&builder, "s", grp->dgr_group);
+        g_variant_builder_open(&builder, G_VARIANT_TYPE("a(ss)"));
+        for( size_t j = 0; grp->dgr_keys[j]; ++j ) {
+            gchar *val = g_key_file_get_value(ini, grp->dgr_group,
+                                              grp->dgr_keys[j], NULL);
+            if( val ) {
+                g_variant_builder_add(&builder, "(ss)", grp->dgr_keys[j], val);
+                g_free(val);
+            }
+        }
+        g_variant_builder_close(&builder);
+        g_variant_builder_close(&builder);
+    }
+
+    GVariant *entry = g_variant_new("(xttxtt" APPCACHE_GROUP_TYPE ")",
+                                    stamps[0].acs_ctime,
+                                    stamps[0].acs_size,
+                                    stamps[0].acs_inode,
+                                    stamps[1].acs_ctime,
+                                    stamps[1].acs_size,
+                                    stamps[1].acs_inode,
+                                    &builder);
+    return g_variant_ref_sink(entry);
+}
+
+/** Get cached desktop data
+ *
+ * @param self     cache object, or NULL
+ * @param appname  application name
+ * @param stamps   current APPCACHE_STAMP_COUNT file stamps
+ *
+ * @return keyfile with cached data, or NULL if not cached / outdated
+ */
+GKeyFile *
+appcache_lookup(appcache_t *self, const char *appname, const appcache_stamp_t *stamps)
+{
+    GKeyFile *ini   = NULL;
+    GVariant *entry = NULL;
+
+    if( !self )
+        goto EXIT;
+
+    if( !(entry = appcache_get_entry(self, appname)) )
+        goto EXIT;
+
+    if( !appcache_entry_matches(entry, stamps) ) {
+        log_debug("appcache(%s): outdated", appname);
+        goto EXIT;
+    }
+
+    if( (ini = appcache_entry_to_keyfile(entry)) ) {
+        log_debug("appcache(%s): hit", appname);
+        appcache_adopt_entry(self, appname);
+    }
+
+EXIT:
+    return ini;
+}
+
+void
+appcache_update(appcache_t *self, const char *appname, const appcache_stamp_t *stamps, GKeyFile *ini)
+{
+    if( self ) {
+        log_debug("appcache(%s): update", appname);
+        g_hash_table_remove(self->apc_stale, appname);
+        g_hash_table_replace(self->apc_entries, g_strdup(appname),
+                             appcache_entry_from_keyfile(stamps, ini));
+        self->apc_dirty = true;
+    }
+}
+
+void
+appcache_remove(appcache_t *self, const char *appname)
+{
+    if( self ) {
+        g_hash_table_remove(self->apc_stale, appname);
+        if( g_hash_table_remove(self->apc_entries, appname) ) {
+            log_debug("appcache(%s): remove", appname);
+            self->apc_dirty = true;
+        }
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef  APPCACHE_H_
+# define APPCACHE_H_
+
+# include <stdbool.h>
+# include <glib.h>
+
+G_BEGIN_DECLS
+
+/* ========================================================================= *
+ * Constants
+ * ========================================================================= */
+
+/* Number of desktop files that can contribute to one appinfo:
+ * APPLICATIONS_DIRECTORY and SAILJAIL_APP_DIRECTORY.
+ */
+# define APPCACHE_STAMP_COUNT 2
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct appcache_t appcache_t;
+
+typedef struct appcache_stamp_t
+{
+    gint64  acs_ctime;  // -1 if the file does not exist
+    guint64 acs_size;
+    guint64 acs_inode;
+} appcache_stamp_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * APPCACHE_STAMP
+ * ------------------------------------------------------------------------- */
+
+void appcache_stamp_clear(appcache_stamp_t *self);
+bool appcache_stamp_equal(const appcache_stamp_t *self, const appcache_stamp_t *that);
+
+/* ------------------------------------------------------------------------- *
+ * APPCACHE
+ * ------------------------------------------------------------------------- */
+
+appcache_t *appcache_create   (const char *path);
+void        appcache_delete   (appcache_t *self);
+void        appcache_delete_at(appcache_t **pself);
+void        appcache_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * APPCACHE_STORAGE
+ * ------------------------------------------------------------------------- */
+
+bool appcache_load(appcache_t *self);
+bool appcache_save(appcache_t *self);
+
+/* ------------------------------------------------------------------------- *
+ * APPCACHE_ENTRY
+ * ------------------------------------------------------------------------- */
+
+GKeyFile *appcache_lookup(appcache_t *self, const char *appname, const appcache_stamp_t *stamps);
+void      appcache_update(appcache_t *self, const char *appname, const appcache_stamp_t *stamps, GKeyFile *ini);
+void      appcache_remove(appcache_t *self, const char *appname);
+
+G_END_DECLS
+
+#endif /* APPCACHE_H_ */
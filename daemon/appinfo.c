@@ -38,9 +38,13 @@
 #include "appinfo.h"
 
 #include "applications.h"
+#include "appcache.h"
 #include "control.h"
 #include "config.h"
+#include "desktop.h"
+#include "intern.h"
 #include "stringset.h"
+#include "permset.h"
 #include "logging.h"
 #include "util.h"
 
@@ -77,6 +81,8 @@ typedef enum
     APPINFO_DIR_COUNT
 } appinfo_dir_t;
 
+G_STATIC_ASSERT(APPINFO_DIR_COUNT == APPCACHE_STAMP_COUNT);
+
 static const char * const appinfo_state_name[] =
 {
     [APPINFO_STATE_UNSET]   = "UNSET",
@@ -106,23 +112,26 @@ typedef struct
  * APPINFO
  * ------------------------------------------------------------------------- */
 
-static void  appinfo_ctor      (appinfo_t *self, applications_t *applications, const gchar *id);
-static void  appinfo_dtor      (appinfo_t *self);
-appinfo_t   *appinfo_create    (applications_t *applications, const gchar *id);
-void         appinfo_delete    (appinfo_t *self);
-void         appinfo_delete_cb (void *self);
-gboolean     appinfo_equal     (const appinfo_t *self, const appinfo_t *that);
-gboolean     appinfo_equal_cb  (gconstpointer a, gconstpointer b);
-guint        appinfo_hash      (const appinfo_t *self);
-guint        appinfo_hash_cb   (gconstpointer key);
-GVariant    *appinfo_to_variant(const appinfo_t *self);
-gchar       *appinfo_to_string (const appinfo_t *self);
+static void      appinfo_ctor         (appinfo_t *self, applications_t *applications, const gchar *id);
+static void      appinfo_dtor         (appinfo_t *self);
+appinfo_t       *appinfo_create       (applications_t *applications, const gchar *id);
+void             appinfo_delete       (appinfo_t *self);
+void             appinfo_delete_cb    (void *self);
+gboolean         appinfo_equal        (const appinfo_t *self, const appinfo_t *that);
+gboolean         appinfo_equal_cb     (gconstpointer a, gconstpointer b);
+guint            appinfo_hash         (const appinfo_t *self);
+guint            appinfo_hash_cb      (gconstpointer key);
+static GVariant *appinfo_build_variant(const appinfo_t *self);
+static void      appinfo_drop_variant (appinfo_t *self);
+GVariant        *appinfo_to_variant   (const appinfo_t *self);
+gchar           *appinfo_to_string    (const appinfo_t *self);
 
 /* ------------------------------------------------------------------------- *
  * APPINFO_ATTRIBUTE
  * ------------------------------------------------------------------------- */
 
 bool            appinfo_valid          (const appinfo_t *self);
+bool            appinfo_deleted        (const appinfo_t *self);
 control_t      *appinfo_control        (const appinfo_t *self);
 const config_t *appinfo_config         (const appinfo_t *self);
 applications_t *appinfo_applications   (const appinfo_t *self);
@@ -133,10 +142,12 @@ bool            appinfo_dbus_auto_start(const appinfo_t *self);
  * APPINFO_PROPERTY
  * ------------------------------------------------------------------------- */
 
-static void             appinfo_set_dirty            (appinfo_t *self);
+static void             appinfo_set_dirty            (appinfo_t *self, app_change_t change);
+static void             appinfo_record_change        (appinfo_t *self, app_change_t change);
 static bool             appinfo_clear_dirty          (appinfo_t *self);
 static appinfo_state_t  appinfo_get_state            (const appinfo_t *self);
 static void             appinfo_set_state            (appinfo_t *self, appinfo_state_t state);
+bool                    appinfo_defined              (const gchar *value);
 const gchar            *appinfo_get_name             (const appinfo_t *self);
 const gchar            *appinfo_get_type             (const appinfo_t *self);
 const gchar            *appinfo_get_icon             (const appinfo_t *self);
@@ -169,11 +180,18 @@ void                    appinfo_set_mode             (appinfo_t *self, app_mode_
  * APPINFO_PERMISSIONS
  * ------------------------------------------------------------------------- */
 
-bool         appinfo_has_permission      (const appinfo_t *self, const gchar *perm);
-stringset_t *appinfo_get_permissions     (const appinfo_t *self);
-bool         appinfo_evaluate_permissions(appinfo_t *self);
-void         appinfo_set_permissions     (appinfo_t *self, const stringset_t *in);
-void         appinfo_clear_permissions   (appinfo_t *self);
+bool               appinfo_has_permission           (const appinfo_t *self, const gchar *perm);
+const permset_t   *appinfo_get_permissions          (const appinfo_t *self);
+const stringset_t *appinfo_get_requested_permissions(const appinfo_t *self);
+bool               appinfo_evaluate_permissions     (appinfo_t *self);
+void               appinfo_set_permissions          (appinfo_t *self, const stringset_t *in);
+void               appinfo_clear_permissions        (appinfo_t *self);
+
+/* ------------------------------------------------------------------------- *
+ * APPINFO_CHANGES
+ * ------------------------------------------------------------------------- */
+
+app_change_t appinfo_take_changes(appinfo_t *self);
 
 /* ------------------------------------------------------------------------- *
  * APPINFO_PARSE
@@ -182,6 +200,10 @@ void         appinfo_clear_permissions   (appinfo_t *self);
 static appinfo_file_t  appinfo_combined_file_state    (appinfo_file_t state1, appinfo_file_t state2);
 static appinfo_file_t  appinfo_check_desktop_from_path(appinfo_t *self, const gchar *path, appinfo_dir_t dir);
 bool                   appinfo_parse_desktop          (appinfo_t *self);
+bool                   appinfo_parse_begin            (appinfo_t *self, gchar **paths);
+void                   appinfo_parse_apply            (appinfo_t *self, GKeyFile *ini);
+bool                   appinfo_parse_end              (appinfo_t *self);
+static void            appinfo_parse_keyfile          (appinfo_t *self, GKeyFile *ini);
 static gchar          *appinfo_read_exec_dbus         (appinfo_t *self, GKeyFile *ini, const gchar *group);
 
 /* ------------------------------------------------------------------------- *
@@ -224,11 +246,13 @@ struct appinfo_t
     // uplink
     applications_t  *anf_applications;
 
-    gchar           *anf_appname;
+    const gchar     *anf_appname;       // interned
     appinfo_state_t  anf_state;
-    time_t           anf_dt_ctime[APPINFO_DIR_COUNT];
+    appcache_stamp_t anf_dt_stamp[APPINFO_DIR_COUNT];
     bool             anf_dirty;
+    app_change_t     anf_changes;       // not yet broadcast changes
     app_mode_t       anf_mode;
+    GVariant        *anf_variant;       // cached appinfo_to_variant() data
 
     // desktop properties
     gchar           *anf_dt_name;       // DESKTOP_KEY_NAME
@@ -248,7 +272,7 @@ struct appinfo_t
     gchar           *anf_sj_exec_dbus;         // SAILJAIL_KEY_EXEC_DBUS
     gchar           *anf_sj_data_directory;    // SAILJAIL_KEY_DATA_DIRECTORY
     stringset_t     *anf_sj_permissions_in;    // SAILJAIL_KEY_PERMISSIONS
-    stringset_t     *anf_sj_permissions_out;
+    permset_t        anf_sj_permissions_out;
 };
 
 /* Internally used placeholder for NULL string values.
@@ -260,14 +284,16 @@ static void
 appinfo_ctor(appinfo_t *self, applications_t *applications, const gchar *id)
 {
     self->anf_applications               = applications;
-    self->anf_appname                    = g_strdup(id);
+    self->anf_appname                    = intern_acquire(id);
 
     self->anf_state                      = APPINFO_STATE_UNSET;
-    self->anf_dt_ctime[APPINFO_DIR_MAIN] = -1;
-    self->anf_dt_ctime[APPINFO_DIR_ALT]  = -1;
+    appcache_stamp_clear(&self->anf_dt_stamp[APPINFO_DIR_MAIN]);
+    appcache_stamp_clear(&self->anf_dt_stamp[APPINFO_DIR_ALT]);
     self->anf_dirty                      = false;
+    self->anf_changes                    = 0;
 
     self->anf_mode                       = APP_MODE_NORMAL;
+    self->anf_variant                    = NULL;
 
     self->anf_dt_name                    = NULL;
     self->anf_dt_type                    = NULL;
@@ -280,7 +306,7 @@ appinfo_ctor(appinfo_t *self, applications_t *applications, const gchar *id)
     self->anf_mo_method                  = NULL;
 
     self->anf_sj_permissions_in          = stringset_create();
-    self->anf_sj_permissions_out         = stringset_create();
+    permset_init(&self->anf_sj_permissions_out);
     self->anf_sj_organization_name       = NULL;
     self->anf_sj_application_name        = NULL;
     self->anf_sj_exec_dbus               = NULL;
@@ -308,9 +334,10 @@ appinfo_dtor(appinfo_t *self)
     appinfo_set_exec_dbus(self, NULL);
     appinfo_set_data_directory(self, NULL);
     stringset_delete_at(&self->anf_sj_permissions_in);
-    stringset_delete_at(&self->anf_sj_permissions_out);
 
-    change_string(&self->anf_appname, NULL);
+    appinfo_drop_variant(self);
+
+    intern_release_at(&self->anf_appname);
     self->anf_applications = NULL;
 }
 
@@ -361,8 +388,8 @@ appinfo_hash_cb(gconstpointer key)
     return appinfo_hash(key);
 }
 
-GVariant *
-appinfo_to_variant(const appinfo_t *self)
+static GVariant *
+appinfo_build_variant(const appinfo_t *self)
 {
     GVariantBuilder *builder = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
 
@@ -372,16 +399,16 @@ appinfo_to_variant(const appinfo_t *self)
     }
 
     auto void add_string(const char *label, const char *value) {
-        if( value && value != appinfo_unknown ) {
+        if( appinfo_defined(value) ) {
             g_variant_builder_add(builder, "{sv}", label,
                                   g_variant_new_string(value));
         }
     }
 
-    auto void add_stringset(const char *label, const stringset_t *value) {
+    auto void add_permset(const char *label, const permset_t *value) {
         if( value ) {
             g_variant_builder_add(builder, "{sv}", label,
-                                  stringset_to_variant(value));
+                                  permset_to_variant(value));
         }
     }
 
@@ -409,7 +436,7 @@ appinfo_to_variant(const appinfo_t *self)
         add_string(SAILJAIL_KEY_APPLICATION_NAME, appinfo_get_application_name(self));
         add_string(SAILJAIL_KEY_EXEC_DBUS, appinfo_get_exec_dbus(self));
         add_string(SAILJAIL_KEY_DATA_DIRECTORY, appinfo_get_data_directory(self));
-        add_stringset(SAILJAIL_KEY_PERMISSIONS, appinfo_get_permissions(self));
+        add_permset(SAILJAIL_KEY_PERMISSIONS, appinfo_get_permissions(self));
     }
 
     GVariant *variant = g_variant_builder_end(builder);
@@ -418,6 +445,40 @@ appinfo_to_variant(const appinfo_t *self)
     return variant;
 }
 
+static void
+appinfo_drop_variant(appinfo_t *self)
+{
+    if( self->anf_variant ) {
+        g_variant_unref(self->anf_variant),
+            self->anf_variant = NULL;
+    }
+}
+
+/** Get application details as a{sv} dictionary
+ *
+ * The dictionary is built on demand and then cached until some
+ * application property changes, so that repeated D-Bus queries
+ * about the same application can share the same data.
+ *
+ * @param self  appinfo object, or NULL
+ *
+ * @return new reference to a non-floating variant, to be released
+ *         via g_variant_unref()
+ */
+GVariant *
+appinfo_to_variant(const appinfo_t *self)
+{
+    if( !self )
+        return g_variant_ref_sink(appinfo_build_variant(NULL));
+
+    /* Cached data is not part of the logical object state */
+    appinfo_t *cache = (appinfo_t *)self;
+    if( !cache->anf_variant )
+        cache->anf_variant = g_variant_ref_sink(appinfo_build_variant(self));
+
+    return g_variant_ref(cache->anf_variant);
+}
+
 gchar *
 appinfo_to_string(const appinfo_t *self)
 {
@@ -440,6 +501,12 @@ appinfo_valid(const appinfo_t *self)
     return appinfo_get_state(self) == APPINFO_STATE_VALID;
 }
 
+bool
+appinfo_deleted(const appinfo_t *self)
+{
+    return appinfo_get_state(self) == APPINFO_STATE_DELETED;
+}
+
 control_t *
 appinfo_control(const appinfo_t *self)
 {
@@ -478,9 +545,17 @@ appinfo_dbus_auto_start(const appinfo_t *self)
  * ------------------------------------------------------------------------- */
 
 static void
-appinfo_set_dirty(appinfo_t *self)
+appinfo_set_dirty(appinfo_t *self, app_change_t change)
 {
     self->anf_dirty = true;
+    appinfo_record_change(self, change);
+}
+
+static void
+appinfo_record_change(appinfo_t *self, app_change_t change)
+{
+    self->anf_changes |= change;
+    appinfo_drop_variant(self);
 }
 
 static bool
@@ -506,7 +581,7 @@ appinfo_set_state(appinfo_t *self, appinfo_state_t state)
                   appinfo_state_name[self->anf_state],
                   appinfo_state_name[state]);
         self->anf_state = state;
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
     }
 }
 
@@ -514,6 +589,13 @@ appinfo_set_state(appinfo_t *self, appinfo_state_t state)
  * Getters
  * - - - - - - - - - - - - - - - - - - - */
 
+bool
+appinfo_defined(const gchar *value)
+{
+    /* String getters return placeholder instead of NULL */
+    return value && value != appinfo_unknown;
+}
+
 const gchar *
 appinfo_get_name(const appinfo_t *self)
 {
@@ -616,84 +698,84 @@ void
 appinfo_set_name(appinfo_t *self, const gchar *name)
 {
     if( change_string(&self->anf_dt_name, name) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
 }
 
 void
 appinfo_set_type(appinfo_t *self, const gchar *type)
 {
     if( change_string(&self->anf_dt_type, type) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
 }
 
 void
 appinfo_set_icon(appinfo_t *self, const gchar *icon)
 {
     if( change_string(&self->anf_dt_icon, icon) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
 }
 
 void
 appinfo_set_exec(appinfo_t *self, const gchar *exec)
 {
     if( change_string(&self->anf_dt_exec, exec) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
 }
 
 void
 appinfo_set_no_display(appinfo_t *self, bool no_display)
 {
     if( change_boolean(&self->anf_dt_no_display, no_display) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
 }
 
 void
 appinfo_set_service(appinfo_t *self, const gchar *service)
 {
     if( change_string(&self->anf_mo_service, service) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
 }
 
 void
 appinfo_set_object(appinfo_t *self, const gchar *object)
 {
     if( change_string(&self->anf_mo_object, object) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
 }
 
 void
 appinfo_set_method(appinfo_t *self, const gchar *method)
 {
     if( change_string(&self->anf_mo_method, method) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
 }
 
 void
 appinfo_set_organization_name(appinfo_t *self, const gchar *organization_name)
 {
     if( change_string(&self->anf_sj_organization_name, organization_name) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
 }
 
 void
 appinfo_set_application_name(appinfo_t *self, const gchar *application_name)
 {
     if( change_string(&self->anf_sj_application_name, application_name) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
 }
 
 void
 appinfo_set_exec_dbus(appinfo_t *self, const gchar *exec_dbus)
 {
     if( change_string(&self->anf_sj_exec_dbus, exec_dbus) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
 }
 
 void
 appinfo_set_data_directory(appinfo_t *self, const gchar *data_directory)
 {
     if( change_string(&self->anf_sj_data_directory, data_directory) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
 }
 
 void
@@ -701,7 +783,7 @@ appinfo_set_mode(appinfo_t *self, app_mode_t mode)
 {
     if( self->anf_mode != mode ) {
         self->anf_mode = mode;
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_DESKTOP);
     }
 }
 
@@ -712,28 +794,43 @@ appinfo_set_mode(appinfo_t *self, app_mode_t mode)
 bool
 appinfo_has_permission(const appinfo_t *self, const gchar *perm)
 {
-    return stringset_has_item(appinfo_get_permissions(self), perm);
+    return permset_has_name(appinfo_get_permissions(self), perm);
 }
 
-stringset_t *
+const permset_t *
 appinfo_get_permissions(const appinfo_t *self)
 {
-    return self->anf_sj_permissions_out;
+    return &self->anf_sj_permissions_out;
+}
+
+const stringset_t *
+appinfo_get_requested_permissions(const appinfo_t *self)
+{
+    return self->anf_sj_permissions_in;
 }
 
 bool
 appinfo_evaluate_permissions(appinfo_t *self)
 {
-    bool changed = false;
     const stringset_t *mask = control_available_permissions(appinfo_control(self));
-    stringset_t *temp = stringset_filter_in(self->anf_sj_permissions_in, mask);
+    permset_t temp;
 
-    if( stringset_assign(self->anf_sj_permissions_out, temp) )
-        changed = true;
+    permset_init(&temp);
+    for( const GList *iter = stringset_list(self->anf_sj_permissions_in);
+         iter; iter = iter->next ) {
+        if( stringset_has_item(mask, iter->data) )
+            permset_add_name(&temp, iter->data);
+    }
 
-    stringset_delete(temp);
+    if( !permset_assign(&self->anf_sj_permissions_out, &temp) )
+        return false;
 
-    return changed;
+    /* Changes are reported to the caller instead of marking appinfo
+     * dirty, but they still need to be broadcast and cached data
+     * must not be used anymore.
+     */
+    appinfo_record_change(self, APP_CHANGE_PERMISSIONS);
+    return true;
 }
 
 void
@@ -741,14 +838,32 @@ appinfo_set_permissions(appinfo_t *self, const stringset_t *in)
 {
     stringset_assign(self->anf_sj_permissions_in, in);
     if( appinfo_evaluate_permissions(self) )
-        appinfo_set_dirty(self);
+        appinfo_set_dirty(self, APP_CHANGE_PERMISSIONS);
 }
 
 void
 appinfo_clear_permissions(appinfo_t *self)
 {
-    if( stringset_clear(appinfo_get_permissions(self)) )
-        appinfo_set_dirty(self);
+    if( permset_clear(&self->anf_sj_permissions_out) )
+        appinfo_set_dirty(self, APP_CHANGE_PERMISSIONS);
+}
+
+/* ------------------------------------------------------------------------- *
+ * APPINFO_CHANGES
+ * ------------------------------------------------------------------------- */
+
+/** Get and clear changes made since the previous call
+ *
+ * @param self  appinfo object
+ *
+ * @return mask of APP_CHANGE_DESKTOP and APP_CHANGE_PERMISSIONS bits
+ */
+app_change_t
+appinfo_take_changes(appinfo_t *self)
+{
+    app_change_t changes = self->anf_changes;
+    self->anf_changes = 0;
+    return changes;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -809,23 +924,29 @@ appinfo_check_desktop_from_path(appinfo_t *self, const gchar *path, appinfo_dir_
     if( stat(path, &st) == -1 ) {
         if( errno == ENOENT ) {
             log_debug("%s: could not stat: %m", path);
-            /* If file existed before, self->anf_dt_ctime[dir] != -1 */
-            state = self->anf_dt_ctime[dir] != -1 ? APPINFO_FILE_DELETED : APPINFO_FILE_MISSING;
+            /* If file existed before, stamp ctime != -1 */
+            state = self->anf_dt_stamp[dir].acs_ctime != -1 ? APPINFO_FILE_DELETED : APPINFO_FILE_MISSING;
         }
         else {
             log_warning("%s: could not stat: %m", path);
             state = APPINFO_FILE_INVALID;
         }
-        self->anf_dt_ctime[dir] = -1;
+        appcache_stamp_clear(&self->anf_dt_stamp[dir]);
         goto EXIT;
     }
 
-    if( self->anf_dt_ctime[dir] == st.st_ctime ) {
+    appcache_stamp_t stamp = {
+        .acs_ctime = st.st_ctime,
+        .acs_size  = st.st_size,
+        .acs_inode = st.st_ino,
+    };
+
+    if( appcache_stamp_equal(&self->anf_dt_stamp[dir], &stamp) ) {
         /* Retain current state */
         goto EXIT;
     }
 
-    self->anf_dt_ctime[dir] = st.st_ctime;
+    self->anf_dt_stamp[dir] = stamp;
 
     /* Test file readability */
     if( access(path, R_OK) == -1 ) {
@@ -840,14 +961,53 @@ EXIT:
     return state;
 }
 
+/** Parse desktop files synchronously
+ *
+ * @param self  appinfo object
+ *
+ * @return true if appinfo changed, false otherwise
+ */
 bool
 appinfo_parse_desktop(appinfo_t *self)
 {
+    gchar *paths[APPCACHE_STAMP_COUNT] = { };
+
+    if( appinfo_parse_begin(self, paths) ) {
+        GKeyFile *ini = desktop_load(paths, G_N_ELEMENTS(paths));
+        appinfo_parse_apply(self, ini);
+        if( ini )
+            g_key_file_unref(ini);
+    }
+
+    for( size_t i = 0; i < G_N_ELEMENTS(paths); ++i )
+        g_free(paths[i]);
+
+    return appinfo_parse_end(self);
+}
+
+/** Check desktop files and determine whether they need to be loaded
+ *
+ * Changes in desktop file state are applied directly, as is cached
+ * data when neither of the files has changed since the cache was
+ * written.
+ *
+ * Otherwise the files given in paths need to be loaded, and the
+ * result passed to appinfo_parse_apply(). Loading does not touch
+ * appinfo state and can be done in a worker thread.
+ *
+ * @param self   appinfo object
+ * @param paths  array of APPCACHE_STAMP_COUNT paths to fill in,
+ *               unused entries are set to NULL
+ *
+ * @return true if desktop files need to be loaded, false otherwise
+ */
+bool
+appinfo_parse_begin(appinfo_t *self, gchar **paths)
+{
+    bool           load        = false;
     GKeyFile      *ini         = NULL;
     gchar         *path1       = NULL;
     gchar         *path2       = NULL;
-    GError        *err         = NULL;
-    gchar        **permissions = NULL;
     appinfo_file_t file1_state = 0;
     appinfo_file_t file2_state = 0;
     appinfo_file_t combined    = 0;
@@ -871,16 +1031,62 @@ appinfo_parse_desktop(appinfo_t *self)
         goto EXIT;
     }
 
-    ini = g_key_file_new();
-    if( file1_state <= APPINFO_FILE_CHANGED && !keyfile_merge(ini, path1) ) {
-        appinfo_set_state(self, APPINFO_STATE_INVALID);
+    /* Use cached data if neither of the files has changed since
+     * the cache was written, otherwise load and cache the files.
+     */
+    appcache_t *appcache = applications_appcache(appinfo_applications(self));
+    if( (ini = appcache_lookup(appcache, appinfo_id(self), self->anf_dt_stamp)) ) {
+        appinfo_parse_keyfile(self, ini);
+        g_key_file_unref(ini);
         goto EXIT;
     }
-    if( file2_state <= APPINFO_FILE_CHANGED && !keyfile_merge(ini, path2) ) {
+
+    if( file1_state <= APPINFO_FILE_CHANGED )
+        paths[APPINFO_DIR_MAIN] = path1, path1 = NULL;
+    if( file2_state <= APPINFO_FILE_CHANGED )
+        paths[APPINFO_DIR_ALT] = path2, path2 = NULL;
+    load = true;
+
+EXIT:
+    g_free(path1);
+    g_free(path2);
+
+    return load;
+}
+
+/** Apply data loaded from desktop files
+ *
+ * @param self  appinfo object
+ * @param ini   data obtained via desktop_load(), or NULL on failure
+ */
+void
+appinfo_parse_apply(appinfo_t *self, GKeyFile *ini)
+{
+    if( !ini ) {
         appinfo_set_state(self, APPINFO_STATE_INVALID);
-        goto EXIT;
     }
+    else {
+        appcache_t *appcache = applications_appcache(appinfo_applications(self));
+        appcache_update(appcache, appinfo_id(self), self->anf_dt_stamp, ini);
+        appinfo_parse_keyfile(self, ini);
+    }
+}
+
+/** Finish parsing desktop files
+ *
+ * @param self  appinfo object
+ *
+ * @return true if appinfo changed, false otherwise
+ */
+bool
+appinfo_parse_end(appinfo_t *self)
+{
+    return appinfo_clear_dirty(self);
+}
 
+static void
+appinfo_parse_keyfile(appinfo_t *self, GKeyFile *ini)
+{
     //log_debug("appinfo(%s): updating", appinfo_id(self));
 
     /* Parse desktop properties */
@@ -988,16 +1194,6 @@ appinfo_parse_desktop(appinfo_t *self)
         appinfo_set_state(self, APPINFO_STATE_VALID);
     else
         appinfo_set_state(self, APPINFO_STATE_INVALID);
-
-EXIT:
-    g_clear_error(&err);
-    g_strfreev(permissions);
-    if( ini )
-        g_key_file_unref(ini);
-    g_free(path1);
-    g_free(path2);
-
-    return appinfo_clear_dirty(self);
 }
 
 static gchar *
@@ -47,6 +47,7 @@ G_BEGIN_DECLS
  * ========================================================================= */
 
 typedef struct stringset_t    stringset_t;
+typedef struct permset_t      permset_t;
 typedef struct applications_t applications_t;
 typedef struct appinfo_t      appinfo_t;
 typedef struct config_t       config_t;
@@ -58,6 +59,17 @@ typedef enum {
     APP_MODE_NONE,
 } app_mode_t;
 
+/** What has changed, bits are exposed via D-Bus as is */
+typedef enum {
+    APP_CHANGE_DESKTOP     = 1 << 0, // desktop file / sailjail metadata
+    APP_CHANGE_PERMISSIONS = 1 << 1, // permissions application may use
+    APP_CHANGE_ALLOWED     = 1 << 2, // per user: launch allowed
+    APP_CHANGE_AGREED      = 1 << 3, // per user: license agreed
+    APP_CHANGE_GRANTED     = 1 << 4, // per user: granted permissions
+    APP_CHANGE_ADDED       = 1 << 5, // changelog: application added
+    APP_CHANGE_REMOVED     = 1 << 6, // changelog: application removed
+} app_change_t;
+
 /* ========================================================================= *
  * Prototypes
  * ========================================================================= */
@@ -81,6 +93,7 @@ gchar     *appinfo_to_string (const appinfo_t *self);
  * ------------------------------------------------------------------------- */
 
 bool            appinfo_valid          (const appinfo_t *self);
+bool            appinfo_deleted        (const appinfo_t *self);
 control_t      *appinfo_control        (const appinfo_t *self);
 const config_t *appinfo_config         (const appinfo_t *self);
 applications_t *appinfo_applications   (const appinfo_t *self);
@@ -91,6 +104,7 @@ bool            appinfo_dbus_auto_start(const appinfo_t *self);
  * APPINFO_PROPERTY
  * ------------------------------------------------------------------------- */
 
+bool         appinfo_defined              (const gchar *value);
 const gchar *appinfo_get_name             (const appinfo_t *self);
 const gchar *appinfo_get_type             (const appinfo_t *self);
 const gchar *appinfo_get_icon             (const appinfo_t *self);
@@ -123,17 +137,27 @@ void         appinfo_set_mode             (appinfo_t *self, app_mode_t mode);
  * APPINFO_PERMISSIONS
  * ------------------------------------------------------------------------- */
 
-bool         appinfo_has_permission      (const appinfo_t *self, const gchar *perm);
-stringset_t *appinfo_get_permissions     (const appinfo_t *self);
-bool         appinfo_evaluate_permissions(appinfo_t *self);
-void         appinfo_set_permissions     (appinfo_t *self, const stringset_t *in);
-void         appinfo_clear_permissions   (appinfo_t *self);
+bool               appinfo_has_permission           (const appinfo_t *self, const gchar *perm);
+const permset_t   *appinfo_get_permissions          (const appinfo_t *self);
+const stringset_t *appinfo_get_requested_permissions(const appinfo_t *self);
+bool               appinfo_evaluate_permissions     (appinfo_t *self);
+void               appinfo_set_permissions          (appinfo_t *self, const stringset_t *in);
+void               appinfo_clear_permissions        (appinfo_t *self);
+
+/* ------------------------------------------------------------------------- *
+ * APPINFO_CHANGES
+ * ------------------------------------------------------------------------- */
+
+app_change_t appinfo_take_changes(appinfo_t *self);
 
 /* ------------------------------------------------------------------------- *
  * APPINFO_PARSE
  * ------------------------------------------------------------------------- */
 
 bool appinfo_parse_desktop(appinfo_t *self);
+bool appinfo_parse_begin  (appinfo_t *self, gchar **paths);
+void appinfo_parse_apply  (appinfo_t *self, GKeyFile *ini);
+bool appinfo_parse_end    (appinfo_t *self);
 
 G_END_DECLS
 
@@ -38,14 +38,15 @@
 
 #include "logging.h"
 #include "control.h"
+#include "intern.h"
 #include "stringset.h"
 #include "appinfo.h"
+#include "appcache.h"
+#include "desktop.h"
 #include "util.h"
+#include "watcher.h"
 
 #include <glob.h>
-#include <fnmatch.h>
-
-#include <gio/gio.h>
 
 /* ========================================================================= *
  * CONSTANTS
@@ -53,6 +54,16 @@
 
 #define APPLICATIONS_RESCAN_DELAY            1000 // [ms]
 
+/* When more than this many desktop files have changed, it is
+ * cheaper to just rescan everything.
+ */
+#define APPLICATIONS_DIRTY_MAX               128
+
+/* Upper limit for number of threads used for parsing desktop
+ * files during full rescans.
+ */
+#define APPLICATIONS_LOAD_THREADS_MAX        8
+
 /* ========================================================================= *
  * Types
  * ========================================================================= */
@@ -78,7 +89,7 @@ applications_t *applications_create   (control_t *control);
 void            applications_delete   (applications_t *self);
 void            applications_delete_at(applications_t **pself);
 void            applications_delete_cb(void *self);
-void            applications_rethink  (applications_t *self);
+void            applications_rethink  (applications_t *self, const stringset_t *permissions);
 
 /* ------------------------------------------------------------------------- *
  * APPLICATIONS_ATTRIBUTES
@@ -88,6 +99,7 @@ control_t         *applications_control  (const applications_t *self);
 const stringset_t *applications_available(applications_t *self);
 appinfo_t         *applications_appinfo  (applications_t *self, const char *appname);
 const config_t    *applications_config   (const applications_t *self);
+appcache_t        *applications_appcache (const applications_t *self);
 
 /* ------------------------------------------------------------------------- *
  * APPLICATIONS_NOTIFY
@@ -99,22 +111,26 @@ static void applications_notify_changed(applications_t *self, GHashTable *change
  * APPLICATIONS_MONITOR
  * ------------------------------------------------------------------------- */
 
-static applications_monitor_t  applications_get_monitor      (applications_t *self, GFileMonitor *mon);
-static const char             *applications_monitor_dir_path (applications_monitor_t monitor);
-static const char             *applications_monitor_name     (applications_monitor_t monitor);
-static void                    applications_start_monitor_dir(applications_t *self, applications_monitor_t monitor);
-static void                    applications_start_monitor    (applications_t *self);
-static void                    applications_stop_monitor_dir (applications_t *self, applications_monitor_t monitor);
-static void                    applications_stop_monitor     (applications_t *self);
-static bool                    applications_monitor_p        (const gchar *path);
-static void                    applications_monitor_cb       (GFileMonitor *mon, GFile *file1, GFile *file2, GFileMonitorEvent event, gpointer aptr);
+static const char *applications_monitor_dir_path (applications_monitor_t monitor);
+static const char *applications_monitor_name     (applications_monitor_t monitor);
+static void        applications_start_monitor_dir(applications_t *self, applications_monitor_t monitor);
+static void        applications_start_monitor    (applications_t *self);
+static void        applications_stop_monitor_dir (applications_t *self, applications_monitor_t monitor);
+static void        applications_stop_monitor     (applications_t *self);
+static void        applications_mark_dirty       (applications_t *self, const gchar *name);
+static void        applications_mark_all_dirty   (applications_t *self);
+static void        applications_monitor_cb       (const gchar *name, gpointer aptr);
 
 /* ------------------------------------------------------------------------- *
  * APPLICATIONS_SCAN
  * ------------------------------------------------------------------------- */
 
+static guint    applications_load_threads (void);
 static void     applications_scan_pattern (GHashTable *scanned, const char *pattern);
 static void     applications_scan_now     (applications_t *self);
+static void     applications_scan_dirty   (applications_t *self);
+static void     applications_scan_finish  (applications_t *self, GHashTable *changed);
+static void     applications_rescan_now   (applications_t *self);
 static gboolean applications_rescan_cb    (gpointer aptr);
 static void     applications_rescan_later (applications_t *self);
 static bool     applications_cancel_rescan(applications_t *self);
@@ -127,6 +143,14 @@ static appinfo_t *applications_get_appinfo   (const applications_t *self, const
 static appinfo_t *applications_add_appinfo   (applications_t *self, const char *appname);
 static bool       applications_remove_appinfo(applications_t *self, const char *appname);
 
+/* ------------------------------------------------------------------------- *
+ * APPLICATIONS_PERMISSIONS
+ * ------------------------------------------------------------------------- */
+
+static void        applications_index_appinfo  (applications_t *self, appinfo_t *appinfo);
+static void        applications_unindex_appinfo(applications_t *self, const char *appname);
+const stringset_t *applications_by_permission  (applications_t *self, const char *permission);
+
 /* ========================================================================= *
  * APPLICATIONS
  * ========================================================================= */
@@ -137,8 +161,13 @@ struct applications_t
     control_t             *aps_control;
     stringset_t           *aps_available;
     guint                  aps_rescan_id;
-    GFileMonitor          *aps_monitor_objs[DIRECTORY_MONITOR_COUNT];
+    stringset_t           *aps_dirty;
+    bool                   aps_all_dirty;
+    guint                  aps_monitor_ids[DIRECTORY_MONITOR_COUNT];
     GHashTable            *aps_appinfo_lut;
+    appcache_t            *aps_appcache;
+    GHashTable            *aps_permission_lut; // permission -> requesting apps
+    GHashTable            *aps_requested_lut;  // app -> indexed permissions
 };
 
 static void
@@ -150,15 +179,35 @@ applications_ctor(applications_t *self, control_t *control)
     self->aps_control     = control;
     self->aps_available   = stringset_create();
     self->aps_rescan_id   = 0;
+    self->aps_dirty       = stringset_create();
+    self->aps_all_dirty   = false;
 
-    self->aps_monitor_objs[APPLICATIONS_DIRECTORY_MONITOR] = NULL;
-    self->aps_monitor_objs[SAILJAIL_APP_DIRECTORY_MONITOR] = NULL;
+    self->aps_monitor_ids[APPLICATIONS_DIRECTORY_MONITOR] = 0;
+    self->aps_monitor_ids[SAILJAIL_APP_DIRECTORY_MONITOR] = 0;
 
     self->aps_appinfo_lut = g_hash_table_new_full(g_str_hash,
                                                   g_str_equal,
-                                                  g_free,
+                                                  intern_release_cb,
                                                   appinfo_delete_cb);
 
+    /* Reverse index for re-evaluating only applications that
+     * are affected by changes in available permissions.
+     */
+    self->aps_permission_lut = g_hash_table_new_full(g_str_hash,
+                                                     g_str_equal,
+                                                     intern_release_cb,
+                                                     stringset_delete_cb);
+    self->aps_requested_lut  = g_hash_table_new_full(g_str_hash,
+                                                     g_str_equal,
+                                                     intern_release_cb,
+                                                     stringset_delete_cb);
+
+    /* Desktop data that has not changed since the previous
+     * run does not need to be parsed again.
+     */
+    self->aps_appcache = appcache_create(APPCACHE_PATH);
+    appcache_load(self->aps_appcache);
+
     /* Fetch initial state */
     applications_start_monitor(self);
     applications_scan_now(self);
@@ -181,6 +230,19 @@ applications_dtor(applications_t *self)
             self->aps_appinfo_lut = NULL;
     }
 
+    if( self->aps_requested_lut ) {
+        g_hash_table_unref(self->aps_requested_lut),
+            self->aps_requested_lut = NULL;
+    }
+
+    if( self->aps_permission_lut ) {
+        g_hash_table_unref(self->aps_permission_lut),
+            self->aps_permission_lut = NULL;
+    }
+
+    appcache_delete_at(&self->aps_appcache);
+
+    stringset_delete_at(&self->aps_dirty);
     stringset_delete_at(&self->aps_available);
 }
 
@@ -227,7 +289,7 @@ const stringset_t *
 applications_available(applications_t *self)
 {
     if( applications_cancel_rescan(self) )
-        applications_scan_now(self);
+        applications_rescan_now(self);
     return self->aps_available;
 }
 
@@ -247,6 +309,12 @@ applications_config(const applications_t *self)
     return control_config(applications_control(self));
 }
 
+appcache_t *
+applications_appcache(const applications_t *self)
+{
+    return self->aps_appcache;
+}
+
 /* ========================================================================= *
  * APPLICATIONS_NOTIFY
  * ========================================================================= */
@@ -262,15 +330,6 @@ applications_notify_changed(applications_t *self, GHashTable *changed)
  * APPLICATIONS_MONITOR
  * ========================================================================= */
 
-static applications_monitor_t
-applications_get_monitor(applications_t *self, GFileMonitor *mon)
-{
-    for( applications_monitor_t monitor = 0; monitor < DIRECTORY_MONITOR_COUNT; ++monitor )
-        if( self->aps_monitor_objs[monitor] == mon )
-            return monitor;
-    return DIRECTORY_MONITOR_COUNT;
-}
-
 static const char *
 applications_monitor_dir_path(applications_monitor_t monitor)
 {
@@ -298,16 +357,10 @@ applications_start_monitor_dir(applications_t *self, applications_monitor_t moni
 {
     applications_stop_monitor_dir(self, monitor);
 
-    GFileMonitorFlags flags = G_FILE_MONITOR_WATCH_MOVES;
-    GFile *file = g_file_new_for_path(applications_monitor_dir_path(monitor));
-    if( file ) {
-        if( (self->aps_monitor_objs[monitor] = g_file_monitor_directory(file, flags, 0, 0)) ) {
-            g_signal_connect(self->aps_monitor_objs[monitor], "changed",
-                             G_CALLBACK(applications_monitor_cb), self);
-            log_info("%s: started", applications_monitor_name(monitor));
-        }
-        g_object_unref(file);
-    }
+    self->aps_monitor_ids[monitor] =
+        watcher_add(applications_monitor_dir_path(monitor),
+                    APPLICATIONS_PATTERN, applications_monitor_cb, self);
+    log_info("%s: started", applications_monitor_name(monitor));
 }
 
 static void
@@ -320,10 +373,9 @@ applications_start_monitor(applications_t *self)
 static void
 applications_stop_monitor_dir(applications_t *self, applications_monitor_t monitor)
 {
-    if( self->aps_monitor_objs[monitor] ) {
+    if( self->aps_monitor_ids[monitor] ) {
         log_info("%s: stopped", applications_monitor_name(monitor));
-        g_object_unref(self->aps_monitor_objs[monitor]),
-            self->aps_monitor_objs[monitor] = NULL;
+        watcher_remove_at(&self->aps_monitor_ids[monitor]);
     }
 }
 
@@ -334,50 +386,88 @@ applications_stop_monitor(applications_t *self)
         applications_stop_monitor_dir(self, monitor);
 }
 
-static bool
-applications_monitor_p(const gchar *path)
+static void
+applications_mark_dirty(applications_t *self, const gchar *name)
+{
+    if( self->aps_all_dirty )
+        return;
+
+    stringset_add_item_steal(self->aps_dirty, path_to_desktop_name(name));
+
+    if( stringset_size(self->aps_dirty) > APPLICATIONS_DIRTY_MAX )
+        applications_mark_all_dirty(self);
+}
+
+static void
+applications_mark_all_dirty(applications_t *self)
 {
-    path = path_basename(path);
-    return path && fnmatch(APPLICATIONS_PATTERN, path, FNM_PATHNAME) == 0;
+    self->aps_all_dirty = true;
+    stringset_clear(self->aps_dirty);
 }
 
 static void
-applications_monitor_cb(GFileMonitor      *mon,
-                        GFile             *file1,
-                        GFile             *file2,
-                        GFileMonitorEvent  event,
-                        gpointer           aptr)
+applications_monitor_cb(const gchar *name, gpointer aptr)
 {
     applications_t *self = aptr;
 
-    const char *path1 = file1 ? g_file_peek_path(file1) : NULL;
-    const char *path2 = file2 ? g_file_peek_path(file2) : NULL;
-    bool trigger = (applications_monitor_p(path1) ||
-                    applications_monitor_p(path2));
-
-    if( trigger ) {
-        log_info("%s: trigger @ %s %s", applications_monitor_name(applications_get_monitor(self, mon)),
-                 path1, path2);
-        applications_rescan_later(self);
+    if( !name ) {
+        /* Directory level change -> rescan everything */
+        applications_mark_all_dirty(self);
     }
+    else {
+        /* Note: Rescanning an application checks desktop files
+         *       from both directories, so it does not matter
+         *       which one of those triggered the rescan.
+         */
+        applications_mark_dirty(self, name);
+    }
+
+    log_info("APPLICATIONS MONITOR: trigger @ %s", name ?: "*");
+    applications_rescan_later(self);
 }
 
 /* ========================================================================= *
  * APPLICATIONS_SCAN
  * ========================================================================= */
 
+/** Re-evaluate permissions of applications
+ *
+ * @param self         applications object
+ * @param permissions  permissions that have been added / removed,
+ *                     or NULL to re-evaluate all applications
+ */
 void
-applications_rethink(applications_t *self)
+applications_rethink(applications_t *self, const stringset_t *permissions)
 {
     GHashTable *changed = g_hash_table_new_full(g_str_hash, g_str_equal,
                                                 g_free, NULL);
 
-    GHashTableIter iter;
-    gpointer key, value;
-    g_hash_table_iter_init(&iter, self->aps_appinfo_lut);
-    while( g_hash_table_iter_next(&iter, &key, &value) ) {
-        if( appinfo_evaluate_permissions(value) )
-            g_hash_table_add(changed, g_strdup(key));
+    if( !permissions ) {
+        GHashTableIter iter;
+        gpointer key, value;
+        g_hash_table_iter_init(&iter, self->aps_appinfo_lut);
+        while( g_hash_table_iter_next(&iter, &key, &value) ) {
+            if( appinfo_evaluate_permissions(value) )
+                g_hash_table_add(changed, g_strdup(key));
+        }
+    }
+    else {
+        /* Only applications that request changed permissions
+         * can end up with different set of permissions.
+         */
+        for( const GList *perm = stringset_list(permissions); perm; perm = perm->next ) {
+            const stringset_t *apps = g_hash_table_lookup(self->aps_permission_lut,
+                                                          perm->data);
+            if( !apps )
+                continue;
+            for( const GList *app = stringset_list(apps); app; app = app->next ) {
+                if( g_hash_table_contains(changed, app->data) )
+                    continue;
+                appinfo_t *appinfo = applications_get_appinfo(self, app->data);
+                if( appinfo && appinfo_evaluate_permissions(appinfo) )
+                    g_hash_table_add(changed, g_strdup(app->data));
+            }
+        }
     }
 
     if( g_hash_table_size(changed) > 0 )
@@ -386,6 +476,12 @@ applications_rethink(applications_t *self)
     g_hash_table_unref(changed);
 }
 
+static guint
+applications_load_threads(void)
+{
+    return MIN(g_get_num_processors(), APPLICATIONS_LOAD_THREADS_MAX);
+}
+
 static void
 applications_scan_pattern(GHashTable *scanned, const char *pattern)
 {
@@ -406,17 +502,25 @@ applications_scan_now(applications_t *self)
 {
     GHashTable *scanned = NULL;
     GHashTable *changed = NULL;
+    GArray     *jobs    = NULL;
+    GPtrArray  *pending = NULL;
 
     applications_cancel_rescan(self);
 
     log_info("APPLICATIONS RESCAN: executing");
 
+    /* Full rescan covers also pending incremental changes */
+    stringset_clear(self->aps_dirty);
+    self->aps_all_dirty = false;
+
     scanned = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 
     applications_scan_pattern(scanned, APPLICATIONS_DIRECTORY "/" APPLICATIONS_PATTERN);
     applications_scan_pattern(scanned, SAILJAIL_APP_DIRECTORY "/" APPLICATIONS_PATTERN);
 
     changed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    jobs    = g_array_new(FALSE, TRUE, sizeof(desktop_load_t));
+    pending = g_ptr_array_new();
 
     GHashTableIter iter;
     gpointer key, value;
@@ -440,8 +544,39 @@ applications_scan_now(applications_t *self)
     while( g_hash_table_iter_next(&iter, &key, &value) ) {
         //log_debug("APPLICATIONS RESCAN: update: %s", (char *)key);
         appinfo_t *appinfo = applications_add_appinfo(self, key);
-        if( appinfo_parse_desktop(appinfo) )
-            g_hash_table_add(changed, g_strdup(key));
+        gchar **paths = g_new0(gchar *, APPCACHE_STAMP_COUNT);
+        if( appinfo_parse_begin(appinfo, paths) ) {
+            desktop_load_t job = {
+                .dld_paths = paths,
+                .dld_count = APPCACHE_STAMP_COUNT,
+                .dld_ini   = NULL,
+            };
+            g_array_append_val(jobs, job);
+            g_ptr_array_add(pending, appinfo);
+        }
+        else {
+            g_free(paths);
+            if( appinfo_parse_end(appinfo) )
+                g_hash_table_add(changed, g_strdup(key));
+            applications_index_appinfo(self, appinfo);
+        }
+    }
+
+    /* Parse changed desktop files in worker threads, then
+     * apply the results in the same way as serial parsing
+     * would have done.
+     */
+    desktop_load_all((desktop_load_t *)jobs->data, jobs->len,
+                     applications_load_threads());
+
+    for( guint i = 0; i < jobs->len; ++i ) {
+        desktop_load_t *job = &g_array_index(jobs, desktop_load_t, i);
+        appinfo_t *appinfo = g_ptr_array_index(pending, i);
+        appinfo_parse_apply(appinfo, job->dld_ini);
+        if( appinfo_parse_end(appinfo) )
+            g_hash_table_add(changed, g_strdup(appinfo_id(appinfo)));
+        applications_index_appinfo(self, appinfo);
+        desktop_load_clear(job);
     }
 
     /* Update available list */
@@ -452,16 +587,86 @@ applications_scan_now(applications_t *self)
             stringset_add_item(self->aps_available, key);
     }
 
-    /* Notify upwards, receiver can ref() if needed */
-    if( g_hash_table_size(changed) > 0 )
-        applications_notify_changed(self, changed);
+    applications_scan_finish(self, changed);
 
+    if( pending )
+        g_ptr_array_unref(pending);
+    if( jobs )
+        g_array_unref(jobs);
     if( changed )
         g_hash_table_unref(changed);
     if( scanned )
         g_hash_table_unref(scanned);
 }
 
+static void
+applications_scan_dirty(applications_t *self)
+{
+    GHashTable  *changed = NULL;
+    stringset_t *dirty   = NULL;
+
+    applications_cancel_rescan(self);
+
+    log_info("APPLICATIONS RESCAN: executing for %u applications",
+             stringset_size(self->aps_dirty));
+
+    /* Detach the set, so that it can't change while being processed */
+    dirty = self->aps_dirty;
+    self->aps_dirty = stringset_create();
+
+    changed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    for( const GList *iter = stringset_list(dirty); iter; iter = iter->next ) {
+        const gchar *appname = iter->data;
+        bool existed = applications_get_appinfo(self, appname) != NULL;
+        appinfo_t *appinfo = applications_add_appinfo(self, appname);
+        bool updated = appinfo_parse_desktop(appinfo);
+
+        if( appinfo_deleted(appinfo) ) {
+            /* Both desktop files are gone */
+            log_debug("APPLICATIONS RESCAN: remove: %s", appname);
+            if( existed )
+                g_hash_table_add(changed, g_strdup(appname));
+            stringset_remove_item(self->aps_available, appname);
+            applications_remove_appinfo(self, appname);
+        }
+        else {
+            if( updated )
+                g_hash_table_add(changed, g_strdup(appname));
+            applications_index_appinfo(self, appinfo);
+            if( appinfo_valid(appinfo) )
+                stringset_add_item(self->aps_available, appname);
+            else
+                stringset_remove_item(self->aps_available, appname);
+        }
+    }
+
+    applications_scan_finish(self, changed);
+
+    g_hash_table_unref(changed);
+    stringset_delete(dirty);
+}
+
+static void
+applications_scan_finish(applications_t *self, GHashTable *changed)
+{
+    /* Persist parsed desktop data */
+    appcache_save(self->aps_appcache);
+
+    /* Notify upwards, receiver can ref() if needed */
+    if( g_hash_table_size(changed) > 0 )
+        applications_notify_changed(self, changed);
+}
+
+static void
+applications_rescan_now(applications_t *self)
+{
+    if( self->aps_all_dirty )
+        applications_scan_now(self);
+    else if( !stringset_empty(self->aps_dirty) )
+        applications_scan_dirty(self);
+}
+
 static gboolean
 applications_rescan_cb(gpointer aptr)
 {
@@ -470,7 +675,7 @@ applications_rescan_cb(gpointer aptr)
     self->aps_rescan_id = 0;
 
     log_info("APPLICATIONS RESCAN: triggered");
-    applications_scan_now(self);
+    applications_rescan_now(self);
 
     return G_SOURCE_REMOVE;
 }
@@ -515,7 +720,8 @@ applications_add_appinfo(applications_t *self, const char *appname)
     appinfo_t *appinfo = applications_get_appinfo(self, appname);
     if( !appinfo ) {
         appinfo = appinfo_create(self, appname);
-        g_hash_table_insert(self->aps_appinfo_lut, g_strdup(appname), appinfo);
+        g_hash_table_insert(self->aps_appinfo_lut,
+                            (gpointer)intern_acquire(appname), appinfo);
     }
     return appinfo;
 }
@@ -523,5 +729,80 @@ applications_add_appinfo(applications_t *self, const char *appname)
 static bool
 applications_remove_appinfo(applications_t *self, const char *appname)
 {
+    applications_unindex_appinfo(self, appname);
+    appcache_remove(self->aps_appcache, appname);
     return g_hash_table_remove(self->aps_appinfo_lut, appname);
 }
+
+/* ------------------------------------------------------------------------- *
+ * APPLICATIONS_PERMISSIONS
+ * ------------------------------------------------------------------------- */
+
+static void
+applications_index_appinfo(applications_t *self, appinfo_t *appinfo)
+{
+    const char        *appname   = appinfo_id(appinfo);
+    const stringset_t *requested = NULL;
+    const stringset_t *indexed   = g_hash_table_lookup(self->aps_requested_lut,
+                                                       appname);
+
+    if( appinfo_valid(appinfo) )
+        requested = appinfo_get_requested_permissions(appinfo);
+
+    if( indexed && requested && stringset_equal(indexed, requested) )
+        return;
+
+    applications_unindex_appinfo(self, appname);
+
+    if( !requested || stringset_empty(requested) )
+        return;
+
+    for( const GList *iter = stringset_list(requested); iter; iter = iter->next ) {
+        const gchar *perm = iter->data;
+        stringset_t *apps = g_hash_table_lookup(self->aps_permission_lut, perm);
+        if( !apps ) {
+            apps = stringset_create();
+            g_hash_table_insert(self->aps_permission_lut,
+                                (gpointer)intern_acquire(perm), apps);
+        }
+        stringset_add_item(apps, appname);
+    }
+    g_hash_table_insert(self->aps_requested_lut,
+                        (gpointer)intern_acquire(appname),
+                        stringset_copy(requested));
+}
+
+static void
+applications_unindex_appinfo(applications_t *self, const char *appname)
+{
+    const stringset_t *indexed = g_hash_table_lookup(self->aps_requested_lut,
+                                                     appname);
+    if( !indexed )
+        return;
+
+    for( const GList *iter = stringset_list(indexed); iter; iter = iter->next ) {
+        const gchar *perm = iter->data;
+        stringset_t *apps = g_hash_table_lookup(self->aps_permission_lut, perm);
+        if( apps && stringset_remove_item(apps, appname) && stringset_empty(apps) )
+            g_hash_table_remove(self->aps_permission_lut, perm);
+    }
+    g_hash_table_remove(self->aps_requested_lut, appname);
+}
+
+/** Get applications requesting a permission
+ *
+ * Applications are included regardless of whether the
+ * permission is currently available or not.
+ *
+ * @param self        applications object
+ * @param permission  permission name
+ *
+ * @return set of application names, or NULL if there are none
+ */
+const stringset_t *
+applications_by_permission(applications_t *self, const char *permission)
+{
+    if( applications_cancel_rescan(self) )
+        applications_rescan_now(self);
+    return g_hash_table_lookup(self->aps_permission_lut, permission);
+}
@@ -49,6 +49,7 @@ typedef struct config_t       config_t;
 typedef struct stringset_t    stringset_t;
 typedef struct applications_t applications_t;
 typedef struct appinfo_t      appinfo_t;
+typedef struct appcache_t     appcache_t;
 typedef struct control_t      control_t;
 
 /* ========================================================================= *
@@ -63,7 +64,7 @@ applications_t *applications_create   (control_t *control);
 void            applications_delete   (applications_t *self);
 void            applications_delete_at(applications_t **pself);
 void            applications_delete_cb(void *self);
-void            applications_rethink  (applications_t *self);
+void            applications_rethink  (applications_t *self, const stringset_t *permissions);
 
 /* ------------------------------------------------------------------------- *
  * APPLICATIONS_ATTRIBUTES
@@ -73,6 +74,13 @@ control_t         *applications_control  (const applications_t *self);
 const stringset_t *applications_available(applications_t *self);
 appinfo_t         *applications_appinfo  (applications_t *self, const char *appname);
 const config_t    *applications_config   (const applications_t *self);
+appcache_t        *applications_appcache (const applications_t *self);
+
+/* ------------------------------------------------------------------------- *
+ * APPLICATIONS_PERMISSIONS
+ * ------------------------------------------------------------------------- */
+
+const stringset_t *applications_by_permission(applications_t *self, const char *permission);
 
 G_END_DECLS
 
@@ -39,6 +39,7 @@
 # include "appinfo.h"
 # include "applications.h"
 # include "control.h"
+# include "intern.h"
 # include "session.h"
 # include "stringset.h"
 # include "util.h"
@@ -118,7 +119,7 @@ appservices_ctor(appservices_t *self, control_t *control)
 
     self->asv_service_lut = g_hash_table_new_full(g_str_hash,
                                                   g_str_equal,
-                                                  g_free,
+                                                  intern_release_cb,
                                                   serviceinfo_delete_cb);
     appservices_rethink(self);
 }
@@ -202,12 +203,12 @@ appservices_rethink(appservices_t *self)
                                                       NULL);
                 if( name && exec && appname ) {
                     stringset_add_item(appnames_to_remove, appname);
-                    g_hash_table_replace(self->asv_service_lut, appname,
+                    g_hash_table_replace(self->asv_service_lut,
+                                         (gpointer)intern_acquire(appname),
                                          serviceinfo_create(name, exec));
                 }
-                else {
-                    g_free(appname);
-                }
+
+                g_free(appname);
 
                 g_free(name);
                 g_free(exec);
@@ -412,7 +413,8 @@ appservices_write_service_file(appservices_t *self, const char *appname, appinfo
 
     g_key_file_unref(keyfile);
 
-    g_hash_table_replace(self->asv_service_lut, g_strdup(appname),
+    g_hash_table_replace(self->asv_service_lut,
+                         (gpointer)intern_acquire(appname),
                          serviceinfo_create(service_name, exec));
 
     g_free(service_name);
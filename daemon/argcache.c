@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "argcache.h"
+
+#include "appinfo.h"
+#include "firejail.h"
+#include "logging.h"
+#include "permset.h"
+#include "profile.h"
+#include "stringset.h"
+#include "util.h"
+
+#include <unistd.h>
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct argentry_t argentry_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * ARGCACHE
+ * ------------------------------------------------------------------------- */
+
+static void  argcache_ctor     (argcache_t *self);
+static void  argcache_dtor     (argcache_t *self);
+argcache_t  *argcache_create   (void);
+void         argcache_delete   (argcache_t *self);
+void         argcache_delete_at(argcache_t **pself);
+void         argcache_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * ARGENTRY
+ * ------------------------------------------------------------------------- */
+
+static argentry_t *argentry_create   (void);
+static void        argentry_delete   (argentry_t *self);
+static void        argentry_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * ARGCACHE_ENTRY
+ * ------------------------------------------------------------------------- */
+
+static argentry_t  *argcache_build     (uid_t uid, const appinfo_t *appinfo, const permset_t *granted, const char *key);
+const stringset_t  *argcache_lookup    (argcache_t *self, uid_t uid, const appinfo_t *appinfo, const permset_t *granted);
+void                argcache_invalidate(argcache_t *self, const char *appname);
+void                argcache_clear     (argcache_t *self);
+
+/* ========================================================================= *
+ * ARGCACHE
+ * ========================================================================= */
+
+struct argcache_t
+{
+    /* appname -> uid:granted permissions -> firejail options */
+    GHashTable *agc_entries;
+};
+
+static void
+argcache_ctor(argcache_t *self)
+{
+    log_info("argcache() create");
+    self->agc_entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                              (GDestroyNotify)g_hash_table_unref);
+}
+
+static void
+argcache_dtor(argcache_t *self)
+{
+    log_info("argcache() delete");
+    if( self->agc_entries ) {
+        g_hash_table_unref(self->agc_entries),
+            self->agc_entries = NULL;
+    }
+}
+
+argcache_t *
+argcache_create(void)
+{
+    argcache_t *self = g_malloc0(sizeof *self);
+    argcache_ctor(self);
+    return self;
+}
+
+void
+argcache_delete(argcache_t *self)
+{
+    if( self ) {
+        argcache_dtor(self);
+        g_free(self);
+    }
+}
+
+void
+argcache_delete_at(argcache_t **pself)
+{
+    argcache_delete(*pself), *pself = NULL;
+}
+
+void
+argcache_delete_cb(void *self)
+{
+    argcache_delete(self);
+}
+
+/* ========================================================================= *
+ * ARGENTRY
+ * ========================================================================= */
+
+struct argentry_t
+{
+    stringset_t *age_args;     // firejail options
+    GHashTable  *age_sources;  // files inlined to flattened profile
+};
+
+static argentry_t *
+argentry_create(void)
+{
+    argentry_t *self  = g_malloc0(sizeof *self);
+    self->age_args    = stringset_create();
+    self->age_sources = profile_sources_create();
+    return self;
+}
+
+static void
+argentry_delete(argentry_t *self)
+{
+    if( self ) {
+        stringset_delete(self->age_args);
+        g_hash_table_unref(self->age_sources);
+        g_free(self);
+    }
+}
+
+static void
+argentry_delete_cb(void *self)
+{
+    argentry_delete(self);
+}
+
+/* ========================================================================= *
+ * ARGCACHE_ENTRY
+ * ========================================================================= */
+
+static argentry_t *
+argcache_build(uid_t uid, const appinfo_t *appinfo, const permset_t *granted,
+               const char *key)
+{
+    /* Application specific part of firejail options. Whatever depends
+     * on how the client is invoked (binary, booster, debug and tracing
+     * options) is left for sailjail client to add.
+     */
+    auto const char *defined(const char *value) {
+        return appinfo_defined(value) ? value : NULL;
+    }
+
+    argentry_t  *entry        = argentry_create();
+    stringset_t *args         = entry->age_args;
+    const char  *desktop_name = appinfo_id(appinfo);
+    gchar       *desktop_path = path_from_desktop_name(desktop_name);
+    gchar      **vector       = permset_to_strv(granted);
+
+    if( desktop_path && access(desktop_path, R_OK) == -1 )
+        g_free(desktop_path), desktop_path = NULL;
+
+    firejail_add_application(args, desktop_name, desktop_path,
+                             defined(appinfo_get_organization_name(appinfo)),
+                             defined(appinfo_get_application_name(appinfo)),
+                             defined(appinfo_get_data_directory(appinfo)),
+                             defined(appinfo_get_service(appinfo)),
+                             appinfo_get_mode(appinfo) != APP_MODE_NORMAL);
+
+    /* Firejail would parse the whole include graph of every profile
+     * on each launch - pass a single pre-flattened profile instead.
+     * Inlined files are recorded so that edits to them can be
+     * detected on lookup.
+     */
+    stringset_t *profiles = firejail_profiles(NULL, desktop_name,
+                                              (const char * const *)vector);
+    gchar       *profile  = profile_path(uid, desktop_name, key);
+    if( profile_write(profile, profiles, entry->age_sources) ) {
+        firejail_add_option(args, "--profile=%s", profile);
+    }
+    else {
+        for( const GList *iter = stringset_list(profiles); iter; iter = iter->next )
+            firejail_add_option(args, "--profile=%s", (const char *)iter->data);
+    }
+
+    g_free(profile);
+    stringset_delete(profiles);
+    g_strfreev(vector);
+    g_free(desktop_path);
+
+    return entry;
+}
+
+const stringset_t *
+argcache_lookup(argcache_t *self, uid_t uid, const appinfo_t *appinfo,
+                const permset_t *granted)
+{
+    const char  *appname = appinfo_id(appinfo);
+    GHashTable  *entries = g_hash_table_lookup(self->agc_entries, appname);
+    gchar       *perms   = permset_to_string(granted);
+    gchar       *key     = g_strdup_printf("%u:%s", (unsigned)uid, perms);
+    argentry_t  *entry   = NULL;
+
+    if( !entries ) {
+        entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                        argentry_delete_cb);
+        g_hash_table_insert(self->agc_entries, g_strdup(appname), entries);
+    }
+
+    /* Profile files can change without permission set changing */
+    entry = g_hash_table_lookup(entries, key);
+    if( entry && profile_sources_changed(entry->age_sources) ) {
+        log_debug("argcache: profiles changed %s [%s]", appname, key);
+        g_hash_table_remove(entries, key), entry = NULL;
+    }
+
+    if( !entry ) {
+        log_debug("argcache: build %s [%s]", appname, key);
+        entry = argcache_build(uid, appinfo, granted, perms);
+        g_hash_table_insert(entries, key, entry), key = NULL;
+    }
+
+    g_free(key);
+    g_free(perms);
+    return entry->age_args;
+}
+
+void
+argcache_invalidate(argcache_t *self, const char *appname)
+{
+    if( self && g_hash_table_remove(self->agc_entries, appname) )
+        log_debug("argcache: invalidate %s", appname);
+}
+
+void
+argcache_clear(argcache_t *self)
+{
+    if( self ) {
+        log_debug("argcache: invalidate all");
+        g_hash_table_remove_all(self->agc_entries);
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef  ARGCACHE_H_
+# define ARGCACHE_H_
+
+# include <stdbool.h>
+# include <glib.h>
+
+G_BEGIN_DECLS
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct stringset_t stringset_t;
+typedef struct permset_t   permset_t;
+typedef struct appinfo_t   appinfo_t;
+typedef struct argcache_t  argcache_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * ARGCACHE
+ * ------------------------------------------------------------------------- */
+
+argcache_t *argcache_create   (void);
+void        argcache_delete   (argcache_t *self);
+void        argcache_delete_at(argcache_t **pself);
+void        argcache_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * ARGCACHE_ENTRY
+ * ------------------------------------------------------------------------- */
+
+const stringset_t *argcache_lookup    (argcache_t *self, uid_t uid, const appinfo_t *appinfo, const permset_t *granted);
+void               argcache_invalidate(argcache_t *self, const char *appname);
+void               argcache_clear     (argcache_t *self);
+
+G_END_DECLS
+
+#endif /* ARGCACHE_H_ */
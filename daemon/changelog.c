@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "changelog.h"
+
+#include "intern.h"
+#include "logging.h"
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct changelog_entry_t
+{
+    /* Generation during which the change was recorded */
+    guint64      cle_generation;
+
+    /* Interned application id */
+    const gchar *cle_app;
+
+    /* User whose settings changed, or (uid_t)-1 for application level */
+    uid_t        cle_uid;
+
+    /* APP_CHANGE_xxx bits */
+    guint32      cle_mask;
+} changelog_entry_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * CHANGELOG
+ * ------------------------------------------------------------------------- */
+
+static void  changelog_ctor     (changelog_t *self, guint capacity);
+static void  changelog_dtor     (changelog_t *self);
+changelog_t *changelog_create   (guint capacity);
+void         changelog_delete   (changelog_t *self);
+void         changelog_delete_at(changelog_t **pself);
+void         changelog_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * CHANGELOG_ENTRIES
+ * ------------------------------------------------------------------------- */
+
+static changelog_entry_t *changelog_entry   (const changelog_t *self, guint index);
+guint64                   changelog_generation(const changelog_t *self);
+guint64                   changelog_advance   (changelog_t *self);
+void                      changelog_add       (changelog_t *self, const gchar *app, uid_t uid, guint32 mask);
+bool                      changelog_covers    (const changelog_t *self, guint64 generation);
+GVariant                 *changelog_since     (const changelog_t *self, guint64 generation);
+
+/* ========================================================================= *
+ * CHANGELOG
+ * ========================================================================= */
+
+struct changelog_t
+{
+    /* Ring buffer of recorded changes, oldest at clg_head */
+    changelog_entry_t *clg_entries;
+    guint              clg_capacity;
+    guint              clg_head;
+    guint              clg_count;
+
+    /* Generation new changes are recorded in */
+    guint64            clg_generation;
+
+    /* Changes made after this generation are all in the log */
+    guint64            clg_horizon;
+};
+
+static void
+changelog_ctor(changelog_t *self, guint capacity)
+{
+    log_info("changelog() create");
+    self->clg_capacity = capacity ?: CHANGELOG_CAPACITY_DEFAULT;
+    self->clg_entries  = g_malloc0_n(self->clg_capacity, sizeof *self->clg_entries);
+    self->clg_head     = 0;
+    self->clg_count    = 0;
+
+    /* Start from wall clock time so that generations known by clients
+     * from before daemon restart are older than the horizon and lead to
+     * resync instead of silently missing changes.
+     */
+    self->clg_generation = (guint64)g_get_real_time();
+    self->clg_horizon    = self->clg_generation;
+}
+
+static void
+changelog_dtor(changelog_t *self)
+{
+    log_info("changelog() delete");
+    for( guint i = 0; i < self->clg_count; ++i )
+        intern_release_at(&changelog_entry(self, i)->cle_app);
+    g_free(self->clg_entries),
+        self->clg_entries = NULL;
+    self->clg_count = 0;
+}
+
+changelog_t *
+changelog_create(guint capacity)
+{
+    changelog_t *self = g_malloc0(sizeof *self);
+    changelog_ctor(self, capacity);
+    return self;
+}
+
+void
+changelog_delete(changelog_t *self)
+{
+    if( self ) {
+        changelog_dtor(self);
+        g_free(self);
+    }
+}
+
+void
+changelog_delete_at(changelog_t **pself)
+{
+    changelog_delete(*pself), *pself = NULL;
+}
+
+void
+changelog_delete_cb(void *self)
+{
+    changelog_delete(self);
+}
+
+/* ========================================================================= *
+ * CHANGELOG_ENTRIES
+ * ========================================================================= */
+
+static changelog_entry_t *
+changelog_entry(const changelog_t *self, guint index)
+{
+    return &self->clg_entries[(self->clg_head + index) % self->clg_capacity];
+}
+
+guint64
+changelog_generation(const changelog_t *self)
+{
+    return self->clg_generation;
+}
+
+guint64
+changelog_advance(changelog_t *self)
+{
+    return ++self->clg_generation;
+}
+
+void
+changelog_add(changelog_t *self, const gchar *app, uid_t uid, guint32 mask)
+{
+    changelog_entry_t *entry;
+
+    if( self->clg_count < self->clg_capacity ) {
+        entry = changelog_entry(self, self->clg_count++);
+    }
+    else {
+        /* Overwrite the oldest entry. Changes made during its generation
+         * are no longer fully available -> move the horizon past it.
+         */
+        entry = changelog_entry(self, 0);
+        self->clg_head = (self->clg_head + 1) % self->clg_capacity;
+        if( self->clg_horizon < entry->cle_generation )
+            self->clg_horizon = entry->cle_generation;
+        intern_release_at(&entry->cle_app);
+    }
+
+    entry->cle_generation = self->clg_generation;
+    entry->cle_app        = intern_acquire(app);
+    entry->cle_uid        = uid;
+    entry->cle_mask       = mask;
+}
+
+bool
+changelog_covers(const changelog_t *self, guint64 generation)
+{
+    /* Generations from the future are from some earlier daemon
+     * instance and must be treated as unknown too.
+     */
+    return (generation >= self->clg_horizon &&
+            generation <= self->clg_generation);
+}
+
+/** Get changes made after given generation
+ *
+ * @param self        changelog object
+ * @param generation  generation the caller is up to date with
+ *
+ * @return floating (tba(suu)) variant holding current generation,
+ *         resync required flag and (app, uid, mask) change entries
+ */
+GVariant *
+changelog_since(const changelog_t *self, guint64 generation)
+{
+    bool            resync = !changelog_covers(self, generation);
+    GVariantBuilder builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(suu)"));
+    if( !resync ) {
+        for( guint i = 0; i < self->clg_count; ++i ) {
+            const changelog_entry_t *entry = changelog_entry(self, i);
+            if( entry->cle_generation > generation )
+                g_variant_builder_add(&builder, "(suu)", entry->cle_app,
+                                      (guint32)entry->cle_uid,
+                                      entry->cle_mask);
+        }
+    }
+    log_debug("changelog: since %" G_GUINT64_FORMAT ": %s",
+              generation, resync ? "resync" : "delta");
+
+    return g_variant_new("(tba(suu))", self->clg_generation, resync,
+                         &builder);
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef  CHANGELOG_H_
+# define CHANGELOG_H_
+
+# include <stdbool.h>
+# include <glib.h>
+
+G_BEGIN_DECLS
+
+/* ========================================================================= *
+ * Constants
+ * ========================================================================= */
+
+/** Default number of entries kept in changelog */
+# define CHANGELOG_CAPACITY_DEFAULT 1024
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct changelog_t changelog_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * CHANGELOG
+ * ------------------------------------------------------------------------- */
+
+changelog_t *changelog_create   (guint capacity);
+void         changelog_delete   (changelog_t *self);
+void         changelog_delete_at(changelog_t **pself);
+void         changelog_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * CHANGELOG_ENTRIES
+ * ------------------------------------------------------------------------- */
+
+guint64   changelog_generation(const changelog_t *self);
+guint64   changelog_advance   (changelog_t *self);
+void      changelog_add       (changelog_t *self, const gchar *app, uid_t uid, guint32 mask);
+bool      changelog_covers    (const changelog_t *self, guint64 generation);
+GVariant *changelog_since     (const changelog_t *self, guint64 generation);
+
+G_END_DECLS
+
+#endif /* CHANGELOG_H_ */
@@ -36,6 +36,7 @@
 
 #include "control.h"
 
+#include "argcache.h"
 #include "logging.h"
 #include "users.h"
 #include "permissions.h"
@@ -47,6 +48,7 @@
 #include "appservices.h"
 #include "prompter.h"
 #include "later.h"
+#include "warmup.h"
 
 /* ========================================================================= *
  * Types
@@ -85,11 +87,13 @@ settings_t        *control_settings              (const control_t *self);
 appservices_t     *control_appservices           (const control_t *self);
 appsettings_t     *control_appsettings           (control_t *self, uid_t uid, const char *app);
 appinfo_t         *control_appinfo               (const control_t *self, const char *appname);
+const stringset_t *control_jail_args             (const control_t *self, const appinfo_t *appinfo, const permset_t *granted);
 uid_t              control_current_user          (const control_t *self);
 bool               control_valid_user            (const control_t *self, uid_t uid);
 uid_t              control_min_user              (const control_t *self);
 uid_t              control_max_user              (const control_t *self);
 bool               control_user_is_guest         (const control_t *self, uid_t uid);
+GList             *control_user_list             (const control_t *self);
 const stringset_t *control_available_permissions (const control_t *self);
 bool               control_valid_permission      (const control_t *self, const char *perm);
 const stringset_t *control_available_applications(const control_t *self);
@@ -99,12 +103,13 @@ bool               control_valid_application     (const control_t *self, const c
  * CONTROL_SLOTS
  * ------------------------------------------------------------------------- */
 
-void control_on_users_changed     (control_t *self);
+void control_on_users_changed     (control_t *self, GHashTable *added, GHashTable *removed);
 void control_on_session_changed   (control_t *self);
-void control_on_permissions_change(control_t *self);
+void control_on_permissions_change(control_t *self, const stringset_t *added, const stringset_t *removed);
 void control_on_application_change(control_t *self, GHashTable *changed);
 void control_on_settings_change   (control_t *self, const char *app);
 void control_on_appservices_change(control_t *self);
+void control_on_prompter_ready    (control_t *self, bool connected);
 
 /* ------------------------------------------------------------------------- *
  * CONTROL_RETHINK
@@ -127,7 +132,12 @@ struct control_t
 
     uid_t           ctl_session_user;
 
+    stringset_t    *ctl_changed_permissions;
     stringset_t    *ctl_changed_applications;
+    stringset_t    *ctl_rethink_settings_apps;
+    GHashTable     *ctl_added_users;
+    GHashTable     *ctl_removed_users;
+    bool            ctl_rethink_settings_all;
     later_t        *ctl_rethink_applications;
     later_t        *ctl_rethink_settings;
     later_t        *ctl_rethink_prompter;
@@ -142,6 +152,8 @@ struct control_t
     settings_t     *ctl_settings;
     service_t      *ctl_service;
     appservices_t  *ctl_appservices;
+    argcache_t     *ctl_argcache;
+    warmup_t       *ctl_warmup;
 };
 
 /* ========================================================================= *
@@ -156,7 +168,12 @@ control_ctor(control_t *self, const config_t *config)
     self->ctl_session_user = SESSION_UID_UNDEFINED;
 
     /* Init re-evaluation pipeline */
-    self->ctl_changed_applications = stringset_create();
+    self->ctl_changed_permissions   = stringset_create();
+    self->ctl_changed_applications  = stringset_create();
+    self->ctl_rethink_settings_apps = stringset_create();
+    self->ctl_added_users           = g_hash_table_new(g_direct_hash, g_direct_equal);
+    self->ctl_removed_users         = g_hash_table_new(g_direct_hash, g_direct_equal);
+    self->ctl_rethink_settings_all  = false;
     self->ctl_rethink_applications =
         later_create("applications", 0, 0,
                      control_rethink_applications_cb, self);
@@ -182,6 +199,7 @@ control_ctor(control_t *self, const config_t *config)
     self->ctl_permissions  = permissions_create(self);
     self->ctl_applications = applications_create(self);
     self->ctl_settings     = settings_create(config, self);
+    self->ctl_argcache     = argcache_create();
 
     /* Set correct session user */
     self->ctl_session_user = session_current_user(control_session(self));
@@ -190,6 +208,10 @@ control_ctor(control_t *self, const config_t *config)
     self->ctl_service      = service_create(self);
 
     self->ctl_appservices  = appservices_create(self);
+
+    /* Prepare for the first launch in current session */
+    self->ctl_warmup       = warmup_create(self);
+    warmup_start(self->ctl_warmup, self->ctl_session_user);
 }
 
 static void
@@ -197,10 +219,13 @@ control_dtor(control_t *self)
 {
     log_info("control() delete");
 
+    warmup_delete_at(&self->ctl_warmup);
+
     /* Quit D-Bus service */
     service_delete_at(&self->ctl_service);
 
     /* Quit data tracking */
+    argcache_delete_at(&self->ctl_argcache);
     settings_delete_at(&self->ctl_settings);
     applications_delete_at(&self->ctl_applications);
     permissions_delete_at(&self->ctl_permissions);
@@ -215,7 +240,17 @@ control_dtor(control_t *self)
     later_delete_at(&self->ctl_rethink_prompter);
     later_delete_at(&self->ctl_rethink_settings);
     later_delete_at(&self->ctl_rethink_applications);
+    if( self->ctl_removed_users ) {
+        g_hash_table_unref(self->ctl_removed_users),
+            self->ctl_removed_users = NULL;
+    }
+    if( self->ctl_added_users ) {
+        g_hash_table_unref(self->ctl_added_users),
+            self->ctl_added_users = NULL;
+    }
+    stringset_delete_at(&self->ctl_rethink_settings_apps);
     stringset_delete_at(&self->ctl_changed_applications);
+    stringset_delete_at(&self->ctl_changed_permissions);
 }
 
 control_t *
@@ -317,6 +352,15 @@ control_appinfo(const control_t *self, const char *appname)
     return applications_appinfo(control_applications(self), appname);
 }
 
+const stringset_t *
+control_jail_args(const control_t *self, const appinfo_t *appinfo,
+                  const permset_t *granted)
+{
+    /* Applications are always launched on behalf of the session user */
+    return argcache_lookup(self->ctl_argcache, control_current_user(self),
+                           appinfo, granted);
+}
+
 uid_t
 control_current_user(const control_t *self)
 {
@@ -352,6 +396,12 @@ control_user_is_guest(const control_t *self, uid_t uid)
     return users_user_is_guest(control_users(self), uid);
 }
 
+GList *
+control_user_list(const control_t *self)
+{
+    return users_user_list(control_users(self));
+}
+
 const stringset_t *
 control_available_permissions(const control_t *self)
 {
@@ -381,19 +431,30 @@ control_valid_application(const control_t *self, const char *appname)
  * ------------------------------------------------------------------------- */
 
 void
-control_on_users_changed(control_t *self)
+control_on_users_changed(control_t *self, GHashTable *added,
+                         GHashTable *removed)
 {
     log_notice("*** users changed notification");
 
-    users_t *users = control_users(self);
-    uid_t first = users_first_user(users);
-    uid_t last  = users_last_user(users);
-
-    for( uid_t uid = first; uid <= last; ++uid ) {
-        log_notice("uid[%u] = %s",
-                   (unsigned)uid,
-                   users_user_exists(users, uid) ? "exists" : "n/a");
+    /* Only settings of added and removed users need to be touched */
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, added);
+    while( g_hash_table_iter_next(&iter, &key, NULL) ) {
+        log_notice("uid[%u] = added", GPOINTER_TO_UINT(key));
+        g_hash_table_remove(self->ctl_removed_users, key);
+        g_hash_table_add(self->ctl_added_users, key);
     }
+    g_hash_table_iter_init(&iter, removed);
+    while( g_hash_table_iter_next(&iter, &key, NULL) ) {
+        log_notice("uid[%u] = removed", GPOINTER_TO_UINT(key));
+        g_hash_table_remove(self->ctl_added_users, key);
+        g_hash_table_add(self->ctl_removed_users, key);
+    }
+
+    /* Access policies refer to user and group names */
+    if( self->ctl_service )
+        service_reload_policies(self->ctl_service);
 
     later_schedule(self->ctl_rethink_settings);
     // -> control_rethink_settings_cb()
@@ -407,30 +468,45 @@ control_on_session_changed(control_t *self)
     session_t *session = control_session(self);
 
     /* To drop guest user settings from memory when guest user session ends */
-    if( control_user_is_guest(self, self->ctl_session_user) )
+    if( control_user_is_guest(self, self->ctl_session_user) ) {
+        self->ctl_rethink_settings_all = true;
         later_schedule(self->ctl_rethink_settings);
         // -> control_rethink_settings_cb()
+    }
 
     later_schedule(self->ctl_rethink_prompter);
     // -> control_rethink_prompter_cb()
 
-    later_schedule(self->ctl_rethink_appservices);
-    // -> control_rethink_appservices_cb()
-
     self->ctl_session_user = session_current_user(session);
     log_notice("session uid = %d", (int)self->ctl_session_user);
+
+    /* Prepare state of the new user in the background. Appservices
+     * sync is part of the warmup, unless there is no user to warm. */
+    warmup_start(self->ctl_warmup, self->ctl_session_user);
+    if( self->ctl_session_user == SESSION_UID_UNDEFINED ) {
+        later_schedule(self->ctl_rethink_appservices);
+        // -> control_rethink_appservices_cb()
+    }
 }
 
 void
-control_on_permissions_change(control_t *self)
+control_on_permissions_change(control_t *self, const stringset_t *added,
+                              const stringset_t *removed)
 {
     log_notice("*** permissions changed notification");
 
+    /* Only applications requesting these need to be re-evaluated */
+    stringset_extend(self->ctl_changed_permissions, added);
+    stringset_extend(self->ctl_changed_permissions, removed);
+
     permissions_t *permissions = control_permissions(self);
     gchar *perms = stringset_to_string(permissions_available(permissions));
     log_notice("available permissions = %s", perms);
     g_free(perms);
 
+    /* Permission profiles are looked up when building firejail options */
+    argcache_clear(self->ctl_argcache);
+
     later_schedule(self->ctl_rethink_applications);
     // -> control_rethink_applications_cb()
 }
@@ -446,6 +522,8 @@ control_on_application_change(control_t *self, GHashTable *changed)
     while( g_hash_table_iter_next(&iter, &key, &value) ) {
         log_debug("application change: %s", (char *)key);
         stringset_add_item(self->ctl_changed_applications, key);
+        stringset_add_item(self->ctl_rethink_settings_apps, key);
+        argcache_invalidate(self->ctl_argcache, key);
     }
 
     later_schedule(self->ctl_rethink_settings);
@@ -458,6 +536,8 @@ void
 control_on_settings_change(control_t *self, const char *app)
 {
     log_notice("*** settings changed notification: %s", app);
+    /* Drop options built for no longer granted permission sets */
+    argcache_invalidate(self->ctl_argcache, app);
     stringset_add_item(self->ctl_changed_applications, app);
     later_schedule(self->ctl_rethink_broadcast);
     // -> control_rethink_broadcast_cb()
@@ -471,6 +551,15 @@ control_on_appservices_change(control_t *self)
     // -> control_rethink_dbusconfig_cb()
 }
 
+void
+control_on_prompter_ready(control_t *self, bool connected)
+{
+    log_notice("*** prompter %s notification",
+               connected ? "connected" : "connect failed");
+    if( self->ctl_warmup )
+        warmup_prompter_ready(self->ctl_warmup, connected);
+}
+
 /* ------------------------------------------------------------------------- *
  * CONTROL_RETHINK
  * ------------------------------------------------------------------------- */
@@ -480,7 +569,9 @@ control_rethink_applications_cb(gpointer aptr)
 {
     log_notice("*** rethink applications data");
     control_t *self = aptr;
-    applications_rethink(control_applications(self));
+    applications_rethink(control_applications(self),
+                         self->ctl_changed_permissions);
+    stringset_clear(self->ctl_changed_permissions);
     // -> control_on_application_change()
 }
 
@@ -489,7 +580,17 @@ control_rethink_settings_cb(gpointer aptr)
 {
     log_notice("*** rethink settings data");
     control_t *self = aptr;
-    settings_rethink(control_settings(self));
+    settings_rethink_users(control_settings(self), self->ctl_added_users,
+                           self->ctl_removed_users);
+    g_hash_table_remove_all(self->ctl_added_users);
+    g_hash_table_remove_all(self->ctl_removed_users);
+    if( self->ctl_rethink_settings_all )
+        settings_rethink(control_settings(self));
+    else
+        settings_rethink_applications(control_settings(self),
+                                      self->ctl_rethink_settings_apps);
+    self->ctl_rethink_settings_all = false;
+    stringset_clear(self->ctl_rethink_settings_apps);
     // -> control_on_settings_change()
 }
 
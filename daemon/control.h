@@ -47,6 +47,7 @@ G_BEGIN_DECLS
  * ========================================================================= */
 
 typedef struct stringset_t    stringset_t;
+typedef struct permset_t      permset_t;
 typedef struct config_t       config_t;
 typedef struct users_t        users_t;
 typedef struct session_t      session_t;
@@ -86,11 +87,13 @@ settings_t        *control_settings              (const control_t *self);
 appservices_t     *control_appservices           (const control_t *self);
 appsettings_t     *control_appsettings           (control_t *self, uid_t uid, const char *app);
 appinfo_t         *control_appinfo               (const control_t *self, const char *appname);
+const stringset_t *control_jail_args             (const control_t *self, const appinfo_t *appinfo, const permset_t *granted);
 uid_t              control_current_user          (const control_t *self);
 bool               control_valid_user            (const control_t *self, uid_t uid);
 uid_t              control_min_user              (const control_t *self);
 uid_t              control_max_user              (const control_t *self);
 bool               control_user_is_guest         (const control_t *self, uid_t uid);
+GList             *control_user_list             (const control_t *self);
 const stringset_t *control_available_permissions (const control_t *self);
 bool               control_valid_permission      (const control_t *self, const char *perm);
 const stringset_t *control_available_applications(const control_t *self);
@@ -100,12 +103,13 @@ bool               control_valid_application     (const control_t *self, const c
  * CONTROL_SLOTS
  * ------------------------------------------------------------------------- */
 
-void control_on_users_changed     (control_t *self);
+void control_on_users_changed     (control_t *self, GHashTable *added, GHashTable *removed);
 void control_on_session_changed   (control_t *self);
-void control_on_permissions_change(control_t *self);
+void control_on_permissions_change(control_t *self, const stringset_t *added, const stringset_t *removed);
 void control_on_application_change(control_t *self, GHashTable *changed);
 void control_on_settings_change   (control_t *self, const char *app);
 void control_on_appservices_change(control_t *self);
+void control_on_prompter_ready    (control_t *self, bool connected);
 
 G_END_DECLS
 
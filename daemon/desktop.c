@@ -0,0 +1,528 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "desktop.h"
+
+#include "logging.h"
+#include "util.h"
+
+#include <string.h>
+
+/* ========================================================================= *
+ * Constants
+ * ========================================================================= */
+
+/* Temporary key used for creating empty groups in keyfiles */
+#define DESKTOP_KEY_PLACEHOLDER "X-Sailjaild-Placeholder"
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+/** Wanted key-value pair, pointing to parsed data */
+typedef struct
+{
+    const char *dvl_group;
+    const char *dvl_key;
+    const char *dvl_value;
+    size_t      dvl_length;
+} desktop_value_t;
+
+/* ========================================================================= *
+ * Config
+ * ========================================================================= */
+
+/* Desktop file keys that are used by appinfo_parse_desktop().
+ *
+ * Anything else is left out when parsing and from the appinfo
+ * cache, so these must be kept in sync with the parser.
+ */
+
+static const char * const desktop_desktop_keys[] =
+{
+    DESKTOP_KEY_NAME,
+    DESKTOP_KEY_TYPE,
+    DESKTOP_KEY_ICON,
+    DESKTOP_KEY_EXEC,
+    DESKTOP_KEY_NO_DISPLAY,
+    MAEMO_KEY_SERVICE,
+    MAEMO_KEY_OBJECT,
+    MAEMO_KEY_METHOD,
+    NEMO_KEY_APPLICATION_TYPE,
+    NEMO_KEY_SINGLE_INSTANCE,
+    NULL
+};
+
+static const char * const desktop_sailjail_keys[] =
+{
+    SAILJAIL_KEY_ORGANIZATION_NAME,
+    SAILJAIL_KEY_APPLICATION_NAME,
+    SAILJAIL_KEY_DATA_DIRECTORY,
+    SAILJAIL_KEY_PERMISSIONS,
+    SAILJAIL_KEY_SANDBOXING,
+    SAILJAIL_KEY_EXEC_DBUS,
+    NULL
+};
+
+static const desktop_group_t desktop_group_lut[] =
+{
+    { DESKTOP_SECTION,            desktop_desktop_keys  },
+    { SAILJAIL_SECTION_PRIMARY,   desktop_sailjail_keys },
+    { SAILJAIL_SECTION_SECONDARY, desktop_sailjail_keys },
+};
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * DESKTOP_SYNTAX
+ * ------------------------------------------------------------------------- */
+
+static bool desktop_is_space     (char ch);
+static bool desktop_is_group_line(const char *beg, const char *end);
+static bool desktop_is_group_name(const char *beg, const char *end);
+static bool desktop_is_key_name  (const char *beg, const char *end);
+static bool desktop_equal        (const char *beg, const char *end, const char *str);
+
+/* ------------------------------------------------------------------------- *
+ * DESKTOP_LOOKUP
+ * ------------------------------------------------------------------------- */
+
+static const desktop_group_t *desktop_lookup_group(const char *beg, const char *end);
+static const char            *desktop_lookup_key  (const desktop_group_t *group, const char *beg, const char *end);
+
+/* ------------------------------------------------------------------------- *
+ * DESKTOP
+ * ------------------------------------------------------------------------- */
+
+const desktop_group_t *desktop_groups(size_t *pcount);
+bool                   desktop_merge (GKeyFile *ini, const gchar *path);
+GKeyFile              *desktop_load  (gchar **paths, size_t count);
+bool                   desktop_parse (GKeyFile *ini, const gchar *path, const char *data, size_t size);
+
+/* ------------------------------------------------------------------------- *
+ * DESKTOP_LOAD
+ * ------------------------------------------------------------------------- */
+
+static void desktop_load_cb   (gpointer data, gpointer aptr);
+void        desktop_load_all  (desktop_load_t *jobs, size_t count, guint threads);
+void        desktop_load_clear(desktop_load_t *job);
+
+/* ========================================================================= *
+ * DESKTOP_SYNTAX
+ * ========================================================================= */
+
+/* Syntax checks follow what GKeyFile does, so that files that would
+ * fail to load via g_key_file_load_from_file() are rejected also here.
+ */
+
+static bool
+desktop_is_space(char ch)
+{
+    return g_ascii_isspace(ch);
+}
+
+static bool
+desktop_is_group_line(const char *beg, const char *end)
+{
+    /* "[group]" optionally followed by spaces / tabs */
+    const char *pos = beg;
+    if( pos == end || *pos != '[' )
+        return false;
+    while( ++pos < end && *pos != ']' )
+        ;
+    if( pos == end )
+        return false;
+    while( ++pos < end && (*pos == ' ' || *pos == '\t') )
+        ;
+    return pos == end;
+}
+
+static bool
+desktop_is_group_name(const char *beg, const char *end)
+{
+    if( beg == end )
+        return false;
+    for( const char *pos = beg; pos < end; ++pos ) {
+        if( *pos == '[' || *pos == ']' || g_ascii_iscntrl(*pos) )
+            return false;
+    }
+    return true;
+}
+
+static bool
+desktop_is_key_name(const char *beg, const char *end)
+{
+    const char *pos = beg;
+    while( pos < end && *pos != '[' && *pos != ']' )
+        ++pos;
+
+    /* Non-empty, no leading / trailing spaces */
+    if( pos == beg || *beg == ' ' || pos[-1] == ' ' )
+        return false;
+
+    /* Optional locale suffix: "Key[xx_YY.UTF-8@mod]" */
+    if( pos < end && *pos == '[' ) {
+        while( ++pos < end && (g_ascii_isalnum(*pos) || memchr("-_.@", *pos, 4)) )
+            ;
+        if( pos == end || *pos != ']' )
+            return false;
+        ++pos;
+    }
+
+    return pos == end;
+}
+
+static bool
+desktop_equal(const char *beg, const char *end, const char *str)
+{
+    size_t len = strlen(str);
+    return (size_t)(end - beg) == len && !memcmp(beg, str, len);
+}
+
+/* ========================================================================= *
+ * DESKTOP_LOOKUP
+ * ========================================================================= */
+
+static const desktop_group_t *
+desktop_lookup_group(const char *beg, const char *end)
+{
+    for( size_t i = 0; i < G_N_ELEMENTS(desktop_group_lut); ++i ) {
+        if( desktop_equal(beg, end, desktop_group_lut[i].dgr_group) )
+            return &desktop_group_lut[i];
+    }
+    return NULL;
+}
+
+static const char *
+desktop_lookup_key(const desktop_group_t *group, const char *beg, const char *end)
+{
+    for( size_t i = 0; group->dgr_keys[i]; ++i ) {
+        if( desktop_equal(beg, end, group->dgr_keys[i]) )
+            return group->dgr_keys[i];
+    }
+    return NULL;
+}
+
+/* ========================================================================= *
+ * DESKTOP
+ * ========================================================================= */
+
+const desktop_group_t *
+desktop_groups(size_t *pcount)
+{
+    *pcount = G_N_ELEMENTS(desktop_group_lut);
+    return desktop_group_lut;
+}
+
+/** Merge sailjaild relevant data from desktop file to keyfile
+ *
+ * Replaces keyfile_merge() for desktop files: the file is read to
+ * memory and scanned once, and only the keys listed in
+ * desktop_group_lut[] are copied over as raw values, so that GKeyFile
+ * escaping and list semantics apply when the values are read.
+ *
+ * Desktop files are small and can be replaced or truncated by package
+ * management at any time, so the content is read rather than memory
+ * mapped - a mapping would raise SIGBUS on access past the new end.
+ *
+ * @param ini   keyfile to merge to
+ * @param path  desktop file path
+ *
+ * @return true if the file was parsed, false otherwise
+ */
+bool
+desktop_merge(GKeyFile *ini, const gchar *path)
+{
+    bool    ack  = false;
+    gchar  *data = NULL;
+    gsize   size = 0;
+    GError *err  = NULL;
+
+    if( !g_file_get_contents(path, &data, &size, &err) ) {
+        if( g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT) )
+            log_debug("%s: read failed: %s", path, err->message);
+        else
+            log_err("%s: read failed: %s", path, err->message);
+        goto EXIT;
+    }
+
+    ack = desktop_parse(ini, path, data, size);
+
+EXIT:
+    g_clear_error(&err);
+    g_free(data);
+
+    return ack;
+}
+
+/** Load sailjaild relevant data from a set of desktop files
+ *
+ * The files are merged in order to a new keyfile. Only the keyfile
+ * that is created here is modified, so this can be called from
+ * worker threads.
+ *
+ * @param paths  array of desktop file paths, NULL entries are skipped
+ * @param count  number of entries in paths
+ *
+ * @return keyfile, or NULL if any of the files could not be parsed
+ */
+GKeyFile *
+desktop_load(gchar **paths, size_t count)
+{
+    GKeyFile *ini = g_key_file_new();
+
+    for( size_t i = 0; i < count; ++i ) {
+        if( paths[i] && !desktop_merge(ini, paths[i]) ) {
+            g_key_file_unref(ini), ini = NULL;
+            break;
+        }
+    }
+
+    return ini;
+}
+
+/** Merge sailjaild relevant data from desktop file content to keyfile
+ *
+ * Nothing is merged if the content is not valid keyfile data.
+ *
+ * @param ini   keyfile to merge to
+ * @param path  desktop file path, for diagnostic logging
+ * @param data  desktop file content
+ * @param size  desktop file content size
+ *
+ * @return true if the content was parsed, false otherwise
+ */
+bool
+desktop_parse(GKeyFile *ini, const gchar *path, const char *data, size_t size)
+{
+    bool        ack    = false;
+    GArray     *values = g_array_new(false, false, sizeof(desktop_value_t));
+    const char *end    = data + size;
+    const char *pos    = data;
+    guint       lineno = 0;
+
+    /* Current group: name range and lookup result */
+    const char            *group_beg = NULL;
+    const char            *group_end = NULL;
+    const desktop_group_t *group     = NULL;
+
+    /* Encoding is checked only within the first group */
+    const char            *first_beg = NULL;
+    const char            *first_end = NULL;
+    bool                   first     = false;
+
+    while( pos < end ) {
+        const char *beg = pos;
+        const char *eol = memchr(pos, '\n', end - pos);
+        if( eol ) {
+            pos = eol + 1;
+            if( eol > beg && eol[-1] == '\r' )
+                --eol;
+        }
+        else {
+            pos = eol = end;
+        }
+        ++lineno;
+
+        while( beg < eol && desktop_is_space(*beg) )
+            ++beg;
+
+        /* Empty line or comment */
+        if( beg == eol || *beg == '#' )
+            continue;
+
+        /* Group header */
+        if( desktop_is_group_line(beg, eol) ) {
+            const char *name_end = eol;
+            while( name_end[-1] != ']' )
+                --name_end;
+            --name_end;
+            if( !desktop_is_group_name(beg + 1, name_end) ) {
+                log_err("%s:%u: invalid group name", path, lineno);
+                goto EXIT;
+            }
+            group_beg = beg + 1;
+            group_end = name_end;
+            if( !first_beg )
+                first_beg = group_beg, first_end = group_end;
+            first = ((group_end - group_beg) == (first_end - first_beg) &&
+                     !memcmp(group_beg, first_beg, group_end - group_beg));
+            group     = desktop_lookup_group(group_beg, group_end);
+            continue;
+        }
+
+        /* Key-value pair */
+        const char *eq = memchr(beg, '=', eol - beg);
+        if( !eq || eq == beg ) {
+            log_err("%s:%u: not a key-value pair, group, or comment",
+                    path, lineno);
+            goto EXIT;
+        }
+        if( !group_beg ) {
+            log_err("%s:%u: key-value pair outside group", path, lineno);
+            goto EXIT;
+        }
+
+        const char *key_end = eq;
+        while( key_end > beg && desktop_is_space(key_end[-1]) )
+            --key_end;
+        if( !desktop_is_key_name(beg, key_end) ) {
+            log_err("%s:%u: invalid key name", path, lineno);
+            goto EXIT;
+        }
+
+        const char *val = eq + 1;
+        while( val < eol && desktop_is_space(*val) )
+            ++val;
+
+        if( first && desktop_equal(beg, key_end, "Encoding") &&
+            !((size_t)(eol - val) == 5 && !g_ascii_strncasecmp(val, "UTF-8", 5)) ) {
+            log_err("%s:%u: unsupported encoding", path, lineno);
+            goto EXIT;
+        }
+
+        /* Group exists in keyfile only if it has keys, so remember
+         * also groups we do not care about the content of */
+        desktop_value_t item = {
+            .dvl_group  = group ? group->dgr_group : NULL,
+            .dvl_key    = group ? desktop_lookup_key(group, beg, key_end) : NULL,
+            .dvl_value  = val,
+            .dvl_length = eol - val,
+        };
+        if( item.dvl_group )
+            g_array_append_val(values, item);
+    }
+
+    /* Content is valid -> apply to keyfile. Later values override
+     * earlier ones, as with GKeyFile. */
+    for( guint i = 0; i < values->len; ++i ) {
+        const desktop_value_t *item = &g_array_index(values, desktop_value_t, i);
+        if( item->dvl_key ) {
+            gchar *val = g_strndup(item->dvl_value, item->dvl_length);
+            g_key_file_set_value(ini, item->dvl_group, item->dvl_key, val);
+            g_free(val);
+        }
+        else if( !g_key_file_has_group(ini, item->dvl_group) ) {
+            /* Only presence of the group is significant. Removing
+             * the last key leaves an empty group in place. */
+            g_key_file_set_value(ini, item->dvl_group, DESKTOP_KEY_PLACEHOLDER, "");
+            g_key_file_remove_key(ini, item->dvl_group, DESKTOP_KEY_PLACEHOLDER, NULL);
+        }
+    }
+    ack = true;
+
+EXIT:
+    g_array_unref(values);
+    return ack;
+}
+
+/* ========================================================================= *
+ * DESKTOP_LOAD
+ * ========================================================================= */
+
+static void
+desktop_load_cb(gpointer data, gpointer aptr)
+{
+    (void)aptr; // unused
+
+    desktop_load_t *job = data;
+    job->dld_ini = desktop_load(job->dld_paths, job->dld_count);
+}
+
+/** Load a batch of desktop file sets
+ *
+ * Files are parsed in a thread pool and the function returns when all
+ * of the jobs have been processed. Each worker touches only the job it
+ * is handling, so results can be used from the calling thread without
+ * further locking.
+ *
+ * @param jobs     array of load jobs
+ * @param count    number of entries in jobs
+ * @param threads  maximum number of worker threads to use
+ */
+void
+desktop_load_all(desktop_load_t *jobs, size_t count, guint threads)
+{
+    GThreadPool *pool = NULL;
+    GError      *err  = NULL;
+
+    if( threads > count )
+        threads = count;
+
+    if( threads > 1 ) {
+        pool = g_thread_pool_new(desktop_load_cb, NULL, threads, FALSE, &err);
+        if( !pool ) {
+            log_warning("desktop load: thread pool: %s",
+                        err ? err->message : "unknown error");
+        }
+    }
+
+    for( size_t i = 0; i < count; ++i ) {
+        if( !pool )
+            desktop_load_cb(&jobs[i], NULL);
+        else if( !g_thread_pool_push(pool, &jobs[i], &err) ) {
+            log_warning("desktop load: push: %s",
+                        err ? err->message : "unknown error");
+            g_clear_error(&err);
+            desktop_load_cb(&jobs[i], NULL);
+        }
+    }
+
+    /* Wait for queued jobs to finish */
+    if( pool )
+        g_thread_pool_free(pool, FALSE, TRUE);
+
+    g_clear_error(&err);
+}
+
+void
+desktop_load_clear(desktop_load_t *job)
+{
+    if( job->dld_paths ) {
+        for( size_t i = 0; i < job->dld_count; ++i )
+            g_free(job->dld_paths[i]);
+        g_free(job->dld_paths),
+            job->dld_paths = NULL;
+    }
+    job->dld_count = 0;
+
+    if( job->dld_ini ) {
+        g_key_file_unref(job->dld_ini),
+            job->dld_ini = NULL;
+    }
+}
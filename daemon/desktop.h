@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef  DESKTOP_H_
+# define DESKTOP_H_
+
+# include <stdbool.h>
+# include <glib.h>
+
+G_BEGIN_DECLS
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+/** Desktop file group and the keys in it that sailjaild uses */
+typedef struct desktop_group_t
+{
+    const char         *dgr_group;
+    const char * const *dgr_keys;  // NULL terminated
+} desktop_group_t;
+
+/** Desktop file set to be loaded via desktop_load_all() */
+typedef struct desktop_load_t
+{
+    gchar    **dld_paths;  // paths to merge, NULL entries are skipped
+    size_t     dld_count;  // number of entries in dld_paths
+    GKeyFile  *dld_ini;    // desktop_load() result
+} desktop_load_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * DESKTOP
+ * ------------------------------------------------------------------------- */
+
+const desktop_group_t *desktop_groups(size_t *pcount);
+bool                   desktop_merge (GKeyFile *ini, const gchar *path);
+GKeyFile              *desktop_load  (gchar **paths, size_t count);
+bool                   desktop_parse (GKeyFile *ini, const gchar *path, const char *data, size_t size);
+
+/* ------------------------------------------------------------------------- *
+ * DESKTOP_LOAD
+ * ------------------------------------------------------------------------- */
+
+void desktop_load_all  (desktop_load_t *jobs, size_t count, guint threads);
+void desktop_load_clear(desktop_load_t *job);
+
+G_END_DECLS
+
+#endif /* DESKTOP_H_ */
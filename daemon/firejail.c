@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "firejail.h"
+
+#include "stringset.h"
+#include "util.h"
+
+#include <string.h>
+#include <unistd.h>
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * UTILITY
+ * ------------------------------------------------------------------------- */
+
+static bool empty_p      (const char *str);
+static void add_readable (stringset_t *paths, gchar *path);
+
+/* ------------------------------------------------------------------------- *
+ * FIREJAIL
+ * ------------------------------------------------------------------------- */
+
+void         firejail_add_option     (stringset_t *args, const char *fmt, ...);
+void         firejail_add_permission (stringset_t *args, const char *name);
+void         firejail_add_profile    (stringset_t *args, const char *name);
+void         firejail_add_directory  (stringset_t *args, bool create, const char *fmt, ...);
+void         firejail_add_application(stringset_t *args, const char *desktop_name, const char *desktop_path, const char *org_name, const char *app_name, const char *data_dir, const char *service, bool use_compatibility);
+stringset_t *firejail_profiles       (const char *booster_name, const char *desktop_name, const char * const *granted);
+void         firejail_add_profiles   (stringset_t *args, const char *booster_name, const char *desktop_name, const char * const *granted);
+
+/* ========================================================================= *
+ * UTILITY
+ * ========================================================================= */
+
+static bool empty_p(const char *str)
+{
+    return !str || !*str;
+}
+
+static void add_readable(stringset_t *paths, gchar *path)
+{
+    if( path && access(path, R_OK) == 0 )
+        stringset_add_item_steal(paths, path);
+    else
+        g_free(path);
+}
+
+/* ========================================================================= *
+ * FIREJAIL
+ * ========================================================================= */
+
+void
+firejail_add_option(stringset_t *args, const char *fmt, ...)
+{
+    va_list va;
+    va_start(va, fmt);
+    gchar *option = g_strdup_vprintf(fmt, va);
+    va_end(va);
+    stringset_add_item_steal(args, option);
+}
+
+void
+firejail_add_permission(stringset_t *args, const char *name)
+{
+    gchar *path = path_from_permission_name(name);
+    if( path && access(path, R_OK) == 0 )
+        firejail_add_option(args, "--profile=%s", path);
+    g_free(path);
+}
+
+void
+firejail_add_profile(stringset_t *args, const char *name)
+{
+    gchar *path = path_from_profile_name(name);
+    if( path && access(path, R_OK) == 0 )
+        firejail_add_option(args, "--profile=%s", path);
+    g_free(path);
+}
+
+void
+firejail_add_directory(stringset_t *args, bool create, const char *fmt, ...)
+{
+    va_list va;
+    va_start(va, fmt);
+    gchar *path = g_strdup_vprintf(fmt, va);
+    va_end(va);
+
+    if( create )
+        firejail_add_option(args, "--mkdir=%s", path);
+    firejail_add_option(args, "--whitelist=%s", path);
+    g_free(path);
+}
+
+void
+firejail_add_application(stringset_t *args,
+                         const char  *desktop_name,
+                         const char  *desktop_path,
+                         const char  *org_name,
+                         const char  *app_name,
+                         const char  *data_dir,
+                         const char  *service,
+                         bool         use_compatibility)
+{
+    if( org_name )
+        firejail_add_option(args, "--template=OrganizationName:%s", org_name);
+    if( app_name )
+        firejail_add_option(args, "--template=ApplicationName:%s", app_name);
+
+    firejail_add_option(args, "--whitelist=/usr/share/%s", data_dir ?: desktop_name);
+
+    /* Watch out for alternate desktop files in /etc as whitelisting
+     * them while private-etc is used leads to problems */
+    if( desktop_path && strncmp(desktop_path, "/etc/", 5) )
+        firejail_add_option(args, "--whitelist=%s", desktop_path);
+
+    /* Legacy app binary based data directories are made available.
+     * But they are not created unless legacy app sandboxing is used. */
+    firejail_add_directory(args, use_compatibility, "${HOME}/.local/share/%s", desktop_name);
+    firejail_add_directory(args, use_compatibility, "${HOME}/.config/%s", desktop_name);
+    firejail_add_directory(args, use_compatibility, "${HOME}/.cache/%s", desktop_name);
+
+    if( !empty_p(org_name) && !empty_p(app_name) ) {
+        firejail_add_directory(args, true,  "${HOME}/.cache/%s/%s", org_name, app_name);
+        firejail_add_directory(args, true,  "${HOME}/.local/share/%s/%s", org_name, app_name);
+        firejail_add_directory(args, true,  "${HOME}/.config/%s/%s", org_name, app_name);
+
+        firejail_add_option(args, "--dbus-user.own=%s.%s", org_name, app_name);
+    }
+
+    if( !empty_p(service) )
+        firejail_add_option(args, "--dbus-user.own=%s", service);
+}
+
+stringset_t *
+firejail_profiles(const char         *booster_name,
+                  const char         *desktop_name,
+                  const char * const *granted)
+{
+    stringset_t *paths = stringset_create();
+
+    /* Include booster type specific profile */
+    if( booster_name )
+        add_readable(paths, path_from_profile_name(booster_name));
+
+    /* Include application specific profile */
+    add_readable(paths, path_from_profile_name(desktop_name));
+
+    /* Include granted permissions */
+    for( size_t i = 0; granted && granted[i]; ++i )
+        add_readable(paths, path_from_permission_name(granted[i]));
+    add_readable(paths, path_from_permission_name("Base"));
+
+    return paths;
+}
+
+void
+firejail_add_profiles(stringset_t        *args,
+                      const char         *booster_name,
+                      const char         *desktop_name,
+                      const char * const *granted)
+{
+    stringset_t *paths = firejail_profiles(booster_name, desktop_name, granted);
+    for( const GList *iter = stringset_list(paths); iter; iter = iter->next )
+        firejail_add_option(args, "--profile=%s", (const char *)iter->data);
+    stringset_delete(paths);
+}
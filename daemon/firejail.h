@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef  FIREJAIL_H_
+# define FIREJAIL_H_
+
+# include <stdbool.h>
+# include <glib.h>
+
+G_BEGIN_DECLS
+
+/* ========================================================================= *
+ * Constants
+ * ========================================================================= */
+
+# define FIREJAIL_BINARY "/usr/bin/firejail"
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct stringset_t stringset_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * FIREJAIL
+ * ------------------------------------------------------------------------- */
+
+void         firejail_add_option     (stringset_t *args, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void         firejail_add_permission (stringset_t *args, const char *name);
+void         firejail_add_profile    (stringset_t *args, const char *name);
+void         firejail_add_directory  (stringset_t *args, bool create, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+void         firejail_add_application(stringset_t *args, const char *desktop_name, const char *desktop_path, const char *org_name, const char *app_name, const char *data_dir, const char *service, bool use_compatibility);
+stringset_t *firejail_profiles       (const char *booster_name, const char *desktop_name, const char * const *granted);
+void         firejail_add_profiles   (stringset_t *args, const char *booster_name, const char *desktop_name, const char * const *granted);
+
+G_END_DECLS
+
+#endif /* FIREJAIL_H_ */
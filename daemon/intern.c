@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "intern.h"
+
+#include "logging.h"
+
+#include <string.h>
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct intern_entry_t intern_entry_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * INTERN_ENTRY
+ * ------------------------------------------------------------------------- */
+
+static intern_entry_t *intern_entry_create   (const gchar *str, gsize len);
+static void            intern_entry_delete   (intern_entry_t *self);
+static intern_entry_t *intern_entry_from_text(gpointer text);
+
+/* ------------------------------------------------------------------------- *
+ * INTERN
+ * ------------------------------------------------------------------------- */
+
+const gchar *intern_acquire   (const gchar *str);
+void         intern_release   (const gchar *str);
+void         intern_release_cb(gpointer str);
+void         intern_release_at(const gchar **pstr);
+bool         intern_change    (const gchar **pstr, const gchar *str);
+bool         intern_equal     (const gchar *str1, const gchar *str2);
+void         intern_get_stats (intern_stats_t *stats);
+
+/* ========================================================================= *
+ * INTERN_ENTRY
+ * ========================================================================= */
+
+/** Pooled string: reference count and string data in one allocation
+ *
+ * The string is used as hash table key, and the entry containing it
+ * can be located from the key without further lookups.
+ */
+struct intern_entry_t
+{
+    guint ine_refs;
+    gchar ine_text[];
+};
+
+static intern_entry_t *
+intern_entry_create(const gchar *str, gsize len)
+{
+    intern_entry_t *self = g_malloc(sizeof *self + len + 1);
+    self->ine_refs = 0;
+    memcpy(self->ine_text, str, len);
+    self->ine_text[len] = 0;
+    return self;
+}
+
+static void
+intern_entry_delete(intern_entry_t *self)
+{
+    g_free(self);
+}
+
+static intern_entry_t *
+intern_entry_from_text(gpointer text)
+{
+    return (intern_entry_t *)((gchar *)text - G_STRUCT_OFFSET(intern_entry_t, ine_text));
+}
+
+/* ========================================================================= *
+ * INTERN
+ * ========================================================================= */
+
+/* Application ids and permission names are referenced from several
+ * lookup tables and objects. Keeping a single refcounted copy of each
+ * distinct string saves memory, and allows comparing pooled strings by
+ * pointer.
+ *
+ * The pool is used only from the main thread.
+ */
+static GHashTable *intern_pool = NULL; // text -> text within entry
+
+/** Get pooled copy of a string
+ *
+ * @param str  string to intern, or NULL
+ *
+ * @return pooled string that must be released with intern_release(),
+ *         or NULL if str is NULL
+ */
+const gchar *
+intern_acquire(const gchar *str)
+{
+    intern_entry_t *entry = NULL;
+
+    if( !str )
+        goto EXIT;
+
+    if( !intern_pool )
+        intern_pool = g_hash_table_new(g_str_hash, g_str_equal);
+
+    gpointer text = g_hash_table_lookup(intern_pool, str);
+    if( text ) {
+        entry = intern_entry_from_text(text);
+    }
+    else {
+        entry = intern_entry_create(str, strlen(str));
+        g_hash_table_add(intern_pool, entry->ine_text);
+    }
+    entry->ine_refs += 1;
+
+EXIT:
+    return entry ? entry->ine_text : NULL;
+}
+
+/** Release pooled string obtained via intern_acquire()
+ *
+ * @param str  pooled string, or NULL
+ */
+void
+intern_release(const gchar *str)
+{
+    if( !str )
+        goto EXIT;
+
+    gpointer text = intern_pool ? g_hash_table_lookup(intern_pool, str) : NULL;
+    if( text != str ) {
+        log_err("%s: releasing string that is not pooled", str);
+        goto EXIT;
+    }
+
+    intern_entry_t *entry = intern_entry_from_text(text);
+    if( --entry->ine_refs == 0 ) {
+        g_hash_table_remove(intern_pool, text);
+        intern_entry_delete(entry);
+    }
+
+EXIT:
+    return;
+}
+
+void
+intern_release_cb(gpointer str)
+{
+    intern_release(str);
+}
+
+void
+intern_release_at(const gchar **pstr)
+{
+    intern_release(*pstr), *pstr = NULL;
+}
+
+/** Replace pooled string held in a pointer
+ *
+ * @param pstr  pointer to pooled string, or to NULL
+ * @param str   string to intern, or NULL
+ *
+ * @return true if the value changed, false otherwise
+ */
+bool
+intern_change(const gchar **pstr, const gchar *str)
+{
+    bool changed = false;
+    if( g_strcmp0(*pstr, str) ) {
+        const gchar *prev = *pstr;
+        *pstr = intern_acquire(str);
+        intern_release(prev);
+        changed = true;
+    }
+    return changed;
+}
+
+/** Compare pooled strings
+ *
+ * Both strings must have been obtained via intern_acquire().
+ */
+bool
+intern_equal(const gchar *str1, const gchar *str2)
+{
+    return str1 == str2;
+}
+
+void
+intern_get_stats(intern_stats_t *stats)
+{
+    stats->ist_strings      = 0;
+    stats->ist_references   = 0;
+    stats->ist_pooled_bytes = 0;
+    stats->ist_copied_bytes = 0;
+
+    if( !intern_pool )
+        goto EXIT;
+
+    GHashTableIter iter;
+    gpointer text;
+    g_hash_table_iter_init(&iter, intern_pool);
+    while( g_hash_table_iter_next(&iter, &text, NULL) ) {
+        const intern_entry_t *entry = intern_entry_from_text(text);
+        gsize size = strlen(entry->ine_text) + 1;
+        stats->ist_strings      += 1;
+        stats->ist_references   += entry->ine_refs;
+        stats->ist_pooled_bytes += sizeof *entry + size;
+        stats->ist_copied_bytes += entry->ine_refs * size;
+    }
+
+EXIT:
+    return;
+}
@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "journal.h"
+
+#include "logging.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* ========================================================================= *
+ * File format
+ *
+ * Journal is an append-only text file holding one record per line.
+ * Each record is a GVariant of the type given at journal creation,
+ * serialized with g_variant_print(). A record counts as written only
+ * when it is terminated by a newline and parses back to a value of the
+ * expected type. As tuples always end with ')', no strict prefix of a
+ * record can pass as a valid record - thus torn writes left behind by
+ * crashes or power losses are detected and discarded during replay.
+ * ========================================================================= */
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * JOURNAL
+ * ------------------------------------------------------------------------- */
+
+static void  journal_ctor     (journal_t *self, const gchar *path, const gchar *type);
+static void  journal_dtor     (journal_t *self);
+journal_t   *journal_create   (const gchar *path, const gchar *type);
+void         journal_delete   (journal_t *self);
+void         journal_delete_at(journal_t **pself);
+void         journal_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * JOURNAL_ATTRIBUTES
+ * ------------------------------------------------------------------------- */
+
+const gchar *journal_path   (const journal_t *self);
+gsize        journal_size   (const journal_t *self);
+guint        journal_pending(const journal_t *self);
+
+/* ------------------------------------------------------------------------- *
+ * JOURNAL_STORAGE
+ * ------------------------------------------------------------------------- */
+
+static bool journal_write (int fd, const gchar *data, gsize size);
+bool        journal_append(journal_t *self, GVariant *record);
+bool        journal_sync  (journal_t *self);
+guint       journal_replay(journal_t *self, journal_replay_fn cb, gpointer aptr);
+bool        journal_reset (journal_t *self);
+
+/* ========================================================================= *
+ * JOURNAL
+ * ========================================================================= */
+
+struct journal_t
+{
+    gchar        *jnl_path;
+    GVariantType *jnl_type;
+    GString      *jnl_buffer;  // serialized records waiting for sync
+    guint         jnl_pending; // number of records in jnl_buffer
+    gsize         jnl_size;    // size of synced data on disk
+};
+
+static void
+journal_ctor(journal_t *self, const gchar *path, const gchar *type)
+{
+    self->jnl_path    = g_strdup(path);
+    self->jnl_type    = g_variant_type_new(type);
+    self->jnl_buffer  = g_string_new(NULL);
+    self->jnl_pending = 0;
+    self->jnl_size    = 0;
+
+    struct stat st;
+    if( stat(path, &st) == 0 )
+        self->jnl_size = st.st_size;
+
+    log_info("journal(%s) created", journal_path(self));
+}
+
+static void
+journal_dtor(journal_t *self)
+{
+    log_info("journal(%s) deleted", journal_path(self));
+
+    if( self->jnl_pending )
+        log_warning("%s: %u records were not synced",
+                    journal_path(self), self->jnl_pending);
+
+    if( self->jnl_buffer ) {
+        g_string_free(self->jnl_buffer, TRUE),
+            self->jnl_buffer = NULL;
+    }
+    if( self->jnl_type ) {
+        g_variant_type_free(self->jnl_type),
+            self->jnl_type = NULL;
+    }
+    g_free(self->jnl_path),
+        self->jnl_path = NULL;
+}
+
+journal_t *
+journal_create(const gchar *path, const gchar *type)
+{
+    journal_t *self = g_malloc0(sizeof *self);
+    journal_ctor(self, path, type);
+    return self;
+}
+
+void
+journal_delete(journal_t *self)
+{
+    if( self ) {
+        journal_dtor(self);
+        g_free(self);
+    }
+}
+
+void
+journal_delete_at(journal_t **pself)
+{
+    journal_delete(*pself), *pself = NULL;
+}
+
+void
+journal_delete_cb(void *self)
+{
+    journal_delete(self);
+}
+
+/* ------------------------------------------------------------------------- *
+ * JOURNAL_ATTRIBUTES
+ * ------------------------------------------------------------------------- */
+
+const gchar *
+journal_path(const journal_t *self)
+{
+    return self->jnl_path;
+}
+
+gsize
+journal_size(const journal_t *self)
+{
+    return self->jnl_size;
+}
+
+guint
+journal_pending(const journal_t *self)
+{
+    return self->jnl_pending;
+}
+
+/* ------------------------------------------------------------------------- *
+ * JOURNAL_STORAGE
+ * ------------------------------------------------------------------------- */
+
+static bool
+journal_write(int fd, const gchar *data, gsize size)
+{
+    while( size > 0 ) {
+        ssize_t rc = write(fd, data, size);
+        if( rc == -1 ) {
+            if( errno == EINTR )
+                continue;
+            return false;
+        }
+        data += rc, size -= rc;
+    }
+    return true;
+}
+
+bool
+journal_append(journal_t *self, GVariant *record)
+{
+    bool ack = false;
+
+    g_variant_ref_sink(record);
+
+    if( !g_variant_is_of_type(record, self->jnl_type) ) {
+        log_err("%s: record of unexpected type: %s",
+                journal_path(self), g_variant_get_type_string(record));
+    }
+    else {
+        g_variant_print_string(record, self->jnl_buffer, FALSE);
+        g_string_append_c(self->jnl_buffer, '\n');
+        self->jnl_pending += 1;
+        ack = true;
+    }
+
+    g_variant_unref(record);
+    return ack;
+}
+
+bool
+journal_sync(journal_t *self)
+{
+    bool        ack = false;
+    int         fd  = -1;
+    struct stat st;
+
+    if( !self->jnl_pending ) {
+        ack = true;
+        goto EXIT;
+    }
+
+    fd = open(journal_path(self),
+              O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if( fd == -1 ) {
+        log_err("%s: could not open: %m", journal_path(self));
+        goto EXIT;
+    }
+
+    if( fstat(fd, &st) == -1 ) {
+        log_err("%s: could not stat: %m", journal_path(self));
+        goto EXIT;
+    }
+
+    if( !journal_write(fd, self->jnl_buffer->str, self->jnl_buffer->len) ) {
+        log_err("%s: could not write: %m", journal_path(self));
+        /* Do not leave partial records for next append to build on */
+        if( ftruncate(fd, st.st_size) == -1 )
+            log_err("%s: could not truncate: %m", journal_path(self));
+        goto EXIT;
+    }
+
+    if( fdatasync(fd) == -1 ) {
+        log_err("%s: could not sync: %m", journal_path(self));
+        goto EXIT;
+    }
+
+    log_debug("%s: synced %u records", journal_path(self), self->jnl_pending);
+    self->jnl_size = st.st_size + self->jnl_buffer->len;
+    g_string_truncate(self->jnl_buffer, 0);
+    self->jnl_pending = 0;
+    ack = true;
+
+EXIT:
+    if( fd != -1 )
+        close(fd);
+    return ack;
+}
+
+guint
+journal_replay(journal_t *self, journal_replay_fn cb, gpointer aptr)
+{
+    guint        count = 0;
+    gchar       *data  = NULL;
+    gsize        size  = 0;
+    GError      *err   = NULL;
+    const gchar *pos   = NULL;
+    const gchar *end   = NULL;
+
+    if( !g_file_get_contents(journal_path(self), &data, &size, &err) ) {
+        if( !g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT) )
+            log_err("%s: could not read: %s", journal_path(self), err->message);
+        self->jnl_size = 0;
+        goto EXIT;
+    }
+
+    pos = data;
+    end = data + size;
+    while( pos < end ) {
+        const gchar *eol = memchr(pos, '\n', end - pos);
+        if( !eol )
+            break;
+
+        GVariant *record = g_variant_parse(self->jnl_type, pos, eol,
+                                           NULL, NULL);
+        if( !record )
+            break;
+
+        cb(record, aptr);
+        g_variant_unref(record);
+        pos = eol + 1;
+        count += 1;
+    }
+
+    self->jnl_size = pos - data;
+    if( self->jnl_size < size ) {
+        /* Drop torn tail so that future appends remain parseable */
+        log_warning("%s: discarding %zu bytes of incomplete data",
+                    journal_path(self), (size_t)(size - self->jnl_size));
+        if( truncate(journal_path(self), self->jnl_size) == -1 )
+            log_err("%s: could not truncate: %m", journal_path(self));
+    }
+
+    log_info("%s: replayed %u records", journal_path(self), count);
+
+EXIT:
+    g_clear_error(&err);
+    g_free(data);
+    return count;
+}
+
+bool
+journal_reset(journal_t *self)
+{
+    bool ack = true;
+
+    g_string_truncate(self->jnl_buffer, 0);
+    self->jnl_pending = 0;
+
+    if( truncate(journal_path(self), 0) == -1 && errno != ENOENT ) {
+        log_err("%s: could not truncate: %m", journal_path(self));
+        ack = false;
+    }
+    else {
+        self->jnl_size = 0;
+    }
+    return ack;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef  JOURNAL_H_
+# define JOURNAL_H_
+
+# include <stdbool.h>
+# include <glib.h>
+
+G_BEGIN_DECLS
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct journal_t journal_t;
+
+/** Callback for handling records found in journal file */
+typedef void (*journal_replay_fn)(GVariant *record, gpointer aptr);
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * JOURNAL
+ * ------------------------------------------------------------------------- */
+
+journal_t *journal_create   (const gchar *path, const gchar *type);
+void       journal_delete   (journal_t *self);
+void       journal_delete_at(journal_t **pself);
+void       journal_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * JOURNAL_ATTRIBUTES
+ * ------------------------------------------------------------------------- */
+
+const gchar *journal_path   (const journal_t *self);
+gsize        journal_size   (const journal_t *self);
+guint        journal_pending(const journal_t *self);
+
+/* ------------------------------------------------------------------------- *
+ * JOURNAL_STORAGE
+ * ------------------------------------------------------------------------- */
+
+bool  journal_append(journal_t *self, GVariant *record);
+bool  journal_sync  (journal_t *self);
+guint journal_replay(journal_t *self, journal_replay_fn cb, gpointer aptr);
+bool  journal_reset (journal_t *self);
+
+G_END_DECLS
+
+#endif /* JOURNAL_H_ */
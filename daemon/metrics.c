@@ -0,0 +1,606 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "metrics.h"
+
+#include "logging.h"
+
+#include <string.h>
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct metrics_histogram_t metrics_histogram_t;
+typedef struct metrics_method_t    metrics_method_t;
+typedef struct metrics_signal_t    metrics_signal_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * METRICS_HISTOGRAM
+ * ------------------------------------------------------------------------- */
+
+static guint                metrics_histogram_bucket(gint64 value);
+static void                 metrics_histogram_add   (metrics_histogram_t *self, gint64 value);
+static void                 metrics_histogram_report(const metrics_histogram_t *self, GString *text, const char *title);
+static metrics_histogram_t *metrics_histogram_create(void);
+
+/* ------------------------------------------------------------------------- *
+ * METRICS_METHOD
+ * ------------------------------------------------------------------------- */
+
+static metrics_method_t    *metrics_method_create   (void);
+static void                 metrics_method_delete_cb(void *self);
+static metrics_histogram_t *metrics_method_error    (metrics_method_t *self, int code);
+
+/* ------------------------------------------------------------------------- *
+ * METRICS
+ * ------------------------------------------------------------------------- */
+
+static void  metrics_ctor     (metrics_t *self);
+static void  metrics_dtor     (metrics_t *self);
+metrics_t   *metrics_create   (void);
+void         metrics_delete   (metrics_t *self);
+void         metrics_delete_at(metrics_t **pself);
+void         metrics_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * METRICS_RECORD
+ * ------------------------------------------------------------------------- */
+
+static metrics_method_t *metrics_method       (metrics_t *self, const char *method);
+static void              metrics_sender       (metrics_t *self, const char *sender);
+void                     metrics_record_call  (metrics_t *self, const char *sender, const char *method);
+void                     metrics_record_reply (metrics_t *self, const char *method, int code, gint64 latency);
+void                     metrics_record_push  (metrics_t *self, guint depth);
+void                     metrics_record_pop   (metrics_t *self, guint depth, gint64 wait);
+void                     metrics_record_signal(metrics_t *self, const char *member, gsize size);
+
+/* ------------------------------------------------------------------------- *
+ * METRICS_INVOCATION
+ * ------------------------------------------------------------------------- */
+
+static GQuark metrics_call_quark   (void);
+static GQuark metrics_queue_quark  (void);
+static void   metrics_set_stamp    (GDBusMethodInvocation *invocation, GQuark quark);
+static gint64 metrics_get_elapsed  (GDBusMethodInvocation *invocation, GQuark quark);
+void          metrics_call_begin   (metrics_t *self, GDBusMethodInvocation *invocation);
+void          metrics_call_end     (metrics_t *self, GDBusMethodInvocation *invocation, int code);
+void          metrics_queue_enter  (metrics_t *self, GDBusMethodInvocation *invocation, guint depth);
+void          metrics_queue_leave  (metrics_t *self, GDBusMethodInvocation *invocation, guint depth);
+
+/* ------------------------------------------------------------------------- *
+ * METRICS_REPORT
+ * ------------------------------------------------------------------------- */
+
+static gint   metrics_compare_code(gconstpointer a, gconstpointer b);
+static gchar *metrics_error_name  (int code);
+gchar        *metrics_report      (const metrics_t *self);
+
+/* ========================================================================= *
+ * METRICS_HISTOGRAM
+ * ========================================================================= */
+
+struct metrics_histogram_t
+{
+    guint64 mhg_count;
+    guint64 mhg_total;                   // [us]
+    guint64 mhg_max;                     // [us]
+    guint64 mhg_bucket[METRICS_BUCKETS]; // [2^N ... 2^(N+1)-1] us
+};
+
+static guint
+metrics_histogram_bucket(gint64 value)
+{
+    /* Bucket N holds values in range [2^N, 2^(N+1)), except that the
+     * first one also holds zero and the last one everything above.
+     */
+    if( value < 2 )
+        return 0;
+    if( value >= ((gint64)1 << (METRICS_BUCKETS - 1)) )
+        return METRICS_BUCKETS - 1;
+    return g_bit_storage((gulong)value) - 1;
+}
+
+static void
+metrics_histogram_add(metrics_histogram_t *self, gint64 value)
+{
+    if( value < 0 )
+        value = 0;
+    self->mhg_count += 1;
+    self->mhg_total += value;
+    if( self->mhg_max < (guint64)value )
+        self->mhg_max = value;
+    self->mhg_bucket[metrics_histogram_bucket(value)] += 1;
+}
+
+static void
+metrics_histogram_report(const metrics_histogram_t *self, GString *text,
+                         const char *title)
+{
+    g_string_append_printf(text, "    %s: n=%" G_GUINT64_FORMAT
+                           " avg=%" G_GUINT64_FORMAT
+                           " max=%" G_GUINT64_FORMAT " us:",
+                           title, self->mhg_count,
+                           self->mhg_count ? self->mhg_total / self->mhg_count : 0,
+                           self->mhg_max);
+    for( guint i = 0; i < METRICS_BUCKETS; ++i ) {
+        if( !self->mhg_bucket[i] )
+            continue;
+        guint64 lo = i ? ((guint64)1 << i) : 0;
+        if( i == METRICS_BUCKETS - 1 )
+            g_string_append_printf(text, " %" G_GUINT64_FORMAT "-:", lo);
+        else
+            g_string_append_printf(text, " %" G_GUINT64_FORMAT
+                                   "-%" G_GUINT64_FORMAT ":",
+                                   lo, ((guint64)2 << i) - 1);
+        g_string_append_printf(text, "%" G_GUINT64_FORMAT, self->mhg_bucket[i]);
+    }
+    g_string_append(text, "\n");
+}
+
+static metrics_histogram_t *
+metrics_histogram_create(void)
+{
+    return g_malloc0(sizeof(metrics_histogram_t));
+}
+
+/* ========================================================================= *
+ * METRICS_METHOD
+ * ========================================================================= */
+
+struct metrics_method_t
+{
+    guint64              mmt_calls;
+    guint64              mmt_pending; // calls without reply yet
+    metrics_histogram_t  mmt_ok;      // latency of successful replies
+    GHashTable          *mmt_errors;  // error code -> metrics_histogram_t *
+};
+
+static metrics_method_t *
+metrics_method_create(void)
+{
+    metrics_method_t *self = g_malloc0(sizeof *self);
+    self->mmt_errors = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                             NULL, g_free);
+    return self;
+}
+
+static void
+metrics_method_delete_cb(void *self)
+{
+    metrics_method_t *method = self;
+    if( method ) {
+        g_hash_table_unref(method->mmt_errors);
+        g_free(method);
+    }
+}
+
+static metrics_histogram_t *
+metrics_method_error(metrics_method_t *self, int code)
+{
+    metrics_histogram_t *histogram =
+        g_hash_table_lookup(self->mmt_errors, GINT_TO_POINTER(code));
+    if( !histogram ) {
+        histogram = metrics_histogram_create();
+        g_hash_table_insert(self->mmt_errors, GINT_TO_POINTER(code), histogram);
+    }
+    return histogram;
+}
+
+/* ========================================================================= *
+ * METRICS_SIGNAL
+ * ========================================================================= */
+
+struct metrics_signal_t
+{
+    guint64 msg_count;
+    guint64 msg_bytes; // serialized payload size
+};
+
+/* ========================================================================= *
+ * METRICS
+ * ========================================================================= */
+
+struct metrics_t
+{
+    gint64               mtr_started;     // monotonic [us]
+
+    // method calls
+    GHashTable          *mtr_methods;     // method name -> metrics_method_t *
+    GHashTable          *mtr_senders;     // sender name -> guint64 *
+    guint64              mtr_evicted;     // calls from dropped senders
+
+    // prompter queue
+    guint                mtr_queue_depth;
+    guint                mtr_queue_max;
+    guint64              mtr_queue_total;
+    metrics_histogram_t  mtr_queue_wait;
+
+    // broadcasts
+    GHashTable          *mtr_signals;     // signal name -> metrics_signal_t *
+};
+
+static void
+metrics_ctor(metrics_t *self)
+{
+    log_info("metrics() create");
+    self->mtr_started     = g_get_monotonic_time();
+    self->mtr_methods     = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  g_free, metrics_method_delete_cb);
+    self->mtr_senders     = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  g_free, g_free);
+    self->mtr_evicted     = 0;
+    self->mtr_queue_depth = 0;
+    self->mtr_queue_max   = 0;
+    self->mtr_queue_total = 0;
+    self->mtr_signals     = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  g_free, g_free);
+}
+
+static void
+metrics_dtor(metrics_t *self)
+{
+    log_info("metrics() delete");
+    if( self->mtr_methods ) {
+        g_hash_table_unref(self->mtr_methods),
+            self->mtr_methods = NULL;
+    }
+    if( self->mtr_senders ) {
+        g_hash_table_unref(self->mtr_senders),
+            self->mtr_senders = NULL;
+    }
+    if( self->mtr_signals ) {
+        g_hash_table_unref(self->mtr_signals),
+            self->mtr_signals = NULL;
+    }
+}
+
+metrics_t *
+metrics_create(void)
+{
+    metrics_t *self = g_malloc0(sizeof *self);
+    metrics_ctor(self);
+    return self;
+}
+
+void
+metrics_delete(metrics_t *self)
+{
+    if( self ) {
+        metrics_dtor(self);
+        g_free(self);
+    }
+}
+
+void
+metrics_delete_at(metrics_t **pself)
+{
+    metrics_delete(*pself), *pself = NULL;
+}
+
+void
+metrics_delete_cb(void *self)
+{
+    metrics_delete(self);
+}
+
+/* ========================================================================= *
+ * METRICS_RECORD
+ * ========================================================================= */
+
+static metrics_method_t *
+metrics_method(metrics_t *self, const char *method)
+{
+    /* Only methods declared in introspection data get dispatched,
+     * so the number of entries stays bounded. */
+    metrics_method_t *stats = g_hash_table_lookup(self->mtr_methods, method);
+    if( !stats ) {
+        stats = metrics_method_create();
+        g_hash_table_insert(self->mtr_methods, g_strdup(method), stats);
+    }
+    return stats;
+}
+
+static void
+metrics_sender(metrics_t *self, const char *sender)
+{
+    guint64 *count = g_hash_table_lookup(self->mtr_senders, sender);
+    if( !count ) {
+        if( g_hash_table_size(self->mtr_senders) >= METRICS_SENDERS_MAX ) {
+            /* Make room by dropping the least active sender. Heavy
+             * hitters stay visible while one-shot clients cycle. */
+            GHashTableIter iter;
+            gpointer       key   = NULL;
+            gpointer       value = NULL;
+            const char    *drop  = NULL;
+            guint64        least = G_MAXUINT64;
+            g_hash_table_iter_init(&iter, self->mtr_senders);
+            while( g_hash_table_iter_next(&iter, &key, &value) ) {
+                if( least > *(guint64 *)value )
+                    least = *(guint64 *)value, drop = key;
+            }
+            if( drop ) {
+                self->mtr_evicted += least;
+                g_hash_table_remove(self->mtr_senders, drop);
+            }
+        }
+        count = g_malloc0(sizeof *count);
+        g_hash_table_insert(self->mtr_senders, g_strdup(sender), count);
+    }
+    *count += 1;
+}
+
+void
+metrics_record_call(metrics_t *self, const char *sender, const char *method)
+{
+    if( self && method ) {
+        metrics_method_t *stats = metrics_method(self, method);
+        stats->mmt_calls   += 1;
+        stats->mmt_pending += 1;
+        if( sender )
+            metrics_sender(self, sender);
+    }
+}
+
+void
+metrics_record_reply(metrics_t *self, const char *method, int code,
+                     gint64 latency)
+{
+    if( self && method ) {
+        metrics_method_t *stats = metrics_method(self, method);
+        if( stats->mmt_pending > 0 )
+            stats->mmt_pending -= 1;
+        if( code == METRICS_REPLY_OK )
+            metrics_histogram_add(&stats->mmt_ok, latency);
+        else
+            metrics_histogram_add(metrics_method_error(stats, code), latency);
+    }
+}
+
+void
+metrics_record_push(metrics_t *self, guint depth)
+{
+    if( self ) {
+        self->mtr_queue_depth  = depth;
+        self->mtr_queue_total += 1;
+        if( self->mtr_queue_max < depth )
+            self->mtr_queue_max = depth;
+    }
+}
+
+void
+metrics_record_pop(metrics_t *self, guint depth, gint64 wait)
+{
+    if( self ) {
+        self->mtr_queue_depth = depth;
+        metrics_histogram_add(&self->mtr_queue_wait, wait);
+    }
+}
+
+void
+metrics_record_signal(metrics_t *self, const char *member, gsize size)
+{
+    /* Every subscriber wakes up once per signal, so signal count
+     * is what matters most; payload size tells bus traffic. */
+    if( self && member ) {
+        metrics_signal_t *stats = g_hash_table_lookup(self->mtr_signals, member);
+        if( !stats ) {
+            stats = g_malloc0(sizeof *stats);
+            g_hash_table_insert(self->mtr_signals, g_strdup(member), stats);
+        }
+        stats->msg_count += 1;
+        stats->msg_bytes += size;
+    }
+}
+
+/* ========================================================================= *
+ * METRICS_INVOCATION
+ * ========================================================================= */
+
+static GQuark
+metrics_call_quark(void)
+{
+    static GQuark quark = 0;
+    if( !quark )
+        quark = g_quark_from_static_string("sailjaild-metrics-call");
+    return quark;
+}
+
+static GQuark
+metrics_queue_quark(void)
+{
+    static GQuark quark = 0;
+    if( !quark )
+        quark = g_quark_from_static_string("sailjaild-metrics-queue");
+    return quark;
+}
+
+static void
+metrics_set_stamp(GDBusMethodInvocation *invocation, GQuark quark)
+{
+    gint64 *stamp = g_malloc(sizeof *stamp);
+    *stamp = g_get_monotonic_time();
+    g_object_set_qdata_full(G_OBJECT(invocation), quark, stamp, g_free);
+}
+
+static gint64
+metrics_get_elapsed(GDBusMethodInvocation *invocation, GQuark quark)
+{
+    const gint64 *stamp = g_object_get_qdata(G_OBJECT(invocation), quark);
+    return stamp ? g_get_monotonic_time() - *stamp : 0;
+}
+
+void
+metrics_call_begin(metrics_t *self, GDBusMethodInvocation *invocation)
+{
+    if( self && invocation ) {
+        metrics_set_stamp(invocation, metrics_call_quark());
+        metrics_record_call(self,
+                            g_dbus_method_invocation_get_sender(invocation),
+                            g_dbus_method_invocation_get_method_name(invocation));
+    }
+}
+
+void
+metrics_call_end(metrics_t *self, GDBusMethodInvocation *invocation, int code)
+{
+    /* Note: Must be called before g_dbus_method_invocation_return_xxx()
+     *       as those release the invocation object.
+     */
+    if( self && invocation ) {
+        metrics_record_reply(self,
+                             g_dbus_method_invocation_get_method_name(invocation),
+                             code,
+                             metrics_get_elapsed(invocation, metrics_call_quark()));
+    }
+}
+
+void
+metrics_queue_enter(metrics_t *self, GDBusMethodInvocation *invocation,
+                    guint depth)
+{
+    if( self && invocation ) {
+        metrics_set_stamp(invocation, metrics_queue_quark());
+        metrics_record_push(self, depth);
+    }
+}
+
+void
+metrics_queue_leave(metrics_t *self, GDBusMethodInvocation *invocation,
+                    guint depth)
+{
+    if( self && invocation ) {
+        metrics_record_pop(self, depth,
+                           metrics_get_elapsed(invocation, metrics_queue_quark()));
+    }
+}
+
+/* ========================================================================= *
+ * METRICS_REPORT
+ * ========================================================================= */
+
+static gint
+metrics_compare_code(gconstpointer a, gconstpointer b)
+{
+    gint lhs = GPOINTER_TO_INT(a);
+    gint rhs = GPOINTER_TO_INT(b);
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static gchar *
+metrics_error_name(int code)
+{
+    GError error = {
+        .domain  = G_DBUS_ERROR,
+        .code    = code,
+        .message = (gchar *)"",
+    };
+    return g_dbus_error_encode_gerror(&error);
+}
+
+gchar *
+metrics_report(const metrics_t *self)
+{
+    GString *text = g_string_new(NULL);
+
+    g_string_append_printf(text, "uptime: %" G_GINT64_FORMAT " s\n",
+                            (g_get_monotonic_time() - self->mtr_started)
+                            / G_USEC_PER_SEC);
+
+    g_string_append(text, "methods:\n");
+    GList *methods = g_list_sort(g_hash_table_get_keys(self->mtr_methods),
+                                 (GCompareFunc)strcmp);
+    for( GList *iter = methods; iter; iter = iter->next ) {
+        const char             *method = iter->data;
+        const metrics_method_t *stats  =
+            g_hash_table_lookup(self->mtr_methods, method);
+        g_string_append_printf(text, "  %s: calls=%" G_GUINT64_FORMAT
+                               " pending=%" G_GUINT64_FORMAT "\n",
+                               method, stats->mmt_calls, stats->mmt_pending);
+        if( stats->mmt_ok.mhg_count )
+            metrics_histogram_report(&stats->mmt_ok, text, "ok");
+        GList *codes = g_list_sort(g_hash_table_get_keys(stats->mmt_errors),
+                                   metrics_compare_code);
+        for( GList *code = codes; code; code = code->next ) {
+            gchar *name = metrics_error_name(GPOINTER_TO_INT(code->data));
+            metrics_histogram_report(g_hash_table_lookup(stats->mmt_errors,
+                                                         code->data),
+                                     text, name);
+            g_free(name);
+        }
+        g_list_free(codes);
+    }
+    g_list_free(methods);
+
+    g_string_append_printf(text, "prompter queue: depth=%u max=%u"
+                           " queued=%" G_GUINT64_FORMAT "\n",
+                           self->mtr_queue_depth, self->mtr_queue_max,
+                           self->mtr_queue_total);
+    if( self->mtr_queue_wait.mhg_count )
+        metrics_histogram_report(&self->mtr_queue_wait, text, "wait");
+
+    g_string_append(text, "senders:\n");
+    GList *senders = g_list_sort(g_hash_table_get_keys(self->mtr_senders),
+                                 (GCompareFunc)strcmp);
+    for( GList *iter = senders; iter; iter = iter->next ) {
+        const guint64 *count = g_hash_table_lookup(self->mtr_senders, iter->data);
+        g_string_append_printf(text, "  %s: calls=%" G_GUINT64_FORMAT "\n",
+                               (const char *)iter->data, *count);
+    }
+    g_list_free(senders);
+    if( self->mtr_evicted )
+        g_string_append_printf(text, "  (other): calls=%" G_GUINT64_FORMAT "\n",
+                               self->mtr_evicted);
+
+    g_string_append(text, "signals:\n");
+    GList *signals = g_list_sort(g_hash_table_get_keys(self->mtr_signals),
+                                 (GCompareFunc)strcmp);
+    for( GList *iter = signals; iter; iter = iter->next ) {
+        const metrics_signal_t *stats =
+            g_hash_table_lookup(self->mtr_signals, iter->data);
+        g_string_append_printf(text, "  %s: count=%" G_GUINT64_FORMAT
+                               " bytes=%" G_GUINT64_FORMAT "\n",
+                               (const char *)iter->data,
+                               stats->msg_count, stats->msg_bytes);
+    }
+    g_list_free(signals);
+
+    return g_string_free(text, FALSE);
+}
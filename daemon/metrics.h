@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef  METRICS_H_
+# define METRICS_H_
+
+# include <stdbool.h>
+# include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* ========================================================================= *
+ * Constants
+ * ========================================================================= */
+
+/* Number of log2 latency buckets, in microseconds */
+# define METRICS_BUCKETS     32
+
+/* Maximum number of distinct D-Bus senders tracked */
+# define METRICS_SENDERS_MAX 64
+
+/* Pseudo error code used for recording successful replies */
+# define METRICS_REPLY_OK    (-1)
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct metrics_t metrics_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * METRICS
+ * ------------------------------------------------------------------------- */
+
+metrics_t *metrics_create   (void);
+void       metrics_delete   (metrics_t *self);
+void       metrics_delete_at(metrics_t **pself);
+void       metrics_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * METRICS_RECORD
+ * ------------------------------------------------------------------------- */
+
+void metrics_record_call  (metrics_t *self, const char *sender, const char *method);
+void metrics_record_reply (metrics_t *self, const char *method, int code, gint64 latency);
+void metrics_record_push  (metrics_t *self, guint depth);
+void metrics_record_pop   (metrics_t *self, guint depth, gint64 wait);
+void metrics_record_signal(metrics_t *self, const char *member, gsize size);
+
+/* ------------------------------------------------------------------------- *
+ * METRICS_INVOCATION
+ * ------------------------------------------------------------------------- */
+
+void metrics_call_begin (metrics_t *self, GDBusMethodInvocation *invocation);
+void metrics_call_end   (metrics_t *self, GDBusMethodInvocation *invocation, int code);
+void metrics_queue_enter(metrics_t *self, GDBusMethodInvocation *invocation, guint depth);
+void metrics_queue_leave(metrics_t *self, GDBusMethodInvocation *invocation, guint depth);
+
+/* ------------------------------------------------------------------------- *
+ * METRICS_REPORT
+ * ------------------------------------------------------------------------- */
+
+gchar *metrics_report(const metrics_t *self);
+
+G_END_DECLS
+
+#endif /* METRICS_H_ */
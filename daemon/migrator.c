@@ -40,6 +40,7 @@
 #include "control.h"
 #include "logging.h"
 #include "util.h"
+#include "permset.h"
 #include "settings.h"
 #include "stringset.h"
 
@@ -550,7 +551,7 @@ migrator_process_file(migrator_t *self, const gchar *path)
     gchar         *appname     = NULL;
     appsettings_t *appsettings = NULL;
     approval_t    *approval    = approval_create(self, path);
-    stringset_t   *granted     = stringset_create();
+    permset_t      granted;
 
     if( approval_valid(approval) ) {
         appname = path_to_desktop_name(approval_profile(approval));
@@ -560,9 +561,11 @@ migrator_process_file(migrator_t *self, const gchar *path)
             if( !g_strcmp0(approval_organization(approval), appinfo_get_organization_name(appinfo)) &&
                 !g_strcmp0(approval_application(approval), appinfo_get_application_name(appinfo)) ) {
                 appsettings = settings_appsettings(migrator_settings(self), approval_uid(approval), appname);
-                stringset_extend(granted, appsettings_get_granted(appsettings));
-                stringset_extend(granted, approval_permissions(approval));
-                appsettings_set_granted(appsettings, granted);
+                permset_assign(&granted, appsettings_get_granted(appsettings));
+                for( const GList *iter = stringset_list(approval_permissions(approval));
+                     iter; iter = iter->next )
+                    permset_add_name(&granted, iter->data);
+                appsettings_set_granted(appsettings, &granted);
                 appsettings_set_allowed(appsettings, APP_ALLOWED_ALWAYS);
                 migrated = true;
                 log_info("%s migrated", path);
@@ -575,7 +578,6 @@ migrator_process_file(migrator_t *self, const gchar *path)
 
     migrator_removal_enqueue(self, path);
 
-    stringset_delete(granted);
     approval_delete(approval);
     g_free(appname);
 }
@@ -0,0 +1,977 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "appcache.h"
+#include "desktop.h"
+#include "firejail.h"
+#include "intern.h"
+#include "metrics.h"
+#include "permset.h"
+#include "profile.h"
+#include "stringset.h"
+#include "util.h"
+#include "watcher.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glob.h>
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+/* ========================================================================= *
+ * Constants
+ * ========================================================================= */
+
+#define BENCH_STRINGSET_ITEMS    10000
+
+#define BENCH_INTERN_APPS        300
+#define BENCH_INTERN_USERS       8
+
+#define BENCH_PERMSET_USERS      8
+#define BENCH_PERMSET_APPS       500
+
+#define BENCH_DESKTOP_ROUNDS     1000
+#define BENCH_DESKTOP_CORPUS     2000
+
+#define BENCH_APPCACHE_FILES     500
+
+#define BENCH_METRICS_APPS       300
+
+#define BENCH_PROFILE_PERMISSIONS 20
+#define BENCH_PROFILE_INCLUDES   10
+#define BENCH_PROFILE_LINES      50
+#define BENCH_PROFILE_ROUNDS     100
+
+#define BENCH_WATCHER_ROUNDS     100
+#define BENCH_WATCHER_TIMEOUT    10000
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct
+{
+    const char *name;
+    bool      (*func)(void);
+} bench_t;
+
+typedef struct
+{
+    guint      wtc_notifies;
+    gint64     wtc_notified;
+    GMainLoop *wtc_main_loop;
+} bench_watch_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * UTILITY
+ * ------------------------------------------------------------------------- */
+
+static double   bench_elapsed_ms      (gint64 started);
+static gchar   *bench_tmpdir          (void);
+static gchar   *bench_write           (const gchar *dir, const gchar *name, const gchar *text);
+static void     bench_cleanup         (const gchar *dir);
+static gchar  **bench_names           (guint count);
+
+/* ------------------------------------------------------------------------- *
+ * STRINGSET
+ * ------------------------------------------------------------------------- */
+
+static bool     bench_stringset       (void);
+
+/* ------------------------------------------------------------------------- *
+ * INTERN
+ * ------------------------------------------------------------------------- */
+
+static bool     bench_intern          (void);
+
+/* ------------------------------------------------------------------------- *
+ * PERMSET
+ * ------------------------------------------------------------------------- */
+
+static bool     bench_permset         (void);
+
+/* ------------------------------------------------------------------------- *
+ * DESKTOP
+ * ------------------------------------------------------------------------- */
+
+static gchar   *bench_desktop_text    (guint i);
+static bool     bench_desktop_parse   (void);
+static bool     bench_desktop_threads (void);
+
+/* ------------------------------------------------------------------------- *
+ * APPCACHE
+ * ------------------------------------------------------------------------- */
+
+static bool     bench_appcache        (void);
+
+/* ------------------------------------------------------------------------- *
+ * METRICS
+ * ------------------------------------------------------------------------- */
+
+static gsize    bench_signal_size     (const char *member, GVariant *parameters);
+static bool     bench_metrics         (void);
+
+/* ------------------------------------------------------------------------- *
+ * PROFILE
+ * ------------------------------------------------------------------------- */
+
+static gsize    bench_profile_parse   (const gchar *path, int depth);
+static gint64   bench_profile_firejail(const stringset_t *profiles);
+static bool     bench_profile         (void);
+
+/* ------------------------------------------------------------------------- *
+ * WATCHER
+ * ------------------------------------------------------------------------- */
+
+static void     bench_watch_notify_cb (const gchar *name, gpointer aptr);
+static void     bench_watch_monitor_cb(GFileMonitor *mon, GFile *file1, GFile *file2, GFileMonitorEvent event, gpointer aptr);
+static gboolean bench_watch_timeout_cb(gpointer aptr);
+static void     bench_watch_run       (bench_watch_t *watch, guint ms);
+static void     bench_watch_settle    (bench_watch_t *watch, guint ms);
+static void     bench_watch_rounds    (bench_watch_t *watch, const gchar *dir, gint64 *latency, guint *notifies);
+static bool     bench_watcher         (void);
+
+/* ------------------------------------------------------------------------- *
+ * MAIN
+ * ------------------------------------------------------------------------- */
+
+int main(int ac, char **av);
+
+/* ========================================================================= *
+ * UTILITY
+ * ========================================================================= */
+
+static const bench_t bench_lut[] =
+{
+    { "stringset",       bench_stringset       },
+    { "intern",          bench_intern          },
+    { "permset",         bench_permset         },
+    { "desktop-parse",   bench_desktop_parse   },
+    { "desktop-threads", bench_desktop_threads },
+    { "appcache",        bench_appcache        },
+    { "metrics",         bench_metrics         },
+    { "profile",         bench_profile         },
+    { "watcher",         bench_watcher         },
+    { NULL,              NULL                  }
+};
+
+static double
+bench_elapsed_ms(gint64 started)
+{
+    return (g_get_monotonic_time() - started) / 1000.0;
+}
+
+static gchar *
+bench_tmpdir(void)
+{
+    GError *err = NULL;
+    gchar  *dir = g_dir_make_tmp("module_bench-XXXXXX", &err);
+    if( !dir ) {
+        fprintf(stderr, "tmpdir: %s\n", err->message);
+        g_error_free(err);
+    }
+    return dir;
+}
+
+static gchar *
+bench_write(const gchar *dir, const gchar *name, const gchar *text)
+{
+    gchar *path = g_build_filename(dir, name, NULL);
+    if( !g_file_set_contents(path, text, -1, NULL) ) {
+        fprintf(stderr, "%s: could not write\n", path);
+        g_free(path), path = NULL;
+    }
+    return path;
+}
+
+static void
+bench_cleanup(const gchar *dir)
+{
+    GDir *handle = g_dir_open(dir, 0, NULL);
+    if( handle ) {
+        const gchar *name;
+        while( (name = g_dir_read_name(handle)) ) {
+            gchar *path = g_build_filename(dir, name, NULL);
+            if( g_file_test(path, G_FILE_TEST_IS_DIR) )
+                bench_cleanup(path);
+            else
+                g_unlink(path);
+            g_free(path);
+        }
+        g_dir_close(handle);
+    }
+    g_rmdir(dir);
+}
+
+static gchar **
+bench_names(guint count)
+{
+    gchar **names = g_malloc0_n(count + 1, sizeof *names);
+    for( guint i = 0; i < count; ++i )
+        names[i] = g_strdup_printf("org.example.application%05u", i);
+    return names;
+}
+
+/* ========================================================================= *
+ * STRINGSET
+ * ========================================================================= */
+
+static bool
+bench_stringset(void)
+{
+    gchar      **names = bench_names(BENCH_STRINGSET_ITEMS);
+    stringset_t *set   = stringset_create();
+    stringset_t *mask  = stringset_create();
+
+    gint64 started = g_get_monotonic_time();
+    for( guint i = 0; names[i]; ++i )
+        stringset_add_item(set, names[i]);
+    printf("add %u items: %.3f ms\n", BENCH_STRINGSET_ITEMS,
+           bench_elapsed_ms(started));
+
+    for( guint i = 0; names[i]; i += 2 )
+        stringset_add_item(mask, names[i]);
+    started = g_get_monotonic_time();
+    stringset_t *in  = stringset_filter_in(set, mask);
+    stringset_t *out = stringset_filter_out(set, mask);
+    printf("filter %u items in and out: %.3f ms\n", BENCH_STRINGSET_ITEMS,
+           bench_elapsed_ms(started));
+    stringset_delete(out);
+    stringset_delete(in);
+
+    /* Removing in reverse order is the worst case for
+     * list scanning removal. */
+    started = g_get_monotonic_time();
+    for( guint i = BENCH_STRINGSET_ITEMS; i-- > 0; )
+        stringset_remove_item(set, names[i]);
+    printf("remove %u items: %.3f ms\n", BENCH_STRINGSET_ITEMS,
+           bench_elapsed_ms(started));
+
+    bool ack = stringset_empty(set);
+    stringset_delete(mask);
+    stringset_delete(set);
+    g_strfreev(names);
+    return ack;
+}
+
+/* ========================================================================= *
+ * INTERN
+ * ========================================================================= */
+
+static bool
+bench_intern(void)
+{
+    /* Application id references held by the daemon: key in the
+     * applications lookup table, appinfo object, key in the services
+     * lookup table, and for each user a key in the usersettings table
+     * plus the appsettings object.
+     */
+    const guint    refs_per_app = 3 + 2 * BENCH_INTERN_USERS;
+    const gchar  **held         = g_malloc0_n(BENCH_INTERN_APPS * refs_per_app,
+                                              sizeof *held);
+    guint          count        = 0;
+    intern_stats_t stats;
+
+    for( guint i = 0; i < BENCH_INTERN_APPS; ++i ) {
+        gchar *appname = g_strdup_printf("org.example.application%03u", i);
+        for( guint k = 0; k < refs_per_app; ++k )
+            held[count++] = intern_acquire(appname);
+        g_free(appname);
+    }
+
+    /* Ignores malloc bookkeeping, which makes the
+     * actual savings larger than reported */
+    intern_get_stats(&stats);
+    printf("%u apps x %u users: %zu bytes pooled, %zu bytes as copies,"
+           " %zu bytes saved\n",
+           BENCH_INTERN_APPS, BENCH_INTERN_USERS,
+           stats.ist_pooled_bytes, stats.ist_copied_bytes,
+           stats.ist_copied_bytes - stats.ist_pooled_bytes);
+    bool ack = (stats.ist_strings == BENCH_INTERN_APPS &&
+                stats.ist_references == count);
+
+    for( guint i = 0; i < count; ++i )
+        intern_release(held[i]);
+    g_free(held);
+    return ack;
+}
+
+/* ========================================================================= *
+ * PERMSET
+ * ========================================================================= */
+
+static bool
+bench_permset(void)
+{
+    /* The set operations that appsettings_rethink() does for each
+     * application: intersect granted with application permissions,
+     * and compare the result with previous state.
+     */
+    static const char * const names[] = {
+        "Audio", "Bluetooth", "Calendar", "CallRecordings", "Camera",
+        "Contacts", "Documents", "Downloads", "Internet", "Location",
+        "MediaIndexing", "Messages", "Microphone", "Music", "NFC",
+        "Phone", "Pictures", "RemovableMedia", "Sharing", "Videos",
+    };
+    const guint count = BENCH_PERMSET_USERS * BENCH_PERMSET_APPS;
+
+    stringset_t **ss_permissions = g_malloc0_n(count, sizeof *ss_permissions);
+    stringset_t **ss_granted     = g_malloc0_n(count, sizeof *ss_granted);
+    permset_t    *ps_permissions = g_malloc0_n(count, sizeof *ps_permissions);
+    permset_t    *ps_granted     = g_malloc0_n(count, sizeof *ps_granted);
+
+    for( guint k = 0; k < G_N_ELEMENTS(names); ++k )
+        permset_intern(names[k]);
+
+    for( guint i = 0; i < count; ++i ) {
+        ss_permissions[i] = stringset_create();
+        ss_granted[i]     = stringset_create();
+        for( guint k = 0; k < G_N_ELEMENTS(names); ++k ) {
+            if( (i + k) % 3 == 0 )
+                stringset_add_item(ss_permissions[i], names[k]);
+            if( (i + k) % 6 == 0 )
+                stringset_add_item(ss_granted[i], names[k]);
+        }
+        permset_from_stringset(&ps_permissions[i], ss_permissions[i]);
+        permset_from_stringset(&ps_granted[i], ss_granted[i]);
+    }
+
+    gint64 started = g_get_monotonic_time();
+    for( guint i = 0; i < count; ++i ) {
+        stringset_t *effective = stringset_filter_in(ss_granted[i],
+                                                     ss_permissions[i]);
+        if( !stringset_equal(ss_granted[i], effective) )
+            stringset_assign(ss_granted[i], effective);
+        stringset_delete(effective);
+    }
+    printf("stringset, %u apps x %u users: %.3f ms\n",
+           BENCH_PERMSET_APPS, BENCH_PERMSET_USERS, bench_elapsed_ms(started));
+
+    started = g_get_monotonic_time();
+    for( guint i = 0; i < count; ++i ) {
+        permset_t effective = ps_granted[i];
+        permset_mask(&effective, &ps_permissions[i]);
+        if( !permset_equal(&ps_granted[i], &effective) )
+            permset_assign(&ps_granted[i], &effective);
+    }
+    printf("permset, %u apps x %u users: %.3f ms\n",
+           BENCH_PERMSET_APPS, BENCH_PERMSET_USERS, bench_elapsed_ms(started));
+
+    for( guint i = 0; i < count; ++i ) {
+        stringset_delete(ss_permissions[i]);
+        stringset_delete(ss_granted[i]);
+    }
+    g_free(ss_permissions);
+    g_free(ss_granted);
+    g_free(ps_permissions);
+    g_free(ps_granted);
+    return true;
+}
+
+/* ========================================================================= *
+ * DESKTOP
+ * ========================================================================= */
+
+/* Synthetic content resembling typical application desktop files */
+static gchar *
+bench_desktop_text(guint i)
+{
+    return g_strdup_printf("[Desktop Entry]\n"
+                           "Type=Application\n"
+                           "Name=Application %u\n"
+                           "Name[fi]=Sovellus %u\n"
+                           "Comment=Synthetic application number %u\n"
+                           "Icon=icon-launcher-app%u\n"
+                           "Exec=/usr/bin/sailfish-qml app%u\n"
+                           "X-Nemo-Application-Type=silica-qt5\n"
+                           "X-Nemo-Single-Instance=no\n"
+                           "X-Maemo-Service=org.example.app%u\n"
+                           "X-Maemo-Object-Path=/org/example/app%u\n"
+                           "X-Maemo-Method=org.example.app%u.launch\n"
+                           "\n"
+                           "[X-Sailjail]\n"
+                           "OrganizationName=org.example\n"
+                           "ApplicationName=app%u\n"
+                           "Permissions=Internet;Audio;Pictures;Location\n",
+                           i, i, i, i, i, i, i, i, i);
+}
+
+static bool
+bench_desktop_parse(void)
+{
+    /* Installed application desktop files */
+    glob_t gl = {};
+    if( glob(APPLICATIONS_DIRECTORY "/" APPLICATIONS_PATTERN, 0, 0, &gl) != 0 ) {
+        printf("no files in %s\n", APPLICATIONS_DIRECTORY);
+        globfree(&gl);
+        return true;
+    }
+
+    gint64 started = g_get_monotonic_time();
+    for( guint round = 0; round < BENCH_DESKTOP_ROUNDS; ++round ) {
+        for( size_t i = 0; i < gl.gl_pathc; ++i ) {
+            GKeyFile *ini = g_key_file_new();
+            keyfile_merge(ini, gl.gl_pathv[i]);
+            g_key_file_unref(ini);
+        }
+    }
+    double before = bench_elapsed_ms(started);
+
+    started = g_get_monotonic_time();
+    for( guint round = 0; round < BENCH_DESKTOP_ROUNDS; ++round ) {
+        for( size_t i = 0; i < gl.gl_pathc; ++i ) {
+            GKeyFile *ini = g_key_file_new();
+            desktop_merge(ini, gl.gl_pathv[i]);
+            g_key_file_unref(ini);
+        }
+    }
+    double after = bench_elapsed_ms(started);
+
+    size_t total = gl.gl_pathc * BENCH_DESKTOP_ROUNDS;
+    printf("keyfile_merge, %zu files: %.3f ms, %.0f files/s\n",
+           total, before, total / before * 1e3);
+    printf("desktop_merge, %zu files: %.3f ms, %.0f files/s\n",
+           total, after, total / after * 1e3);
+
+    globfree(&gl);
+    return true;
+}
+
+static bool
+bench_desktop_threads(void)
+{
+    static const guint threads[] = { 1, 2, 4, 8 };
+
+    bool   ack = false;
+    gchar *dir = bench_tmpdir();
+    if( !dir )
+        return false;
+
+    gchar          **paths  = g_new0(gchar *, BENCH_DESKTOP_CORPUS + 1);
+    desktop_load_t  *jobs   = g_new0(desktop_load_t, BENCH_DESKTOP_CORPUS);
+    double           serial = 0;
+
+    for( guint i = 0; i < BENCH_DESKTOP_CORPUS; ++i ) {
+        gchar *name = g_strdup_printf("app%u" APPLICATIONS_EXTENSION, i);
+        gchar *text = bench_desktop_text(i);
+        paths[i] = bench_write(dir, name, text);
+        g_free(text);
+        g_free(name);
+        if( !paths[i] )
+            goto EXIT;
+    }
+
+    for( size_t t = 0; t < G_N_ELEMENTS(threads); ++t ) {
+        for( guint i = 0; i < BENCH_DESKTOP_CORPUS; ++i ) {
+            jobs[i].dld_count = 1;
+            jobs[i].dld_paths = g_new0(gchar *, 1);
+            jobs[i].dld_paths[0] = g_strdup(paths[i]);
+        }
+
+        gint64 started = g_get_monotonic_time();
+        desktop_load_all(jobs, BENCH_DESKTOP_CORPUS, threads[t]);
+        double elapsed = bench_elapsed_ms(started);
+
+        if( t == 0 )
+            serial = elapsed;
+        printf("desktop_load_all, %u files, %u threads: %.3f ms, speedup %.2f\n",
+               BENCH_DESKTOP_CORPUS, threads[t], elapsed, serial / elapsed);
+
+        for( guint i = 0; i < BENCH_DESKTOP_CORPUS; ++i )
+            desktop_load_clear(&jobs[i]);
+    }
+    ack = true;
+
+EXIT:
+    bench_cleanup(dir);
+    g_free(jobs);
+    g_strfreev(paths);
+    g_free(dir);
+    return ack;
+}
+
+/* ========================================================================= *
+ * APPCACHE
+ * ========================================================================= */
+
+static bool
+bench_appcache(void)
+{
+    bool   ack = false;
+    gchar *dir = bench_tmpdir();
+    if( !dir )
+        return false;
+
+    gchar           *path  = g_build_filename(dir, "appinfo.cache", NULL);
+    gchar          **names = bench_names(BENCH_APPCACHE_FILES);
+    gchar          **paths = g_new0(gchar *, BENCH_APPCACHE_FILES + 1);
+    appcache_stamp_t stamps[APPCACHE_STAMP_COUNT];
+
+    stamps[0] = (appcache_stamp_t){ 1620000000, 123, 4567 };
+    appcache_stamp_clear(&stamps[1]);
+
+    for( guint i = 0; i < BENCH_APPCACHE_FILES; ++i ) {
+        gchar *name = g_strdup_printf("%s" APPLICATIONS_EXTENSION, names[i]);
+        gchar *text = bench_desktop_text(i);
+        paths[i] = bench_write(dir, name, text);
+        g_free(text);
+        g_free(name);
+        if( !paths[i] )
+            goto EXIT;
+    }
+
+    /* Cold: every desktop file is parsed and the cache is written */
+    gint64 started = g_get_monotonic_time();
+    appcache_t *appcache = appcache_create(path);
+    appcache_load(appcache);
+    for( guint i = 0; i < BENCH_APPCACHE_FILES; ++i ) {
+        GKeyFile *ini = g_key_file_new();
+        keyfile_merge(ini, paths[i]);
+        appcache_update(appcache, names[i], stamps, ini);
+        g_key_file_unref(ini);
+    }
+    appcache_save(appcache);
+    appcache_delete(appcache);
+    double cold = bench_elapsed_ms(started);
+
+    /* Warm: everything comes from the cache */
+    guint hits = 0;
+    started = g_get_monotonic_time();
+    appcache = appcache_create(path);
+    appcache_load(appcache);
+    for( guint i = 0; i < BENCH_APPCACHE_FILES; ++i ) {
+        GKeyFile *ini = appcache_lookup(appcache, names[i], stamps);
+        if( ini ) {
+            ++hits;
+            g_key_file_unref(ini);
+        }
+    }
+    appcache_save(appcache);
+    appcache_delete(appcache);
+    double warm = bench_elapsed_ms(started);
+
+    printf("cold start, %u desktop files: %.3f ms\n", BENCH_APPCACHE_FILES, cold);
+    printf("warm start, %u desktop files: %.3f ms, %u cache hits\n",
+           BENCH_APPCACHE_FILES, warm, hits);
+    ack = (hits == BENCH_APPCACHE_FILES);
+
+EXIT:
+    bench_cleanup(dir);
+    g_strfreev(paths);
+    g_strfreev(names);
+    g_free(path);
+    g_free(dir);
+    return ack;
+}
+
+/* ========================================================================= *
+ * METRICS
+ * ========================================================================= */
+
+/* Size of the message as it goes over the bus */
+static gsize
+bench_signal_size(const char *member, GVariant *parameters)
+{
+    GDBusMessage *message = g_dbus_message_new_signal("/org/sailfishos/sailjaild1",
+                                                      "org.sailfishos.sailjaild1",
+                                                      member);
+    g_dbus_message_set_serial(message, 1);
+    g_dbus_message_set_body(message, parameters);
+    gsize   size = 0;
+    guchar *blob = g_dbus_message_to_blob(message, &size,
+                                          G_DBUS_CAPABILITY_FLAGS_NONE, NULL);
+    g_free(blob);
+    g_object_unref(message);
+    return size;
+}
+
+static bool
+bench_metrics(void)
+{
+    /* Broadcast storm where every application changes at once:
+     * per-application signals vs one ApplicationsChanged signal.
+     * Each signal wakes up every subscriber once.
+     */
+    metrics_t      *batched      = metrics_create();
+    gsize           legacy_bytes = 0;
+    GVariantBuilder changed;
+
+    g_variant_builder_init(&changed, G_VARIANT_TYPE("as"));
+    for( int i = 0; i < BENCH_METRICS_APPS; ++i ) {
+        gchar *app = g_strdup_printf("org.example.application%d", i);
+        legacy_bytes += bench_signal_size("ApplicationChanged",
+                                          g_variant_new("(s)", app));
+        g_variant_builder_add(&changed, "s", app);
+        g_free(app);
+    }
+    gsize batched_bytes =
+        bench_signal_size("ApplicationsChanged",
+                          g_variant_new("(@as@as@as)",
+                                        g_variant_new_strv(NULL, 0),
+                                        g_variant_builder_end(&changed),
+                                        g_variant_new_strv(NULL, 0)));
+    metrics_record_signal(batched, "ApplicationsChanged", batched_bytes);
+
+    printf("per-application: %d signals, %zu bytes\n",
+           BENCH_METRICS_APPS, legacy_bytes);
+    printf("ApplicationsChanged: 1 signal, %zu bytes\n", batched_bytes);
+
+    gchar *report = metrics_report(batched);
+    printf("\n%s", report);
+    g_free(report);
+
+    metrics_delete(batched);
+    return true;
+}
+
+/* ========================================================================= *
+ * PROFILE
+ * ========================================================================= */
+
+/* Read profiles the way firejail does, following each include */
+static gsize
+bench_profile_parse(const gchar *path, int depth)
+{
+    gsize  lines = 0;
+    gchar *text  = NULL;
+    if( depth <= PROFILE_INCLUDE_DEPTH_MAX &&
+        g_file_get_contents(path, &text, NULL, NULL) ) {
+        gchar **vector = g_strsplit(text, "\n", -1);
+        for( size_t i = 0; vector[i]; ++i ) {
+            gchar *line = g_strstrip(vector[i]);
+            if( g_str_has_prefix(line, "include /") )
+                lines += bench_profile_parse(line + 8, depth + 1);
+            else if( *line && *line != '#' )
+                ++lines;
+        }
+        g_strfreev(vector);
+    }
+    g_free(text);
+    return lines;
+}
+
+static gint64
+bench_profile_firejail(const stringset_t *profiles)
+{
+    GPtrArray *argv = g_ptr_array_new_with_free_func(g_free);
+    g_ptr_array_add(argv, g_strdup(FIREJAIL_BINARY));
+    g_ptr_array_add(argv, g_strdup("--quiet"));
+    for( const GList *iter = stringset_list(profiles); iter; iter = iter->next )
+        g_ptr_array_add(argv, g_strdup_printf("--profile=%s", (gchar *)iter->data));
+    g_ptr_array_add(argv, g_strdup("--"));
+    g_ptr_array_add(argv, g_strdup("/bin/true"));
+    g_ptr_array_add(argv, NULL);
+
+    gint64 started = g_get_monotonic_time();
+    gint64 elapsed = -1;
+    if( g_spawn_sync(NULL, (gchar **)argv->pdata, NULL,
+                     G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+                     NULL, NULL, NULL, NULL, NULL, NULL) )
+        elapsed = g_get_monotonic_time() - started;
+
+    g_ptr_array_free(argv, true);
+    return elapsed;
+}
+
+static bool
+bench_profile(void)
+{
+    /* Permission profiles sharing common includes, each of which
+     * includes further files - similar to stock sailjail permissions */
+    bool   ack = false;
+    gchar *dir = bench_tmpdir();
+    if( !dir )
+        return false;
+
+    stringset_t *profiles = stringset_create();
+    stringset_t *single   = stringset_create();
+    gchar       *flat     = g_build_filename(dir, "flat.profile", NULL);
+
+    for( int i = 0; i < BENCH_PROFILE_INCLUDES; ++i ) {
+        GString *text = g_string_new(NULL);
+        if( i + 1 < BENCH_PROFILE_INCLUDES )
+            g_string_append_printf(text, "include %s/common%02d.inc\n", dir, i + 1);
+        for( int j = 0; j < BENCH_PROFILE_LINES; ++j )
+            g_string_append_printf(text, "noblacklist ${HOME}/.common%02d-%02d\n", i, j);
+        gchar *name = g_strdup_printf("common%02d.inc", i);
+        gchar *path = bench_write(dir, name, text->str);
+        g_free(name);
+        g_string_free(text, true);
+        if( !path )
+            goto EXIT;
+        g_free(path);
+    }
+
+    for( int i = 0; i < BENCH_PROFILE_PERMISSIONS; ++i ) {
+        GString *text = g_string_new(NULL);
+        g_string_append_printf(text, "include %s/common%02d.inc\n", dir,
+                               i % BENCH_PROFILE_INCLUDES);
+        for( int j = 0; j < BENCH_PROFILE_LINES; ++j )
+            g_string_append_printf(text, "whitelist ${HOME}/.perm%02d-%02d\n", i, j);
+        gchar *name = g_strdup_printf("Perm%02d.permission", i);
+        gchar *path = bench_write(dir, name, text->str);
+        g_free(name);
+        g_string_free(text, true);
+        if( !path )
+            goto EXIT;
+        stringset_add_item_steal(profiles, path);
+    }
+
+    gint64 started = g_get_monotonic_time();
+    if( !profile_write(flat, profiles, NULL) )
+        goto EXIT;
+    gint64 generate = g_get_monotonic_time() - started;
+    stringset_add_item(single, flat);
+
+    gint64 parse[2] = { 0, 0 };
+    gsize  lines[2] = { 0, 0 };
+    for( int i = 0; i < BENCH_PROFILE_ROUNDS; ++i ) {
+        started = g_get_monotonic_time();
+        lines[0] = 0;
+        for( const GList *iter = stringset_list(profiles); iter; iter = iter->next )
+            lines[0] += bench_profile_parse(iter->data, 0);
+        parse[0] += g_get_monotonic_time() - started;
+
+        started = g_get_monotonic_time();
+        lines[1] = bench_profile_parse(flat, 0);
+        parse[1] += g_get_monotonic_time() - started;
+    }
+
+    /* Actual firejail startup can be compared only where it is
+     * installed, otherwise -1 is reported for both */
+    gint64 startup[2] = { -1, -1 };
+    if( access(FIREJAIL_BINARY, X_OK) == 0 ) {
+        startup[0] = bench_profile_firejail(profiles);
+        startup[1] = bench_profile_firejail(single);
+    }
+
+    printf("%d profiles: include chain %" G_GINT64_FORMAT " us / %zu lines,"
+           " flattened %" G_GINT64_FORMAT " us / %zu lines,"
+           " generated in %" G_GINT64_FORMAT " us\n",
+           BENCH_PROFILE_PERMISSIONS,
+           parse[0] / BENCH_PROFILE_ROUNDS, lines[0],
+           parse[1] / BENCH_PROFILE_ROUNDS, lines[1],
+           generate);
+    printf("firejail startup: %" G_GINT64_FORMAT " us vs %" G_GINT64_FORMAT " us\n",
+           startup[0], startup[1]);
+    ack = true;
+
+EXIT:
+    stringset_delete(single);
+    stringset_delete(profiles);
+    g_free(flat);
+    bench_cleanup(dir);
+    g_free(dir);
+    return ack;
+}
+
+/* ========================================================================= *
+ * WATCHER
+ * ========================================================================= */
+
+static void
+bench_watch_notify_cb(const gchar *name, gpointer aptr)
+{
+    bench_watch_t *watch = aptr;
+    (void)name;
+    if( !watch->wtc_notifies++ )
+        watch->wtc_notified = g_get_monotonic_time();
+    g_main_loop_quit(watch->wtc_main_loop);
+}
+
+static void
+bench_watch_monitor_cb(GFileMonitor *mon, GFile *file1, GFile *file2,
+                       GFileMonitorEvent event, gpointer aptr)
+{
+    (void)mon;
+    (void)file2;
+    (void)event;
+    gchar *name = g_file_get_basename(file1);
+    if( g_str_has_suffix(name, ".test") )
+        bench_watch_notify_cb(name, aptr);
+    g_free(name);
+}
+
+static gboolean
+bench_watch_timeout_cb(gpointer aptr)
+{
+    bench_watch_t *watch = aptr;
+    g_main_loop_quit(watch->wtc_main_loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+bench_watch_run(bench_watch_t *watch, guint ms)
+{
+    guint timeout = g_timeout_add(ms, bench_watch_timeout_cb, watch);
+    g_main_loop_run(watch->wtc_main_loop);
+    g_source_remove(timeout);
+}
+
+static void
+bench_watch_settle(bench_watch_t *watch, guint ms)
+{
+    /* Keep dispatching until no events arrive for a while */
+    guint notifies;
+    do {
+        notifies = watch->wtc_notifies;
+        bench_watch_run(watch, ms);
+    } while( notifies != watch->wtc_notifies );
+}
+
+static void
+bench_watch_rounds(bench_watch_t *watch, const gchar *dir,
+                   gint64 *latency, guint *notifies)
+{
+    *latency = 0;
+    *notifies = 0;
+    for( int i = 0; i < BENCH_WATCHER_ROUNDS; ++i ) {
+        gchar *name = g_strdup_printf("file%03d.test", i);
+        watch->wtc_notifies = 0;
+        gint64 started = g_get_monotonic_time();
+        gchar *path = bench_write(dir, name, "test\n");
+        bench_watch_run(watch, BENCH_WATCHER_TIMEOUT);
+        *latency += watch->wtc_notified - started;
+        /* Collect also trailing events for the same change */
+        bench_watch_settle(watch, 50);
+        *notifies += watch->wtc_notifies;
+        if( path )
+            g_unlink(path);
+        bench_watch_settle(watch, 50);
+        g_free(path);
+        g_free(name);
+    }
+}
+
+static bool
+bench_watcher(void)
+{
+    gchar *dir = bench_tmpdir();
+    if( !dir )
+        return false;
+
+    bench_watch_t watch = {
+        .wtc_main_loop = g_main_loop_new(NULL, FALSE),
+    };
+    gint64 latency[2];
+    guint  notifies[2];
+
+    /* Shared inotify watcher */
+    watcher_stats_t stats1, stats2;
+    watcher_get_stats(&stats1);
+    guint id = watcher_add(dir, "*.test", bench_watch_notify_cb, &watch);
+    bench_watch_rounds(&watch, dir, &latency[0], &notifies[0]);
+    watcher_remove(id);
+    watcher_get_stats(&stats2);
+
+    /* GFileMonitor, events are passed via GIO worker thread */
+    GFile        *file = g_file_new_for_path(dir);
+    GFileMonitor *mon  = g_file_monitor_directory(file, G_FILE_MONITOR_WATCH_MOVES,
+                                                  NULL, NULL);
+    if( mon ) {
+        g_signal_connect(mon, "changed", G_CALLBACK(bench_watch_monitor_cb), &watch);
+        bench_watch_rounds(&watch, dir, &latency[1], &notifies[1]);
+        g_object_unref(mon);
+    }
+    g_object_unref(file);
+
+    printf("%d changes: watcher %" G_GINT64_FORMAT " us avg latency,"
+           " %u callbacks, %u wakeups, %u events\n",
+           BENCH_WATCHER_ROUNDS, latency[0] / BENCH_WATCHER_ROUNDS, notifies[0],
+           stats2.wst_wakeups - stats1.wst_wakeups,
+           stats2.wst_events - stats1.wst_events);
+    if( mon )
+        printf("%d changes: GFileMonitor %" G_GINT64_FORMAT " us avg latency,"
+               " %u callbacks\n",
+               BENCH_WATCHER_ROUNDS, latency[1] / BENCH_WATCHER_ROUNDS,
+               notifies[1]);
+
+    g_main_loop_unref(watch.wtc_main_loop);
+    bench_cleanup(dir);
+    g_free(dir);
+    return id != 0;
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int ac, char **av)
+{
+    int exit_code = EXIT_SUCCESS;
+
+    for( int i = 1; i < ac; ++i ) {
+        const bench_t *bench = bench_lut;
+        while( bench->name && strcmp(bench->name, av[i]) )
+            ++bench;
+        if( !bench->name ) {
+            fprintf(stderr,
+                    "USAGE:\n"
+                    "     %s [benchmark ...]\n"
+                    "\n"
+                    "DESCRIPTION:\n"
+                    "     Measures cost of individual sailjaild modules\n"
+                    "     outside the daemon. By default all benchmarks\n"
+                    "     are run, available ones are:\n"
+                    "\n", *av);
+            for( bench = bench_lut; bench->name; ++bench )
+                fprintf(stderr, "     %s\n", bench->name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for( const bench_t *bench = bench_lut; bench->name; ++bench ) {
+        bool selected = (ac < 2);
+        for( int i = 1; !selected && i < ac; ++i )
+            selected = !strcmp(bench->name, av[i]);
+        if( !selected )
+            continue;
+        printf("--- %s\n", bench->name);
+        if( !bench->func() ) {
+            fprintf(stderr, "%s: failed\n", bench->name);
+            exit_code = EXIT_FAILURE;
+        }
+    }
+
+    return exit_code;
+}
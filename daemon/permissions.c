@@ -38,13 +38,13 @@
 
 #include "logging.h"
 #include "control.h"
+#include "permset.h"
 #include "stringset.h"
 #include "util.h"
 
-#include <glob.h>
-#include <fnmatch.h>
+#include "watcher.h"
 
-#include <gio/gio.h>
+#include <glob.h>
 
 /* ========================================================================= *
  * CONSTANTS
@@ -87,7 +87,7 @@ const stringset_t *permissions_available(permissions_t *self);
  * PERMISSIONS_NOTIFY
  * ------------------------------------------------------------------------- */
 
-static void permissions_notify_changed(permissions_t *self);
+static void permissions_notify_changed(permissions_t *self, const stringset_t *added, const stringset_t *removed);
 
 /* ------------------------------------------------------------------------- *
  * PERMISSIONS_MONITOR
@@ -95,14 +95,13 @@ static void permissions_notify_changed(permissions_t *self);
 
 static void permissions_start_monitor(permissions_t *self);
 static void permissions_stop_monitor (permissions_t *self);
-static bool permissions_monitor_p    (const gchar *path);
-static void permissions_monitor_cb   (GFileMonitor *mon, GFile *file1, GFile *file2, GFileMonitorEvent event, gpointer aptr);
+static void permissions_monitor_cb   (const gchar *name, gpointer aptr);
 
 /* ------------------------------------------------------------------------- *
  * PERMISSIONS_SCAN
  * ------------------------------------------------------------------------- */
 
-static bool     permissions_scan_now     (permissions_t *self);
+static bool     permissions_scan_now     (permissions_t *self, stringset_t *added, stringset_t *removed);
 static gboolean permissions_rescan_cb    (gpointer aptr);
 static void     permissions_rescan_later (permissions_t *self);
 static bool     permissions_cancel_rescan(permissions_t *self);
@@ -117,7 +116,7 @@ struct permissions_t
     control_t             *prm_control;
     stringset_t           *prm_current;
     guint                  prm_rescan_id;
-    GFileMonitor          *prm_monitor_obj;
+    guint                  prm_monitor_id;
 };
 
 static void
@@ -129,11 +128,11 @@ permissions_ctor(permissions_t *self, control_t *control)
     self->prm_control     = control;
     self->prm_current     = stringset_create();
     self->prm_rescan_id   = 0;
-    self->prm_monitor_obj = NULL;
+    self->prm_monitor_id  = 0;
 
     /* Fetch initial state */
     permissions_start_monitor(self);
-    permissions_scan_now(self);
+    permissions_scan_now(self, NULL, NULL);
 
     /* Enable notifications */
     self->prm_initialized = true;
@@ -198,8 +197,17 @@ permissions_control(const permissions_t *self)
 const stringset_t *
 permissions_available(permissions_t *self)
 {
-    if( permissions_cancel_rescan(self) )
-        permissions_scan_now(self);
+    if( permissions_cancel_rescan(self) ) {
+        /* Applications are re-evaluated only for permissions that
+         * are reported as changed -> also early rescans must notify.
+         */
+        stringset_t *added   = stringset_create();
+        stringset_t *removed = stringset_create();
+        if( permissions_scan_now(self, added, removed) )
+            permissions_notify_changed(self, added, removed);
+        stringset_delete(removed);
+        stringset_delete(added);
+    }
 
     return self->prm_current;
 }
@@ -209,11 +217,13 @@ permissions_available(permissions_t *self)
  * ========================================================================= */
 
 static void
-permissions_notify_changed(permissions_t *self)
+permissions_notify_changed(permissions_t *self, const stringset_t *added,
+                           const stringset_t *removed)
 {
     if( self->prm_initialized ) {
         log_info("PERMISSIONS NOTIFY");
-        control_on_permissions_change(permissions_control(self));
+        control_on_permissions_change(permissions_control(self),
+                                      added, removed);
     }
 }
 
@@ -226,61 +236,45 @@ permissions_start_monitor(permissions_t *self)
 {
     permissions_stop_monitor(self);
 
-    GFileMonitorFlags flags = G_FILE_MONITOR_WATCH_MOVES;
-    GFile *file = g_file_new_for_path(PERMISSIONS_DIRECTORY);
-    if( file ) {
-        if( (self->prm_monitor_obj = g_file_monitor_directory(file, flags, 0, 0)) ) {
-            g_signal_connect(self->prm_monitor_obj, "changed",
-                             G_CALLBACK(permissions_monitor_cb), self);
-            log_info("PERMISSIONS MONITOR: started");
-        }
-        g_object_unref(file);
-    }
+    self->prm_monitor_id = watcher_add(PERMISSIONS_DIRECTORY,
+                                       PERMISSIONS_PATTERN,
+                                       permissions_monitor_cb, self);
+    log_info("PERMISSIONS MONITOR: started");
 }
 
 static void
 permissions_stop_monitor(permissions_t *self)
 {
-    if( self->prm_monitor_obj ) {
+    if( self->prm_monitor_id ) {
         log_info("PERMISSIONS MONITOR: stopped");
-        g_object_unref(self->prm_monitor_obj),
-            self->prm_monitor_obj = NULL;
+        watcher_remove_at(&self->prm_monitor_id);
     }
 }
 
-static bool
-permissions_monitor_p(const gchar *path)
-{
-    path = path_basename(path);
-    return path && fnmatch(PERMISSIONS_PATTERN, path, FNM_PATHNAME) == 0;
-}
-
 static void
-permissions_monitor_cb(GFileMonitor      *mon,
-                       GFile             *file1,
-                       GFile             *file2,
-                       GFileMonitorEvent  event,
-                       gpointer           aptr)
+permissions_monitor_cb(const gchar *name, gpointer aptr)
 {
     permissions_t *self = aptr;
 
-    const char *path1 = file1 ? g_file_peek_path(file1) : NULL;
-    const char *path2 = file2 ? g_file_peek_path(file2) : NULL;
-    bool trigger = (permissions_monitor_p(path1) ||
-                    permissions_monitor_p(path2));
-
-    if( trigger ) {
-        log_info("PERMISSIONS MONITOR: trigger @ %s %s", path1, path2);
-        permissions_rescan_later(self);
-    }
+    log_info("PERMISSIONS MONITOR: trigger @ %s", name ?: "*");
+    permissions_rescan_later(self);
 }
 
 /* ========================================================================= *
  * PERMISSIONS_SCAN
  * ========================================================================= */
 
+/** Rescan available permissions
+ *
+ * @param self     permissions object
+ * @param added    where to add names of new permissions, or NULL
+ * @param removed  where to add names of removed permissions, or NULL
+ *
+ * @return true if available permissions changed, false otherwise
+ */
 static bool
-permissions_scan_now(permissions_t *self)
+permissions_scan_now(permissions_t *self, stringset_t *added,
+                     stringset_t *removed)
 {
     permissions_cancel_rescan(self);
     log_info("PERMISSIONS RESCAN: executing");
@@ -311,6 +305,17 @@ permissions_scan_now(permissions_t *self)
      */
     stringset_remove_item(scanned, PERMISSION_BASE);
 
+    /* Permissions that can't be registered could not be requested
+     * or granted -> treat them as if they were not installed. */
+    for( const GList *iter = stringset_list(scanned); iter; ) {
+        const gchar *name = iter->data;
+        iter = iter->next;
+        if( permset_intern(name) == PERMSET_INVALID ) {
+            log_crit("%s: permission ignored: too many permissions", name);
+            stringset_remove_item(scanned, name);
+        }
+    }
+
     stringset_t *addset = stringset_filter_out(scanned, self->prm_current);
     stringset_t *remset = stringset_filter_out(self->prm_current, scanned);
 
@@ -330,6 +335,11 @@ permissions_scan_now(permissions_t *self)
         changed = true;
     }
 
+    if( added )
+        stringset_extend(added, addset);
+    if( removed )
+        stringset_extend(removed, remset);
+
     stringset_delete(addset);
     stringset_delete(remset);
 
@@ -350,8 +360,12 @@ permissions_rescan_cb(gpointer aptr)
     self->prm_rescan_id = 0;
 
     log_info("PERMISSIONS RESCAN: triggered");
-    if( permissions_scan_now(self) )
-        permissions_notify_changed(self);
+    stringset_t *added   = stringset_create();
+    stringset_t *removed = stringset_create();
+    if( permissions_scan_now(self, added, removed) )
+        permissions_notify_changed(self, added, removed);
+    stringset_delete(removed);
+    stringset_delete(added);
 
     return G_SOURCE_REMOVE;
 }
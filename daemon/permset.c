@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "permset.h"
+
+#include "intern.h"
+#include "logging.h"
+#include "stringset.h"
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * PERMSET_REGISTRY
+ * ------------------------------------------------------------------------- */
+
+guint        permset_intern(const gchar *name);
+guint        permset_lookup(const gchar *name);
+const gchar *permset_name  (guint id);
+guint        permset_count (void);
+
+/* ------------------------------------------------------------------------- *
+ * PERMSET
+ * ------------------------------------------------------------------------- */
+
+void  permset_init  (permset_t *self);
+bool  permset_clear (permset_t *self);
+bool  permset_empty (const permset_t *self);
+guint permset_size  (const permset_t *self);
+bool  permset_has   (const permset_t *self, guint id);
+bool  permset_add   (permset_t *self, guint id);
+bool  permset_remove(permset_t *self, guint id);
+guint permset_next  (const permset_t *self, guint id);
+bool  permset_equal (const permset_t *self, const permset_t *that);
+bool  permset_assign(permset_t *self, const permset_t *that);
+bool  permset_extend(permset_t *self, const permset_t *that);
+bool  permset_mask  (permset_t *self, const permset_t *mask);
+bool  permset_unmask(permset_t *self, const permset_t *mask);
+
+/* ------------------------------------------------------------------------- *
+ * PERMSET_NAMES
+ * ------------------------------------------------------------------------- */
+
+bool         permset_has_name      (const permset_t *self, const gchar *name);
+bool         permset_add_name      (permset_t *self, const gchar *name);
+bool         permset_remove_name   (permset_t *self, const gchar *name);
+void         permset_from_stringset(permset_t *self, const stringset_t *set);
+void         permset_from_strv     (permset_t *self, char **vector);
+stringset_t *permset_to_stringset  (const permset_t *self);
+gchar      **permset_to_strv       (const permset_t *self);
+gchar       *permset_to_string     (const permset_t *self);
+GVariant    *permset_to_variant    (const permset_t *self);
+
+/* ========================================================================= *
+ * PERMSET_REGISTRY
+ * ========================================================================= */
+
+/* Names of available permissions are given dense ids in order of
+ * appearance. Ids are never released, so that bitmasks stay valid also
+ * when permission files are removed and re-added at runtime.
+ *
+ * Name based helpers do not register anything - names that are not
+ * known to the registry can't be available permissions and thus are
+ * ignored, like unavailable permissions are elsewhere. This keeps
+ * random names seen e.g. in desktop files from filling the registry.
+ */
+static GHashTable *permset_registry_ids   = NULL; // name -> id + 1
+static GPtrArray  *permset_registry_names = NULL; // id -> name
+
+guint
+permset_intern(const gchar *name)
+{
+    guint id = permset_lookup(name);
+
+    if( id == PERMSET_INVALID && name ) {
+        if( !permset_registry_ids ) {
+            permset_registry_ids = g_hash_table_new(g_str_hash, g_str_equal);
+            permset_registry_names = g_ptr_array_new();
+        }
+
+        if( permset_registry_names->len >= PERMSET_MAX ) {
+            log_crit("%s: permission registry is full (%d entries)",
+                     name, PERMSET_MAX);
+        }
+        else {
+            gpointer key = (gpointer)intern_acquire(name);
+            id = permset_registry_names->len;
+            g_ptr_array_add(permset_registry_names, key);
+            g_hash_table_insert(permset_registry_ids, key,
+                                GUINT_TO_POINTER(id + 1));
+        }
+    }
+
+    return id;
+}
+
+guint
+permset_lookup(const gchar *name)
+{
+    guint id = PERMSET_INVALID;
+    if( permset_registry_ids && name ) {
+        gpointer val = g_hash_table_lookup(permset_registry_ids, name);
+        if( val )
+            id = GPOINTER_TO_UINT(val) - 1;
+    }
+    return id;
+}
+
+const gchar *
+permset_name(guint id)
+{
+    const gchar *name = NULL;
+    if( permset_registry_names && id < permset_registry_names->len )
+        name = g_ptr_array_index(permset_registry_names, id);
+    return name;
+}
+
+guint
+permset_count(void)
+{
+    return permset_registry_names ? permset_registry_names->len : 0;
+}
+
+/* ========================================================================= *
+ * PERMSET
+ * ========================================================================= */
+
+void
+permset_init(permset_t *self)
+{
+    for( guint i = 0; i < PERMSET_WORDS; ++i )
+        self->pms_word[i] = 0;
+}
+
+bool
+permset_clear(permset_t *self)
+{
+    bool changed = !permset_empty(self);
+    permset_init(self);
+    return changed;
+}
+
+bool
+permset_empty(const permset_t *self)
+{
+    guint64 bits = 0;
+    for( guint i = 0; i < PERMSET_WORDS; ++i )
+        bits |= self->pms_word[i];
+    return bits == 0;
+}
+
+guint
+permset_size(const permset_t *self)
+{
+    guint size = 0;
+    for( guint i = 0; i < PERMSET_WORDS; ++i )
+        size += __builtin_popcountll(self->pms_word[i]);
+    return size;
+}
+
+bool
+permset_has(const permset_t *self, guint id)
+{
+    if( id >= PERMSET_MAX )
+        return false;
+    return (self->pms_word[id / 64] >> (id % 64)) & 1;
+}
+
+bool
+permset_add(permset_t *self, guint id)
+{
+    if( id >= PERMSET_MAX || permset_has(self, id) )
+        return false;
+    self->pms_word[id / 64] |= (guint64)1 << (id % 64);
+    return true;
+}
+
+bool
+permset_remove(permset_t *self, guint id)
+{
+    if( !permset_has(self, id) )
+        return false;
+    self->pms_word[id / 64] &= ~((guint64)1 << (id % 64));
+    return true;
+}
+
+guint
+permset_next(const permset_t *self, guint id)
+{
+    /* Returns the smallest id >= given id that is in the set,
+     * or PERMSET_MAX if there are none */
+    while( id < PERMSET_MAX ) {
+        guint64 bits = self->pms_word[id / 64] >> (id % 64);
+        if( bits )
+            return id + __builtin_ctzll(bits);
+        id = (id / 64 + 1) * 64;
+    }
+    return PERMSET_MAX;
+}
+
+bool
+permset_equal(const permset_t *self, const permset_t *that)
+{
+    guint64 diff = 0;
+    for( guint i = 0; i < PERMSET_WORDS; ++i )
+        diff |= self->pms_word[i] ^ that->pms_word[i];
+    return diff == 0;
+}
+
+bool
+permset_assign(permset_t *self, const permset_t *that)
+{
+    bool changed = !permset_equal(self, that);
+    *self = *that;
+    return changed;
+}
+
+bool
+permset_extend(permset_t *self, const permset_t *that)
+{
+    guint64 diff = 0;
+    for( guint i = 0; i < PERMSET_WORDS; ++i ) {
+        guint64 bits = self->pms_word[i] | that->pms_word[i];
+        diff |= bits ^ self->pms_word[i];
+        self->pms_word[i] = bits;
+    }
+    return diff != 0;
+}
+
+bool
+permset_mask(permset_t *self, const permset_t *mask)
+{
+    guint64 diff = 0;
+    for( guint i = 0; i < PERMSET_WORDS; ++i ) {
+        guint64 bits = self->pms_word[i] & mask->pms_word[i];
+        diff |= bits ^ self->pms_word[i];
+        self->pms_word[i] = bits;
+    }
+    return diff != 0;
+}
+
+bool
+permset_unmask(permset_t *self, const permset_t *mask)
+{
+    guint64 diff = 0;
+    for( guint i = 0; i < PERMSET_WORDS; ++i ) {
+        guint64 bits = self->pms_word[i] & ~mask->pms_word[i];
+        diff |= bits ^ self->pms_word[i];
+        self->pms_word[i] = bits;
+    }
+    return diff != 0;
+}
+
+/* ========================================================================= *
+ * PERMSET_NAMES
+ * ========================================================================= */
+
+bool
+permset_has_name(const permset_t *self, const gchar *name)
+{
+    return permset_has(self, permset_lookup(name));
+}
+
+bool
+permset_add_name(permset_t *self, const gchar *name)
+{
+    return permset_add(self, permset_lookup(name));
+}
+
+bool
+permset_remove_name(permset_t *self, const gchar *name)
+{
+    return permset_remove(self, permset_lookup(name));
+}
+
+void
+permset_from_stringset(permset_t *self, const stringset_t *set)
+{
+    permset_init(self);
+    for( const GList *iter = stringset_list(set); iter; iter = iter->next )
+        permset_add_name(self, iter->data);
+}
+
+void
+permset_from_strv(permset_t *self, char **vector)
+{
+    permset_init(self);
+    if( vector ) {
+        for( size_t i = 0; vector[i]; ++i )
+            permset_add_name(self, vector[i]);
+    }
+}
+
+stringset_t *
+permset_to_stringset(const permset_t *self)
+{
+    stringset_t *set = stringset_create();
+    for( guint id = permset_next(self, 0); id < PERMSET_MAX;
+         id = permset_next(self, id + 1) )
+        stringset_add_item(set, permset_name(id));
+    return set;
+}
+
+gchar **
+permset_to_strv(const permset_t *self)
+{
+    gchar **vector = g_malloc0_n(permset_size(self) + 1, sizeof *vector);
+    guint   index  = 0;
+    for( guint id = permset_next(self, 0); id < PERMSET_MAX;
+         id = permset_next(self, id + 1) )
+        vector[index++] = g_strdup(permset_name(id));
+    vector[index] = NULL;
+    return vector;
+}
+
+gchar *
+permset_to_string(const permset_t *self)
+{
+    GString *string = g_string_new(NULL);
+    for( guint id = permset_next(self, 0); id < PERMSET_MAX;
+         id = permset_next(self, id + 1) ) {
+        if( string->len )
+            g_string_append_c(string, ',');
+        g_string_append(string, permset_name(id));
+    }
+    return g_string_free(string, false);
+}
+
+GVariant *
+permset_to_variant(const permset_t *self)
+{
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("as"));
+    for( guint id = permset_next(self, 0); id < PERMSET_MAX;
+         id = permset_next(self, id + 1) )
+        g_variant_builder_add(&builder, "s", permset_name(id));
+    return g_variant_builder_end(&builder);
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef  PERMSET_H_
+# define PERMSET_H_
+
+# include <stdbool.h>
+# include <glib.h>
+
+G_BEGIN_DECLS
+
+/* ========================================================================= *
+ * Constants
+ * ========================================================================= */
+
+/* Maximum number of distinct permission names.
+ *
+ * Only names of available permissions are registered, see
+ * permset_intern(). */
+# define PERMSET_MAX     256
+# define PERMSET_WORDS   (PERMSET_MAX / 64)
+
+/* Id returned for names that can't be registered */
+# define PERMSET_INVALID PERMSET_MAX
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct stringset_t stringset_t;
+
+/** Set of permissions as bitmask indexed by registry ids
+ *
+ * Fixed size value type that can be embedded in other objects
+ * and used as local variable without dynamic memory allocations.
+ */
+typedef struct permset_t
+{
+    guint64 pms_word[PERMSET_WORDS];
+} permset_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * PERMSET_REGISTRY
+ * ------------------------------------------------------------------------- */
+
+guint        permset_intern(const gchar *name);
+guint        permset_lookup(const gchar *name);
+const gchar *permset_name  (guint id);
+guint        permset_count (void);
+
+/* ------------------------------------------------------------------------- *
+ * PERMSET
+ * ------------------------------------------------------------------------- */
+
+void  permset_init  (permset_t *self);
+bool  permset_clear (permset_t *self);
+bool  permset_empty (const permset_t *self);
+guint permset_size  (const permset_t *self);
+bool  permset_has   (const permset_t *self, guint id);
+bool  permset_add   (permset_t *self, guint id);
+bool  permset_remove(permset_t *self, guint id);
+guint permset_next  (const permset_t *self, guint id);
+bool  permset_equal (const permset_t *self, const permset_t *that);
+bool  permset_assign(permset_t *self, const permset_t *that);
+bool  permset_extend(permset_t *self, const permset_t *that);
+bool  permset_mask  (permset_t *self, const permset_t *mask);
+bool  permset_unmask(permset_t *self, const permset_t *mask);
+
+/* ------------------------------------------------------------------------- *
+ * PERMSET_NAMES
+ * ------------------------------------------------------------------------- */
+
+bool         permset_has_name      (const permset_t *self, const gchar *name);
+bool         permset_add_name      (permset_t *self, const gchar *name);
+bool         permset_remove_name   (permset_t *self, const gchar *name);
+void         permset_from_stringset(permset_t *self, const stringset_t *set);
+void         permset_from_strv     (permset_t *self, char **vector);
+stringset_t *permset_to_stringset  (const permset_t *self);
+gchar      **permset_to_strv       (const permset_t *self);
+gchar       *permset_to_string     (const permset_t *self);
+GVariant    *permset_to_variant    (const permset_t *self);
+
+G_END_DECLS
+
+#endif /* PERMSET_H_ */
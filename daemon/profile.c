@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "profile.h"
+
+#include "logging.h"
+#include "stringset.h"
+#include "util.h"
+
+#include <sys/stat.h>
+
+#include <string.h>
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+/** State of a file that flattened profile content was read from */
+typedef struct profile_stamp_t
+{
+    gint64  pst_mtime;  // nanoseconds
+    guint64 pst_size;
+    guint64 pst_inode;
+} profile_stamp_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * PROFILE_STAMP
+ * ------------------------------------------------------------------------- */
+
+static bool profile_stamp_get  (profile_stamp_t *self, const gchar *path);
+static bool profile_stamp_equal(const profile_stamp_t *self, const profile_stamp_t *that);
+
+/* ------------------------------------------------------------------------- *
+ * PROFILE_FLATTEN
+ * ------------------------------------------------------------------------- */
+
+static const gchar *profile_include_target(const gchar *line);
+static bool         profile_flatten_file  (GString *out, GHashTable *seen, GHashTable *sources, const gchar *path, int depth);
+
+/* ------------------------------------------------------------------------- *
+ * PROFILE
+ * ------------------------------------------------------------------------- */
+
+gchar *profile_flatten(const stringset_t *profiles, GHashTable *sources);
+gchar *profile_path   (uid_t uid, const gchar *appname, const gchar *key);
+bool   profile_write  (const gchar *path, const stringset_t *profiles, GHashTable *sources);
+
+/* ------------------------------------------------------------------------- *
+ * PROFILE_SOURCES
+ * ------------------------------------------------------------------------- */
+
+GHashTable *profile_sources_create (void);
+bool        profile_sources_changed(GHashTable *sources);
+
+/* ========================================================================= *
+ * PROFILE_STAMP
+ * ========================================================================= */
+
+static bool
+profile_stamp_get(profile_stamp_t *self, const gchar *path)
+{
+    struct stat st;
+    if( stat(path, &st) == -1 )
+        return false;
+    self->pst_mtime = st.st_mtim.tv_sec * G_GINT64_CONSTANT(1000000000) +
+                      st.st_mtim.tv_nsec;
+    self->pst_size  = st.st_size;
+    self->pst_inode = st.st_ino;
+    return true;
+}
+
+static bool
+profile_stamp_equal(const profile_stamp_t *self, const profile_stamp_t *that)
+{
+    return (self->pst_mtime == that->pst_mtime &&
+            self->pst_size  == that->pst_size  &&
+            self->pst_inode == that->pst_inode);
+}
+
+/* ========================================================================= *
+ * PROFILE_FLATTEN
+ * ========================================================================= */
+
+static const gchar *
+profile_include_target(const gchar *line)
+{
+    /* Only absolute include paths are resolved here. Relative names
+     * are looked up by firejail from user config directory first, and
+     * macros get expanded at launch time - those are left as is.
+     */
+    if( strncmp(line, "include", 7) || !g_ascii_isspace(line[7]) )
+        return NULL;
+
+    line += 8;
+    while( g_ascii_isspace(*line) )
+        ++line;
+
+    if( *line != '/' || strchr(line, '$') )
+        return NULL;
+
+    return line;
+}
+
+static bool
+profile_flatten_file(GString *out, GHashTable *seen, GHashTable *sources,
+                     const gchar *path, int depth)
+{
+    bool             ack   = false;
+    gchar           *text  = NULL;
+    gchar          **lines = NULL;
+    profile_stamp_t  stamp;
+
+    if( g_hash_table_contains(seen, path) ) {
+        /* Applying the same file again would not change anything,
+         * and skipping it also breaks include cycles.
+         */
+        g_string_append_printf(out, "# %s: already included\n", path);
+        ack = true;
+        goto EXIT;
+    }
+
+    if( depth > PROFILE_INCLUDE_DEPTH_MAX ) {
+        log_warning("%s: includes nested too deep", path);
+        goto EXIT;
+    }
+
+    /* Stamp is taken before reading, so that changes made while
+     * reading get detected on the next check */
+    if( !profile_stamp_get(&stamp, path) ||
+        !g_file_get_contents(path, &text, NULL, NULL) )
+        goto EXIT;
+
+    if( sources ) {
+        profile_stamp_t *copy = g_new(profile_stamp_t, 1);
+        *copy = stamp;
+        g_hash_table_insert(sources, g_strdup(path), copy);
+    }
+
+    g_hash_table_add(seen, g_strdup(path));
+    g_string_append_printf(out, "# %s\n", path);
+
+    lines = g_strsplit(text, "\n", -1);
+    for( size_t i = 0; lines[i]; ++i ) {
+        gchar *line = g_strstrip(lines[i]);
+        if( *line == 0 || *line == '#' )
+            continue;
+
+        /* Unresolvable includes are passed on for firejail to handle */
+        const gchar *target = profile_include_target(line);
+        if( !target ||
+            !profile_flatten_file(out, seen, sources, target, depth + 1) )
+            g_string_append_printf(out, "%s\n", line);
+    }
+    ack = true;
+
+EXIT:
+    g_strfreev(lines);
+    g_free(text);
+    return ack;
+}
+
+/* ========================================================================= *
+ * PROFILE
+ * ========================================================================= */
+
+/** Construct single profile equivalent to given list of profiles
+ *
+ * @param profiles  Ordered set of profile paths as passed to firejail
+ * @param sources   Table from profile_sources_create() to which files
+ *                  that got inlined are added, or NULL
+ *
+ * @return profile text with includes resolved, release with g_free()
+ */
+gchar *
+profile_flatten(const stringset_t *profiles, GHashTable *sources)
+{
+    GString    *out  = g_string_new(NULL);
+    GHashTable *seen = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                             g_free, NULL);
+
+    g_string_append(out, "# Generated by sailjaild, do not edit\n");
+    for( const GList *iter = stringset_list(profiles); iter; iter = iter->next ) {
+        const gchar *path = iter->data;
+        if( !profile_flatten_file(out, seen, sources, path, 0) )
+            g_string_append_printf(out, "include %s\n", path);
+    }
+
+    g_hash_table_unref(seen);
+    return g_string_free(out, false);
+}
+
+gchar *
+profile_path(uid_t uid, const gchar *appname, const gchar *key)
+{
+    /* Granted permissions are hashed to keep file names short */
+    gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key ?: "", -1);
+    gchar *path = g_strdup_printf(RUNTIME_PROFILES_DIRECTORY "/%u/%s-%.16s"
+                                  PROFILES_EXTENSION,
+                                  (unsigned)uid, appname, hash);
+    g_free(hash);
+    return path;
+}
+
+bool
+profile_write(const gchar *path, const stringset_t *profiles,
+              GHashTable *sources)
+{
+    bool    ack  = false;
+    GError *err  = NULL;
+    gchar  *dir  = path_dirname(path);
+    gchar  *text = profile_flatten(profiles, sources);
+
+    if( g_mkdir_with_parents(dir, 0755) == -1 ) {
+        log_warning("%s: could not create directory: %m", dir);
+        goto EXIT;
+    }
+
+    /* Replaced via rename, so firejail instances that are already
+     * reading the previous version are not affected.
+     */
+    if( !g_file_set_contents(path, text, -1, &err) ) {
+        log_warning("%s: save failed: %s", path, err->message);
+        goto EXIT;
+    }
+
+    log_debug("%s: saved", path);
+    ack = true;
+
+EXIT:
+    g_clear_error(&err);
+    g_free(text);
+    g_free(dir);
+    return ack;
+}
+
+/* ========================================================================= *
+ * PROFILE_SOURCES
+ * ========================================================================= */
+
+GHashTable *
+profile_sources_create(void)
+{
+    /* path -> profile_stamp_t */
+    return g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+}
+
+/** Check whether flattened profile content is out of date
+ *
+ * Inlined files can be edited, replaced or removed without the set
+ * of available permissions changing, and absolute includes can point
+ * anywhere in the file system - so instead of watching, the files
+ * are checked when the flattened profile is about to be used.
+ *
+ * @param sources  Table filled in by profile_flatten()
+ *
+ * @return true if any of the files has changed, false otherwise
+ */
+bool
+profile_sources_changed(GHashTable *sources)
+{
+    GHashTableIter  iter;
+    gpointer        key, value;
+    profile_stamp_t stamp;
+
+    if( sources ) {
+        g_hash_table_iter_init(&iter, sources);
+        while( g_hash_table_iter_next(&iter, &key, &value) ) {
+            if( !profile_stamp_get(&stamp, key) ||
+                !profile_stamp_equal(&stamp, value) ) {
+                log_debug("%s: changed", (const gchar *)key);
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -38,7 +38,9 @@
 #include "prompter.h"
 
 #include "control.h"
+#include "metrics.h"
 #include "service.h"
+#include "permset.h"
 #include "session.h"
 #include "stringset.h"
 #include "appinfo.h"
@@ -97,6 +99,7 @@ void         prompter_delete_at           (prompter_t **pself);
 void         prompter_delete_cb           (void *self);
 void         prompter_applications_changed(prompter_t *self, const stringset_t *changed);
 void         prompter_session_changed     (prompter_t *self);
+bool         prompter_prewarm             (prompter_t *self);
 
 /* ------------------------------------------------------------------------- *
  * PROMPTER_ATTRIBUTES
@@ -104,6 +107,7 @@ void         prompter_session_changed     (prompter_t *self);
 
 static service_t     *prompter_service     (const prompter_t *self);
 static control_t     *prompter_control     (const prompter_t *self);
+static metrics_t     *prompter_metrics     (const prompter_t *self);
 static appsettings_t *prompter_appsettings (const prompter_t *self, uid_t uid, const char *app);
 static uid_t          prompter_current_user(const prompter_t *self);
 static gchar         *prompter_bus_address (const prompter_t *self);
@@ -166,8 +170,8 @@ void                          prompter_dbus_reload_config   (prompter_t *self);
  * PROMPTER_RETURN
  * ------------------------------------------------------------------------- */
 
-static void prompter_return_value(GDBusMethodInvocation *invocation, GVariant *val);
-static void prompter_return_error(GDBusMethodInvocation *invocation, int code, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+static void prompter_return_value(prompter_t *self, GDBusMethodInvocation *invocation, GVariant *value);
+static void prompter_return_error(prompter_t *self, GDBusMethodInvocation *invocation, int code, const char *fmt, ...) __attribute__((format(printf, 4, 5)));
 
 /* ------------------------------------------------------------------------- *
  * PROMPTER_QUEUE
@@ -187,6 +191,8 @@ static GList                 *prompter_drop       (prompter_t *self, GList *iter
 static GDBusConnection *prompter_connection         (const prompter_t *self);
 static bool             prompter_is_connected       (const prompter_t *self);
 static bool             prompter_connect            (prompter_t *self);
+static void             prompter_connect_cb         (GObject *obj, GAsyncResult *res, gpointer aptr);
+static GDBusConnection *prompter_connect_temporary  (const prompter_t *self);
 static void             prompter_disconnect         (prompter_t *self);
 static void             prompter_disconnect_flush_cb(GObject *obj, GAsyncResult *res, gpointer aptr);
 
@@ -261,6 +267,8 @@ struct prompter_t
     uid_t                  prm_cached_user;
     GQueue                *prm_queue;           // GDBusMethodInvocation *
     GDBusConnection       *prm_connection;
+    GCancellable          *prm_connecting;      // pending user bus connect
+    gint64                 prm_connect_started;
     GDBusMethodInvocation *prm_invocation;
     GCancellable          *prm_cancellable;
     gchar                 *prm_prompt;
@@ -279,6 +287,8 @@ prompter_ctor(prompter_t *self, service_t *service)
     self->prm_cached_user = control_current_user(service_control(service));
     self->prm_queue       = g_queue_new();
     self->prm_connection  = NULL;
+    self->prm_connecting  = NULL;
+    self->prm_connect_started = 0;
     self->prm_invocation  = NULL;
     self->prm_cancellable = NULL;
     self->prm_prompt      = NULL;
@@ -377,6 +387,25 @@ prompter_session_changed(prompter_t *self)
     self->prm_cached_user = prompter_current_user(self);
 }
 
+/** Start connecting to user bus ahead of the first prompt
+ *
+ * @param self  prompter object
+ *
+ * @return true if connection attempt was started, false otherwise
+ */
+bool
+prompter_prewarm(prompter_t *self)
+{
+    /* Connection to previous user bus must be dropped first */
+    prompter_session_changed(self);
+
+    if( prompter_get_state(self) != PROMPTER_STATE_IDLE ||
+        prompter_is_connected(self) || self->prm_connecting )
+        return false;
+
+    return prompter_connect(self);
+}
+
 /* ------------------------------------------------------------------------- *
  * PROMPTER_ATTRIBUTES
  * ------------------------------------------------------------------------- */
@@ -393,6 +422,12 @@ prompter_control(const prompter_t *self)
     return service_control(prompter_service(self));
 }
 
+static metrics_t *
+prompter_metrics(const prompter_t *self)
+{
+    return service_metrics(prompter_service(self));
+}
+
 static appsettings_t *
 prompter_appsettings(const prompter_t *self, uid_t uid, const char *app)
 {
@@ -466,7 +501,7 @@ prompter_enter_state(prompter_t *self)
         break;
 
     case PROMPTER_STATE_CONNECT:
-        // FIXME: this should be done asynchronously
+        /* Might already be connected or connecting due to prewarm */
         if( !prompter_connect(self) )
             prompter_set_state(self, PROMPTER_STATE_CONNECTION_FAILURE);
         break;
@@ -723,7 +758,7 @@ prompter_finish_invocation(prompter_t *self)
         self->prm_invocation = NULL;
         if( !prompter_check_invocation(self, invocation) ) {
             /* If we get here, the prompt was canceled */
-            prompter_return_error(invocation, G_DBUS_ERROR_AUTH_FAILED,
+            prompter_return_error(self, invocation, G_DBUS_ERROR_AUTH_FAILED,
                                   SERVICE_MESSAGE_NOT_ALLOWED);
         }
 
@@ -745,7 +780,7 @@ prompter_try_finish_invocation(prompter_t            *self,
         g_variant_get(parameters, "(&s)", &app);
         if( !app ) {
             /* Should not be reached but it's an error to get here anyway */
-            prompter_return_error(invocation, G_DBUS_ERROR_INVALID_ARGS,
+            prompter_return_error(self, invocation, G_DBUS_ERROR_INVALID_ARGS,
                                   SERVICE_MESSAGE_INVALID_APPLICATION, "<null>");
             handled = true;
         }
@@ -773,35 +808,39 @@ prompter_check_invocation(prompter_t *self, GDBusMethodInvocation *invocation) {
 
     g_variant_get(parameters, "(&s)", &app);
     if( !app ) {
-        prompter_return_error(invocation, G_DBUS_ERROR_INVALID_ARGS,
+        prompter_return_error(self, invocation, G_DBUS_ERROR_INVALID_ARGS,
                               SERVICE_MESSAGE_INVALID_APPLICATION, "<null>");
         handled = true;
     }
     else if( !(appsettings = prompter_appsettings(self, uid, app)) ) {
         if( !control_valid_user(prompter_control(self), uid) )
-            prompter_return_error(invocation, G_DBUS_ERROR_INVALID_ARGS,
+            prompter_return_error(self, invocation, G_DBUS_ERROR_INVALID_ARGS,
                                   SERVICE_MESSAGE_INVALID_USER, uid);
         else
-            prompter_return_error(invocation, G_DBUS_ERROR_INVALID_ARGS,
+            prompter_return_error(self, invocation, G_DBUS_ERROR_INVALID_ARGS,
                                   SERVICE_MESSAGE_INVALID_APPLICATION, app);
         handled = true;
     }
     else {
         app_allowed_t allowed = appsettings_get_allowed(appsettings);
         if( allowed == APP_ALLOWED_NEVER ) {
-            prompter_return_error(invocation, G_DBUS_ERROR_AUTH_FAILED,
+            prompter_return_error(self, invocation, G_DBUS_ERROR_AUTH_FAILED,
                                   SERVICE_MESSAGE_DENIED_PERMANENTLY);
             handled = true;
         }
         else if( allowed == APP_ALLOWED_ALWAYS ) {
-            const stringset_t *granted =
+            const permset_t *granted =
                 appsettings_get_granted(appsettings);
-            gchar **vector = stringset_to_strv(granted);
-            GVariant *variant =
-                g_variant_new_strv((const gchar * const *)vector, -1);
-            prompter_return_value(invocation, variant);
+            const appinfo_t *appinfo =
+                control_appinfo(prompter_control(self), app);
+            const gchar *method =
+                g_dbus_method_invocation_get_method_name(invocation);
+            prompter_return_value(self, invocation,
+                                  service_launch_reply(prompter_service(self),
+                                                       method,
+                                                       appinfo,
+                                                       granted));
             handled = true;
-            g_strfreev(vector);
         }
     }
 
@@ -975,8 +1014,8 @@ static GVariant *
 prompter_invocation_args(const prompter_t *self, appinfo_t *appinfo)
 {
     gchar *desktop                 = NULL;
-    const stringset_t *permissions = NULL;
-    stringset_t *filtered          = NULL;
+    const permset_t *permissions   = NULL;
+    permset_t filtered;
     GVariant *args                 = NULL;
 
     GVariantBuilder builder;
@@ -994,8 +1033,8 @@ prompter_invocation_args(const prompter_t *self, appinfo_t *appinfo)
 
     g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sas}"));
     permissions = appinfo_get_permissions(appinfo);
-    filtered = service_filter_permissions(prompter_service(self), permissions);
-    gchar **vector = stringset_to_strv(filtered);
+    service_filter_permissions(prompter_service(self), permissions, &filtered);
+    gchar **vector = permset_to_strv(&filtered);
     for( guint i = 0; vector[i]; ++i ) {
         gchar *perm = vector[i];
         vector[i] = path_from_permission_name(perm);
@@ -1010,7 +1049,6 @@ prompter_invocation_args(const prompter_t *self, appinfo_t *appinfo)
     args = g_variant_new("(s@a{sas})", desktop, g_variant_builder_end(&builder));
 
 EXIT:
-    stringset_delete(filtered);
     g_free(desktop);
     return args;
 }
@@ -1130,7 +1168,7 @@ prompter_handle_name_lost(prompter_t *self, const gchar *name)
         log_debug("-> canceling %p", invocation);
         prompter_cancel_invocation(self);
         /* Must call g_dbus_method_invocation_return_* to destroy the invocation */
-        prompter_return_error(invocation, G_DBUS_ERROR_AUTH_FAILED,
+        prompter_return_error(self, invocation, G_DBUS_ERROR_AUTH_FAILED,
                               SERVICE_MESSAGE_DISCONNECTED);
         prompter_eval_state_later(self);
     }
@@ -1142,8 +1180,10 @@ prompter_handle_name_lost(prompter_t *self, const gchar *name)
         if( !g_strcmp0(g_dbus_method_invocation_get_sender(invocation), name) ) {
             log_debug("-> skipping %p", invocation);
             iter->data = NULL;
+            metrics_queue_leave(prompter_metrics(self), invocation,
+                                prompter_queued(self) - 1);
             /* Must call g_dbus_method_invocation_return_* to destroy the invocation */
-            prompter_return_error(invocation, G_DBUS_ERROR_AUTH_FAILED,
+            prompter_return_error(self, invocation, G_DBUS_ERROR_AUTH_FAILED,
                                   SERVICE_MESSAGE_DISCONNECTED);
             iter = prompter_drop(self, iter);
         }
@@ -1158,17 +1198,21 @@ prompter_dbus_reload_config(prompter_t *self)
 {
     log_info("reload dbus config");
 
-    bool connected = prompter_is_connected(self);
+    /* Prompter connection is set up asynchronously, use a separate
+     * connection unless it is already available.
+     */
+    GDBusConnection *connection = prompter_connection(self);
+    bool             connected  = connection != NULL;
 
     if( !connected ) {
         log_info("temporarily connecting to the user session");
-        if( !prompter_connect(self) ) {
+        if( !(connection = prompter_connect_temporary(self)) ) {
             log_err("unable to connect to the user session to reload dbus config");
             return;
         }
     }
 
-    g_dbus_connection_call(prompter_connection(self),
+    g_dbus_connection_call(connection,
                            DBUS_SERVICE,
                            DBUS_PATH,
                            DBUS_INTERFACE,
@@ -1183,7 +1227,8 @@ prompter_dbus_reload_config(prompter_t *self)
 
     if( !connected ) {
         log_info("disconnecting temporary user session connection");
-        prompter_disconnect(self);
+        g_dbus_connection_flush(connection, NULL,
+                                prompter_disconnect_flush_cb, NULL);
     }
 }
 
@@ -1192,20 +1237,20 @@ prompter_dbus_reload_config(prompter_t *self)
  * ------------------------------------------------------------------------- */
 
 static void
-prompter_return_value(GDBusMethodInvocation *invocation, GVariant *val)
+prompter_return_value(prompter_t *self, GDBusMethodInvocation *invocation,
+                      GVariant *value)
 {
-    g_dbus_method_invocation_return_value(invocation,
-                                          val
-                                          ? g_variant_new_tuple(&val, 1)
-                                          : NULL);
+    metrics_call_end(prompter_metrics(self), invocation, METRICS_REPLY_OK);
+    g_dbus_method_invocation_return_value(invocation, value);
 }
 
-static void __attribute__((format(printf, 3, 4)))
-prompter_return_error(GDBusMethodInvocation *invocation, int code,
-                      const char *fmt, ...)
+static void __attribute__((format(printf, 4, 5)))
+prompter_return_error(prompter_t *self, GDBusMethodInvocation *invocation,
+                      int code, const char *fmt, ...)
 {
     va_list va;
     va_start(va, fmt);
+    metrics_call_end(prompter_metrics(self), invocation, code);
     g_dbus_method_invocation_return_error_valist(invocation, G_DBUS_ERROR,
                                                  code, fmt, va);
     va_end(va);
@@ -1220,6 +1265,7 @@ prompter_enqueue(prompter_t *self, GDBusMethodInvocation *invocation)
 {
     log_info("enqueue %p", invocation);
     g_queue_push_tail(self->prm_queue, invocation);
+    metrics_queue_enter(prompter_metrics(self), invocation, prompter_queued(self));
 }
 
 static guint
@@ -1233,6 +1279,7 @@ prompter_dequeue(prompter_t *self)
 {
     GDBusMethodInvocation *invocation = g_queue_pop_head(self->prm_queue);
     log_info("dequeue %p", invocation);
+    metrics_queue_leave(prompter_metrics(self), invocation, prompter_queued(self));
     return invocation;
 }
 
@@ -1242,7 +1289,8 @@ prompter_dequeue_all(prompter_t *self)
     for( GList *iter = prompter_iter(self); iter; iter = iter->next ) {
         GDBusMethodInvocation *invocation = iter->data;
         iter->data = NULL;
-        prompter_return_error(invocation, G_DBUS_ERROR_AUTH_FAILED,
+        metrics_queue_leave(prompter_metrics(self), invocation, 0);
+        prompter_return_error(self, invocation, G_DBUS_ERROR_AUTH_FAILED,
                               SERVICE_MESSAGE_DISMISSED);
     }
     g_queue_remove_all(self->prm_queue, NULL);
@@ -1281,11 +1329,13 @@ prompter_is_connected(const prompter_t *self)
 static bool
 prompter_connect(prompter_t *self)
 {
+    bool    ack     = false;
     gchar  *address = NULL;
-    GError *error   = NULL;
 
-    if( self->prm_connection )
+    if( self->prm_connection || self->prm_connecting ) {
+        ack = true;
         goto EXIT;
+    }
 
     if( !(address = prompter_bus_address(self)) )
         goto EXIT;
@@ -1294,27 +1344,101 @@ prompter_connect(prompter_t *self)
         G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
         G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION;
 
-    self->prm_connection =
-        g_dbus_connection_new_for_address_sync(address, flags,
-                                               NULL, NULL, &error);
+    log_info("connecting to %s", address);
+    change_cancellable_steal(&self->prm_connecting, g_cancellable_new());
+    self->prm_connect_started = g_get_monotonic_time();
+    g_dbus_connection_new_for_address(address, flags, NULL,
+                                      self->prm_connecting,
+                                      prompter_connect_cb, self);
+    ack = true;
+
+EXIT:
+    g_free(address);
+    return ack;
+}
+
+static void
+prompter_connect_cb(GObject *obj, GAsyncResult *res, gpointer aptr)
+{
+    (void)obj; // unused
+
+    prompter_t      *self = aptr;
+    GError          *err  = NULL;
+    GDBusConnection *con  = g_dbus_connection_new_for_address_finish(res, &err);
+
+    /* Canceled on disconnect, prompter might not exist anymore */
+    if( g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED) )
+        goto EXIT;
+
+    g_clear_object(&self->prm_connecting);
 
-    if( error ) {
-        log_err("connecting to %s failed: %s", address, error->message);
+    if( !con ) {
+        if( prompter_get_state(self) == PROMPTER_STATE_CONNECT ) {
+            log_err("connecting to user bus failed: %s",
+                    err ? err->message : "unknown error");
+            prompter_set_state(self, PROMPTER_STATE_CONNECTION_FAILURE);
+        }
+        else {
+            /* Prewarm, retried when actually needed */
+            log_warning("connecting to user bus failed: %s",
+                        err ? err->message : "unknown error");
+        }
+    }
+    else {
+        log_info("connected to user bus in %.1f ms",
+                 (g_get_monotonic_time() - self->prm_connect_started) / 1000.0);
+
+        /* This is not a user session service, set exit-on-close explicitly false */
+        g_dbus_connection_set_exit_on_close(con, FALSE);
+        self->prm_connection = con, con = NULL;
+        prompter_eval_state_later(self);
+    }
+
+    control_on_prompter_ready(prompter_control(self), prompter_is_connected(self));
+
+EXIT:
+    if( con )
+        g_object_unref(con);
+    g_clear_error(&err);
+}
+
+static GDBusConnection *
+prompter_connect_temporary(const prompter_t *self)
+{
+    GDBusConnection *con     = NULL;
+    GError          *err     = NULL;
+    gchar           *address = NULL;
+
+    if( !(address = prompter_bus_address(self)) )
+        goto EXIT;
+
+    GDBusConnectionFlags flags =
+        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+        G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION;
+
+    con = g_dbus_connection_new_for_address_sync(address, flags,
+                                                 NULL, NULL, &err);
+    if( !con ) {
+        log_err("connecting to %s failed: %s", address,
+                err ? err->message : "unknown error");
         goto EXIT;
     }
 
     /* This is not a user session service, set exit-on-close explicitly false */
-    g_dbus_connection_set_exit_on_close(self->prm_connection, FALSE);
+    g_dbus_connection_set_exit_on_close(con, FALSE);
 
 EXIT:
-    g_clear_error(&error);
+    g_clear_error(&err);
     g_free(address);
-    return self->prm_connection != NULL;
+    return con;
 }
 
 static void
 prompter_disconnect(prompter_t *self)
 {
+    /* Abandon pending connection attempt */
+    change_cancellable_steal(&self->prm_connecting, NULL);
+
     if( self->prm_connection ) {
         g_dbus_connection_flush(self->prm_connection, NULL,
                                 prompter_disconnect_flush_cb, NULL),
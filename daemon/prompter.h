@@ -37,6 +37,7 @@
 #ifndef  PROMPTER_H_
 # define PROMPTER_H_
 
+# include <stdbool.h>
 # include <gio/gio.h>
 
 G_BEGIN_DECLS
@@ -66,6 +67,7 @@ void        prompter_delete_at           (prompter_t **pself);
 void        prompter_delete_cb           (void *self);
 void        prompter_applications_changed(prompter_t *self, const stringset_t *changed);
 void        prompter_session_changed     (prompter_t *self);
+bool        prompter_prewarm             (prompter_t *self);
 
 /* ------------------------------------------------------------------------- *
  * PROMPTER_INVOCATION
@@ -36,6 +36,7 @@
  */
 
 #include "config.h"
+#include "firejail.h"
 #include "logging.h"
 #include "util.h"
 #include "service.h"
@@ -65,12 +66,24 @@
 #define LAUNCHNOTIFY_INTERFACE                  "org.nemomobile.lipstick.LauncherModel"
 #define LAUNCHNOTIFY_METHOD_LAUNCH_CANCELED     "cancelNotifyLaunching"
 
+/* Maximum number of launch phases that can be timed */
+#define CLIENT_TIMING_PHASES                    16
+
+/* Prefix for launch timing lines, see tools/measure_launch_time.py */
+#define CLIENT_TIMING_TAG                       "sailjail-timing:"
+
 /* ========================================================================= *
  * Types
  * ========================================================================= */
 
 typedef struct client_t client_t;
 
+typedef struct
+{
+    const char *ctp_name;
+    gint64      ctp_time;
+} client_phase_t;
+
 /* ========================================================================= *
  * Prototypes
  * ========================================================================= */
@@ -79,7 +92,6 @@ typedef struct client_t client_t;
  * UTILITY
  * ------------------------------------------------------------------------- */
 
-static bool empty_p        (const char *str);
 static bool path_dirname_eq(const char *path, const char *target);
 
 /* ------------------------------------------------------------------------- *
@@ -119,6 +131,8 @@ static const gchar **client_get_argv           (const client_t *self, int *pargc
 static void          client_set_argv           (client_t *self, int argc, char **argv);
 static const gchar **client_get_granted        (const client_t *self);
 static void          client_set_granted        (client_t *self, gchar **granted);
+static const gchar **client_get_jail_args      (const client_t *self);
+static void          client_set_jail_args      (client_t *self, gchar **jail_args);
 static const gchar  *client_get_desktop1_path  (const client_t *self);
 static void          client_set_desktop1_path  (client_t *self, const char *path);
 static const gchar  *client_get_desktop2_path  (const client_t *self);
@@ -129,27 +143,34 @@ static bool          client_get_dry_run        (const client_t *self);
 static void          client_set_dry_run        (client_t *self, bool dry_run);
 static const gchar  *client_get_trace_dir      (const client_t *self);
 static void          client_set_trace_dir      (client_t *self, const char *path);
+static void          client_set_timing_path    (client_t *self, const char *path);
 static void          client_set_appinfo_variant(client_t *self, const char *key, GVariant *val);
 static GVariant     *client_get_appinfo_variant(const client_t *self, const char *key);
 const char          *client_get_appinfo_string (const client_t *self, const char *key);
 const char         **client_get_appinfo_strv   (const client_t *self, const char *key);
 
+/* ------------------------------------------------------------------------- *
+ * CLIENT_TIMING
+ * ------------------------------------------------------------------------- */
+
+static void client_timing_mark(client_t *self, const char *phase);
+static void client_timing_emit(client_t *self, const char *status);
+
 /* ------------------------------------------------------------------------- *
  * CLIENT_OPTIONS
  * ------------------------------------------------------------------------- */
 
-static const GList *client_get_firejail_options   (const client_t *self);
-static void         client_add_firejail_option    (client_t *self, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
-static void         client_add_firejail_permission(client_t *self, const char *name);
-static void         client_add_firejail_profile   (client_t *self, const char *name);
-static void         client_add_firejail_directory (client_t *self, bool create, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+static const GList *client_get_firejail_options(const client_t *self);
+static void         client_add_firejail_option (client_t *self, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
 
 /* ------------------------------------------------------------------------- *
  * CLIENT_IPC
  * ------------------------------------------------------------------------- */
 
 static bool client_prompt_permissions(client_t *self, const char *application);
+static void client_parse_appinfo     (client_t *self, GVariant *dict);
 static bool client_query_appinfo     (client_t *self, const char *application);
+static bool client_prompt_launch     (client_t *self, const char *application);
 
 /* ------------------------------------------------------------------------- *
  * CLIENT_LAUNCH
@@ -188,11 +209,6 @@ int main(int argc, char **argv);
  * UTILITY
  * ========================================================================= */
 
-static bool empty_p(const char *str)
-{
-    return !str || !*str;
-}
-
 static bool path_dirname_eq(const char *path, const char *target)
 {
     gchar *dir_path = path_dirname(path);
@@ -212,11 +228,17 @@ struct client_t
     gchar           *cli_desktop1_path;
     gchar           *cli_desktop2_path;
     gchar           *cli_trace_dir;
+    FILE            *cli_timing_file;
+    gint64           cli_timing_base;
+    client_phase_t   cli_timing_phase[CLIENT_TIMING_PHASES];
+    size_t           cli_timing_count;
+    bool             cli_timing_done;
     bool             cli_debug_mode;
     bool             cli_dry_run;
     GDBusConnection *cli_system_bus;
     GDBusConnection *cli_session_bus;
     gchar          **cli_granted;
+    gchar          **cli_jail_args;
     GHashTable      *cli_appinfo;
 
     stringset_t     *cli_firejail_args; /* Note: using ordered set allows us
@@ -234,11 +256,16 @@ client_ctor(client_t *self)
     self->cli_desktop1_path = NULL;
     self->cli_desktop2_path = NULL;
     self->cli_trace_dir     = NULL;
+    self->cli_timing_file   = NULL;
+    self->cli_timing_base   = g_get_monotonic_time();
+    self->cli_timing_count  = 0;
+    self->cli_timing_done   = false;
     self->cli_debug_mode    = false;
     self->cli_dry_run       = false;
     self->cli_system_bus    = NULL;
     self->cli_session_bus   = NULL;
     self->cli_granted       = NULL;
+    self->cli_jail_args     = NULL;
     self->cli_appinfo       = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
                                                    (GDestroyNotify)g_variant_unref);
     self->cli_firejail_args = stringset_create();
@@ -254,6 +281,7 @@ client_dtor(client_t *self)
         self->cli_appinfo = NULL;
 
     client_set_granted(self, NULL);
+    client_set_jail_args(self, NULL);
 
     if( self->cli_system_bus ) {
         g_object_unref(self->cli_system_bus),
@@ -268,6 +296,7 @@ client_dtor(client_t *self)
     client_set_desktop1_path(self, NULL);
     client_set_desktop2_path(self, NULL);
     client_set_trace_dir(self, NULL);
+    client_set_timing_path(self, NULL);
     client_set_argv(self, 0, NULL);
 }
 
@@ -433,6 +462,19 @@ client_set_granted(client_t *self, gchar **granted)
         self->cli_granted = granted;
 }
 
+static const gchar **
+client_get_jail_args(const client_t *self)
+{
+    return (const gchar **)self->cli_jail_args;
+}
+
+static void
+client_set_jail_args(client_t *self, gchar **jail_args)
+{
+    g_strfreev(self->cli_jail_args),
+        self->cli_jail_args = jail_args;
+}
+
 static const gchar *
 client_get_desktop1_path(const client_t *self)
 {
@@ -503,6 +545,39 @@ client_set_trace_dir(client_t *self, const char *path)
     change_string(&self->cli_trace_dir, path);
 }
 
+static void
+client_set_timing_path(client_t *self, const char *path)
+{
+    if( self->cli_timing_file && self->cli_timing_file != stderr )
+        fclose(self->cli_timing_file);
+    self->cli_timing_file = NULL;
+
+    if( !path ) {
+        /* Timing disabled */
+    }
+    else if( !strcmp(path, "-") ) {
+        self->cli_timing_file = stderr;
+    }
+    else {
+        /* Sailjail is setgid binary - the file is opened using the
+         * real gid, so that the user can't use the privileged group
+         * for appending to files that are not otherwise writable.
+         */
+        gid_t egid = getegid();
+        if( setegid(getgid()) == -1 ) {
+            log_warning("failed to drop group: %m");
+        }
+        else {
+            if( !(self->cli_timing_file = fopen(path, "ae")) )
+                log_warning("%s: can't open for writing: %m", path);
+            if( setegid(egid) == -1 ) {
+                log_err("failed to restore group: %m");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+}
+
 static void
 client_set_appinfo_variant(client_t *self, const char *key, GVariant *val)
 {
@@ -542,57 +617,79 @@ client_get_appinfo_strv(const client_t *self, const char *key)
 }
 
 /* ------------------------------------------------------------------------- *
- * CLIENT_OPTIONS
+ * CLIENT_TIMING
  * ------------------------------------------------------------------------- */
 
-static const GList *
-client_get_firejail_options(const client_t *self)
-{
-    return stringset_list(self->cli_firejail_args);
-}
-
 static void
-client_add_firejail_option(client_t *self, const char *fmt, ...)
+client_timing_mark(client_t *self, const char *phase)
 {
-    va_list va;
-    va_start(va, fmt);
-    gchar *option = g_strdup_vprintf(fmt, va);
-    va_end(va);
-    stringset_add_item_steal(self->cli_firejail_args, option);
+    /* Only pointer check is done when timing is not enabled */
+    if( !self->cli_timing_file || self->cli_timing_done )
+        return;
+
+    if( self->cli_timing_count < CLIENT_TIMING_PHASES ) {
+        client_phase_t *entry = &self->cli_timing_phase[self->cli_timing_count++];
+        entry->ctp_name = phase;
+        entry->ctp_time = g_get_monotonic_time();
+    }
 }
 
 static void
-client_add_firejail_permission(client_t *self, const char *name)
+client_timing_emit(client_t *self, const char *status)
 {
-    gchar *path = path_from_permission_name(name);
-    if( path && access(path, R_OK) == 0 )
-        client_add_firejail_option(self, "--profile=%s", path);
-    g_free(path);
+    /* Emits single line like:
+     *   sailjail-timing: app=NAME status=STATUS PHASE=MS ... total=MS
+     *
+     * Phase values are milliseconds spent since the previous phase.
+     */
+    if( !self->cli_timing_file || self->cli_timing_done )
+        return;
+
+    self->cli_timing_done = true;
+
+    gint64   prev = self->cli_timing_base;
+    gchar   *app  = path_to_desktop_name(client_get_desktop1_path(self) ?:
+                                         client_get_desktop2_path(self));
+    GString *line = g_string_new(CLIENT_TIMING_TAG);
+
+    g_string_append_printf(line, " app=%s status=%s", app ?: "unknown", status);
+    for( size_t i = 0; i < self->cli_timing_count; ++i ) {
+        const client_phase_t *entry = &self->cli_timing_phase[i];
+        g_string_append_printf(line, " %s=%.3f", entry->ctp_name,
+                               (entry->ctp_time - prev) / 1000.0);
+        prev = entry->ctp_time;
+    }
+    g_string_append_printf(line, " total=%.3f",
+                           (g_get_monotonic_time() - self->cli_timing_base) / 1000.0);
+
+    fprintf(self->cli_timing_file, "%s\n", line->str);
+    fflush(self->cli_timing_file);
+
+    g_string_free(line, true);
+    g_free(app);
 }
 
-static void
-client_add_firejail_profile(client_t *self, const char *name)
+/* ------------------------------------------------------------------------- *
+ * CLIENT_OPTIONS
+ * ------------------------------------------------------------------------- */
+
+static const GList *
+client_get_firejail_options(const client_t *self)
 {
-    gchar *path = path_from_profile_name(name);
-    if( path && access(path, R_OK) == 0 )
-        client_add_firejail_option(self, "--profile=%s", path);
-    g_free(path);
+    return stringset_list(self->cli_firejail_args);
 }
 
 static void
-client_add_firejail_directory(client_t *self, bool create, const char *fmt, ...)
+client_add_firejail_option(client_t *self, const char *fmt, ...)
 {
     va_list va;
     va_start(va, fmt);
-    gchar *path = g_strdup_vprintf(fmt, va);
+    gchar *option = g_strdup_vprintf(fmt, va);
     va_end(va);
-
-    if( create )
-        client_add_firejail_option(self, "--mkdir=%s", path);
-    client_add_firejail_option(self, "--whitelist=%s", path);
-    g_free(path);
+    stringset_add_item_steal(self->cli_firejail_args, option);
 }
 
+
 /* ------------------------------------------------------------------------- *
  * CLIENT_IPC
  * ------------------------------------------------------------------------- */
@@ -628,6 +725,10 @@ client_prompt_permissions(client_t *self, const char *application)
                 PERMISSIONMGR_INTERFACE, PERMISSIONMGR_METHOD_PROMPT,
                 application, "invalid reply");
     }
+    else {
+        log_notice("obtained permissions via %s", PERMISSIONMGR_METHOD_PROMPT);
+        client_timing_mark(self, "prompt");
+    }
 
 EXIT:
     if( reply )
@@ -662,14 +763,35 @@ client_query_appinfo(client_t *self, const char *application)
                 application, err ? err->message : "no reply");
         goto EXIT;
     }
-    GVariantIter  *iter_array = NULL;
-    g_variant_get(reply, "(a{sv})", &iter_array);
-    if( !iter_array )
+    GVariant *dict = NULL;
+    g_variant_get(reply, "(@a{sv})", &dict);
+    if( !dict )
         goto EXIT;
 
-    const char *key = NULL;
-    GVariant   *val = NULL;
-    while( g_variant_iter_loop (iter_array, "{&sv}", &key, &val) ) {
+    client_parse_appinfo(self, dict);
+    g_variant_unref(dict);
+
+    log_notice("obtained application info via %s", PERMISSIONMGR_METHOD_GET_APPINFO);
+    client_timing_mark(self, "appinfo");
+    ack = true;
+
+EXIT:
+    if( reply )
+        g_variant_unref(reply);
+    g_clear_error(&err);
+
+    return ack;
+}
+
+static void
+client_parse_appinfo(client_t *self, GVariant *dict)
+{
+    GVariantIter iter;
+    const char  *key = NULL;
+    GVariant    *val = NULL;
+
+    g_variant_iter_init(&iter, dict);
+    while( g_variant_iter_loop(&iter, "{&sv}", &key, &val) ) {
         const GVariantType *type = g_variant_get_type(val);
         if( g_variant_type_equal(type, G_VARIANT_TYPE_BOOLEAN) )
             log_debug("%s=%s", key, g_variant_get_boolean(val) ? "true" : "false");
@@ -679,16 +801,73 @@ client_query_appinfo(client_t *self, const char *application)
             log_debug("%s=%s@%p", key, (char *)type, val);
         client_set_appinfo_variant(self, key, val);
     }
-    g_variant_iter_free(iter_array);
+}
 
-    ack = true;
+static bool
+client_prompt_launch(client_t *self, const char *application)
+{
+    /* Obtains both launch permissions and application details
+     * with a single method call. Falls back to making separate
+     * calls if sailjaild does not support the combined method.
+     */
+    GError    *err         = NULL;
+    GVariant  *reply       = NULL;
+    gchar    **permissions = NULL;
+    GVariant  *dict        = NULL;
+    gchar    **jail_args   = NULL;
+
+    reply = g_dbus_connection_call_sync(client_system_bus(self),
+                                        PERMISSIONMGR_SERVICE,
+                                        PERMISSIONMGR_OBJECT,
+                                        PERMISSIONMGR_INTERFACE,
+                                        PERMISSIONMGR_METHOD_PROMPT_LAUNCH,
+                                        g_variant_new("(s)", application),
+                                        NULL,
+                                        G_DBUS_CALL_FLAGS_NONE,
+                                        G_MAXINT,
+                                        NULL,
+                                        &err);
+    if( g_error_matches(err, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD) ) {
+        log_debug("%s.%s() not supported - using fallback",
+                  PERMISSIONMGR_INTERFACE, PERMISSIONMGR_METHOD_PROMPT_LAUNCH);
+        g_clear_error(&err);
+        return (client_prompt_permissions(self, application) &&
+                client_query_appinfo(self, application));
+    }
+
+    if( err || !reply ) {
+        log_err("%s.%s(%s): failed: %s",
+                PERMISSIONMGR_INTERFACE, PERMISSIONMGR_METHOD_PROMPT_LAUNCH,
+                application, err ? err->message : "no reply");
+        goto EXIT;
+    }
+
+    g_variant_get(reply, "(^as@a{sv}^as)", &permissions, &dict, &jail_args);
+    if( !permissions || !dict ) {
+        log_err("%s.%s(%s): failed: %s",
+                PERMISSIONMGR_INTERFACE, PERMISSIONMGR_METHOD_PROMPT_LAUNCH,
+                application, "invalid reply");
+        g_strfreev(permissions), permissions = NULL;
+        goto EXIT;
+    }
+
+    client_parse_appinfo(self, dict);
+    if( jail_args && *jail_args )
+        client_set_jail_args(self, jail_args), jail_args = NULL;
+    log_notice("obtained permissions and application info via %s",
+               PERMISSIONMGR_METHOD_PROMPT_LAUNCH);
+    client_timing_mark(self, "prompt_launch");
 
 EXIT:
+    g_strfreev(jail_args);
+    if( dict )
+        g_variant_unref(dict);
     if( reply )
         g_variant_unref(reply);
     g_clear_error(&err);
 
-    return ack;
+    client_set_granted(self, permissions);
+    return permissions != NULL;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -725,6 +904,7 @@ client_launch_application(client_t *self)
          */
         if( !sailjailclient_binary_check(binary_path) )
             goto EXIT;
+        client_timing_mark(self, "booster_check");
     }
     else {
         binary_path = g_strdup(*argv);
@@ -732,21 +912,19 @@ client_launch_application(client_t *self)
 
     binary_name  = path_basename(binary_path);
 
-    /* Prompt for launch permission */
+    /* Prompt for launch permission and obtain application details */
     if( booster_name ) {
         /* Application boosters are launched without prompting,
          * with full set of permissions required by the application.
          */
         log_debug("booster launch - skip permission query");
+        if( !client_query_appinfo(self, desktop_name) )
+            goto EXIT;
     }
-    else if( !client_prompt_permissions(self, desktop_name) ) {
+    else if( !client_prompt_launch(self, desktop_name) ) {
         goto EXIT;
     }
 
-    /* Obtain application details */
-    if( !client_query_appinfo(self, desktop_name) )
-        goto EXIT;
-
     const char  *exec        = client_desktop_exec(self);
     const char  *exec_dbus   = client_sailjail_exec_dbus(self);
     const char  *org_name    = client_sailjail_organization_name(self);
@@ -815,54 +993,30 @@ client_launch_application(client_t *self)
         g_free(args);
         goto EXIT;
     }
+    client_timing_mark(self, "validate_argv");
 
     /* Construct firejail command to execute */
-    client_add_firejail_option(self, "/usr/bin/firejail");
+    client_add_firejail_option(self, FIREJAIL_BINARY);
     if( client_get_debug_mode(self) )
         client_add_firejail_option(self, "--debug");
     else
         client_add_firejail_option(self, "--quiet");
 
-    if( org_name )
-        client_add_firejail_option(self, "--template=OrganizationName:%s", org_name);
-    if( app_name )
-        client_add_firejail_option(self, "--template=ApplicationName:%s", app_name);
-
     client_add_firejail_option(self, "--private-bin=%s", binary_name);
-    client_add_firejail_option(self, "--whitelist=/usr/share/%s", data_dir ?: desktop_name);
-
-    /* Watch out for alternate desktop files in /etc as whitelisting
-     * them while private-etc is used leads to problems */
-    if( desktop1_path && strncmp(desktop1_path, "/etc/", 5) )
-        client_add_firejail_option(self, "--whitelist=%s", desktop1_path);
-
-    /* Legacy app binary based data directories are made available.
-     * But they are not created unless legacy app sandboxing is used. */
-    client_add_firejail_directory(self, use_compatibility, "${HOME}/.local/share/%s", desktop_name);
-    client_add_firejail_directory(self, use_compatibility, "${HOME}/.config/%s", desktop_name);
-    client_add_firejail_directory(self, use_compatibility, "${HOME}/.cache/%s", desktop_name);
 
-    if( !empty_p(org_name) && !empty_p(app_name) ) {
-        client_add_firejail_directory(self, true,  "${HOME}/.cache/%s/%s", org_name, app_name);
-        client_add_firejail_directory(self, true,  "${HOME}/.local/share/%s/%s", org_name, app_name);
-        client_add_firejail_directory(self, true,  "${HOME}/.config/%s/%s", org_name, app_name);
-
-        client_add_firejail_option(self, "--dbus-user.own=%s.%s", org_name, app_name);
+    const gchar **jail_args = client_get_jail_args(self);
+    if( jail_args ) {
+        /* Use application options precomputed by sailjaild */
+        for( size_t i = 0; jail_args[i]; ++i )
+            stringset_add_item(self->cli_firejail_args, jail_args[i]);
+    }
+    else {
+        firejail_add_application(self->cli_firejail_args, desktop_name,
+                                 desktop1_path, org_name, app_name, data_dir,
+                                 service, use_compatibility);
+        firejail_add_profiles(self->cli_firejail_args, booster_name,
+                              desktop_name, granted);
     }
-
-    if( !empty_p(service) )
-        client_add_firejail_option(self, "--dbus-user.own=%s", service);
-
-    /* Include booster type specific profile */
-    client_add_firejail_profile(self, booster_name);
-
-    /* Include application specific profile */
-    client_add_firejail_profile(self, desktop_name);
-
-    /* Include granted permissions */
-    for( size_t i = 0; granted[i]; ++i )
-        client_add_firejail_permission(self, granted[i]);
-    client_add_firejail_permission(self, "Base");
 
     /* Tracing options */
     const gchar *trace_dir = client_get_trace_dir(self);
@@ -886,6 +1040,7 @@ client_launch_application(client_t *self)
     for( int i = 0; i < argc; ++i )
         g_array_append_val(array, argv[i]);
     char **args = (char **)g_array_free(array, false);
+    client_timing_mark(self, "build_args");
 
     log_notice("Launching '%s' via sailjailclient...", binary_name);
     if( log_p(LOG_INFO) ) {
@@ -907,9 +1062,11 @@ client_launch_application(client_t *self)
         log_err("failed to set group: %m");
         goto EXIT;
     }
+    client_timing_mark(self, "set_group");
 
     /* Handle --dry-run */
     if( client_get_dry_run(self) ) {
+        client_timing_emit(self, "dry-run");
         for( size_t i = 0; args[i]; ++i )
             printf("%s%s", i ? " " : "", args[i]);
         printf("\n");
@@ -918,6 +1075,7 @@ client_launch_application(client_t *self)
     }
 
     /* Execute the application */
+    client_timing_emit(self, "exec");
     fflush(NULL);
     errno = 0;
     execv(*args, args);
@@ -1239,6 +1397,9 @@ static const char sailjailclient_usage_template[] = ""
 "        ignored. And \".desktop\" extension can be omitted.\n"
 "  -t, --trace=DIR\n"
 "        Enable libtrace and dbus proxy logging\n"
+"  -T, --timing=FILE\n"
+"        Append launch phase timings to FILE, or to stderr if FILE\n"
+"        is \"-\". See tools/measure_launch_time.py for processing.\n"
 "  -d, --debug-mode\n"
 "        Execute firejail in debug verbosity\n"
 "  -D, --dry-run\n"
@@ -1276,6 +1437,7 @@ static const struct option long_options[] = {
     {"output",       required_argument, NULL, 'o'},
     {"profile",      required_argument, NULL, 'p'},
     {"trace",        required_argument, NULL, 't'},
+    {"timing",       required_argument, NULL, 'T'},
     {"debug-mode",   no_argument,       NULL, 'd'},
     {"dry-run",      no_argument,       NULL, 'D'},
     // bw compat
@@ -1296,6 +1458,7 @@ static const char short_options[] =\
 "a:" // --app
 "o:" // --output
 "t:" // --trace
+"T:" // --timing
 "m:" // --match-exec
 "d"  // --debug-mode
 "D"  // --dry-run
@@ -1382,6 +1545,9 @@ sailjailclient_main(int argc, char **argv)
         case 't':
             client_set_trace_dir(client, optarg);
             break;
+        case 'T':
+            client_set_timing_path(client, optarg);
+            break;
         case 'd':
             client_set_debug_mode(client, true);
             break;
@@ -1429,6 +1595,7 @@ sailjailclient_main(int argc, char **argv)
     }
 
     client_set_argv(client, argc, argv);
+    client_timing_mark(client, "options");
 
     if( match_exec ) {
         if( !sailjailclient_validate_argv(match_exec,
@@ -1450,6 +1617,7 @@ sailjailclient_main(int argc, char **argv)
 
     if( !sailjailclient_binary_check(binary) )
         goto EXIT;
+    client_timing_mark(client, "binary_check");
 
     /* Sanity check desktop file path */
     desktop1_path = path_from_desktop_name(desktop_file ?: binary);
@@ -1468,6 +1636,7 @@ sailjailclient_main(int argc, char **argv)
         log_warning("Application permissions are not defined");
         goto EXIT;
     }
+    client_timing_mark(client, "desktop_check");
 
     /* Check if privileged application handling is possible */
     struct passwd *pw = getpwnam("privileged");
@@ -1480,11 +1649,14 @@ sailjailclient_main(int argc, char **argv)
     else {
         client_set_privileged(client, true);
     }
+    client_timing_mark(client, "privileged_check");
 
     /* Execute */
     exit_code = client_launch_application(client);
 
 EXIT:
+    /* No-op if already emitted before exec / dry-run exit */
+    client_timing_emit(client, exit_code == EXIT_SUCCESS ? "done" : "failed");
     client_delete_at(&client);
     g_free(desktop1_path);
     g_free(desktop2_path);
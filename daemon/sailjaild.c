@@ -158,11 +158,15 @@ sailjaild_main(int argc, char **argv)
 
     sailjaild_filesystem_setup();
 
+    gint64 started = g_get_monotonic_time();
+
     control = control_create(config);
 
     if( systemd )
         sd_notify(0, "READY=1");
 
+    log_info("ready in %.1f ms", (g_get_monotonic_time() - started) * 1e-3);
+
     exit_code = app_run();
 
 EXIT:
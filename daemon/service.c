@@ -37,14 +37,19 @@
 
 #include "service.h"
 
+#include "accesscache.h"
+#include "changelog.h"
 #include "logging.h"
 #include "mainloop.h"
+#include "metrics.h"
 #include "prompter.h"
 #include "control.h"
+#include "config.h"
 #include "appinfo.h"
 #include "appservices.h"
 #include "applications.h"
 #include "permissions.h"
+#include "permset.h"
 #include "session.h"
 #include "stringset.h"
 #include "settings.h"
@@ -63,9 +68,58 @@ typedef void DAPolicy;
  * Types
  * ========================================================================= */
 
-typedef struct prompter_t prompter_t;
+typedef struct prompter_t       prompter_t;
+
+typedef struct service_t        service_t;
+typedef struct service_call_t   service_call_t;
+typedef struct service_method_t service_method_t;
+
+/** Access policies, indexes in service_t::srv_policy[] */
+typedef enum service_policy_t {
+    SERVICE_POLICY_PRIVILEGED,
+    SERVICE_POLICY_MDM,
+    SERVICE_POLICY_COUNT
+} service_policy_t;
+
+/** Access restrictions checked before calling method handler */
+typedef enum service_access_t {
+    SERVICE_ACCESS_PUBLIC,       // any client
+    SERVICE_ACCESS_ADMIN,        // privileged or mdm clients only
+} service_access_t;
+
+/** Argument validation done before calling method handler */
+typedef enum service_validate_t {
+    SERVICE_VALIDATE_NONE,        // no uid/application checks
+    SERVICE_VALIDATE_USER,        // uid must be valid
+    SERVICE_VALIDATE_APPSETTINGS, // uid and application must be valid
+} service_validate_t;
+
+/** Method call context, filled in before calling method handler */
+struct service_call_t
+{
+    service_t              *scl_service;
+    const service_method_t *scl_method;
+    const gchar            *scl_sender;
+    GVariant               *scl_parameters;
+    GDBusMethodInvocation  *scl_invocation;
+
+    // validated arguments
+    uid_t                   scl_uid;
+    const gchar            *scl_app;
+    appsettings_t          *scl_appsettings;
+};
 
-typedef struct service_t  service_t;
+/** Method handler lookup table entry */
+struct service_method_t
+{
+    const char          *smt_name;
+    const char          *smt_signature; // type of input arguments tuple
+    service_access_t     smt_access;
+    service_validate_t   smt_validate;
+    int                  smt_uid_arg;   // index of uid argument, or -1
+    int                  smt_app_arg;   // index of application argument, or -1
+    void               (*smt_handler)(service_call_t *call);
+};
 
 /* ========================================================================= *
  * Policies
@@ -76,6 +130,16 @@ typedef struct service_t  service_t;
 
 #define G_BUS_TO_DA_BUS(bus) ((bus) == G_BUS_TYPE_SYSTEM ? DA_BUS_SYSTEM : DA_BUS_SESSION)
 
+/* ========================================================================= *
+ * Config
+ * ========================================================================= */
+
+/* Whether ApplicationAdded / Changed / Removed signals are broadcast
+ * for each application in addition to ApplicationsChanged.
+ */
+#define SERVICE_SIGNALS_SECTION     "Signals"
+#define SERVICE_KEY_PER_APPLICATION "PerApplication"
+
 /* ========================================================================= *
  * Prototypes
  * ========================================================================= */
@@ -96,7 +160,7 @@ void         service_applications_changed(service_t *self, const stringset_t *ch
  * SERVICE_PERMISSIONS
  * ------------------------------------------------------------------------- */
 
-stringset_t *service_filter_permissions(const service_t *self, const stringset_t *permissions);
+void service_filter_permissions(const service_t *self, const permset_t *permissions, permset_t *filtered);
 
 /* ------------------------------------------------------------------------- *
  * SERVICE_ATTRIBUTES
@@ -107,6 +171,7 @@ static applications_t *service_applications(const service_t *self);
 static appsettings_t  *service_appsettings (const service_t *self, uid_t uid, const char *app);
 static appinfo_t      *service_appinfo     (const service_t *self, const char *appname);
 prompter_t            *service_prompter    (service_t *self);
+metrics_t             *service_metrics     (service_t *self);
 
 /* ------------------------------------------------------------------------- *
  * SERVICE_CONNECTION
@@ -136,10 +201,63 @@ bool        service_is_nameowner (const service_t *self);
  * SERVICE_ACCESS_CONTROL
  * ------------------------------------------------------------------------- */
 
-static bool service_may_administrate(const gchar *sender);
-static bool service_is_privileged   (const gchar *sender);
-static bool service_is_mdm          (const gchar *sender);
-static bool service_test_policy     (const gchar *sender, DAPolicy *policy);
+static void service_load_policies   (service_t *self);
+static void service_unload_policies (service_t *self);
+void        service_reload_policies (service_t *self);
+static bool service_may_administrate(service_t *self, const gchar *sender);
+static bool service_is_privileged   (service_t *self, const gchar *sender);
+static bool service_is_mdm          (service_t *self, const gchar *sender);
+static bool service_test_policy     (service_t *self, const gchar *sender, service_policy_t policy);
+static bool service_check_policy_cb (const gchar *sender, guint policy, gpointer aptr);
+
+/* ------------------------------------------------------------------------- *
+ * SERVICE_LAUNCH
+ * ------------------------------------------------------------------------- */
+
+GVariant *service_launch_reply(service_t *self, const char *method, const appinfo_t *appinfo, const permset_t *granted);
+
+/* ------------------------------------------------------------------------- *
+ * SERVICE_BATCH
+ * ------------------------------------------------------------------------- */
+
+static GVariant *service_batch_entry(service_t *self, const char *app, uid_t uid, bool with_appinfo);
+static GVariant *service_batch_reply(service_t *self, gchar **apps, uid_t uid, bool with_appinfo);
+
+/* ------------------------------------------------------------------------- *
+ * SERVICE_CALL
+ * ------------------------------------------------------------------------- */
+
+static void service_call_reply_tuple(service_call_t *call, GVariant *tuple);
+static void service_call_reply_value(service_call_t *call, GVariant *value);
+static void service_call_reply_error(service_call_t *call, int code, const gchar *fmt, ...) __attribute__((format(printf, 3, 4)));
+static bool service_call_validate   (service_call_t *call);
+
+/* ------------------------------------------------------------------------- *
+ * SERVICE_HANDLER
+ * ------------------------------------------------------------------------- */
+
+static void service_handle_get_metrics           (service_call_t *call);
+static void service_handle_get_changes_since     (service_call_t *call);
+static void service_handle_get_applications      (service_call_t *call);
+static void service_handle_get_appinfo           (service_call_t *call);
+static void service_handle_get_apps_by_permission(service_call_t *call);
+static void service_handle_get_appinfo_batch     (service_call_t *call);
+static void service_handle_get_launch_state_batch(service_call_t *call);
+static void service_handle_get_license           (service_call_t *call);
+static void service_handle_set_license           (service_call_t *call);
+static void service_handle_get_launchable        (service_call_t *call);
+static void service_handle_set_launchable        (service_call_t *call);
+static void service_handle_get_granted           (service_call_t *call);
+static void service_handle_set_granted           (service_call_t *call);
+static void service_handle_launch                (service_call_t *call, bool prompt);
+static void service_handle_prompt                (service_call_t *call);
+static void service_handle_query                 (service_call_t *call);
+
+/* ------------------------------------------------------------------------- *
+ * SERVICE_METHOD
+ * ------------------------------------------------------------------------- */
+
+static const service_method_t *service_method_lookup(const gchar *name);
 
 /* ------------------------------------------------------------------------- *
  * SERVICE_DBUS
@@ -151,7 +269,7 @@ static void                service_dbus_bus_acquired_cb (GDBusConnection *connec
 static void                service_dbus_name_acquired_cb(GDBusConnection *connection, const gchar *name, gpointer user_data);
 static void                service_dbus_name_lost_cb    (GDBusConnection *connection, const gchar *name, gpointer user_data);
 static void                service_dbus_call_cb         (GDBusConnection *connection, const gchar *sender, const gchar *object_path, const gchar *interface_name, const gchar *method_name, GVariant *parameters, GDBusMethodInvocation *invocation, gpointer user_data);
-static void                service_dbus_emit_signal     (service_t *self, const char *member, const char *value);
+static void                service_dbus_emit_signal     (service_t *self, const char *member, GVariant *parameters);
 
 /* ========================================================================= *
  * SERVICE
@@ -168,9 +286,13 @@ struct service_t
     guint            srv_dbus_object_id;    // g_dbus_connection_register_object()
     guint            srv_notify_id;         // service_schedule_notify()
     stringset_t     *srv_dbus_applications; // signaled applications
-    stringset_t     *srv_permission_filter; // masking: Base,Privileged,Compatibility
+    permset_t        srv_permission_filter; // masking: Base,Privileged,Compatibility
+    DAPolicy        *srv_policy[SERVICE_POLICY_COUNT];
+    accesscache_t   *srv_accesscache;       // sender -> policy decisions
+    changelog_t     *srv_changelog;         // generation -> broadcast changes
 
     // downlink
+    metrics_t       *srv_metrics;
     prompter_t      *srv_prompter;
 
     // dbus service
@@ -190,14 +312,22 @@ service_ctor(service_t *self, control_t *control)
     self->srv_dbus_object_id    = 0;
     self->srv_notify_id         = 0;
     self->srv_dbus_applications = stringset_create();
+    self->srv_changelog         = changelog_create(CHANGELOG_CAPACITY_DEFAULT);
 
     /* Some permissions must be omitted from prompting */
-    self->srv_permission_filter = stringset_create();
-    stringset_add_item(self->srv_permission_filter, PERMISSION_BASE);
-    stringset_add_item(self->srv_permission_filter, PERMISSION_PRIVILEGED);
-    stringset_add_item(self->srv_permission_filter, PERMISSION_COMPATIBILITY);
+    permset_init(&self->srv_permission_filter);
+    permset_add(&self->srv_permission_filter, permset_intern(PERMISSION_BASE));
+    permset_add(&self->srv_permission_filter, permset_intern(PERMISSION_PRIVILEGED));
+    permset_add(&self->srv_permission_filter, permset_intern(PERMISSION_COMPATIBILITY));
+
+    /* Access policy checks are cached per client */
+    for( int i = 0; i < SERVICE_POLICY_COUNT; ++i )
+        self->srv_policy[i] = NULL;
+    self->srv_accesscache = accesscache_create(service_check_policy_cb, self);
+    service_load_policies(self);
 
     // downlink
+    self->srv_metrics          = metrics_create();
     self->srv_prompter         = prompter_create(self);
 
     // fetch initial set of already known applications
@@ -229,6 +359,7 @@ service_dtor(service_t *self)
 
     // downlink
     prompter_delete_at(&self->srv_prompter);
+    metrics_delete_at(&self->srv_metrics);
 
     // connection ref
     service_set_connection(self, NULL);
@@ -236,8 +367,9 @@ service_dtor(service_t *self)
     // data
     service_cancel_notify(self);
     stringset_delete_at(&self->srv_dbus_applications);
-    stringset_delete_at(&self->srv_permission_filter);
-
+    changelog_delete_at(&self->srv_changelog);
+    accesscache_delete_at(&self->srv_accesscache);
+    service_unload_policies(self);
 }
 
 service_t *
@@ -273,20 +405,19 @@ service_delete_cb(void *self)
  * SERVICE_PERMISSIONS
  * ------------------------------------------------------------------------- */
 
-stringset_t *
-service_filter_permissions(const service_t *self, const stringset_t *permissions)
+void
+service_filter_permissions(const service_t *self, const permset_t *permissions,
+                           permset_t *filtered)
 {
     /* Mask out permissions that we do not want to show in prompt */
-    stringset_t *filtered = stringset_filter_out(permissions,
-                                                 self->srv_permission_filter);
+    *filtered = *permissions;
+    permset_unmask(filtered, &self->srv_permission_filter);
 
     /* But masking must not lead into auto-allow Privileged */
-    if( stringset_empty(filtered) ) {
-        if( stringset_has_item(permissions, PERMISSION_PRIVILEGED) )
-            stringset_add_item(filtered, PERMISSION_PRIVILEGED);
+    if( permset_empty(filtered) ) {
+        if( permset_has_name(permissions, PERMISSION_PRIVILEGED) )
+            permset_add_name(filtered, PERMISSION_PRIVILEGED);
     }
-
-    return filtered;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -323,6 +454,12 @@ service_prompter(service_t *self)
     return self->srv_prompter;
 }
 
+metrics_t *
+service_metrics(service_t *self)
+{
+    return self->srv_metrics;
+}
+
 #ifdef DEAD_CODE
 static session_t *
 service_session(const service_t *self)
@@ -395,6 +532,9 @@ service_set_connection(service_t *self, GDBusConnection *connection)
                 self->srv_dbus_connection = 0;
         }
 
+        /* Cached decisions are tied to client lifetime on the bus */
+        accesscache_set_connection(self->srv_accesscache, connection);
+
         if( connection ) {
             self->srv_dbus_connection = g_object_ref(connection);
 
@@ -483,52 +623,699 @@ service_is_nameowner(const service_t *self)
  * SERVICE_ACCESS_CONTROL
  * ------------------------------------------------------------------------- */
 
-static bool
-service_may_administrate(const gchar *sender)
+static void
+service_load_policies(service_t *self)
 {
-    return service_is_privileged(sender) || service_is_mdm(sender);
+    /* Note: User and group names are resolved when policy is parsed */
+#ifdef HAVE_LIBDBUSACCESS
+    static const char * const lut[SERVICE_POLICY_COUNT] = {
+        [SERVICE_POLICY_PRIVILEGED] = SERVICE_PRIVILEGED_POLICY,
+        [SERVICE_POLICY_MDM]        = SERVICE_MDM_POLICY,
+    };
+    for( int i = 0; i < SERVICE_POLICY_COUNT; ++i ) {
+        if( !self->srv_policy[i] )
+            self->srv_policy[i] = da_policy_new(lut[i]);
+    }
+#else
+    (void)self;
+#endif
 }
 
-static bool
-service_is_privileged(const gchar *sender)
+static void
+service_unload_policies(service_t *self)
 {
-    static DAPolicy *policy = NULL;
+    for( int i = 0; i < SERVICE_POLICY_COUNT; ++i ) {
 #ifdef HAVE_LIBDBUSACCESS
-    if( !policy )
-        policy = da_policy_new(SERVICE_PRIVILEGED_POLICY);
+        if( self->srv_policy[i] )
+            da_policy_unref(self->srv_policy[i]);
 #endif
-    return service_test_policy(sender, policy);
+        self->srv_policy[i] = NULL;
+    }
+}
+
+void
+service_reload_policies(service_t *self)
+{
+    log_info("reload access policies");
+    accesscache_flush(self->srv_accesscache);
+    service_unload_policies(self);
+    service_load_policies(self);
 }
 
 static bool
-service_is_mdm(const gchar *sender)
+service_may_administrate(service_t *self, const gchar *sender)
 {
-    static DAPolicy *policy = NULL;
-#ifdef HAVE_LIBDBUSACCESS
-    if( !policy )
-        policy = da_policy_new(SERVICE_MDM_POLICY);
-#endif
-    return service_test_policy(sender, policy);
+    return (service_is_privileged(self, sender) ||
+            service_is_mdm(self, sender));
+}
+
+static bool
+service_is_privileged(service_t *self, const gchar *sender)
+{
+    return service_test_policy(self, sender, SERVICE_POLICY_PRIVILEGED);
+}
+
+static bool
+service_is_mdm(service_t *self, const gchar *sender)
+{
+    return service_test_policy(self, sender, SERVICE_POLICY_MDM);
 }
 
 static bool
-service_test_policy(const gchar *sender, DAPolicy *policy)
+service_test_policy(service_t *self, const gchar *sender,
+                    service_policy_t policy)
+{
+    return accesscache_check(self->srv_accesscache, sender, policy);
+}
+
+static bool
+service_check_policy_cb(const gchar *sender, guint policy, gpointer aptr)
 {
 #ifdef HAVE_LIBDBUSACCESS
-    DA_ACCESS access = DA_ACCESS_DENY;
-    DAPeer *peer     = da_peer_get(G_BUS_TO_DA_BUS(PERMISSIONMGR_BUS), sender);
+    service_t *self   = aptr;
+    DA_ACCESS  access = DA_ACCESS_DENY;
+    DAPeer    *peer   = da_peer_get(G_BUS_TO_DA_BUS(PERMISSIONMGR_BUS), sender);
 
-    if( peer )
-        access = da_policy_check(policy, &peer->cred, 0, NULL, DA_ACCESS_DENY);
+    if( peer && policy < SERVICE_POLICY_COUNT && self->srv_policy[policy] )
+        access = da_policy_check(self->srv_policy[policy], &peer->cred, 0,
+                                 NULL, DA_ACCESS_DENY);
 
     return access == DA_ACCESS_ALLOW;
 #else
     (void)sender;
     (void)policy;
+    (void)aptr;
     return true;
 #endif
 }
 
+/* ------------------------------------------------------------------------- *
+ * SERVICE_LAUNCH
+ * ------------------------------------------------------------------------- */
+
+GVariant *
+service_launch_reply(service_t *self, const char *method,
+                     const appinfo_t *appinfo, const permset_t *granted)
+{
+    /* Launch permission methods return granted permissions, and
+     * PromptLaunch() additionally also application details and
+     * precomputed firejail options so that launchers do not need
+     * to make a separate GetAppInfo() call nor construct options
+     * that depend only on application and granted permissions.
+     */
+    GVariant *variant = permset_to_variant(granted);
+    if( !g_strcmp0(method, PERMISSIONMGR_METHOD_PROMPT_LAUNCH) ) {
+        GVariant *jail_args = NULL;
+        GVariant *details   = appinfo_to_variant(appinfo);
+        if( appinfo )
+            jail_args = stringset_to_variant(control_jail_args(service_control(self),
+                                                               appinfo, granted));
+        else
+            jail_args = g_variant_new_strv(NULL, 0);
+        variant = g_variant_new("(@as@a{sv}@as)", variant, details, jail_args);
+        g_variant_unref(details);
+        return variant;
+    }
+    return g_variant_new_tuple(&variant, 1);
+}
+
+/* ------------------------------------------------------------------------- *
+ * SERVICE_BATCH
+ * ------------------------------------------------------------------------- */
+
+static GVariant *
+service_batch_entry(service_t *self, const char *app, uid_t uid, bool with_appinfo)
+{
+    GVariant      *entry       = NULL;
+    appinfo_t     *appinfo     = NULL;
+    appsettings_t *appsettings = NULL;
+
+    /* Invalid applications are just left out from batch replies */
+    if( !(appinfo = service_appinfo(self, app)) )
+        goto EXIT;
+
+    if( !(appsettings = service_appsettings(self, uid, app)) )
+        goto EXIT;
+
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+    if( with_appinfo ) {
+        GVariant *variant = appinfo_to_variant(appinfo);
+        GVariantIter iter;
+        GVariant *item;
+        g_variant_iter_init(&iter, variant);
+        while( (item = g_variant_iter_next_value(&iter)) ) {
+            g_variant_builder_add_value(&builder, item);
+            g_variant_unref(item);
+        }
+        g_variant_unref(variant);
+    }
+
+    g_variant_builder_add(&builder, "{sv}", PERMISSIONMGR_KEY_ALLOWED,
+                          g_variant_new_int32(appsettings_get_allowed(appsettings)));
+    g_variant_builder_add(&builder, "{sv}", PERMISSIONMGR_KEY_AGREED,
+                          g_variant_new_int32(appsettings_get_agreed(appsettings)));
+    g_variant_builder_add(&builder, "{sv}", PERMISSIONMGR_KEY_GRANTED,
+                          permset_to_variant(appsettings_get_granted(appsettings)));
+
+    entry = g_variant_builder_end(&builder);
+
+EXIT:
+    return entry;
+}
+
+static GVariant *
+service_batch_reply(service_t *self, gchar **apps, uid_t uid, bool with_appinfo)
+{
+    stringset_t *requested = NULL;
+
+    /* Empty list = all available applications */
+    if( apps && *apps )
+        requested = stringset_from_strv(apps);
+    else
+        requested = stringset_copy(applications_available(service_applications(self)));
+
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sa{sv}}"));
+
+    for( const GList *iter = stringset_list(requested); iter; iter = iter->next ) {
+        const char *app = iter->data;
+        GVariant *entry = service_batch_entry(self, app, uid, with_appinfo);
+        if( entry )
+            g_variant_builder_add(&builder, "{s@a{sv}}", app, entry);
+    }
+
+    stringset_delete(requested);
+
+    return g_variant_builder_end(&builder);
+}
+
+/* ------------------------------------------------------------------------- *
+ * SERVICE_CALL
+ * ------------------------------------------------------------------------- */
+
+static void
+service_call_reply_tuple(service_call_t *call, GVariant *tuple)
+{
+    log_debug("reply(%p)", tuple);
+    metrics_call_end(service_metrics(call->scl_service),
+                     call->scl_invocation, METRICS_REPLY_OK);
+    g_dbus_method_invocation_return_value(call->scl_invocation, tuple);
+}
+
+static void
+service_call_reply_value(service_call_t *call, GVariant *value)
+{
+    service_call_reply_tuple(call, value ? g_variant_new_tuple(&value, 1) : NULL);
+}
+
+static void __attribute__((format(printf, 3, 4)))
+service_call_reply_error(service_call_t *call, int code, const gchar *fmt, ...)
+{
+    va_list va;
+    va_start(va, fmt);
+    metrics_call_end(service_metrics(call->scl_service),
+                     call->scl_invocation, code);
+    g_dbus_method_invocation_return_error_valist(call->scl_invocation,
+                                                 G_DBUS_ERROR, code, fmt, va);
+    va_end(va);
+}
+
+static bool
+service_call_validate(service_call_t *call)
+{
+    /* Checks that are common to several methods are done here, based
+     * on method table metadata. If something is amiss, error reply is
+     * sent and false returned.
+     */
+    bool                    valid   = false;
+    const service_method_t *method  = call->scl_method;
+    control_t              *control = service_control(call->scl_service);
+    guint32                 uid     = SESSION_UID_UNDEFINED;
+
+    if( !g_variant_is_of_type(call->scl_parameters,
+                              G_VARIANT_TYPE(method->smt_signature)) ) {
+        service_call_reply_error(call, G_DBUS_ERROR_INVALID_ARGS,
+                                 "Expected arguments: %s",
+                                 method->smt_signature);
+        goto EXIT;
+    }
+
+    if( method->smt_access == SERVICE_ACCESS_ADMIN &&
+        !service_may_administrate(call->scl_service, call->scl_sender) ) {
+        service_call_reply_error(call, G_DBUS_ERROR_ACCESS_DENIED,
+                                 SERVICE_MESSAGE_RESTRICTED_METHOD,
+                                 call->scl_sender, method->smt_name);
+        goto EXIT;
+    }
+
+    if( method->smt_uid_arg >= 0 ) {
+        g_variant_get_child(call->scl_parameters, method->smt_uid_arg,
+                            "u", &uid);
+        call->scl_uid = uid;
+    }
+
+    if( method->smt_app_arg >= 0 )
+        g_variant_get_child(call->scl_parameters, method->smt_app_arg,
+                            "&s", &call->scl_app);
+
+    if( method->smt_validate >= SERVICE_VALIDATE_USER ) {
+        if( control_user_is_guest(control, call->scl_uid) &&
+            control_current_user(control) != call->scl_uid ) {
+            service_call_reply_error(call, G_DBUS_ERROR_INVALID_ARGS,
+                                     SERVICE_MESSAGE_GUEST_NOT_LOGGED_IN);
+            goto EXIT;
+        }
+        if( !control_valid_user(control, call->scl_uid) ) {
+            service_call_reply_error(call, G_DBUS_ERROR_INVALID_ARGS,
+                                     SERVICE_MESSAGE_INVALID_USER,
+                                     call->scl_uid);
+            goto EXIT;
+        }
+    }
+
+    if( method->smt_validate >= SERVICE_VALIDATE_APPSETTINGS ) {
+        call->scl_appsettings = control_appsettings(control, call->scl_uid,
+                                                    call->scl_app);
+        if( !call->scl_appsettings ) {
+            service_call_reply_error(call, G_DBUS_ERROR_INVALID_ARGS,
+                                     SERVICE_MESSAGE_INVALID_APPLICATION,
+                                     call->scl_app);
+            goto EXIT;
+        }
+    }
+
+    valid = true;
+
+EXIT:
+    return valid;
+}
+
+/* ------------------------------------------------------------------------- *
+ * SERVICE_HANDLER
+ * ------------------------------------------------------------------------- */
+
+static void
+service_handle_get_metrics(service_call_t *call)
+{
+    gchar *report = metrics_report(service_metrics(call->scl_service));
+    service_call_reply_value(call, g_variant_new_take_string(report));
+}
+
+static void
+service_handle_get_changes_since(service_call_t *call)
+{
+    guint64 generation = 0;
+    g_variant_get_child(call->scl_parameters, 0, "t", &generation);
+    service_call_reply_tuple(call, changelog_since(call->scl_service->srv_changelog,
+                                                   generation));
+}
+
+static void
+service_handle_get_applications(service_call_t *call)
+{
+    GVariantBuilder *builder = g_variant_builder_new(G_VARIANT_TYPE("as"));
+    const stringset_t *apps = applications_available(service_applications(call->scl_service));
+    for( const GList *iter = stringset_list(apps); iter; iter = iter->next ) {
+        const char *appname = iter->data;
+        g_variant_builder_add(builder, "s", appname);
+    }
+    GVariant *variant = g_variant_builder_end(builder);
+    g_variant_builder_unref(builder);
+    service_call_reply_value(call, variant);
+}
+
+static void
+service_handle_get_apps_by_permission(service_call_t *call)
+{
+    const gchar *permission = NULL;
+    g_variant_get_child(call->scl_parameters, 0, "&s", &permission);
+
+    /* Requesting applications that are currently allowed to use it */
+    applications_t    *applications = service_applications(call->scl_service);
+    const stringset_t *apps         = applications_by_permission(applications,
+                                                                 permission);
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("as"));
+    for( const GList *iter = apps ? stringset_list(apps) : NULL; iter; iter = iter->next ) {
+        const char *appname = iter->data;
+        appinfo_t  *appinfo = service_appinfo(call->scl_service, appname);
+        if( appinfo && appinfo_has_permission(appinfo, permission) )
+            g_variant_builder_add(&builder, "s", appname);
+    }
+    service_call_reply_value(call, g_variant_builder_end(&builder));
+}
+
+static void
+service_handle_get_appinfo(service_call_t *call)
+{
+    appinfo_t *appinfo = service_appinfo(call->scl_service, call->scl_app);
+    if( !appinfo ) {
+        service_call_reply_error(call, G_DBUS_ERROR_INVALID_ARGS,
+                                 SERVICE_MESSAGE_INVALID_APPLICATION,
+                                 call->scl_app);
+    }
+    else {
+        GVariant *variant = appinfo_to_variant(appinfo);
+        service_call_reply_value(call, variant);
+        g_variant_unref(variant);
+    }
+}
+
+static void
+service_handle_get_appinfo_batch(service_call_t *call)
+{
+    gchar **apps = NULL;
+    g_variant_get_child(call->scl_parameters, 0, "^as", &apps);
+    service_call_reply_value(call, service_batch_reply(call->scl_service, apps,
+                                                       call->scl_uid, true));
+    g_strfreev(apps);
+}
+
+static void
+service_handle_get_launch_state_batch(service_call_t *call)
+{
+    gchar **apps = NULL;
+    g_variant_get_child(call->scl_parameters, 0, "^as", &apps);
+    service_call_reply_value(call, service_batch_reply(call->scl_service, apps,
+                                                       call->scl_uid, false));
+    g_strfreev(apps);
+}
+
+static void
+service_handle_get_license(service_call_t *call)
+{
+    app_agreed_t agreed = appsettings_get_agreed(call->scl_appsettings);
+    service_call_reply_value(call, g_variant_new_int32(agreed));
+}
+
+static void
+service_handle_set_license(service_call_t *call)
+{
+    gint agreed = APP_AGREED_UNSET;
+    g_variant_get_child(call->scl_parameters, 2, "i", &agreed);
+    appsettings_set_agreed(call->scl_appsettings, agreed);
+    service_call_reply_value(call, NULL);
+}
+
+static void
+service_handle_get_launchable(service_call_t *call)
+{
+    app_allowed_t allowed = appsettings_get_allowed(call->scl_appsettings);
+    service_call_reply_value(call, g_variant_new_int32(allowed));
+}
+
+static void
+service_handle_set_launchable(service_call_t *call)
+{
+    gint allowed = APP_ALLOWED_UNSET;
+    g_variant_get_child(call->scl_parameters, 2, "i", &allowed);
+    appsettings_set_allowed(call->scl_appsettings, allowed);
+    service_call_reply_value(call, NULL);
+}
+
+static void
+service_handle_get_granted(service_call_t *call)
+{
+    const permset_t *granted = appsettings_get_granted(call->scl_appsettings);
+    service_call_reply_value(call, permset_to_variant(granted));
+}
+
+static void
+service_handle_set_granted(service_call_t *call)
+{
+    gchar **vector = NULL;
+    g_variant_get_child(call->scl_parameters, 2, "^as", &vector);
+    if( !vector ) {
+        service_call_reply_error(call, G_DBUS_ERROR_INVALID_ARGS,
+                                 SERVICE_MESSAGE_INVALID_PERMISSIONS);
+    }
+    else {
+        /* Names not known to registry can't be among application
+         * permissions either -> ignore instead of registering */
+        permset_t granted;
+        permset_init(&granted);
+        for( size_t i = 0; vector[i]; ++i )
+            permset_add(&granted, permset_lookup(vector[i]));
+        appsettings_set_granted(call->scl_appsettings, &granted);
+        service_call_reply_value(call, NULL);
+    }
+    g_strfreev(vector);
+}
+
+static void
+service_handle_launch(service_call_t *call, bool prompt)
+{
+    service_t     *self        = call->scl_service;
+    const gchar   *app         = call->scl_app;
+    /* Use session user */
+    guint32        uid         = control_current_user(service_control(self));
+    appinfo_t     *appinfo     = NULL;
+    appsettings_t *appsettings = NULL;
+
+    if( !(appinfo = service_appinfo(self, app)) ) {
+        log_warning("client query with invalid app '%s'", app);
+        service_call_reply_error(call, G_DBUS_ERROR_INVALID_ARGS,
+                                 SERVICE_MESSAGE_INVALID_APPLICATION, app);
+    }
+    else if( !(appsettings = service_appsettings(self, uid, app)) ) {
+        log_warning("client query with invalid uid %d", (int)uid);
+        service_call_reply_error(call, G_DBUS_ERROR_INVALID_ARGS,
+                                 SERVICE_MESSAGE_INVALID_USER, uid);
+    }
+    else {
+        /* Automatically allow apps that do not require any permissions.
+         * Unless they have been explicitly denied earlier.
+         *
+         * Applications defined outside /usr/share/applications can not
+         * be prompted for permissions.
+         */
+        gchar *desktop = path_from_desktop_name(appinfo_id(appinfo));
+        const permset_t *permissions = appinfo_get_permissions(appinfo);
+        permset_t filtered;
+        service_filter_permissions(self, permissions, &filtered);
+        /* Empty permission sets are auto-allowed, except for Mode=None
+         * apps, which still need the warning-only prompt.
+         */
+        if( permset_empty(&filtered) &&
+            appinfo_get_mode(appinfo) != APP_MODE_NONE ) {
+            if( appsettings_get_allowed(appsettings) == APP_ALLOWED_UNSET )
+                appsettings_set_allowed(appsettings, APP_ALLOWED_ALWAYS);
+        }
+        /* Check current status and reply immediately / queue for prompting.
+         */
+        app_allowed_t allowed = appsettings_get_allowed(appsettings);
+        if( allowed == APP_ALLOWED_NEVER ) {
+            log_warning("client query about permanently denied app '%s'", app);
+            service_call_reply_error(call, G_DBUS_ERROR_AUTH_FAILED,
+                                     SERVICE_MESSAGE_DENIED_PERMANENTLY);
+        }
+        else if( allowed == APP_ALLOWED_ALWAYS ) {
+            const permset_t *granted = appsettings_get_granted(appsettings);
+            service_call_reply_tuple(call,
+                                     service_launch_reply(self,
+                                                          call->scl_method->smt_name,
+                                                          appinfo,
+                                                          granted));
+        }
+        else if( !prompt ) {
+            log_warning("client query about not yet allowed app '%s'", app);
+            service_call_reply_error(call, G_DBUS_ERROR_AUTH_FAILED,
+                                     SERVICE_MESSAGE_NOT_ALLOWED);
+        }
+        else if( access(desktop, R_OK) == -1 ) {
+            log_warning("client prompt without accessible desktop file: %s: %m", desktop);
+            service_call_reply_error(call, G_DBUS_ERROR_AUTH_FAILED,
+                                     SERVICE_MESSAGE_NOT_ALLOWED);
+        }
+        else {
+            prompter_handle_invocation(service_prompter(self),
+                                       call->scl_invocation);
+        }
+        g_free(desktop);
+    }
+}
+
+static void
+service_handle_prompt(service_call_t *call)
+{
+    service_handle_launch(call, true);
+}
+
+static void
+service_handle_query(service_call_t *call)
+{
+    service_handle_launch(call, false);
+}
+
+/* ------------------------------------------------------------------------- *
+ * SERVICE_METHOD
+ * ------------------------------------------------------------------------- */
+
+static const service_method_t service_method_lut[] =
+{
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_GET_METRICS,
+        .smt_signature = "()",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_NONE,
+        .smt_uid_arg   = -1,
+        .smt_app_arg   = -1,
+        .smt_handler   = service_handle_get_metrics,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_GET_CHANGES_SINCE,
+        .smt_signature = "(t)",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_NONE,
+        .smt_uid_arg   = -1,
+        .smt_app_arg   = -1,
+        .smt_handler   = service_handle_get_changes_since,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_GET_APPLICATIONS,
+        .smt_signature = "()",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_NONE,
+        .smt_uid_arg   = -1,
+        .smt_app_arg   = -1,
+        .smt_handler   = service_handle_get_applications,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_GET_APPINFO,
+        .smt_signature = "(s)",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_NONE,
+        .smt_uid_arg   = -1,
+        .smt_app_arg   = 0,
+        .smt_handler   = service_handle_get_appinfo,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_GET_APPS_BY_PERMISSION,
+        .smt_signature = "(s)",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_NONE,
+        .smt_uid_arg   = -1,
+        .smt_app_arg   = -1,
+        .smt_handler   = service_handle_get_apps_by_permission,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_GET_APPINFO_BATCH,
+        .smt_signature = "(asu)",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_USER,
+        .smt_uid_arg   = 1,
+        .smt_app_arg   = -1,
+        .smt_handler   = service_handle_get_appinfo_batch,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_GET_LAUNCH_STATE_BATCH,
+        .smt_signature = "(asu)",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_USER,
+        .smt_uid_arg   = 1,
+        .smt_app_arg   = -1,
+        .smt_handler   = service_handle_get_launch_state_batch,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_GET_LICENSE,
+        .smt_signature = "(us)",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_APPSETTINGS,
+        .smt_uid_arg   = 0,
+        .smt_app_arg   = 1,
+        .smt_handler   = service_handle_get_license,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_SET_LICENSE,
+        .smt_signature = "(usi)",
+        .smt_access    = SERVICE_ACCESS_ADMIN,
+        .smt_validate  = SERVICE_VALIDATE_APPSETTINGS,
+        .smt_uid_arg   = 0,
+        .smt_app_arg   = 1,
+        .smt_handler   = service_handle_set_license,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_GET_LAUNCHABLE,
+        .smt_signature = "(us)",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_APPSETTINGS,
+        .smt_uid_arg   = 0,
+        .smt_app_arg   = 1,
+        .smt_handler   = service_handle_get_launchable,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_SET_LAUNCHABLE,
+        .smt_signature = "(usi)",
+        .smt_access    = SERVICE_ACCESS_ADMIN,
+        .smt_validate  = SERVICE_VALIDATE_APPSETTINGS,
+        .smt_uid_arg   = 0,
+        .smt_app_arg   = 1,
+        .smt_handler   = service_handle_set_launchable,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_GET_GRANTED,
+        .smt_signature = "(us)",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_APPSETTINGS,
+        .smt_uid_arg   = 0,
+        .smt_app_arg   = 1,
+        .smt_handler   = service_handle_get_granted,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_SET_GRANTED,
+        .smt_signature = "(usas)",
+        .smt_access    = SERVICE_ACCESS_ADMIN,
+        .smt_validate  = SERVICE_VALIDATE_APPSETTINGS,
+        .smt_uid_arg   = 0,
+        .smt_app_arg   = 1,
+        .smt_handler   = service_handle_set_granted,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_PROMPT,
+        .smt_signature = "(s)",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_NONE,
+        .smt_uid_arg   = -1,
+        .smt_app_arg   = 0,
+        .smt_handler   = service_handle_prompt,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_PROMPT_LAUNCH,
+        .smt_signature = "(s)",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_NONE,
+        .smt_uid_arg   = -1,
+        .smt_app_arg   = 0,
+        .smt_handler   = service_handle_prompt,
+    },
+    {
+        .smt_name      = PERMISSIONMGR_METHOD_QUERY,
+        .smt_signature = "(s)",
+        .smt_access    = SERVICE_ACCESS_PUBLIC,
+        .smt_validate  = SERVICE_VALIDATE_NONE,
+        .smt_uid_arg   = -1,
+        .smt_app_arg   = 0,
+        .smt_handler   = service_handle_query,
+    },
+    {
+        .smt_name      = NULL,
+    }
+};
+
+static const service_method_t *
+service_method_lookup(const gchar *name)
+{
+    static GHashTable *lut = NULL;
+    if( !lut ) {
+        lut = g_hash_table_new(g_str_hash, g_str_equal);
+        for( const service_method_t *method = service_method_lut; method->smt_name; ++method )
+            g_hash_table_insert(lut, (gpointer)method->smt_name, (gpointer)method);
+    }
+    return name ? g_hash_table_lookup(lut, name) : NULL;
+}
+
 /* ------------------------------------------------------------------------- *
  * SERVICE_DBUS
  * ------------------------------------------------------------------------- */
@@ -545,6 +1332,23 @@ static const gchar introspect_xml[] =\
 "      <arg type='a{sv}' name='appinfo' direction='out'/>"
 "    </method>"
 
+"    <method name='" PERMISSIONMGR_METHOD_GET_APPS_BY_PERMISSION "'>"
+"      <arg type='s' name='permission' direction='in'/>"
+"      <arg type='as' name='applications' direction='out'/>"
+"    </method>"
+
+"    <method name='" PERMISSIONMGR_METHOD_GET_APPINFO_BATCH "'>"
+"      <arg type='as' name='applications' direction='in'/>"
+"      <arg type='u' name='uid' direction='in'/>"
+"      <arg type='a{sa{sv}}' name='appinfo' direction='out'/>"
+"    </method>"
+
+"    <method name='" PERMISSIONMGR_METHOD_GET_LAUNCH_STATE_BATCH "'>"
+"      <arg type='as' name='applications' direction='in'/>"
+"      <arg type='u' name='uid' direction='in'/>"
+"      <arg type='a{sa{sv}}' name='state' direction='out'/>"
+"    </method>"
+
 "    <method name='" PERMISSIONMGR_METHOD_GET_LICENSE "'>"
 "      <arg type='u' name='uid' direction='in'/>"
 "      <arg type='s' name='application' direction='in'/>"
@@ -591,6 +1395,24 @@ static const gchar introspect_xml[] =\
 "      <arg type='as' name='granted' direction='out'/>"
 "    </method>"
 
+"    <method name='" PERMISSIONMGR_METHOD_PROMPT_LAUNCH "'>"
+"      <arg type='s' name='application' direction='in'/>"
+"      <arg type='as' name='granted' direction='out'/>"
+"      <arg type='a{sv}' name='appinfo' direction='out'/>"
+"      <arg type='as' name='firejail' direction='out'/>"
+"    </method>"
+
+"    <method name='" PERMISSIONMGR_METHOD_GET_METRICS "'>"
+"      <arg type='s' name='report' direction='out'/>"
+"    </method>"
+
+"    <method name='" PERMISSIONMGR_METHOD_GET_CHANGES_SINCE "'>"
+"      <arg type='t' name='generation' direction='in'/>"
+"      <arg type='t' name='generation' direction='out'/>"
+"      <arg type='b' name='resync' direction='out'/>"
+"      <arg type='a(suu)' name='changes' direction='out'/>"
+"    </method>"
+
 "    <signal name='" PERMISSIONMGR_SIGNAL_APP_ADDED "'>"
 "      <arg type='s' name='application'/>"
 "    </signal>"
@@ -602,6 +1424,18 @@ static const gchar introspect_xml[] =\
 "    <signal name='" PERMISSIONMGR_SIGNAL_APP_REMOVED "'>"
 "      <arg type='s' name='application'/>"
 "    </signal>"
+
+"    <signal name='" PERMISSIONMGR_SIGNAL_APP_CHANGED_EX "'>"
+"      <arg type='s' name='application'/>"
+"      <arg type='u' name='changes'/>"
+"      <arg type='a(uu)' name='users'/>"
+"    </signal>"
+
+"    <signal name='" PERMISSIONMGR_SIGNAL_APPS_CHANGED "'>"
+"      <arg type='as' name='added'/>"
+"      <arg type='as' name='changed'/>"
+"      <arg type='as' name='removed'/>"
+"    </signal>"
 "  </interface>"
 "</node>";
 
@@ -678,272 +1512,37 @@ service_dbus_call_cb(GDBusConnection       *connection,
     log_debug("from=%s object=%s method=%s.%s",
               sender, object_path, interface_name, method_name);
 
-    auto void value_reply(GVariant *val) {
-        log_debug("reply(%p)", val);
-        g_dbus_method_invocation_return_value(invocation,
-                                              val
-                                              ? g_variant_new_tuple(&val, 1)
-                                              : NULL);
-    }
+    metrics_call_begin(service_metrics(self), invocation);
+
+    service_call_t call = {
+        .scl_service     = self,
+        .scl_method      = service_method_lookup(method_name),
+        .scl_sender      = sender,
+        .scl_parameters  = parameters,
+        .scl_invocation  = invocation,
+        .scl_uid         = SESSION_UID_UNDEFINED,
+        .scl_app         = NULL,
+        .scl_appsettings = NULL,
+    };
 
-    auto void __attribute__((format(printf, 2, 3))) error_reply(int code, const gchar *fmt, ...) {
-        va_list va;
-        va_start(va, fmt);
-        g_dbus_method_invocation_return_error_valist(invocation, G_DBUS_ERROR,
-                                                     code, fmt, va);
-        va_end(va);
-    }
+    if( !call.scl_method )
+        service_call_reply_error(&call, G_DBUS_ERROR_UNKNOWN_METHOD,
+                                 "Unknown method: %s", method_name);
+    else if( service_call_validate(&call) )
+        call.scl_method->smt_handler(&call);
 
-    if( !g_strcmp0(method_name, PERMISSIONMGR_METHOD_GET_APPLICATIONS) ) {
-        GVariantBuilder *builder = g_variant_builder_new(G_VARIANT_TYPE("as"));
-        const stringset_t *apps = applications_available(service_applications(self));
-        for( const GList *iter = stringset_list(apps); iter; iter = iter->next ) {
-            const char *appname = iter->data;
-            g_variant_builder_add(builder, "s", appname);
-        }
-        GVariant *variant = g_variant_builder_end(builder);
-        g_variant_builder_unref(builder);
-        value_reply(variant);
-    }
-    else if( !g_strcmp0(method_name, PERMISSIONMGR_METHOD_GET_APPINFO) ) {
-        const gchar *app = NULL;
-        g_variant_get(parameters, "(&s)", &app);
-        appinfo_t *appinfo = service_appinfo(self, app);
-        if( !appinfo ) {
-            error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_APPLICATION, app);
-        }
-        else {
-            GVariant *variant = appinfo_to_variant(appinfo);
-            value_reply(variant);
-        }
-    }
-    else if( !g_strcmp0(method_name, PERMISSIONMGR_METHOD_GET_LICENSE) ) {
-        guint32      uid = SESSION_UID_UNDEFINED;
-        const gchar *app = NULL;
-        g_variant_get(parameters, "(u&s)", &uid, &app);
-        appsettings_t *appsettings = NULL;
-        if( control_user_is_guest(service_control(self), uid) &&
-            control_current_user(service_control(self)) != uid ) {
-            error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_GUEST_NOT_LOGGED_IN);
-        }
-        else if( !control_valid_user(service_control(self), uid) ) {
-            error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_USER, uid);
-        }
-        else if( !(appsettings = control_appsettings(service_control(self), uid, app)) ) {
-            error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_APPLICATION, app);
-        }
-        else {
-            app_agreed_t agreed = appsettings_get_agreed(appsettings);
-            GVariant *variant = g_variant_new_int32(agreed);
-            value_reply(variant);
-        }
-    }
-    else if( !g_strcmp0(method_name, PERMISSIONMGR_METHOD_SET_LICENSE) ) {
-        if( !service_may_administrate(sender) ) {
-            error_reply(G_DBUS_ERROR_ACCESS_DENIED, SERVICE_MESSAGE_RESTRICTED_METHOD, sender,
-                        method_name);
-        } else {
-            guint32      uid   = SESSION_UID_UNDEFINED;
-            const gchar *app   = NULL;
-            gint        agreed = APP_AGREED_UNSET;
-            g_variant_get(parameters, "(u&si)", &uid, &app, &agreed);
-            appsettings_t *appsettings = NULL;
-            if( control_user_is_guest(service_control(self), uid) &&
-                control_current_user(service_control(self)) != uid ) {
-                error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_GUEST_NOT_LOGGED_IN);
-            }
-            else if( !control_valid_user(service_control(self), uid) ) {
-                error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_USER, uid);
-            }
-            else if( !(appsettings = control_appsettings(service_control(self), uid, app)) ) {
-                error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_APPLICATION, app);
-            }
-            else {
-                appsettings_set_agreed(appsettings, agreed);
-                value_reply(NULL);
-            }
-        }
-    }
-    else if( !g_strcmp0(method_name, PERMISSIONMGR_METHOD_GET_LAUNCHABLE) ) {
-        guint32      uid = SESSION_UID_UNDEFINED;
-        const gchar *app = NULL;
-        g_variant_get(parameters, "(u&s)", &uid, &app);
-        appsettings_t *appsettings = NULL;
-        if( control_user_is_guest(service_control(self), uid) &&
-            control_current_user(service_control(self)) != uid ) {
-            error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_GUEST_NOT_LOGGED_IN);
-        }
-        else if( !control_valid_user(service_control(self), uid) ) {
-            error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_USER, uid);
-        }
-        else if( !(appsettings = control_appsettings(service_control(self), uid, app)) ) {
-            error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_APPLICATION, app);
-        }
-        else {
-            app_allowed_t allowed = appsettings_get_allowed(appsettings);
-            GVariant *variant = g_variant_new_int32(allowed);
-            value_reply(variant);
-        }
-    }
-    else if( !g_strcmp0(method_name, PERMISSIONMGR_METHOD_SET_LAUNCHABLE) ) {
-        if( !service_may_administrate(sender) ) {
-            error_reply(G_DBUS_ERROR_ACCESS_DENIED, SERVICE_MESSAGE_RESTRICTED_METHOD, sender,
-                        method_name);
-        } else {
-            guint32      uid    = SESSION_UID_UNDEFINED;
-            const gchar *app    = NULL;
-            gint        allowed = APP_ALLOWED_UNSET;
-            g_variant_get(parameters, "(u&si)", &uid, &app, &allowed);
-            appsettings_t *appsettings = NULL;
-            if( control_user_is_guest(service_control(self), uid) &&
-                control_current_user(service_control(self)) != uid ) {
-                error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_GUEST_NOT_LOGGED_IN);
-            }
-            else if( !control_valid_user(service_control(self), uid) ) {
-                error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_USER, uid);
-            }
-            else if( !(appsettings = control_appsettings(service_control(self), uid, app)) ) {
-                error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_APPLICATION, app);
-            }
-            else {
-                appsettings_set_allowed(appsettings, allowed);
-                value_reply(NULL);
-            }
-        }
-    }
-    else if( !g_strcmp0(method_name, PERMISSIONMGR_METHOD_GET_GRANTED) ) {
-        guint32      uid = SESSION_UID_UNDEFINED;
-        const gchar *app = NULL;
-        g_variant_get(parameters, "(u&s)", &uid, &app);
-        appsettings_t *appsettings = NULL;
-        if( control_user_is_guest(service_control(self), uid) &&
-            control_current_user(service_control(self)) != uid ) {
-            error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_GUEST_NOT_LOGGED_IN);
-        }
-        else if( !control_valid_user(service_control(self), uid) ) {
-            error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_USER, uid);
-        }
-        else if( !(appsettings = control_appsettings(service_control(self), uid, app)) ) {
-            error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_APPLICATION, app);
-        }
-        else {
-            const stringset_t *granted = appsettings_get_granted(appsettings);
-            gchar **vector = stringset_to_strv(granted);
-            GVariant *variant = g_variant_new_strv((const gchar * const *)vector, -1);
-            value_reply(variant);
-            g_strfreev(vector);
-        }
-    }
-    else if( !g_strcmp0(method_name, PERMISSIONMGR_METHOD_SET_GRANTED) ) {
-        if( !service_may_administrate(sender) ) {
-            error_reply(G_DBUS_ERROR_ACCESS_DENIED, SERVICE_MESSAGE_RESTRICTED_METHOD, sender,
-                        method_name);
-        } else {
-            guint32      uid = SESSION_UID_UNDEFINED;
-            const gchar *app = NULL;
-            gchar **vector   = NULL;
-            g_variant_get(parameters, "(u&s^as)", &uid, &app, &vector);
-            appsettings_t *appsettings = NULL;
-            if( control_user_is_guest(service_control(self), uid) &&
-                control_current_user(service_control(self)) != uid ) {
-                error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_GUEST_NOT_LOGGED_IN);
-            }
-            else if( !control_valid_user(service_control(self), uid) ) {
-                error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_USER, uid);
-            }
-            else if( !(appsettings = control_appsettings(service_control(self), uid, app)) ) {
-                error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_APPLICATION, app);
-            }
-            else if( !vector ) {
-                error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_PERMISSIONS);
-            }
-            else {
-                stringset_t *granted = stringset_from_strv(vector);
-                appsettings_set_granted(appsettings, granted);
-                stringset_delete(granted);
-                value_reply(NULL);
-            }
-            g_strfreev(vector);
-        }
-    }
-    else if( !g_strcmp0(method_name, PERMISSIONMGR_METHOD_PROMPT) ||
-             !g_strcmp0(method_name, PERMISSIONMGR_METHOD_QUERY) ) {
-        /* Use session user */
-        guint32        uid         = control_current_user(service_control(self));
-        const gchar   *app         = NULL;
-        appinfo_t     *appinfo     = NULL;
-        appsettings_t *appsettings = NULL;
-        g_variant_get(parameters, "(&s)", &app);
-
-        if( !(appinfo = service_appinfo(self, app)) ) {
-            log_warning("client query with invalid app '%s'", app);
-            error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_APPLICATION, app);
-        }
-        else if( !(appsettings = service_appsettings(self, uid, app)) ) {
-            log_warning("client query with invalid uid %d", (int)uid);
-            error_reply(G_DBUS_ERROR_INVALID_ARGS, SERVICE_MESSAGE_INVALID_USER, uid);
-        }
-        else {
-            /* Automatically allow apps that do not require any permissions.
-             * Unless they have been explicitly denied earlier.
-             *
-             * Applications defined outside /usr/share/applications can not
-             * be prompted for permissions.
-             */
-            gchar *desktop = path_from_desktop_name(appinfo_id(appinfo));
-            const stringset_t *permissions = appinfo_get_permissions(appinfo);
-            stringset_t *filtered = service_filter_permissions(self,
-                                                               permissions);
-            /* Empty permission sets are auto-allowed, except for Mode=None
-             * apps, which still need the warning-only prompt.
-             */
-            if( stringset_empty(filtered) &&
-                appinfo_get_mode(appinfo) != APP_MODE_NONE ) {
-                if( appsettings_get_allowed(appsettings) == APP_ALLOWED_UNSET )
-                    appsettings_set_allowed(appsettings, APP_ALLOWED_ALWAYS);
-            }
-            /* Check current status and reply immediately / queue for prompting.
-             */
-            app_allowed_t allowed = appsettings_get_allowed(appsettings);
-            if( allowed == APP_ALLOWED_NEVER ) {
-                log_warning("client query about permanently denied app '%s'", app);
-                error_reply(G_DBUS_ERROR_AUTH_FAILED, SERVICE_MESSAGE_DENIED_PERMANENTLY);
-            }
-            else if( allowed == APP_ALLOWED_ALWAYS ) {
-                const stringset_t *granted = appsettings_get_granted(appsettings);
-                gchar **vector = stringset_to_strv(granted);
-                GVariant *variant = g_variant_new_strv((const gchar * const *)vector, -1);
-                value_reply(variant);
-                g_strfreev(vector);
-            }
-            else if( !g_strcmp0(method_name, PERMISSIONMGR_METHOD_QUERY) ) {
-                log_warning("client query about not yet allowed app '%s'", app);
-                error_reply(G_DBUS_ERROR_AUTH_FAILED, SERVICE_MESSAGE_NOT_ALLOWED);
-            }
-            else if( access(desktop, R_OK) == -1 ) {
-                log_warning("client prompt without accessible desktop file: %s: %m", desktop);
-                error_reply(G_DBUS_ERROR_AUTH_FAILED, SERVICE_MESSAGE_NOT_ALLOWED);
-            }
-            else {
-                prompter_handle_invocation(service_prompter(self), invocation);
-            }
-            stringset_delete(filtered);
-            g_free(desktop);
-        }
-    }
-    else {
-        error_reply(G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method: %s",
-                    method_name);
-    }
     log_debug("done");
 }
 
 static void
-service_dbus_emit_signal(service_t *self, const char *member, const char *value)
+service_dbus_emit_signal(service_t *self, const char *member, GVariant *parameters)
 {
+    /* Floating parameters are consumed also when sending is skipped */
+    g_variant_ref_sink(parameters);
+
     GDBusConnection *connection = service_get_connection(self);
     if( !connection ) {
-        log_warning("broadcast %s(%s):  skipped: not connected", member, value);
+        log_warning("broadcast %s:  skipped: not connected", member);
     }
     else {
         GError *error = 0;
@@ -951,14 +1550,20 @@ service_dbus_emit_signal(service_t *self, const char *member, const char *value)
                                       PERMISSIONMGR_OBJECT,
                                       PERMISSIONMGR_INTERFACE,
                                       member,
-                                      g_variant_new("(s)", value),
+                                      parameters,
                                       &error);
-        if( error )
-            log_warning("broadcast %s(%s):  failed: %s", member, value, error->message);
-        else
-            log_debug("broadcast %s(%s):  succeeded", member, value);
+        if( error ) {
+            log_warning("broadcast %s:  failed: %s", member, error->message);
+        }
+        else {
+            log_debug("broadcast %s:  succeeded", member);
+            metrics_record_signal(service_metrics(self), member,
+                                  g_variant_get_size(parameters));
+        }
         g_clear_error(&error);
     }
+
+    g_variant_unref(parameters);
 }
 
 void
@@ -967,27 +1572,94 @@ service_applications_changed(service_t *self, const stringset_t *changed)
     log_notice("*** applications changed broadcast");
 
     appservices_t *appservices = control_appservices(service_control(self));
+    settings_t    *settings    = control_settings(service_control(self));
+    bool per_application = config_boolean(control_config(service_control(self)),
+                                          SERVICE_SIGNALS_SECTION,
+                                          SERVICE_KEY_PER_APPLICATION,
+                                          true);
+
+    /* All changes handled in one rethink cycle are reported via one
+     * ApplicationsChanged signal, so that subscribers wake up only
+     * once even if every application changes.
+     */
+    GVariantBuilder added, updated, removed;
+    g_variant_builder_init(&added, G_VARIANT_TYPE("as"));
+    g_variant_builder_init(&updated, G_VARIANT_TYPE("as"));
+    g_variant_builder_init(&removed, G_VARIANT_TYPE("as"));
+
+    /* Everything reported in one broadcast shares one generation */
+    changelog_t *changelog = self->srv_changelog;
+    if( stringset_size(changed) > 0 )
+        changelog_advance(changelog);
 
     for( const GList *iter = stringset_list(changed); iter; iter = iter->next ) {
         const char *app = iter->data;
         appinfo_t *appinfo = service_appinfo(self, app);
         const char *member = PERMISSIONMGR_SIGNAL_APP_CHANGED;
+        guint32     status = 0;
         if( !appinfo_valid(appinfo) ) {
             member = PERMISSIONMGR_SIGNAL_APP_REMOVED;
             stringset_remove_item(self->srv_dbus_applications, app);
 
             appservices_application_removed(appservices, app);
+            g_variant_builder_add(&removed, "s", app);
+            status = APP_CHANGE_REMOVED;
         }
         else if( !stringset_has_item(self->srv_dbus_applications, app) ) {
             member = PERMISSIONMGR_SIGNAL_APP_ADDED;
             stringset_add_item(self->srv_dbus_applications, app);
 
             appservices_application_added(appservices, app, appinfo);
+            g_variant_builder_add(&added, "s", app);
+            status = APP_CHANGE_ADDED;
         }
         else {
             appservices_application_changed(appservices, app, appinfo);
+            g_variant_builder_add(&updated, "s", app);
+        }
+
+        /* Details about what has changed are consumed also when
+         * they are not broadcast, so that they do not pile up.
+         */
+        guint32   changes = appinfo ? appinfo_take_changes(appinfo) : 0;
+        GVariant *users   = settings_take_changes(settings, app);
+
+        changelog_add(changelog, app, SESSION_UID_UNDEFINED, status | changes);
+        if( users ) {
+            GVariantIter iter_users;
+            guint32      uid, mask;
+            g_variant_iter_init(&iter_users, users);
+            while( g_variant_iter_next(&iter_users, "(uu)", &uid, &mask) )
+                changelog_add(changelog, app, uid, mask);
+        }
+
+        if( per_application ) {
+            log_debug("broadcast %s(%s)", member, app);
+            service_dbus_emit_signal(self, member, g_variant_new("(s)", app));
+        }
+
+        /* Change details are not available via any other signal, so
+         * they are broadcast regardless of the legacy signal switch.
+         */
+        if( !g_strcmp0(member, PERMISSIONMGR_SIGNAL_APP_CHANGED) ) {
+            service_dbus_emit_signal(self, PERMISSIONMGR_SIGNAL_APP_CHANGED_EX,
+                                     g_variant_new("(su@a(uu))", app,
+                                                   changes, users));
+            users = NULL;
         }
-        service_dbus_emit_signal(self, member, app);
+
+        if( users )
+            g_variant_unref(g_variant_ref_sink(users));
+    }
+
+    if( stringset_size(changed) > 0 ) {
+        service_dbus_emit_signal(self, PERMISSIONMGR_SIGNAL_APPS_CHANGED,
+                                 g_variant_new("(asasas)", &added, &updated, &removed));
+    }
+    else {
+        g_variant_builder_clear(&added);
+        g_variant_builder_clear(&updated);
+        g_variant_builder_clear(&removed);
     }
 
     prompter_applications_changed(service_prompter(self), changed);
@@ -68,17 +68,30 @@ G_BEGIN_DECLS;
 # define PERMISSIONMGR_OBJECT                  "/org/sailfishos/sailjaild1"
 # define PERMISSIONMGR_METHOD_PROMPT           "PromptLaunchPermissions"
 # define PERMISSIONMGR_METHOD_QUERY            "QueryLaunchPermissions"
+# define PERMISSIONMGR_METHOD_PROMPT_LAUNCH    "PromptLaunch"
 # define PERMISSIONMGR_METHOD_GET_APPLICATIONS "GetApplications"
 # define PERMISSIONMGR_METHOD_GET_APPINFO      "GetAppInfo"
+# define PERMISSIONMGR_METHOD_GET_APPINFO_BATCH "GetAppInfoBatch"
+# define PERMISSIONMGR_METHOD_GET_APPS_BY_PERMISSION "GetApplicationsByPermission"
+# define PERMISSIONMGR_METHOD_GET_LAUNCH_STATE_BATCH "GetLaunchStateBatch"
 # define PERMISSIONMGR_METHOD_GET_LICENSE      "GetLicenseAgreed"
 # define PERMISSIONMGR_METHOD_SET_LICENSE      "SetLicenseAgreed"
 # define PERMISSIONMGR_METHOD_GET_LAUNCHABLE   "GetLaunchAllowed"
 # define PERMISSIONMGR_METHOD_SET_LAUNCHABLE   "SetLaunchAllowed"
 # define PERMISSIONMGR_METHOD_GET_GRANTED      "GetGrantedPermissions"
 # define PERMISSIONMGR_METHOD_SET_GRANTED      "SetGrantedPermissions"
+# define PERMISSIONMGR_METHOD_GET_METRICS      "GetMetrics"
+# define PERMISSIONMGR_METHOD_GET_CHANGES_SINCE "GetChangesSince"
 # define PERMISSIONMGR_SIGNAL_APP_ADDED        "ApplicationAdded"
 # define PERMISSIONMGR_SIGNAL_APP_CHANGED      "ApplicationChanged"
 # define PERMISSIONMGR_SIGNAL_APP_REMOVED      "ApplicationRemoved"
+# define PERMISSIONMGR_SIGNAL_APP_CHANGED_EX   "ApplicationChangedEx"
+# define PERMISSIONMGR_SIGNAL_APPS_CHANGED     "ApplicationsChanged"
+
+/* Launch state keys used in batch replies */
+# define PERMISSIONMGR_KEY_ALLOWED             "Allowed"
+# define PERMISSIONMGR_KEY_AGREED              "Agreed"
+# define PERMISSIONMGR_KEY_GRANTED             "Granted"
 
 /* Message templates used for error reporting */
 # define SERVICE_MESSAGE_INVALID_APPLICATION   "Invalid application name: %s"
@@ -106,7 +119,9 @@ typedef struct control_t      control_t;
 typedef struct service_t      service_t;
 typedef struct appinfo_t      appinfo_t;
 typedef struct stringset_t    stringset_t;
+typedef struct permset_t      permset_t;
 typedef struct prompter_t     prompter_t;
+typedef struct metrics_t      metrics_t;
 
 /* ========================================================================= *
  * Prototypes
@@ -126,7 +141,13 @@ void       service_applications_changed(service_t *self, const stringset_t *chan
  * SERVICE_PERMISSIONS
  * ------------------------------------------------------------------------- */
 
-stringset_t *service_filter_permissions(const service_t *self, const stringset_t *permissions);
+void service_filter_permissions(const service_t *self, const permset_t *permissions, permset_t *filtered);
+
+/* ------------------------------------------------------------------------- *
+ * SERVICE_LAUNCH
+ * ------------------------------------------------------------------------- */
+
+GVariant *service_launch_reply(service_t *self, const char *method, const appinfo_t *appinfo, const permset_t *granted);
 
 /* ------------------------------------------------------------------------- *
  * SERVICE_ATTRIBUTES
@@ -134,6 +155,7 @@ stringset_t *service_filter_permissions(const service_t *self, const stringset_t
 
 control_t  *service_control (const service_t *self);
 prompter_t *service_prompter(service_t *self);
+metrics_t  *service_metrics (service_t *self);
 
 /* ------------------------------------------------------------------------- *
  * SERVICE_NAMEOWNER
@@ -141,6 +163,12 @@ prompter_t *service_prompter(service_t *self);
 
 bool service_is_nameowner(const service_t *self);
 
+/* ------------------------------------------------------------------------- *
+ * SERVICE_ACCESS_CONTROL
+ * ------------------------------------------------------------------------- */
+
+void service_reload_policies(service_t *self);
+
 G_END_DECLS
 
 #endif /* SERVICE_H_ */
@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "service.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+
+/* ========================================================================= *
+ * Constants
+ * ========================================================================= */
+
+/* Number of method calls made per round in dispatch benchmarks */
+#define BENCH_DISPATCH_CALLS 100
+
+#define DBUS_PEER_INTERFACE  "org.freedesktop.DBus.Peer"
+#define DBUS_PEER_METHOD_PING "Ping"
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * BENCH
+ * ------------------------------------------------------------------------- */
+
+static GVariant *bench_call_raw       (GDBusConnection *con, const char *interface, const char *method, GVariant *args, GError **err);
+static GVariant *bench_call           (GDBusConnection *con, const char *method, GVariant *args);
+static gchar   **bench_applications   (GDBusConnection *con);
+static bool      bench_per_application(GDBusConnection *con, gchar **apps, uid_t uid);
+static bool      bench_appinfo_batch  (GDBusConnection *con, gchar **apps, uid_t uid);
+static bool      bench_state_batch    (GDBusConnection *con, gchar **apps, uid_t uid);
+static bool      bench_ping           (GDBusConnection *con, gchar **apps, uid_t uid);
+static bool      bench_dispatch       (GDBusConnection *con, gchar **apps, uid_t uid);
+static void      bench_metrics        (GDBusConnection *con);
+
+/* ------------------------------------------------------------------------- *
+ * MAIN
+ * ------------------------------------------------------------------------- */
+
+int main(int ac, char **av);
+
+/* ========================================================================= *
+ * BENCH
+ * ========================================================================= */
+
+typedef struct
+{
+    const char *name;
+    bool      (*func)(GDBusConnection *con, gchar **apps, uid_t uid);
+} bench_t;
+
+static const bench_t bench_lut[] =
+{
+    { "per-application", bench_per_application },
+    { "appinfo-batch",   bench_appinfo_batch   },
+    { "state-batch",     bench_state_batch     },
+    { "ping",            bench_ping            },
+    { "dispatch",        bench_dispatch        },
+    { NULL,              NULL                  }
+};
+
+static GVariant *
+bench_call_raw(GDBusConnection *con, const char *interface, const char *method,
+               GVariant *args, GError **err)
+{
+    return g_dbus_connection_call_sync(con,
+                                       PERMISSIONMGR_SERVICE,
+                                       PERMISSIONMGR_OBJECT,
+                                       interface,
+                                       method,
+                                       args,
+                                       NULL,
+                                       G_DBUS_CALL_FLAGS_NONE,
+                                       -1,
+                                       NULL,
+                                       err);
+}
+
+static GVariant *
+bench_call(GDBusConnection *con, const char *method, GVariant *args)
+{
+    GError   *err = NULL;
+    GVariant *rsp = bench_call_raw(con, PERMISSIONMGR_INTERFACE, method,
+                                   args, &err);
+    if( err ) {
+        fprintf(stderr, "%s(): %s\n", method, err->message);
+        g_error_free(err);
+    }
+    return rsp;
+}
+
+static gchar **
+bench_applications(GDBusConnection *con)
+{
+    gchar   **apps = NULL;
+    GVariant *rsp  = bench_call(con, PERMISSIONMGR_METHOD_GET_APPLICATIONS, NULL);
+    if( rsp ) {
+        g_variant_get(rsp, "(^as)", &apps);
+        g_variant_unref(rsp);
+    }
+    return apps;
+}
+
+static bool
+bench_per_application(GDBusConnection *con, gchar **apps, uid_t uid)
+{
+    static const char * const methods[] = {
+        PERMISSIONMGR_METHOD_GET_LAUNCHABLE,
+        PERMISSIONMGR_METHOD_GET_LICENSE,
+        PERMISSIONMGR_METHOD_GET_GRANTED,
+        NULL
+    };
+
+    for( size_t i = 0; apps[i]; ++i ) {
+        GVariant *rsp = bench_call(con, PERMISSIONMGR_METHOD_GET_APPINFO,
+                                   g_variant_new("(s)", apps[i]));
+        if( !rsp )
+            return false;
+        g_variant_unref(rsp);
+
+        for( size_t j = 0; methods[j]; ++j ) {
+            rsp = bench_call(con, methods[j],
+                             g_variant_new("(us)", (guint32)uid, apps[i]));
+            if( !rsp )
+                return false;
+            g_variant_unref(rsp);
+        }
+    }
+    return true;
+}
+
+static bool
+bench_appinfo_batch(GDBusConnection *con, gchar **apps, uid_t uid)
+{
+    GVariant *rsp = bench_call(con, PERMISSIONMGR_METHOD_GET_APPINFO_BATCH,
+                               g_variant_new("(^asu)", apps, (guint32)uid));
+    if( !rsp )
+        return false;
+    g_variant_unref(rsp);
+    return true;
+}
+
+static bool
+bench_state_batch(GDBusConnection *con, gchar **apps, uid_t uid)
+{
+    GVariant *rsp = bench_call(con, PERMISSIONMGR_METHOD_GET_LAUNCH_STATE_BATCH,
+                               g_variant_new("(^asu)", apps, (guint32)uid));
+    if( !rsp )
+        return false;
+    g_variant_unref(rsp);
+    return true;
+}
+
+static bool
+bench_ping(GDBusConnection *con, gchar **apps, uid_t uid)
+{
+    /* Baseline: round trip that is handled by gdbus without
+     * involving sailjaild method dispatching at all */
+    (void)apps;
+    (void)uid;
+    for( int i = 0; i < BENCH_DISPATCH_CALLS; ++i ) {
+        GError   *err = NULL;
+        GVariant *rsp = bench_call_raw(con, DBUS_PEER_INTERFACE,
+                                       DBUS_PEER_METHOD_PING, NULL, &err);
+        if( !rsp ) {
+            fprintf(stderr, "%s(): %s\n", DBUS_PEER_METHOD_PING, err->message);
+            g_error_free(err);
+            return false;
+        }
+        g_variant_unref(rsp);
+    }
+    return true;
+}
+
+static bool
+bench_dispatch(GDBusConnection *con, gchar **apps, uid_t uid)
+{
+    /* Method that gets dispatched and validated, but is then rejected
+     * due to invalid application name -> difference to ping round trip
+     * is dominated by method lookup and argument validation. */
+    (void)apps;
+    for( int i = 0; i < BENCH_DISPATCH_CALLS; ++i ) {
+        GError   *err = NULL;
+        GVariant *rsp = bench_call_raw(con, PERMISSIONMGR_INTERFACE,
+                                       PERMISSIONMGR_METHOD_GET_LAUNCHABLE,
+                                       g_variant_new("(us)", (guint32)uid, ""),
+                                       &err);
+        if( rsp )
+            g_variant_unref(rsp);
+        else if( !g_error_matches(err, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS) ) {
+            fprintf(stderr, "%s(): %s\n", PERMISSIONMGR_METHOD_GET_LAUNCHABLE,
+                    err->message);
+            g_error_free(err);
+            return false;
+        }
+        g_clear_error(&err);
+    }
+    return true;
+}
+
+static void
+bench_metrics(GDBusConnection *con)
+{
+    /* Daemon side view: latencies from method dispatch to reply */
+    const gchar *report = NULL;
+    GVariant    *rsp    = bench_call(con, PERMISSIONMGR_METHOD_GET_METRICS, NULL);
+    if( rsp ) {
+        g_variant_get(rsp, "(&s)", &report);
+        printf("\n%s", report);
+        g_variant_unref(rsp);
+    }
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int ac, char **av)
+{
+    int              exit_code = EXIT_FAILURE;
+    int              rounds    = 10;
+    uid_t            uid       = getuid();
+    GDBusConnection *con       = NULL;
+    gchar          **apps      = NULL;
+    GError          *err       = NULL;
+
+    if( ac > 1 )
+        rounds = atoi(av[1]);
+    if( ac > 2 )
+        uid = (uid_t)strtoul(av[2], NULL, 0);
+
+    if( ac > 3 || rounds < 1 ) {
+        fprintf(stderr,
+                "USAGE:\n"
+                "     %s [rounds [uid]]\n"
+                "\n"
+                "DESCRIPTION:\n"
+                "     Measures how long it takes to fetch application\n"
+                "     info and launch state for all applications known\n"
+                "     to sailjaild, using one method call per datum vs\n"
+                "     using batch method calls.\n"
+                "\n"
+                "     Dispatch overhead is estimated by comparing %d\n"
+                "     D-Bus peer pings against %d method calls that\n"
+                "     sailjaild dispatches and validates, followed by\n"
+                "     sailjaild side latency report.\n",
+                *av, BENCH_DISPATCH_CALLS, BENCH_DISPATCH_CALLS);
+        goto EXIT;
+    }
+
+    if( !(con = g_bus_get_sync(PERMISSIONMGR_BUS, NULL, &err)) ) {
+        fprintf(stderr, "bus connect: %s\n", err->message);
+        goto EXIT;
+    }
+
+    if( !(apps = bench_applications(con)) )
+        goto EXIT;
+
+    printf("applications: %u, uid: %u, rounds: %d\n",
+           g_strv_length(apps), (unsigned)uid, rounds);
+
+    for( const bench_t *bench = bench_lut; bench->name; ++bench ) {
+        gint64 started = g_get_monotonic_time();
+        for( int i = 0; i < rounds; ++i ) {
+            if( !bench->func(con, apps, uid) )
+                goto EXIT;
+        }
+        gint64 elapsed = g_get_monotonic_time() - started;
+        printf("%-16s %10.3f ms/round\n", bench->name,
+               elapsed / 1000.0 / rounds);
+    }
+
+    bench_metrics(con);
+
+    exit_code = EXIT_SUCCESS;
+
+EXIT:
+    g_strfreev(apps);
+    if( con )
+        g_object_unref(con);
+    g_clear_error(&err);
+    return exit_code;
+}
@@ -38,15 +38,19 @@
 
 #include "util.h"
 #include "logging.h"
+#include "intern.h"
 #include "stringset.h"
+#include "permset.h"
 #include "control.h"
 #include "appinfo.h"
 #include "config.h"
 #include "migrator.h"
+#include "journal.h"
 
 #include <errno.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 
 /* ========================================================================= *
  * Config
@@ -54,6 +58,26 @@
 
 #define APP_CONFIG_ALLOWLIST "Allowlist"
 
+/* Journal record: appname, allowed, agreed, autogrant, mode, granted,
+ * permissions - i.e. the same data as in settings file application group */
+#define SETTINGS_JOURNAL_RECORD "(siiiiasas)"
+
+/* Journal size that triggers compaction into settings file */
+#define SETTINGS_JOURNAL_LIMIT  (64 * 1024)
+
+/* User settings are loaded on first access, and can be dropped from
+ * memory again when not needed:
+ *
+ *   [Settings]
+ *   IdleTimeout=300   # seconds, 0 = keep loaded
+ *   ResidentLimit=0   # application entries over all users, 0 = no limit
+ */
+#define SETTINGS_CONFIG_SECTION         "Settings"
+#define SETTINGS_KEY_IDLE_TIMEOUT       "IdleTimeout"
+#define SETTINGS_KEY_RESIDENT_LIMIT     "ResidentLimit"
+#define SETTINGS_IDLE_TIMEOUT_DEFAULT   300
+#define SETTINGS_RESIDENT_LIMIT_DEFAULT 0
+
 /* ========================================================================= *
  * Types
  * ========================================================================= */
@@ -95,11 +119,13 @@ void         settings_delete_cb(void *self);
  * SETTINGS_ATTRIBUTES
  * ------------------------------------------------------------------------- */
 
-static const config_t *settings_config     (const settings_t *self);
-control_t             *settings_control    (const settings_t *self);
-appsettings_t         *settings_appsettings(settings_t *self, uid_t uid, const char *app);
-static migrator_t     *settings_migrator   (const settings_t *self);
-static bool            settings_initialized(const settings_t *self);
+static const config_t *settings_config      (const settings_t *self);
+control_t             *settings_control     (const settings_t *self);
+appsettings_t         *settings_appsettings (settings_t *self, uid_t uid, const char *app);
+static usersettings_t *settings_usersettings(settings_t *self, uid_t uid);
+bool                   settings_preload_user(settings_t *self, uid_t uid);
+static migrator_t     *settings_migrator    (const settings_t *self);
+static bool            settings_initialized (const settings_t *self);
 
 /* ------------------------------------------------------------------------- *
  * SETTINGS_USERSETTINGS
@@ -116,6 +142,7 @@ bool            settings_remove_usersettings(settings_t *self, uid_t uid);
 appsettings_t *settings_get_appsettings   (const settings_t *self, uid_t uid, const char *appname);
 appsettings_t *settings_add_appsettings   (settings_t *self, uid_t uid, const char *appname);
 bool           settings_remove_appsettings(settings_t *self, uid_t uid, const char *appname);
+GVariant      *settings_take_changes      (settings_t *self, const char *appname);
 
 /* ------------------------------------------------------------------------- *
  * SETTINGS_STORAGE
@@ -124,11 +151,13 @@ bool           settings_remove_appsettings(settings_t *self, uid_t uid, const ch
 void            settings_load_all   (settings_t *self);
 void            settings_save_all   (const settings_t *self);
 void            settings_load_user  (settings_t *self, uid_t uid);
-void            settings_save_user  (const settings_t *self, uid_t uid);
-static void     settings_save_now   (settings_t *self);
-static gboolean settings_save_cb    (gpointer aptr);
-static void     settings_cancel_save(settings_t *self);
-void            settings_save_later (settings_t *self, uid_t uid);
+void            settings_save_user     (const settings_t *self, uid_t uid);
+static void     settings_flush_journals(settings_t *self);
+static void     settings_save_now      (settings_t *self);
+static gboolean settings_save_cb       (gpointer aptr);
+static void     settings_cancel_save   (settings_t *self);
+static void     settings_schedule_save (settings_t *self);
+void            settings_save_later    (settings_t *self, uid_t uid);
 
 /* ------------------------------------------------------------------------- *
  * SETTINGS_SLOTS
@@ -140,14 +169,30 @@ void settings_on_migration_finished(settings_t *self);
  * SETTINGS_RETHINK
  * ------------------------------------------------------------------------- */
 
-void settings_rethink(settings_t *self);
+void settings_rethink             (settings_t *self);
+void settings_rethink_applications(settings_t *self, const stringset_t *apps);
+void settings_rethink_users       (settings_t *self, GHashTable *added, GHashTable *removed);
+
+/* ------------------------------------------------------------------------- *
+ * SETTINGS_RESIDENCY
+ * ------------------------------------------------------------------------- */
+
+guint           settings_resident_count(const settings_t *self);
+static bool     settings_user_pinned   (const settings_t *self, const usersettings_t *usersettings);
+static void     settings_evict_user    (settings_t *self, uid_t uid);
+void            settings_evict_now     (settings_t *self);
+static gboolean settings_evict_cb      (gpointer aptr);
+static void     settings_schedule_evict(settings_t *self, gint64 delay);
+static void     settings_cancel_evict  (settings_t *self);
 
 /* ------------------------------------------------------------------------- *
  * SETTINGS_UTILITY
  * ------------------------------------------------------------------------- */
 
 static gchar *settings_userdata_path        (uid_t uid);
+static gchar *settings_journal_path         (uid_t uid);
 static void   settings_remove_stale_userdata(uid_t uid);
+static void   settings_purge_stale_userdata (settings_t *self);
 static bool   settings_valid_user           (const settings_t *self, uid_t uid);
 
 /* ------------------------------------------------------------------------- *
@@ -164,10 +209,14 @@ void            usersettings_delete_cb(void *self);
  * USERSETTINGS_ATTRIBUTES
  * ------------------------------------------------------------------------- */
 
-static settings_t     *usersettings_settings(const usersettings_t *self);
-static uid_t           usersettings_uid     (const usersettings_t *self);
-static const config_t *usersettings_config  (const usersettings_t *self);
-static control_t      *usersettings_control (const usersettings_t *self);
+static settings_t     *usersettings_settings       (const usersettings_t *self);
+static uid_t           usersettings_uid            (const usersettings_t *self);
+static const config_t *usersettings_config         (const usersettings_t *self);
+static control_t      *usersettings_control        (const usersettings_t *self);
+static guint           usersettings_app_count      (const usersettings_t *self);
+static gint64          usersettings_accessed       (const usersettings_t *self);
+static void            usersettings_touch          (usersettings_t *self);
+static bool            usersettings_changes_pending(const usersettings_t *self);
 
 /* ------------------------------------------------------------------------- *
  * USERSETTINGS_APPSETTINGS
@@ -183,13 +232,25 @@ bool                  usersettings_remove_appsettings(usersettings_t *self, cons
  * ------------------------------------------------------------------------- */
 
 void usersettings_load(usersettings_t *self, const char *path);
-void usersettings_save(const usersettings_t *self, const char *path);
+bool usersettings_save(const usersettings_t *self, const char *path);
+
+/* ------------------------------------------------------------------------- *
+ * USERSETTINGS_JOURNAL
+ * ------------------------------------------------------------------------- */
+
+static void  usersettings_journal_later    (usersettings_t *self, const gchar *appname);
+static bool  usersettings_journal_flush    (usersettings_t *self);
+static void  usersettings_journal_replay_cb(GVariant *record, gpointer aptr);
+static guint usersettings_journal_replay   (usersettings_t *self);
+static bool  usersettings_journal_reset    (usersettings_t *self);
+static gsize usersettings_journal_size     (const usersettings_t *self);
 
 /* ------------------------------------------------------------------------- *
  * USERSETTINGS_RETHINK
  * ------------------------------------------------------------------------- */
 
-static void usersettings_rethink(usersettings_t *self);
+static void usersettings_rethink            (usersettings_t *self);
+static void usersettings_rethink_application(usersettings_t *self, const gchar *appname);
 
 /* ------------------------------------------------------------------------- *
  * APPSETTINGS
@@ -216,8 +277,10 @@ static const gchar    *appsettings_appname     (const appsettings_t *self);
  * APPSETTINGS_NOTIFY
  * ------------------------------------------------------------------------- */
 
-static void appsettings_notify_change_ex(appsettings_t *self, bool notify);
-static void appsettings_notify_change   (appsettings_t *self);
+static void         appsettings_notify_change_ex(appsettings_t *self, bool notify);
+static void         appsettings_notify_change   (appsettings_t *self, app_change_t change);
+static app_change_t appsettings_take_changes    (appsettings_t *self);
+static bool         appsettings_changes_pending (const appsettings_t *self);
 
 /* ------------------------------------------------------------------------- *
  * APPSETTINGS_PROPERTIES
@@ -228,23 +291,25 @@ static bool               appsettings_update_agreed     (appsettings_t *self, ap
 void                      appsettings_set_agreed        (appsettings_t *self, app_agreed_t agreed);
 static app_mode_t         appsettings_get_current_mode  (const appsettings_t *self);
 static bool               appsettings_update_current_mode(appsettings_t *self, app_mode_t mode);
-static const stringset_t *appsettings_get_permissions   (const appsettings_t *self);
-static int                appsettings_update_permissions(appsettings_t *self, stringset_t *added);
+static const permset_t   *appsettings_get_permissions   (const appsettings_t *self);
+static int                appsettings_update_permissions(appsettings_t *self, permset_t *added);
 static app_grant_t        appsettings_get_autogrant     (const appsettings_t *self);
 static bool               appsettings_update_autogrant  (appsettings_t *self, app_grant_t autogrant);
 app_allowed_t             appsettings_get_allowed       (const appsettings_t *self);
 bool                      appsettings_update_allowed    (appsettings_t *self, app_allowed_t allowed);
 void                      appsettings_set_allowed       (appsettings_t *self, app_allowed_t allowed);
-const stringset_t        *appsettings_get_granted       (appsettings_t *self);
-static bool               appsettings_update_granted    (appsettings_t *self, const stringset_t *granted);
-void                      appsettings_set_granted       (appsettings_t *self, const stringset_t *granted);
+const permset_t          *appsettings_get_granted       (appsettings_t *self);
+static bool               appsettings_update_granted    (appsettings_t *self, const permset_t *granted);
+void                      appsettings_set_granted       (appsettings_t *self, const permset_t *granted);
 
 /* ------------------------------------------------------------------------- *
  * APPSETTINGS_STORAGE
  * ------------------------------------------------------------------------- */
 
-static void appsettings_decode(appsettings_t *self, GKeyFile *file);
-static void appsettings_encode(const appsettings_t *self, GKeyFile *file);
+static void      appsettings_decode       (appsettings_t *self, GKeyFile *file);
+static void      appsettings_encode       (const appsettings_t *self, GKeyFile *file);
+static void      appsettings_decode_record(appsettings_t *self, GVariant *record);
+static GVariant *appsettings_encode_record(const appsettings_t *self);
 
 /* ------------------------------------------------------------------------- *
  * APPSETTINGS_RETHINK
@@ -268,6 +333,10 @@ struct settings_t
     const config_t *stt_config;
     control_t      *stt_control;
     guint           stt_save_id;
+    guint           stt_evict_id;
+    gint64          stt_evict_at;
+    gint64          stt_idle_timeout;
+    guint           stt_resident_limit;
     GHashTable     *stt_users;
     GHashTable     *stt_user_changes;
     migrator_t     *stt_migrator;
@@ -281,15 +350,30 @@ settings_ctor(settings_t *self, const config_t *config, control_t *control)
     self->stt_config       = config;
     self->stt_control      = control;
     self->stt_save_id      = 0;
+    self->stt_evict_id     = 0;
+    self->stt_evict_at     = 0;
     self->stt_users        = g_hash_table_new_full(g_direct_hash,
                                                    g_direct_equal,
                                                    NULL,
                                                    usersettings_delete_cb);
     self->stt_user_changes = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    gint idle_timeout = config_integer(config, SETTINGS_CONFIG_SECTION,
+                                       SETTINGS_KEY_IDLE_TIMEOUT,
+                                       SETTINGS_IDLE_TIMEOUT_DEFAULT);
+    gint resident_limit = config_integer(config, SETTINGS_CONFIG_SECTION,
+                                         SETTINGS_KEY_RESIDENT_LIMIT,
+                                         SETTINGS_RESIDENT_LIMIT_DEFAULT);
+    self->stt_idle_timeout   = MAX(idle_timeout, 0) * (gint64)G_USEC_PER_SEC;
+    self->stt_resident_limit = MAX(resident_limit, 0);
+
     self->stt_migrator     = migrator_create(self);
 
-    /* Get initial state */
-    settings_load_all(self);
+    /* Get initial state. Settings of other users are loaded on demand. */
+    settings_purge_stale_userdata(self);
+    uid_t uid = control_current_user(control);
+    if( settings_valid_user(self, uid) && !control_user_is_guest(control, uid) )
+        settings_load_user(self, uid);
 
     /* Enable notifications */
     self->stt_initialized  = true;
@@ -301,6 +385,11 @@ settings_dtor(settings_t *self)
     log_info("settings() deleted");
     self->stt_initialized  = false;
 
+    /* Do not lose changes made within save delay */
+    settings_cancel_save(self);
+    settings_cancel_evict(self);
+    settings_flush_journals(self);
+
     if( self->stt_users ) {
         g_hash_table_unref(self->stt_users),
             self->stt_users = NULL;
@@ -365,10 +454,41 @@ settings_appsettings(settings_t *self, uid_t uid, const char *app)
     appsettings_t *appsettings = NULL;
     if( settings_valid_user(self, uid) &&
         control_valid_application(settings_control(self), app) )
-        appsettings = settings_add_appsettings(self, uid, app);
+        appsettings = usersettings_add_appsettings(settings_usersettings(self, uid),
+                                                   app);
     return appsettings;
 }
 
+static usersettings_t *
+settings_usersettings(settings_t *self, uid_t uid)
+{
+    /* Load settings on first access. Guest user settings are stored
+     * only volatile (in-memory), so there is nothing to load. */
+    usersettings_t *usersettings = settings_get_usersettings(self, uid);
+    if( usersettings )
+        usersettings_touch(usersettings);
+    else if( control_user_is_guest(settings_control(self), uid) )
+        usersettings = settings_add_usersettings(self, uid);
+    else {
+        settings_load_user(self, uid);
+        usersettings = settings_add_usersettings(self, uid);
+    }
+    return usersettings;
+}
+
+/** Make sure settings of a user are in memory
+ *
+ * @param self  settings object
+ * @param uid   user id
+ *
+ * @return true if user is valid and settings are available
+ */
+bool
+settings_preload_user(settings_t *self, uid_t uid)
+{
+    return settings_valid_user(self, uid) && settings_usersettings(self, uid);
+}
+
 static migrator_t *
 settings_migrator(const settings_t *self)
 {
@@ -399,7 +519,11 @@ settings_add_usersettings(settings_t *self, uid_t uid)
         usersettings = usersettings_create(self, uid);
         g_hash_table_insert(self->stt_users, GINT_TO_POINTER(uid),
                             usersettings);
+
+        /* Check residency limits after the current operation */
+        settings_schedule_evict(self, 0);
     }
+    usersettings_touch(usersettings);
     return usersettings;
 }
 
@@ -440,6 +564,36 @@ settings_remove_appsettings(settings_t *self, uid_t uid, const char *appname)
     return removed;
 }
 
+/** Get and clear per user changes made to application settings
+ *
+ * @param self     settings object
+ * @param appname  application name
+ *
+ * @return floating a(uu) variant with uid and app_change_t mask for
+ *         each user whose settings have changed
+ */
+GVariant *
+settings_take_changes(settings_t *self, const char *appname)
+{
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(uu)"));
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, self->stt_users);
+    while( g_hash_table_iter_next(&iter, &key, &value) ) {
+        appsettings_t *appsettings = usersettings_get_appsettings(value, appname);
+        app_change_t   changes     = appsettings_take_changes(appsettings);
+        if( changes ) {
+            g_variant_builder_add(&builder, "(uu)",
+                                  (guint32)GPOINTER_TO_INT(key),
+                                  (guint32)changes);
+        }
+    }
+
+    return g_variant_builder_end(&builder);
+}
+
 /* ------------------------------------------------------------------------- *
  * SETTINGS_STORAGE
  * ------------------------------------------------------------------------- */
@@ -448,23 +602,33 @@ void
 settings_load_all(settings_t *self)
 {
     control_t *control = settings_control(self);
-    uid_t min_uid = control_min_user(control);
-    uid_t max_uid = control_max_user(control);
+    GList     *users   = control_user_list(control);
 
-    for( uid_t uid = min_uid; uid <= max_uid; ++uid )
-        settings_load_user(self, uid);
+    /* Guest user settings are stored only volatile (in-memory) */
+    for( GList *iter = users; iter; iter = iter->next ) {
+        uid_t uid = GPOINTER_TO_UINT(iter->data);
+        if( !control_user_is_guest(control, uid) )
+            settings_load_user(self, uid);
+    }
+    g_list_free(users);
+
+    settings_purge_stale_userdata(self);
 }
 
 void
 settings_save_all(const settings_t *self)
 {
     control_t *control = settings_control(self);
-    uid_t min_uid = control_min_user(control);
-    uid_t max_uid = control_max_user(control);
 
     /* Save settings for all but guest user */
-    for( uid_t uid = min_uid; uid <= max_uid; ++uid )
-        settings_save_user(self, uid);
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, self->stt_users);
+    while( g_hash_table_iter_next(&iter, &key, &value) ) {
+        uid_t uid = GPOINTER_TO_UINT(key);
+        if( !control_user_is_guest(control, uid) )
+            settings_save_user(self, uid);
+    }
 }
 
 void
@@ -474,6 +638,13 @@ settings_load_user(settings_t *self, uid_t uid)
         gchar *path = settings_userdata_path(uid);
         usersettings_t *usersettings = settings_add_usersettings(self, uid);
         usersettings_load(usersettings, path);
+        if( usersettings_journal_replay(usersettings) ) {
+            /* Fold replayed changes into settings file */
+            settings_save_later(self, uid);
+        }
+        /* Stored data can predate application / permission changes
+         * that were handled while settings were not in memory */
+        usersettings_rethink(usersettings);
         g_free(path);
     }
     else {
@@ -488,20 +659,44 @@ settings_save_user(const settings_t *self, uid_t uid)
     if( settings_valid_user(self, uid) ) {
         gchar *path = settings_userdata_path(uid);
         usersettings_t *usersettings = settings_get_usersettings(self, uid);
-        if( usersettings )
-            usersettings_save(usersettings, path);
+        if( usersettings ) {
+            /* Journal must not hold data older than settings file */
+            usersettings_journal_flush(usersettings);
+            if( usersettings_save(usersettings, path) )
+                usersettings_journal_reset(usersettings);
+        }
         g_free(path);
     }
 }
 
+static void
+settings_flush_journals(settings_t *self)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init(&iter, self->stt_users);
+    while( g_hash_table_iter_next(&iter, &key, &value) ) {
+        usersettings_journal_flush(value);
+
+        /* Schedule compaction of grown journals */
+        if( usersettings_journal_size(value) > SETTINGS_JOURNAL_LIMIT )
+            g_hash_table_add(self->stt_user_changes, key);
+    }
+}
+
 static void
 settings_save_now(settings_t *self)
 {
     settings_cancel_save(self);
 
+    /* Append changed application settings to journals */
+    settings_flush_journals(self);
+
     GHashTableIter iter;
     gpointer key, value;
 
+    /* Compact journals into settings files */
     g_hash_table_iter_init(&iter, self->stt_user_changes);
     while( g_hash_table_iter_next(&iter, &key, &value) ) {
         uid_t uid = GPOINTER_TO_UINT(key);
@@ -531,16 +726,21 @@ settings_cancel_save(settings_t *self)
     }
 }
 
+static void
+settings_schedule_save(settings_t *self)
+{
+    if( !self->stt_save_id ) {
+        self->stt_save_id = g_timeout_add(1000, settings_save_cb, self);
+    }
+}
+
 void
 settings_save_later(settings_t *self, uid_t uid)
 {
     /* Guest user settings are stored only volatile (in-memory) */
     if( !control_user_is_guest(settings_control(self), uid) ) {
         g_hash_table_add(self->stt_user_changes, GINT_TO_POINTER(uid));
-
-        if( !self->stt_save_id ) {
-            self->stt_save_id = g_timeout_add(1000, settings_save_cb, self);
-        }
+        settings_schedule_save(self);
     }
 }
 
@@ -577,6 +777,208 @@ settings_rethink(settings_t *self)
     }
 }
 
+/** Re-evaluate settings of given applications for all users
+ *
+ * Unlike settings_rethink(), stale users are left to be
+ * purged during the next full rethink.
+ *
+ * @param self  settings object
+ * @param apps  names of changed applications
+ */
+void
+settings_rethink_applications(settings_t *self, const stringset_t *apps)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, self->stt_users);
+    while( g_hash_table_iter_next(&iter, &key, &value) ) {
+        if( !settings_valid_user(self, usersettings_uid(value)) )
+            continue;
+        for( const GList *item = stringset_list(apps); item; item = item->next )
+            usersettings_rethink_application(value, item->data);
+    }
+}
+
+/** Update settings after users have been added or removed
+ *
+ * Settings of other users are left as they are.
+ *
+ * @param self     settings object
+ * @param added    set of GUINT_TO_POINTER() uids that were added
+ * @param removed  set of GUINT_TO_POINTER() uids that were removed
+ */
+void
+settings_rethink_users(settings_t *self, GHashTable *added,
+                       GHashTable *removed)
+{
+    control_t *control = settings_control(self);
+
+    GHashTableIter iter;
+    gpointer key;
+
+    g_hash_table_iter_init(&iter, removed);
+    while( g_hash_table_iter_next(&iter, &key, NULL) ) {
+        uid_t uid = GPOINTER_TO_UINT(key);
+        if( settings_valid_user(self, uid) )
+            continue;
+        g_hash_table_remove(self->stt_user_changes, key);
+        settings_remove_usersettings(self, uid);
+        settings_remove_stale_userdata(uid);
+    }
+
+    /* Settings of other users are loaded on first access, and
+     * guest user settings follow guest session instead */
+    g_hash_table_iter_init(&iter, added);
+    while( g_hash_table_iter_next(&iter, &key, NULL) ) {
+        uid_t uid = GPOINTER_TO_UINT(key);
+        if( uid == control_current_user(control) &&
+            !control_user_is_guest(control, uid) )
+            settings_load_user(self, uid);
+    }
+}
+
+/* ------------------------------------------------------------------------- *
+ * SETTINGS_RESIDENCY
+ * ------------------------------------------------------------------------- */
+
+/** Get number of application settings entries currently in memory
+ *
+ * @param self  settings object
+ *
+ * @return number of entries over all loaded users
+ */
+guint
+settings_resident_count(const settings_t *self)
+{
+    guint count = 0;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, self->stt_users);
+    while( g_hash_table_iter_next(&iter, &key, &value) ) {
+        count += usersettings_app_count(value);
+    }
+    return count;
+}
+
+static bool
+settings_user_pinned(const settings_t *self, const usersettings_t *usersettings)
+{
+    /* Session user settings are needed for every launch, guest user
+     * settings exist only in memory, and changes not yet broadcast
+     * would be lost.
+     */
+    control_t *control = settings_control(self);
+    uid_t      uid     = usersettings_uid(usersettings);
+    return (uid == control_current_user(control) ||
+            control_user_is_guest(control, uid) ||
+            usersettings_changes_pending(usersettings));
+}
+
+static void
+settings_evict_user(settings_t *self, uid_t uid)
+{
+    usersettings_t *usersettings = settings_get_usersettings(self, uid);
+    if( usersettings ) {
+        log_info("usersettings(%d) evicted", (int)uid);
+
+        /* Everything not in settings file must be in journal */
+        if( g_hash_table_remove(self->stt_user_changes, GINT_TO_POINTER(uid)) )
+            settings_save_user(self, uid);
+        else
+            usersettings_journal_flush(usersettings);
+
+        settings_remove_usersettings(self, uid);
+    }
+}
+
+/** Drop settings of inactive users from memory
+ *
+ * Users that have been idle longer than configured are evicted, and
+ * then least recently used ones until resident limit is satisfied.
+ * Evicted users are loaded again when accessed.
+ *
+ * @param self  settings object
+ */
+void
+settings_evict_now(settings_t *self)
+{
+    settings_cancel_evict(self);
+
+    gint64  now       = g_get_monotonic_time();
+    guint   resident  = settings_resident_count(self);
+    GList  *evictable = NULL;
+
+    auto gint oldest_first(gconstpointer a, gconstpointer b) {
+        gint64 at_a = usersettings_accessed(a);
+        gint64 at_b = usersettings_accessed(b);
+        return (at_a > at_b) - (at_a < at_b);
+    }
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, self->stt_users);
+    while( g_hash_table_iter_next(&iter, &key, &value) ) {
+        if( !settings_user_pinned(self, value) )
+            evictable = g_list_prepend(evictable, value);
+    }
+    evictable = g_list_sort(evictable, oldest_first);
+
+    gint64 next = 0;
+    for( GList *item = evictable; item; item = item->next ) {
+        usersettings_t *usersettings = item->data;
+        gint64 idle = now - usersettings_accessed(usersettings);
+        bool expired = self->stt_idle_timeout > 0 && idle >= self->stt_idle_timeout;
+        bool over = self->stt_resident_limit > 0 && resident > self->stt_resident_limit;
+        if( expired || over ) {
+            resident -= usersettings_app_count(usersettings);
+            settings_evict_user(self, usersettings_uid(usersettings));
+        }
+        else {
+            /* Oldest remaining user determines when to check again */
+            if( self->stt_idle_timeout > 0 )
+                next = self->stt_idle_timeout - idle;
+            break;
+        }
+    }
+    g_list_free(evictable);
+
+    if( next > 0 )
+        settings_schedule_evict(self, next);
+}
+
+static gboolean
+settings_evict_cb(gpointer aptr)
+{
+    settings_t *self = aptr;
+    self->stt_evict_id = 0;
+    settings_evict_now(self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+settings_schedule_evict(settings_t *self, gint64 delay)
+{
+    if( !self->stt_idle_timeout && !self->stt_resident_limit )
+        return;
+
+    /* Keep the earliest of already scheduled and requested check */
+    gint64 at = g_get_monotonic_time() + delay;
+    if( self->stt_evict_id && self->stt_evict_at <= at )
+        return;
+    settings_cancel_evict(self);
+    self->stt_evict_at = at;
+    self->stt_evict_id = g_timeout_add(delay / 1000, settings_evict_cb, self);
+}
+
+static void
+settings_cancel_evict(settings_t *self)
+{
+    if( self->stt_evict_id ) {
+        g_source_remove(self->stt_evict_id),
+            self->stt_evict_id = 0;
+    }
+}
+
 /* ------------------------------------------------------------------------- *
  * SETTINGS_UTILITY
  * ------------------------------------------------------------------------- */
@@ -588,13 +990,70 @@ settings_userdata_path(uid_t uid)
                            (unsigned)uid);
 }
 
+static gchar *
+settings_journal_path(uid_t uid)
+{
+    return g_strdup_printf(SETTINGS_DIRECTORY "/user-%u" SETTINGS_JOURNAL_EXTENSION,
+                           (unsigned)uid);
+}
+
 static void
 settings_remove_stale_userdata(uid_t uid)
 {
-    gchar *path = settings_userdata_path(uid);
-    if( unlink(path) == -1 && errno != ENOENT )
-        log_err("%s: could not remove: %m", path);
-    g_free(path);
+    gchar *paths[] = {
+        settings_userdata_path(uid),
+        settings_journal_path(uid),
+    };
+    for( size_t i = 0; i < G_N_ELEMENTS(paths); ++i ) {
+        if( unlink(paths[i]) == -1 && errno != ENOENT )
+            log_err("%s: could not remove: %m", paths[i]);
+        g_free(paths[i]);
+    }
+}
+
+static void
+settings_purge_stale_userdata(settings_t *self)
+{
+    /* Settings of users that were removed while sailjaild was not running.
+     * Cost depends on number of settings files, not size of the uid range.
+     */
+    control_t  *control = settings_control(self);
+    uid_t       min_uid = control_min_user(control);
+    uid_t       max_uid = control_max_user(control);
+    GHashTable *stale   = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GDir       *dir     = g_dir_open(SETTINGS_DIRECTORY, 0, NULL);
+
+    const gchar *name;
+    while( dir && (name = g_dir_read_name(dir)) ) {
+        if( strncmp(name, "user-", 5) )
+            continue;
+
+        gchar   *end = NULL;
+        guint64  uid = g_ascii_strtoull(name + 5, &end, 10);
+        if( end == name + 5 ||
+            (strcmp(end, SETTINGS_EXTENSION) &&
+             strcmp(end, SETTINGS_JOURNAL_EXTENSION)) )
+            continue;
+
+        if( uid < min_uid || uid > max_uid )
+            continue;
+
+        if( !settings_valid_user(self, (uid_t)uid) )
+            g_hash_table_add(stale, GUINT_TO_POINTER((guint)uid));
+    }
+
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, stale);
+    while( g_hash_table_iter_next(&iter, &key, NULL) ) {
+        uid_t uid = GPOINTER_TO_UINT(key);
+        settings_remove_usersettings(self, uid);
+        settings_remove_stale_userdata(uid);
+    }
+
+    if( dir )
+        g_dir_close(dir);
+    g_hash_table_unref(stale);
 }
 
 static bool
@@ -609,9 +1068,12 @@ settings_valid_user(const settings_t *self, uid_t uid)
 
 struct usersettings_t
 {
-    settings_t *ust_settings;
-    uid_t       ust_uid;
-    GHashTable *ust_apps;
+    settings_t  *ust_settings;
+    uid_t        ust_uid;
+    GHashTable  *ust_apps;
+    journal_t   *ust_journal;
+    stringset_t *ust_journal_apps; // changed, but not yet journaled
+    gint64       ust_accessed;     // monotonic time of last access
 };
 
 static void
@@ -621,8 +1083,13 @@ usersettings_ctor(usersettings_t *self, settings_t *settings, uid_t uid)
     self->ust_uid      = uid;
     self->ust_apps     = g_hash_table_new_full(g_str_hash,
                                                g_str_equal,
-                                               g_free,
+                                               intern_release_cb,
                                                appsettings_delete_cb);
+    gchar *path = settings_journal_path(uid);
+    self->ust_journal      = journal_create(path, SETTINGS_JOURNAL_RECORD);
+    self->ust_journal_apps = stringset_create();
+    self->ust_accessed     = g_get_monotonic_time();
+    g_free(path);
     log_info("usersettings(%d) created", (int)usersettings_uid(self));
 }
 
@@ -634,6 +1101,8 @@ usersettings_dtor(usersettings_t *self)
         g_hash_table_unref(self->ust_apps),
             self->ust_apps = NULL;
     }
+    journal_delete_at(&self->ust_journal);
+    stringset_delete_at(&self->ust_journal_apps);
 }
 
 usersettings_t *
@@ -687,6 +1156,37 @@ usersettings_control(const usersettings_t *self)
     return settings_control(usersettings_settings(self));
 }
 
+static guint
+usersettings_app_count(const usersettings_t *self)
+{
+    return g_hash_table_size(self->ust_apps);
+}
+
+static gint64
+usersettings_accessed(const usersettings_t *self)
+{
+    return self->ust_accessed;
+}
+
+static void
+usersettings_touch(usersettings_t *self)
+{
+    self->ust_accessed = g_get_monotonic_time();
+}
+
+static bool
+usersettings_changes_pending(const usersettings_t *self)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, self->ust_apps);
+    while( g_hash_table_iter_next(&iter, &key, &value) ) {
+        if( appsettings_changes_pending(value) )
+            return true;
+    }
+    return false;
+}
+
 /* ------------------------------------------------------------------------- *
  * USERSETTINGS_APPSETTINGS
  * ------------------------------------------------------------------------- */
@@ -704,7 +1204,8 @@ usersettings_add_appsettings_ex(usersettings_t *self, const gchar *appname,
     appsettings_t *appsettings = usersettings_get_appsettings(self, appname);
     if( !appsettings ) {
         appsettings = appsettings_create(self, appname);
-        g_hash_table_insert(self->ust_apps, g_strdup(appname), appsettings);
+        g_hash_table_insert(self->ust_apps,
+                            (gpointer)intern_acquire(appname), appsettings);
         if( rethink )
             appsettings_rethink(appsettings);
     }
@@ -756,7 +1257,7 @@ usersettings_load(usersettings_t *self, const char *path)
     }
 }
 
-void
+bool
 usersettings_save(const usersettings_t *self, const char *path)
 {
     GKeyFile *file = g_key_file_new();
@@ -773,8 +1274,73 @@ usersettings_save(const usersettings_t *self, const char *path)
             g_hash_table_iter_remove(&iter);
         }
     }
-    keyfile_save(file, path);
+    bool saved = keyfile_save(file, path);
     g_key_file_unref(file);
+    return saved;
+}
+
+/* ------------------------------------------------------------------------- *
+ * USERSETTINGS_JOURNAL
+ * ------------------------------------------------------------------------- */
+
+static void
+usersettings_journal_later(usersettings_t *self, const gchar *appname)
+{
+    /* Guest user settings are stored only volatile (in-memory) */
+    if( !control_user_is_guest(usersettings_control(self),
+                               usersettings_uid(self)) ) {
+        stringset_add_item(self->ust_journal_apps, appname);
+        settings_schedule_save(usersettings_settings(self));
+    }
+}
+
+static bool
+usersettings_journal_flush(usersettings_t *self)
+{
+    for( const GList *iter = stringset_list(self->ust_journal_apps);
+         iter; iter = iter->next ) {
+        appsettings_t *appsettings = usersettings_get_appsettings(self,
+                                                                  iter->data);
+        if( appsettings )
+            journal_append(self->ust_journal,
+                           appsettings_encode_record(appsettings));
+    }
+    stringset_clear(self->ust_journal_apps);
+    return journal_sync(self->ust_journal);
+}
+
+static void
+usersettings_journal_replay_cb(GVariant *record, gpointer aptr)
+{
+    usersettings_t *self    = aptr;
+    const gchar    *appname = NULL;
+
+    g_variant_get_child(record, 0, "&s", &appname);
+    if( control_valid_application(usersettings_control(self), appname) ) {
+        appsettings_t *appsettings =
+            usersettings_add_appsettings_ex(self, appname, false);
+        appsettings_decode_record(appsettings, record);
+    }
+}
+
+static guint
+usersettings_journal_replay(usersettings_t *self)
+{
+    return journal_replay(self->ust_journal,
+                          usersettings_journal_replay_cb, self);
+}
+
+static bool
+usersettings_journal_reset(usersettings_t *self)
+{
+    stringset_clear(self->ust_journal_apps);
+    return journal_reset(self->ust_journal);
+}
+
+static gsize
+usersettings_journal_size(const usersettings_t *self)
+{
+    return journal_size(self->ust_journal);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -798,6 +1364,22 @@ usersettings_rethink(usersettings_t *self)
     }
 }
 
+static void
+usersettings_rethink_application(usersettings_t *self, const gchar *appname)
+{
+    appsettings_t *appsettings = usersettings_get_appsettings(self, appname);
+    if( !appsettings ) {
+        /* Nothing to do */
+    }
+    else if( control_valid_application(usersettings_control(self), appname) ) {
+        appsettings_rethink(appsettings);
+    }
+    else {
+        usersettings_remove_appsettings(self, appname);
+        settings_save_later(usersettings_settings(self), usersettings_uid(self));
+    }
+}
+
 /* ========================================================================= *
  * APPSETTINGS
  * ========================================================================= */
@@ -805,14 +1387,15 @@ usersettings_rethink(usersettings_t *self)
 struct appsettings_t
 {
     usersettings_t *ast_usersettings;
-    gchar          *ast_appname;
+    const gchar    *ast_appname; // interned
 
     app_allowed_t   ast_allowed;
     app_grant_t     ast_autogrant;
     app_agreed_t    ast_agreed;
     app_mode_t      ast_mode;
-    stringset_t    *ast_granted;
-    stringset_t    *ast_permissions;
+    permset_t       ast_granted;
+    permset_t       ast_permissions;
+    app_change_t    ast_changes;  // not yet broadcast changes
 };
 
 static void
@@ -820,21 +1403,23 @@ appsettings_ctor(appsettings_t *self, usersettings_t *usersettings,
                  const char *appname)
 {
     self->ast_usersettings = usersettings;
-    self->ast_appname      = g_strdup(appname);
+    self->ast_appname      = intern_acquire(appname);
 
     self->ast_allowed      = APP_ALLOWED_UNSET;
     self->ast_autogrant    = APP_GRANT_DEFAULT;
     self->ast_agreed       = APP_AGREED_UNSET;
     self->ast_mode         = APP_MODE_NORMAL;
-    self->ast_granted      = stringset_create();
-    self->ast_permissions  = stringset_create();
+    permset_init(&self->ast_granted);
+    permset_init(&self->ast_permissions);
+    self->ast_changes      = 0;
 
     log_info("appsettings(%d, %s) created",
              (int)usersettings_uid(appsettings_usersettings(self)),
              appsettings_appname(self));
 
-    /* Evaluate derived values to ensure sane initial state */
-    appsettings_rethink(self);
+    /* Note: Derived values are evaluated by the caller - either
+     *       directly, or after stored settings have been decoded.
+     */
 }
 
 static void
@@ -844,9 +1429,7 @@ appsettings_dtor(appsettings_t *self)
              (int)usersettings_uid(appsettings_usersettings(self)),
              appsettings_appname(self));
 
-    change_string(&self->ast_appname, NULL);
-    stringset_delete_at(&self->ast_granted);
-    stringset_delete_at(&self->ast_permissions);
+    intern_release_at(&self->ast_appname);
 }
 
 appsettings_t *
@@ -924,17 +1507,38 @@ appsettings_notify_change_ex(appsettings_t *self, bool notify)
         control_on_settings_change(appsettings_control(self),
                                    appsettings_appname(self));
 
-    /* Schedule user settings saving */
-    settings_save_later(appsettings_settings(self),
-                        appsettings_uid(self));
+    /* Schedule journaling of application settings */
+    usersettings_journal_later(appsettings_usersettings(self),
+                               appsettings_appname(self));
 }
 
 static void
-appsettings_notify_change(appsettings_t *self)
+appsettings_notify_change(appsettings_t *self, app_change_t change)
 {
+    /* Remember what changed until the next broadcast */
+    if( settings_initialized(appsettings_settings(self)) )
+        self->ast_changes |= change;
+
     appsettings_notify_change_ex(self, true);
 }
 
+static app_change_t
+appsettings_take_changes(appsettings_t *self)
+{
+    app_change_t changes = 0;
+    if( self ) {
+        changes = self->ast_changes;
+        self->ast_changes = 0;
+    }
+    return changes;
+}
+
+static bool
+appsettings_changes_pending(const appsettings_t *self)
+{
+    return self && self->ast_changes != 0;
+}
+
 /* ------------------------------------------------------------------------- *
  * APPSETTINGS_PROPERTIES
  * ------------------------------------------------------------------------- */
@@ -965,7 +1569,7 @@ appsettings_update_agreed(appsettings_t *self, app_agreed_t agreed)
     }
 
     if( changed )
-        appsettings_notify_change(self);
+        appsettings_notify_change(self, APP_CHANGE_AGREED);
 
     return changed;
 }
@@ -1014,39 +1618,39 @@ appsettings_update_current_mode(appsettings_t *self, app_mode_t mode)
     return changed;
 }
 
-static const stringset_t *
+static const permset_t *
 appsettings_get_permissions(const appsettings_t *self)
 {
-    return self->ast_permissions;
+    return &self->ast_permissions;
 }
 
 static int
-appsettings_update_permissions(appsettings_t *self, stringset_t *added)
+appsettings_update_permissions(appsettings_t *self, permset_t *added)
 {
     int change = 0; // no change == 0; new perms > 0; other change < 0
 
-    const stringset_t *permissions = NULL;
-    stringset_t *none = NULL;
+    const permset_t *permissions = NULL;
+    permset_t none;
 
     appinfo_t *appinfo = control_appinfo(appsettings_control(self),
                                          appsettings_appname(self));
     if( appinfo )
         permissions = appinfo_get_permissions(appinfo);
 
-    if( !permissions )
-        permissions = none = stringset_create();
+    if( !permissions ) {
+        permset_init(&none);
+        permissions = &none;
+    }
 
-    if( !stringset_equal(self->ast_permissions, permissions) ) {
-        stringset_t *temp = stringset_filter_out(permissions,
-                                                 self->ast_permissions);
-        stringset_assign(added, temp);
-        stringset_delete(temp);
+    if( !permset_equal(&self->ast_permissions, permissions) ) {
+        permset_assign(added, permissions);
+        permset_unmask(added, &self->ast_permissions);
 
-        change = stringset_empty(added) ? -1 : +1;
+        change = permset_empty(added) ? -1 : +1;
 
         if( log_p(LOG_INFO) ) {
-            gchar *prev = stringset_to_string(self->ast_permissions);
-            gchar *curr = stringset_to_string(permissions);
+            gchar *prev = permset_to_string(&self->ast_permissions);
+            gchar *curr = permset_to_string(permissions);
             log_info("%s(uid=%d): permissions: %s -> %s%s",
                      appsettings_appname(self),
                      appsettings_uid(self),
@@ -1055,15 +1659,14 @@ appsettings_update_permissions(appsettings_t *self, stringset_t *added)
             g_free(prev);
             g_free(curr);
         }
-        stringset_assign(self->ast_permissions, permissions);
+        permset_assign(&self->ast_permissions, permissions);
     }
 
-    /* Note: "permission" is internal cache -> no D-Bus notifications */
-    if( change )
-        appsettings_notify_change_ex(self, false);
-
-    stringset_delete(none);
-
+    /* Note: "permission" is internal cache -> no D-Bus notifications,
+     *       and it is not journaled either: changes in derived values
+     *       are, and re-evaluating stale data after load yields the
+     *       same result.
+     */
     return change;
 }
 
@@ -1133,7 +1736,7 @@ appsettings_update_allowed(appsettings_t *self, app_allowed_t allowed)
     }
 
     if( changed )
-        appsettings_notify_change(self);
+        appsettings_notify_change(self, APP_CHANGE_ALLOWED);
 
     return changed;
 }
@@ -1145,14 +1748,14 @@ appsettings_set_allowed(appsettings_t *self, app_allowed_t allowed)
         appsettings_update_granted(self, appsettings_get_permissions(self));
 }
 
-const stringset_t *
+const permset_t *
 appsettings_get_granted(appsettings_t *self)
 {
-    return self->ast_granted;
+    return &self->ast_granted;
 }
 
 static bool
-appsettings_update_granted(appsettings_t *self, const stringset_t *granted)
+appsettings_update_granted(appsettings_t *self, const permset_t *granted)
 {
     /* Note: This must be kept so that it works also when
      *       'granted' arg is actually the current value,
@@ -1162,22 +1765,21 @@ appsettings_update_granted(appsettings_t *self, const stringset_t *granted)
 
     bool changed = false;
 
-    stringset_t *none = NULL;
+    permset_t effective;
+    permset_init(&effective);
 
     if( appsettings_get_allowed(self) != APP_ALLOWED_ALWAYS )
         granted = NULL;
 
-    if( !granted )
-        granted = none = stringset_create();
-
-    const stringset_t *permissions = appsettings_get_permissions(self);
-
-    stringset_t *effective = stringset_filter_in(granted, permissions);
+    if( granted ) {
+        permset_assign(&effective, granted);
+        permset_mask(&effective, appsettings_get_permissions(self));
+    }
 
-    if( !stringset_equal(self->ast_granted, effective) ) {
+    if( !permset_equal(&self->ast_granted, &effective) ) {
         if( log_p(LOG_INFO) ) {
-            gchar *prev = stringset_to_string(self->ast_granted);
-            gchar *curr = stringset_to_string(effective);
+            gchar *prev = permset_to_string(&self->ast_granted);
+            gchar *curr = permset_to_string(&effective);
             log_info("%s(uid=%d): granted: %s -> %s",
                      appsettings_appname(self),
                      appsettings_uid(self),
@@ -1185,19 +1787,17 @@ appsettings_update_granted(appsettings_t *self, const stringset_t *granted)
             g_free(prev);
             g_free(curr);
         }
-        changed = stringset_assign(self->ast_granted, effective);
+        changed = permset_assign(&self->ast_granted, &effective);
     }
-    stringset_delete(effective);
-    stringset_delete(none);
 
     if( changed )
-        appsettings_notify_change(self);
+        appsettings_notify_change(self, APP_CHANGE_GRANTED);
 
     return changed;
 }
 
 void
-appsettings_set_granted(appsettings_t *self, const stringset_t *granted)
+appsettings_set_granted(appsettings_t *self, const permset_t *granted)
 {
     appsettings_update_granted(self, granted);
 }
@@ -1229,11 +1829,13 @@ appsettings_decode(appsettings_t *self, GKeyFile *file)
         self->ast_mode = APP_MODE_NORMAL;
     }
 
-    stringset_delete_at(&self->ast_permissions);
-    self->ast_permissions = keyfile_get_stringset(file, sec, "Permissions");
+    stringset_t *permissions = keyfile_get_stringset(file, sec, "Permissions");
+    permset_from_stringset(&self->ast_permissions, permissions);
+    stringset_delete(permissions);
 
-    stringset_delete_at(&self->ast_granted);
-    self->ast_granted = keyfile_get_stringset(file, sec, "Granted");
+    stringset_t *granted = keyfile_get_stringset(file, sec, "Granted");
+    permset_from_stringset(&self->ast_granted, granted);
+    stringset_delete(granted);
 
     /* Re-evaluate values that depend on each other */
     appsettings_rethink(self);
@@ -1247,8 +1849,63 @@ appsettings_encode(const appsettings_t *self, GKeyFile *file)
     keyfile_set_integer(file, sec, "Agreed", self->ast_agreed);
     keyfile_set_integer(file, sec, "Autogrant", self->ast_autogrant);
     keyfile_set_integer(file, sec, "Mode", self->ast_mode);
-    keyfile_set_stringset(file, sec, "Granted", self->ast_granted);
-    keyfile_set_stringset(file, sec, "Permissions", self->ast_permissions);
+
+    stringset_t *granted = permset_to_stringset(&self->ast_granted);
+    keyfile_set_stringset(file, sec, "Granted", granted);
+    stringset_delete(granted);
+
+    stringset_t *permissions = permset_to_stringset(&self->ast_permissions);
+    keyfile_set_stringset(file, sec, "Permissions", permissions);
+    stringset_delete(permissions);
+}
+
+static void
+appsettings_decode_record(appsettings_t *self, GVariant *record)
+{
+    /* Read values as-is, see appsettings_decode() */
+    gint32   allowed     = APP_ALLOWED_UNSET;
+    gint32   agreed      = APP_AGREED_UNSET;
+    gint32   autogrant   = APP_GRANT_DEFAULT;
+    gint32   mode        = APP_MODE_NORMAL;
+    gchar  **granted     = NULL;
+    gchar  **permissions = NULL;
+
+    g_variant_get(record, "(&siiii^as^as)", NULL,
+                  &allowed, &agreed, &autogrant, &mode,
+                  &granted, &permissions);
+
+    self->ast_allowed   = allowed;
+    self->ast_agreed    = agreed;
+    self->ast_autogrant = autogrant;
+    self->ast_mode      = mode;
+
+    permset_from_strv(&self->ast_permissions, permissions);
+    permset_from_strv(&self->ast_granted, granted);
+
+    g_strfreev(granted);
+    g_strfreev(permissions);
+
+    /* Re-evaluate values that depend on each other */
+    appsettings_rethink(self);
+}
+
+static GVariant *
+appsettings_encode_record(const appsettings_t *self)
+{
+    gchar **granted     = permset_to_strv(&self->ast_granted);
+    gchar **permissions = permset_to_strv(&self->ast_permissions);
+
+    GVariant *record = g_variant_new("(siiii^as^as)",
+                                     appsettings_appname(self),
+                                     self->ast_allowed,
+                                     self->ast_agreed,
+                                     self->ast_autogrant,
+                                     self->ast_mode,
+                                     granted,
+                                     permissions);
+    g_strfreev(granted);
+    g_strfreev(permissions);
+    return record;
 }
 
 /* ------------------------------------------------------------------------- *
@@ -1262,13 +1919,14 @@ appsettings_rethink(appsettings_t *self)
              appsettings_appname(self),
              appsettings_uid(self));
 
-    stringset_t *added = stringset_create();
-    int permission_change = appsettings_update_permissions(self, added);
+    permset_t added;
+    permset_init(&added);
+    int permission_change = appsettings_update_permissions(self, &added);
     bool mode_change =
         appsettings_update_current_mode(self, appsettings_get_current_mode(self));
 
-    const stringset_t *permissions = appsettings_get_permissions(self);
-    const stringset_t *granted = appsettings_get_granted(self);
+    const permset_t *permissions = appsettings_get_permissions(self);
+    const permset_t *granted = appsettings_get_granted(self);
 
     if( mode_change ) {
         if( appsettings_get_allowed(self) != APP_ALLOWED_NEVER )
@@ -1292,8 +1950,8 @@ appsettings_rethink(appsettings_t *self)
         case APP_GRANT_LAUNCH:
             /* Automatically grant just added permissions */
             if( permission_change > 0 ) {
-                stringset_extend(added, granted);
-                granted = added;
+                permset_extend(&added, granted);
+                granted = &added;
             }
             break;
         default:
@@ -1307,8 +1965,6 @@ appsettings_rethink(appsettings_t *self)
 
     /* Re-evaluate granted list */
     appsettings_update_granted(self, granted);
-
-    stringset_delete(added);
 }
 
 /* ------------------------------------------------------------------------- *
@@ -52,6 +52,7 @@ typedef struct usersettings_t usersettings_t;
 typedef struct appsettings_t  appsettings_t;
 typedef struct control_t      control_t;
 typedef struct stringset_t    stringset_t;
+typedef struct permset_t      permset_t;
 typedef struct migrator_t     migrator_t;
 
 typedef enum
@@ -97,8 +98,9 @@ void        settings_delete_cb(void *self);
  * SETTINGS_ATTRIBUTES
  * ------------------------------------------------------------------------- */
 
-control_t     *settings_control    (const settings_t *self);
-appsettings_t *settings_appsettings(settings_t *self, uid_t uid, const char *app);
+control_t     *settings_control     (const settings_t *self);
+appsettings_t *settings_appsettings (settings_t *self, uid_t uid, const char *app);
+bool           settings_preload_user(settings_t *self, uid_t uid);
 
 /* ------------------------------------------------------------------------- *
  * SETTINGS_USERSETTINGS
@@ -115,6 +117,7 @@ bool            settings_remove_usersettings(settings_t *self, uid_t uid);
 appsettings_t *settings_get_appsettings   (const settings_t *self, uid_t uid, const char *appname);
 appsettings_t *settings_add_appsettings   (settings_t *self, uid_t uid, const char *appname);
 bool           settings_remove_appsettings(settings_t *self, uid_t uid, const char *appname);
+GVariant      *settings_take_changes      (settings_t *self, const char *appname);
 
 /* ------------------------------------------------------------------------- *
  * SETTINGS_STORAGE
@@ -136,7 +139,16 @@ void settings_on_migration_finished(settings_t *self);
  * SETTINGS_RETHINK
  * ------------------------------------------------------------------------- */
 
-void settings_rethink(settings_t *self);
+void settings_rethink             (settings_t *self);
+void settings_rethink_applications(settings_t *self, const stringset_t *apps);
+void settings_rethink_users       (settings_t *self, GHashTable *added, GHashTable *removed);
+
+/* ------------------------------------------------------------------------- *
+ * SETTINGS_RESIDENCY
+ * ------------------------------------------------------------------------- */
+
+guint settings_resident_count(const settings_t *self);
+void  settings_evict_now     (settings_t *self);
 
 /* ------------------------------------------------------------------------- *
  * USERSETTINGS
@@ -159,7 +171,7 @@ bool           usersettings_remove_appsettings(usersettings_t *self, const gchar
  * ------------------------------------------------------------------------- */
 
 void usersettings_load(usersettings_t *self, const char *path);
-void usersettings_save(const usersettings_t *self, const char *path);
+bool usersettings_save(const usersettings_t *self, const char *path);
 
 /* ------------------------------------------------------------------------- *
  * APPSETTINGS
@@ -178,8 +190,8 @@ void               appsettings_set_agreed    (appsettings_t *self, app_agreed_t
 app_allowed_t      appsettings_get_allowed   (const appsettings_t *self);
 bool               appsettings_update_allowed(appsettings_t *self, app_allowed_t allowed);
 void               appsettings_set_allowed   (appsettings_t *self, app_allowed_t allowed);
-const stringset_t *appsettings_get_granted   (appsettings_t *self);
-void               appsettings_set_granted   (appsettings_t *self, const stringset_t *granted);
+const permset_t   *appsettings_get_granted   (appsettings_t *self);
+void               appsettings_set_granted   (appsettings_t *self, const permset_t *granted);
 
 G_END_DECLS
 
@@ -36,10 +36,26 @@
 
 #include "stringset.h"
 
+#include <string.h>
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct stringset_item_t stringset_item_t;
+
 /* ========================================================================= *
  * Prototypes
  * ========================================================================= */
 
+/* ------------------------------------------------------------------------- *
+ * STRINGSET_ITEM
+ * ------------------------------------------------------------------------- */
+
+static stringset_item_t *stringset_item_create   (const gchar *text, gsize len);
+static void              stringset_item_delete   (stringset_item_t *self);
+static stringset_item_t *stringset_item_from_text(gpointer text);
+
 /* ------------------------------------------------------------------------- *
  * UTILITY
  * ------------------------------------------------------------------------- */
@@ -71,6 +87,47 @@ bool          stringset_equal         (const stringset_t *self, const stringset_
 bool          stringset_extend        (stringset_t *self, const stringset_t *that);
 bool          stringset_assign        (stringset_t *self, const stringset_t *that);
 
+/* ========================================================================= *
+ * STRINGSET_ITEM
+ * ========================================================================= */
+
+/** Set member: list node and string data in one allocation
+ *
+ * The list node is the first member, so that stringset_list() can
+ * expose items as a plain GList where node->data points to the string.
+ * The string is used as hash table key, and the item containing it can
+ * be located from the key without further lookups.
+ */
+struct stringset_item_t
+{
+    GList sti_link;
+    gchar sti_text[];
+};
+
+static stringset_item_t *
+stringset_item_create(const gchar *text, gsize len)
+{
+    stringset_item_t *self = g_malloc(sizeof *self + len + 1);
+    memcpy(self->sti_text, text, len);
+    self->sti_text[len] = 0;
+    self->sti_link.data = self->sti_text;
+    self->sti_link.prev = NULL;
+    self->sti_link.next = NULL;
+    return self;
+}
+
+static void
+stringset_item_delete(stringset_item_t *self)
+{
+    g_free(self);
+}
+
+static stringset_item_t *
+stringset_item_from_text(gpointer text)
+{
+    return (stringset_item_t *)((gchar *)text - G_STRUCT_OFFSET(stringset_item_t, sti_text));
+}
+
 /* ========================================================================= *
  * STRINGSET
  * ========================================================================= */
@@ -80,7 +137,8 @@ struct stringset_t
     /* GQueue keeps the set in deterministic order */
     GQueue      sst_list;
 
-    /* GHashTable is used for lookups and memory management */
+    /* GHashTable is used for lookups, keys point to item text
+     * and memory is managed via the list */
     GHashTable *sst_hash;
 };
 
@@ -89,8 +147,7 @@ stringset_ctor(stringset_t *self)
 {
     //log_debug("stringset() create");
     g_queue_init(&self->sst_list);
-    self->sst_hash = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                           g_free, NULL);
+    self->sst_hash = g_hash_table_new(g_str_hash, g_str_equal);
 }
 
 static void
@@ -156,18 +213,17 @@ stringset_list(const stringset_t *self)
 bool
 stringset_has_item(const stringset_t *self, const gchar *item)
 {
-    return g_hash_table_lookup(self->sst_hash, item) != 0;
+    return g_hash_table_contains(self->sst_hash, item);
 }
 
 bool
 stringset_add_item(stringset_t *self, const gchar *item)
 {
     bool added_item = false;
-    const gchar *have = g_hash_table_lookup(self->sst_hash, item);
-    if( !have ) {
-        gchar *add = g_strdup(item);
-        g_hash_table_add(self->sst_hash, add);
-        g_queue_push_tail(&self->sst_list, add);
+    if( !g_hash_table_contains(self->sst_hash, item) ) {
+        stringset_item_t *add = stringset_item_create(item, strlen(item));
+        g_hash_table_add(self->sst_hash, add->sti_text);
+        g_queue_push_tail_link(&self->sst_list, &add->sti_link);
         added_item = true;
     }
     return added_item;
@@ -176,15 +232,8 @@ stringset_add_item(stringset_t *self, const gchar *item)
 bool
 stringset_add_item_steal(stringset_t *self, gchar *item)
 {
-    bool added_item = false;
-    const gchar *have = g_hash_table_lookup(self->sst_hash, item);
-    if( have ) {
-        g_free(item);
-    }
-    else {
-        g_hash_table_add(self->sst_hash, item);
-        g_queue_push_tail(&self->sst_list, item);
-    }
+    bool added_item = stringset_add_item(self, item);
+    g_free(item);
     return added_item;
 }
 
@@ -204,10 +253,12 @@ stringset_remove_item(stringset_t *self, const gchar *item)
 {
     bool removed_item = false;
 
-    const gchar *have = g_hash_table_lookup(self->sst_hash, item);
-    if( have ) {
-        g_queue_remove(&self->sst_list, have);
+    gpointer have = NULL;
+    if( g_hash_table_lookup_extended(self->sst_hash, item, &have, NULL) ) {
+        stringset_item_t *rem = stringset_item_from_text(have);
         g_hash_table_remove(self->sst_hash, have);
+        g_queue_unlink(&self->sst_list, &rem->sti_link);
+        stringset_item_delete(rem);
         removed_item = true;
     }
     return removed_item;
@@ -219,8 +270,14 @@ stringset_clear(stringset_t *self)
     bool removed_items = false;
 
     if( !stringset_empty(self) ) {
-        g_queue_clear(&self->sst_list);
         g_hash_table_remove_all(self->sst_hash);
+        GList *iter = self->sst_list.head;
+        while( iter ) {
+            GList *next = iter->next;
+            stringset_item_delete((stringset_item_t *)iter);
+            iter = next;
+        }
+        g_queue_init(&self->sst_list);
         removed_items = true;
     }
     return removed_items;
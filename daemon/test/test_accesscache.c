@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "accesscache.h"
+
+#include <glib.h>
+#include <locale.h>
+
+/* ========================================================================= *
+ * MOCK DATA
+ * ========================================================================= */
+
+#define POLICY_PRIVILEGED 0
+#define POLICY_MDM        1
+
+typedef struct {
+    guint       mck_checks;   // number of policy evaluations
+    const char *mck_allowed;  // sender that passes POLICY_PRIVILEGED
+} accesscache_test_mock_t;
+
+/* ========================================================================= *
+ * MOCK POLICY CHECKER
+ * ========================================================================= */
+
+static bool
+accesscache_test_check_cb(const gchar *sender, guint policy, gpointer aptr)
+{
+    accesscache_test_mock_t *mock = aptr;
+    mock->mck_checks += 1;
+    return policy == POLICY_PRIVILEGED && !g_strcmp0(sender, mock->mck_allowed);
+}
+
+/* ========================================================================= *
+ * ACCESSCACHE TESTS
+ * ========================================================================= */
+
+void test_accesscache_create_delete()
+{
+    accesscache_test_mock_t mock = { 0, NULL };
+    accesscache_t *cache = accesscache_create(accesscache_test_check_cb, &mock);
+    g_assert_nonnull(cache);
+    g_assert_cmpuint(accesscache_size(cache), ==, 0);
+    accesscache_delete_at(&cache);
+    g_assert_null(cache);
+    accesscache_delete_at(&cache);
+    g_assert_null(cache);
+}
+
+void test_accesscache_cached()
+{
+    accesscache_test_mock_t mock = { 0, ":1.10" };
+    accesscache_t *cache = accesscache_create(accesscache_test_check_cb, &mock);
+
+    /* Both allow and deny decisions are cached */
+    for( int i = 0; i < 100; ++i ) {
+        g_assert_true(accesscache_check(cache, ":1.10", POLICY_PRIVILEGED));
+        g_assert_false(accesscache_check(cache, ":1.11", POLICY_PRIVILEGED));
+    }
+    g_assert_cmpuint(mock.mck_checks, ==, 2);
+    g_assert_cmpuint(accesscache_size(cache), ==, 2);
+
+    /* Policies are evaluated separately */
+    g_assert_false(accesscache_check(cache, ":1.10", POLICY_MDM));
+    g_assert_false(accesscache_check(cache, ":1.10", POLICY_MDM));
+    g_assert_cmpuint(mock.mck_checks, ==, 3);
+    g_assert_cmpuint(accesscache_size(cache), ==, 2);
+
+    /* Out of range policy is denied without evaluation */
+    g_assert_false(accesscache_check(cache, ":1.10", ACCESSCACHE_POLICY_MAX));
+    g_assert_cmpuint(mock.mck_checks, ==, 3);
+
+    accesscache_delete(cache);
+}
+
+void test_accesscache_not_unique()
+{
+    accesscache_test_mock_t mock = { 0, "com.example.Service" };
+    accesscache_t *cache = accesscache_create(accesscache_test_check_cb, &mock);
+
+    /* Well-known names are evaluated every time */
+    g_assert_true(accesscache_check(cache, "com.example.Service", POLICY_PRIVILEGED));
+    g_assert_true(accesscache_check(cache, "com.example.Service", POLICY_PRIVILEGED));
+    g_assert_cmpuint(mock.mck_checks, ==, 2);
+    g_assert_cmpuint(accesscache_size(cache), ==, 0);
+
+    accesscache_delete(cache);
+}
+
+void test_accesscache_forget()
+{
+    accesscache_test_mock_t mock = { 0, ":1.10" };
+    accesscache_t *cache = accesscache_create(accesscache_test_check_cb, &mock);
+
+    g_assert_true(accesscache_check(cache, ":1.10", POLICY_PRIVILEGED));
+    g_assert_false(accesscache_check(cache, ":1.11", POLICY_PRIVILEGED));
+    g_assert_cmpuint(mock.mck_checks, ==, 2);
+
+    /* As if NameOwnerChanged(":1.10", ":1.10", "") was received */
+    accesscache_forget(cache, ":1.10");
+    g_assert_cmpuint(accesscache_size(cache), ==, 1);
+    g_assert_true(accesscache_check(cache, ":1.10", POLICY_PRIVILEGED));
+    g_assert_false(accesscache_check(cache, ":1.11", POLICY_PRIVILEGED));
+    g_assert_cmpuint(mock.mck_checks, ==, 3);
+
+    /* Forgetting unknown names is harmless */
+    accesscache_forget(cache, ":1.99");
+    accesscache_forget(cache, NULL);
+    accesscache_forget(NULL, ":1.10");
+    g_assert_cmpuint(accesscache_size(cache), ==, 2);
+
+    accesscache_delete(cache);
+}
+
+void test_accesscache_flush()
+{
+    accesscache_test_mock_t mock = { 0, ":1.10" };
+    accesscache_t *cache = accesscache_create(accesscache_test_check_cb, &mock);
+
+    g_assert_true(accesscache_check(cache, ":1.10", POLICY_PRIVILEGED));
+    g_assert_false(accesscache_check(cache, ":1.11", POLICY_PRIVILEGED));
+    g_assert_cmpuint(mock.mck_checks, ==, 2);
+
+    /* Policy reload: previous decisions must not be used */
+    mock.mck_allowed = ":1.11";
+    accesscache_flush(cache);
+    g_assert_cmpuint(accesscache_size(cache), ==, 0);
+    g_assert_false(accesscache_check(cache, ":1.10", POLICY_PRIVILEGED));
+    g_assert_true(accesscache_check(cache, ":1.11", POLICY_PRIVILEGED));
+    g_assert_cmpuint(mock.mck_checks, ==, 4);
+
+    accesscache_delete(cache);
+}
+
+void test_accesscache_bounded()
+{
+    accesscache_test_mock_t mock = { 0, ":1.0" };
+    accesscache_t *cache = accesscache_create(accesscache_test_check_cb, &mock);
+
+    /* Cache does not grow past the limit */
+    for( guint i = 0; i < ACCESSCACHE_ENTRIES_MAX + 10; ++i ) {
+        gchar *sender = g_strdup_printf(":1.%u", i);
+        g_assert_cmpint(accesscache_check(cache, sender, POLICY_PRIVILEGED), ==, i == 0);
+        g_free(sender);
+    }
+    g_assert_cmpuint(accesscache_size(cache), ==, ACCESSCACHE_ENTRIES_MAX);
+    g_assert_cmpuint(mock.mck_checks, ==, ACCESSCACHE_ENTRIES_MAX + 10);
+
+    /* Oldest entries were dropped and get re-evaluated */
+    g_assert_true(accesscache_check(cache, ":1.0", POLICY_PRIVILEGED));
+    g_assert_cmpuint(mock.mck_checks, ==, ACCESSCACHE_ENTRIES_MAX + 11);
+
+    /* Newest entries are still cached */
+    gchar *sender = g_strdup_printf(":1.%u", ACCESSCACHE_ENTRIES_MAX + 9);
+    g_assert_false(accesscache_check(cache, sender, POLICY_PRIVILEGED));
+    g_assert_cmpuint(mock.mck_checks, ==, ACCESSCACHE_ENTRIES_MAX + 11);
+    g_free(sender);
+
+    /* Forgetting makes room without evicting other entries */
+    accesscache_forget(cache, ":1.0");
+    g_assert_false(accesscache_check(cache, ":1.999", POLICY_PRIVILEGED));
+    g_assert_false(accesscache_check(cache, ":1.11", POLICY_PRIVILEGED));
+    g_assert_cmpuint(mock.mck_checks, ==, ACCESSCACHE_ENTRIES_MAX + 12);
+    g_assert_cmpuint(accesscache_size(cache), ==, ACCESSCACHE_ENTRIES_MAX);
+
+    accesscache_delete(cache);
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/sailjaild/accesscache/create_and_delete", test_accesscache_create_delete);
+    g_test_add_func("/sailjaild/accesscache/cached", test_accesscache_cached);
+    g_test_add_func("/sailjaild/accesscache/not_unique", test_accesscache_not_unique);
+    g_test_add_func("/sailjaild/accesscache/forget", test_accesscache_forget);
+    g_test_add_func("/sailjaild/accesscache/flush", test_accesscache_flush);
+    g_test_add_func("/sailjaild/accesscache/bounded", test_accesscache_bounded);
+
+    return g_test_run();
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "appcache.h"
+#include "util.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+#include <string.h>
+
+/* ========================================================================= *
+ * SET UP AND TEAR DOWN
+ * ========================================================================= */
+
+typedef struct {
+    gchar *directory;
+    gchar *path;
+    appcache_stamp_t stamps[APPCACHE_STAMP_COUNT];
+} appcache_test_data_t;
+
+static void
+appcache_test_set_up(appcache_test_data_t *data, gconstpointer user_data)
+{
+    (void)user_data; // unused
+    data->directory = g_dir_make_tmp("test_appcache-XXXXXX", NULL);
+    g_assert_nonnull(data->directory);
+    data->path = g_build_filename(data->directory, "appinfo.cache", NULL);
+    data->stamps[0] = (appcache_stamp_t){ 1620000000, 123, 4567 };
+    appcache_stamp_clear(&data->stamps[1]);
+}
+
+static void
+appcache_test_tear_down(appcache_test_data_t *data, gconstpointer user_data)
+{
+    (void)user_data; // unused
+    GDir *dir = g_dir_open(data->directory, 0, NULL);
+    if( dir ) {
+        const gchar *name;
+        while( (name = g_dir_read_name(dir)) ) {
+            gchar *path = g_build_filename(data->directory, name, NULL);
+            g_unlink(path);
+            g_free(path);
+        }
+        g_dir_close(dir);
+    }
+    g_rmdir(data->directory);
+    g_free(data->path);
+    g_free(data->directory);
+}
+
+static GKeyFile *
+appcache_test_load_desktop(const gchar *appname)
+{
+    GKeyFile *ini = g_key_file_new();
+    gchar *path = path_from_desktop_name(appname);
+    g_assert_true(keyfile_merge(ini, path));
+    g_free(path);
+    return ini;
+}
+
+static void
+appcache_test_store(appcache_test_data_t *data, const gchar *appname)
+{
+    appcache_t *appcache = appcache_create(data->path);
+    GKeyFile *ini = appcache_test_load_desktop(appname);
+    appcache_update(appcache, appname, data->stamps, ini);
+    g_key_file_unref(ini);
+    g_assert_true(appcache_save(appcache));
+    appcache_delete(appcache);
+}
+
+/* ========================================================================= *
+ * APPCACHE TESTS
+ * ========================================================================= */
+
+void test_appcache_create_delete()
+{
+    appcache_t *appcache = appcache_create("/nonexistent/appinfo.cache");
+    g_assert_nonnull(appcache);
+    g_assert_false(appcache_load(appcache));
+    appcache_delete_at(&appcache);
+    g_assert_null(appcache);
+    appcache_delete_at(&appcache);
+    g_assert_null(appcache);
+}
+
+void test_appcache_roundtrip(appcache_test_data_t *data, gconstpointer user_data)
+{
+    (void)user_data; // unused
+    appcache_test_store(data, "test-app");
+
+    appcache_t *appcache = appcache_create(data->path);
+    g_assert_true(appcache_load(appcache));
+    GKeyFile *ini = appcache_lookup(appcache, "test-app", data->stamps);
+    g_assert_nonnull(ini);
+
+    gchar *name = keyfile_get_string(ini, DESKTOP_SECTION, DESKTOP_KEY_NAME, 0);
+    g_assert_cmpstr(name, ==, "Test Application");
+    g_free(name);
+    g_assert_true(g_key_file_has_group(ini, SAILJAIL_SECTION_PRIMARY));
+    g_assert_false(g_key_file_has_group(ini, SAILJAIL_SECTION_SECONDARY));
+    gchar **permissions = g_key_file_get_string_list(ini, SAILJAIL_SECTION_PRIMARY,
+                                                     SAILJAIL_KEY_PERMISSIONS,
+                                                     NULL, NULL);
+    g_assert_nonnull(permissions);
+    g_assert_cmpstr(permissions[0], ==, "Internet");
+    g_assert_cmpstr(permissions[1], ==, "NonExistingPermission");
+    g_assert_null(permissions[2]);
+    g_strfreev(permissions);
+    g_key_file_unref(ini);
+
+    g_assert_null(appcache_lookup(appcache, "not-cached-app", data->stamps));
+    appcache_delete(appcache);
+}
+
+void test_appcache_outdated(appcache_test_data_t *data, gconstpointer user_data)
+{
+    (void)user_data; // unused
+    appcache_test_store(data, "test-app");
+
+    appcache_t *appcache = appcache_create(data->path);
+    g_assert_true(appcache_load(appcache));
+
+    appcache_stamp_t stamps[APPCACHE_STAMP_COUNT];
+    memcpy(stamps, data->stamps, sizeof stamps);
+    stamps[0].acs_size += 1;
+    g_assert_null(appcache_lookup(appcache, "test-app", stamps));
+
+    memcpy(stamps, data->stamps, sizeof stamps);
+    stamps[0].acs_inode += 1;
+    g_assert_null(appcache_lookup(appcache, "test-app", stamps));
+
+    memcpy(stamps, data->stamps, sizeof stamps);
+    stamps[1].acs_ctime = stamps[0].acs_ctime;
+    g_assert_null(appcache_lookup(appcache, "test-app", stamps));
+
+    appcache_delete(appcache);
+}
+
+void test_appcache_unsupported(appcache_test_data_t *data, gconstpointer user_data)
+{
+    (void)user_data; // unused
+    appcache_t *appcache = appcache_create(data->path);
+
+    g_assert_true(g_file_set_contents(data->path, "", 0, NULL));
+    g_assert_false(appcache_load(appcache));
+
+    g_assert_true(g_file_set_contents(data->path, "SJAC\x7f\0\0\0", 8, NULL));
+    g_assert_false(appcache_load(appcache));
+    g_assert_null(appcache_lookup(appcache, "test-app", data->stamps));
+
+    appcache_delete(appcache);
+}
+
+void test_appcache_drop_unused(appcache_test_data_t *data, gconstpointer user_data)
+{
+    (void)user_data; // unused
+    appcache_t *appcache = appcache_create(data->path);
+    GKeyFile *ini = appcache_test_load_desktop("test-app");
+    appcache_update(appcache, "app-1", data->stamps, ini);
+    appcache_update(appcache, "app-2", data->stamps, ini);
+    g_key_file_unref(ini);
+    g_assert_true(appcache_save(appcache));
+
+    /* Only app-1 is used after reload -> app-2 gets dropped */
+    g_assert_true(appcache_load(appcache));
+    ini = appcache_lookup(appcache, "app-1", data->stamps);
+    g_assert_nonnull(ini);
+    g_key_file_unref(ini);
+    g_assert_true(appcache_save(appcache));
+
+    g_assert_true(appcache_load(appcache));
+    g_assert_null(appcache_lookup(appcache, "app-2", data->stamps));
+    ini = appcache_lookup(appcache, "app-1", data->stamps);
+    g_assert_nonnull(ini);
+    g_key_file_unref(ini);
+
+    appcache_delete(appcache);
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/sailjaild/appcache/create_and_delete", test_appcache_create_delete);
+    g_test_add("/sailjaild/appcache/roundtrip", appcache_test_data_t, NULL,
+               appcache_test_set_up, test_appcache_roundtrip, appcache_test_tear_down);
+    g_test_add("/sailjaild/appcache/outdated", appcache_test_data_t, NULL,
+               appcache_test_set_up, test_appcache_outdated, appcache_test_tear_down);
+    g_test_add("/sailjaild/appcache/unsupported", appcache_test_data_t, NULL,
+               appcache_test_set_up, test_appcache_unsupported, appcache_test_tear_down);
+    g_test_add("/sailjaild/appcache/drop_unused", appcache_test_data_t, NULL,
+               appcache_test_set_up, test_appcache_drop_unused, appcache_test_tear_down);
+
+    return g_test_run();
+}
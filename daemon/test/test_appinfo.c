@@ -35,6 +35,8 @@
  */
 
 #include "appinfo.h"
+#include "appcache.h"
+#include "permset.h"
 #include "stringset.h"
 
 #include <glib.h>
@@ -65,6 +67,12 @@ const stringset_t *
 __wrap_control_available_permissions(const control_t *self)
 {
     const appinfo_test_mock_t *mock = (const appinfo_test_mock_t *)self;
+
+    /* Available permissions are registered by permissions module */
+    for( const GList *iter = stringset_list(mock->mck_ctl_available_permissions);
+         iter; iter = iter->next )
+        permset_intern(iter->data);
+
     return mock->mck_ctl_available_permissions;
 }
 
@@ -86,6 +94,13 @@ __wrap_applications_config(applications_t *self)
     return (config_t *)mock;
 }
 
+appcache_t *
+__wrap_applications_appcache(const applications_t *self)
+{
+    (void)self; // unused
+    return NULL;
+}
+
 /* ========================================================================= *
  * MOCK CONFIG_FUNCTIONS
  * ========================================================================= */
@@ -205,7 +220,58 @@ void test_appinfo_disabled_mode(gconstpointer user_data)
     g_assert_true(appinfo_parse_desktop(appinfo));
     g_assert_true(appinfo_valid(appinfo));
     g_assert_cmpint(appinfo_get_mode(appinfo), ==, APP_MODE_NONE);
-    g_assert_cmpint(stringset_size(appinfo_get_permissions(appinfo)), ==, 0);
+    g_assert_cmpint(permset_size(appinfo_get_permissions(appinfo)), ==, 0);
+    appinfo_delete(appinfo);
+}
+
+void test_appinfo_variant(gconstpointer user_data)
+{
+    appinfo_t *appinfo = appinfo_create((applications_t *)user_data, "test-app");
+    g_assert_nonnull(appinfo);
+    g_assert_true(appinfo_parse_desktop(appinfo));
+
+    /* Repeated queries share the cached data */
+    GVariant *variant1 = appinfo_to_variant(appinfo);
+    GVariant *variant2 = appinfo_to_variant(appinfo);
+    g_assert_false(g_variant_is_floating(variant1));
+    g_assert_true(variant1 == variant2);
+    g_variant_unref(variant2);
+
+    /* Changes invalidate the cached data */
+    appinfo_set_name(appinfo, "Renamed Application");
+    variant2 = appinfo_to_variant(appinfo);
+    g_assert_true(variant1 != variant2);
+    const gchar *name = NULL;
+    g_assert_true(g_variant_lookup(variant1, "Name", "&s", &name));
+    g_assert_cmpstr(name, ==, "Test Application");
+    g_assert_true(g_variant_lookup(variant2, "Name", "&s", &name));
+    g_assert_cmpstr(name, ==, "Renamed Application");
+
+    g_variant_unref(variant1);
+    g_variant_unref(variant2);
+    appinfo_delete(appinfo);
+}
+
+void test_appinfo_changes(gconstpointer user_data)
+{
+    appinfo_t *appinfo = appinfo_create((applications_t *)user_data, "test-app");
+    g_assert_true(appinfo_parse_desktop(appinfo));
+    g_assert_cmpint(appinfo_take_changes(appinfo), ==,
+                    APP_CHANGE_DESKTOP | APP_CHANGE_PERMISSIONS);
+    g_assert_cmpint(appinfo_take_changes(appinfo), ==, 0);
+
+    appinfo_set_icon(appinfo, "other");
+    g_assert_cmpint(appinfo_take_changes(appinfo), ==, APP_CHANGE_DESKTOP);
+
+    appinfo_clear_permissions(appinfo);
+    g_assert_cmpint(appinfo_take_changes(appinfo), ==, APP_CHANGE_PERMISSIONS);
+
+    /* Changes seen via re-evaluation are recorded too */
+    g_assert_true(appinfo_evaluate_permissions(appinfo));
+    g_assert_cmpint(appinfo_take_changes(appinfo), ==, APP_CHANGE_PERMISSIONS);
+    g_assert_false(appinfo_evaluate_permissions(appinfo));
+    g_assert_cmpint(appinfo_take_changes(appinfo), ==, 0);
+
     appinfo_delete(appinfo);
 }
 
@@ -229,6 +295,8 @@ int main(int argc, char **argv)
     g_test_add_data_func("/sailjaild/appinfo/exec", &mock, test_appinfo_exec);
     g_test_add_data_func("/sailjaild/appinfo/compatibility_mode", &mock, test_appinfo_compatibility_mode);
     g_test_add_data_func("/sailjaild/appinfo/disabled_mode", &mock, test_appinfo_disabled_mode);
+    g_test_add_data_func("/sailjaild/appinfo/variant", &mock, test_appinfo_variant);
+    g_test_add_data_func("/sailjaild/appinfo/changes", &mock, test_appinfo_changes);
 
     return g_test_run();
 }
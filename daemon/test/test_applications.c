@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "applications.h"
+#include "appinfo.h"
+#include "permset.h"
+#include "stringset.h"
+#include "util.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+
+/* ========================================================================= *
+ * MOCK DATA
+ * ========================================================================= */
+
+#define TEST_APP_NAME "dirty-app"
+#define TEST_APP_PATH SAILJAIL_APP_DIRECTORY "/" TEST_APP_NAME APPLICATIONS_EXTENSION
+
+typedef struct {
+    stringset_t *mck_ctl_available_permissions;
+    stringset_t *mck_changed;
+    guint        mck_stat_count;
+    GMainLoop   *mck_main_loop;
+} applications_test_mock_t;
+
+static applications_test_mock_t *applications_test_mock = NULL;
+
+void
+applications_test_mock_init(applications_test_mock_t *mock)
+{
+    mock->mck_ctl_available_permissions = stringset_create();
+    stringset_add_item(mock->mck_ctl_available_permissions, "Internet");
+    mock->mck_changed = stringset_create();
+    mock->mck_stat_count = 0;
+    mock->mck_main_loop = g_main_loop_new(NULL, TRUE);
+    applications_test_mock = mock;
+}
+
+/* ========================================================================= *
+ * MOCK CONTROL FUNCTIONS
+ * ========================================================================= */
+
+const stringset_t *
+__wrap_control_available_permissions(const control_t *self)
+{
+    const applications_test_mock_t *mock = (const applications_test_mock_t *)self;
+
+    /* Available permissions are registered by permissions module */
+    for( const GList *iter = stringset_list(mock->mck_ctl_available_permissions);
+         iter; iter = iter->next )
+        permset_intern(iter->data);
+
+    return mock->mck_ctl_available_permissions;
+}
+
+const config_t *
+__wrap_control_config(const control_t *self)
+{
+    return (const config_t *)self;
+}
+
+void
+__wrap_control_on_application_change(control_t *self, GHashTable *changed)
+{
+    applications_test_mock_t *mock = (applications_test_mock_t *)self;
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, changed);
+    while( g_hash_table_iter_next(&iter, &key, NULL) )
+        stringset_add_item(mock->mck_changed, key);
+    g_main_loop_quit(mock->mck_main_loop);
+}
+
+/* ========================================================================= *
+ * MOCK CONFIG FUNCTIONS
+ * ========================================================================= */
+
+stringset_t *
+__wrap_config_stringset(config_t *self, const gchar *sec, const gchar *key)
+{
+    (void)self; // unused
+    (void)sec; // unused
+    (void)key; // unused
+    return stringset_create();
+}
+
+bool
+__wrap_config_boolean(config_t *self, const gchar *sec, const gchar *key, bool def)
+{
+    (void)self; // unused
+    (void)sec; // unused
+    (void)key; // unused
+    return def;
+}
+
+/* ========================================================================= *
+ * MOCK UTIL FUNCTIONS
+ * ========================================================================= */
+
+/* Appinfo does exactly one stat() per constructed desktop file path,
+ * so counting the paths gives the number of stat() calls made while
+ * rescanning. Wrapping stat() itself is not reliable as older C
+ * libraries may inline it.
+ */
+
+gchar *__real_path_from_desktop_name(const gchar *stem);
+gchar *__real_alt_path_from_desktop_name(const gchar *stem);
+
+gchar *
+__wrap_path_from_desktop_name(const gchar *stem)
+{
+    applications_test_mock->mck_stat_count++;
+    return __real_path_from_desktop_name(stem);
+}
+
+gchar *
+__wrap_alt_path_from_desktop_name(const gchar *stem)
+{
+    applications_test_mock->mck_stat_count++;
+    return __real_alt_path_from_desktop_name(stem);
+}
+
+/* ========================================================================= *
+ * Utility
+ * ========================================================================= */
+
+static gboolean
+applications_test_timeout(gpointer user_data)
+{
+    applications_test_mock_t *mock = (applications_test_mock_t *)user_data;
+    g_main_loop_quit(mock->mck_main_loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+applications_test_wait_for_change(applications_test_mock_t *mock)
+{
+    /* Timeout the test after ten seconds if the expected
+     * change notification does not arrive
+     */
+    guint timeout = g_timeout_add_seconds(10, applications_test_timeout, mock);
+    g_main_loop_run(mock->mck_main_loop);
+    g_source_remove(timeout);
+}
+
+static void
+applications_test_reset(applications_test_mock_t *mock)
+{
+    stringset_clear(mock->mck_changed);
+    mock->mck_stat_count = 0;
+}
+
+/* ========================================================================= *
+ * APPLICATIONS TESTS
+ * ========================================================================= */
+
+void test_applications_available(gconstpointer user_data)
+{
+    applications_test_mock_t *mock = (applications_test_mock_t *)user_data;
+    applications_t *applications = applications_create((control_t *)mock);
+    const stringset_t *available = applications_available(applications);
+    g_assert_true(stringset_has_item(available, "test-app"));
+    g_assert_false(stringset_has_item(available, "invalid-app"));
+    g_assert_nonnull(applications_appinfo(applications, "test-app"));
+    g_assert_null(applications_appinfo(applications, "invalid-app"));
+    applications_delete_at(&applications);
+    g_assert_null(applications);
+}
+
+void test_applications_incremental_rescan(gconstpointer user_data)
+{
+    applications_test_mock_t *mock = (applications_test_mock_t *)user_data;
+
+    g_unlink(TEST_APP_PATH);
+    g_assert_cmpint(g_mkdir_with_parents(SAILJAIL_APP_DIRECTORY, 0755), ==, 0);
+
+    applications_test_reset(mock);
+    applications_t *applications = applications_create((control_t *)mock);
+    const stringset_t *available = applications_available(applications);
+    guint full_count = mock->mck_stat_count;
+    g_test_message("full scan: %u stat() calls", full_count);
+    g_assert_cmpuint(full_count, >=, 2 * stringset_size(available));
+    g_assert_false(stringset_has_item(available, TEST_APP_NAME));
+
+    /* Adding a desktop file rescans only that application */
+    applications_test_reset(mock);
+    g_assert_true(g_file_set_contents(TEST_APP_PATH,
+                                      "[Desktop Entry]\n"
+                                      "Type=Application\n"
+                                      "Name=Dirty\n"
+                                      "Exec=/usr/bin/dirty\n", -1, NULL));
+    applications_test_wait_for_change(mock);
+    g_assert_true(stringset_has_item(mock->mck_changed, TEST_APP_NAME));
+    g_assert_cmpuint(stringset_size(mock->mck_changed), ==, 1);
+    g_assert_cmpuint(mock->mck_stat_count, ==, 2);
+    available = applications_available(applications);
+    g_assert_true(stringset_has_item(available, TEST_APP_NAME));
+    g_assert_nonnull(applications_appinfo(applications, TEST_APP_NAME));
+
+    /* As does removing it */
+    applications_test_reset(mock);
+    g_assert_cmpint(g_unlink(TEST_APP_PATH), ==, 0);
+    applications_test_wait_for_change(mock);
+    g_assert_true(stringset_has_item(mock->mck_changed, TEST_APP_NAME));
+    g_assert_cmpuint(mock->mck_stat_count, ==, 2);
+    available = applications_available(applications);
+    g_assert_false(stringset_has_item(available, TEST_APP_NAME));
+    g_assert_null(applications_appinfo(applications, TEST_APP_NAME));
+
+    applications_delete(applications);
+}
+
+void test_applications_by_permission(gconstpointer user_data)
+{
+    applications_test_mock_t *mock = (applications_test_mock_t *)user_data;
+    applications_t *applications = applications_create((control_t *)mock);
+
+    const stringset_t *apps = applications_by_permission(applications, "Internet");
+    g_assert_nonnull(apps);
+    g_assert_true(stringset_has_item(apps, "test-app"));
+    g_assert_false(stringset_has_item(apps, "default-app"));
+
+    /* Requested permissions are indexed whether available or not */
+    apps = applications_by_permission(applications, "NonExistingPermission");
+    g_assert_nonnull(apps);
+    g_assert_true(stringset_has_item(apps, "test-app"));
+    g_assert_null(applications_by_permission(applications, "Camera"));
+
+    appinfo_t *appinfo = applications_appinfo(applications, "test-app");
+    g_assert_false(appinfo_has_permission(appinfo, "NonExistingPermission"));
+
+    /* Unrelated permission changes do not touch applications */
+    applications_test_reset(mock);
+    stringset_t *changed = stringset_create();
+    stringset_add_item(changed, "Camera");
+    stringset_add_item(mock->mck_ctl_available_permissions, "Camera");
+    applications_rethink(applications, changed);
+    g_assert_true(stringset_empty(mock->mck_changed));
+
+    /* Requesting applications are re-evaluated */
+    stringset_clear(changed);
+    stringset_add_item(changed, "NonExistingPermission");
+    stringset_add_item(mock->mck_ctl_available_permissions, "NonExistingPermission");
+    applications_rethink(applications, changed);
+    g_assert_true(stringset_has_item(mock->mck_changed, "test-app"));
+    g_assert_cmpuint(stringset_size(mock->mck_changed), ==, 1);
+    g_assert_true(appinfo_has_permission(appinfo, "NonExistingPermission"));
+
+    stringset_remove_item(mock->mck_ctl_available_permissions, "NonExistingPermission");
+    stringset_remove_item(mock->mck_ctl_available_permissions, "Camera");
+    applications_test_reset(mock);
+    applications_rethink(applications, NULL);
+    g_assert_true(stringset_has_item(mock->mck_changed, "test-app"));
+    g_assert_false(appinfo_has_permission(appinfo, "NonExistingPermission"));
+
+    stringset_delete(changed);
+    applications_delete(applications);
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    applications_test_mock_t mock;
+    applications_test_mock_init(&mock);
+
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_data_func("/sailjaild/applications/available", &mock, test_applications_available);
+    g_test_add_data_func("/sailjaild/applications/incremental_rescan", &mock, test_applications_incremental_rescan);
+    g_test_add_data_func("/sailjaild/applications/by_permission", &mock, test_applications_by_permission);
+
+    return g_test_run();
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "changelog.h"
+#include "intern.h"
+
+#include <glib.h>
+#include <locale.h>
+
+/* ========================================================================= *
+ * Utility
+ * ========================================================================= */
+
+static GVariant *
+changelog_test_since(changelog_t *changelog, guint64 generation,
+                     guint64 *current, gboolean *resync, gsize *count)
+{
+    GVariant *reply = g_variant_ref_sink(changelog_since(changelog, generation));
+    GVariant *changes = NULL;
+    g_variant_get(reply, "(tb@a(suu))", current, resync, &changes);
+    *count = g_variant_n_children(changes);
+    g_variant_unref(reply);
+    return changes;
+}
+
+/* ========================================================================= *
+ * CHANGELOG TESTS
+ * ========================================================================= */
+
+void test_changelog_create_delete()
+{
+    changelog_t *changelog = changelog_create(0);
+    g_assert_nonnull(changelog);
+    changelog_delete_at(&changelog);
+    g_assert_null(changelog);
+    changelog_delete_at(&changelog);
+    g_assert_null(changelog);
+}
+
+void test_changelog_since()
+{
+    changelog_t *changelog = changelog_create(16);
+    guint64 start = changelog_generation(changelog);
+    guint64 current;
+    gboolean resync;
+    gsize count;
+
+    /* Nothing changed yet */
+    GVariant *changes = changelog_test_since(changelog, start, &current,
+                                             &resync, &count);
+    g_assert_cmpuint(current, ==, start);
+    g_assert_false(resync);
+    g_assert_cmpuint(count, ==, 0);
+    g_variant_unref(changes);
+
+    guint64 first = changelog_advance(changelog);
+    g_assert_cmpuint(first, ==, start + 1);
+    changelog_add(changelog, "test-app", (uid_t)-1, 0x1);
+    changelog_add(changelog, "test-app", 100000, 0x4);
+
+    guint64 second = changelog_advance(changelog);
+    changelog_add(changelog, "other-app", 100000, 0x10);
+
+    /* Everything since start */
+    changes = changelog_test_since(changelog, start, &current,
+                                   &resync, &count);
+    g_assert_cmpuint(current, ==, second);
+    g_assert_false(resync);
+    g_assert_cmpuint(count, ==, 3);
+    g_variant_unref(changes);
+
+    /* Only the latest generation */
+    changes = changelog_test_since(changelog, first, &current,
+                                   &resync, &count);
+    g_assert_false(resync);
+    g_assert_cmpuint(count, ==, 1);
+    const gchar *app = NULL;
+    guint32 uid = 0, mask = 0;
+    g_variant_get_child(changes, 0, "(&suu)", &app, &uid, &mask);
+    g_assert_cmpstr(app, ==, "other-app");
+    g_assert_cmpuint(uid, ==, 100000);
+    g_assert_cmpuint(mask, ==, 0x10);
+    g_variant_unref(changes);
+
+    /* Up to date client */
+    changes = changelog_test_since(changelog, second, &current,
+                                   &resync, &count);
+    g_assert_false(resync);
+    g_assert_cmpuint(count, ==, 0);
+    g_variant_unref(changes);
+
+    /* Generations not handed out by this changelog */
+    g_assert_false(changelog_covers(changelog, start - 1));
+    g_assert_false(changelog_covers(changelog, second + 1));
+    changes = changelog_test_since(changelog, 0, &current,
+                                   &resync, &count);
+    g_assert_true(resync);
+    g_assert_cmpuint(count, ==, 0);
+    g_variant_unref(changes);
+
+    changelog_delete(changelog);
+
+    intern_stats_t stats;
+    intern_get_stats(&stats);
+    g_assert_cmpint(stats.ist_strings, ==, 0);
+}
+
+void test_changelog_wrap()
+{
+    changelog_t *changelog = changelog_create(4);
+    guint64 start = changelog_generation(changelog);
+    guint64 current;
+    gboolean resync;
+    gsize count;
+
+    /* Five generations with one change each -> the first gets dropped */
+    for( int i = 0; i < 5; ++i ) {
+        changelog_advance(changelog);
+        changelog_add(changelog, "test-app", (uid_t)-1, 0x1);
+    }
+
+    g_assert_false(changelog_covers(changelog, start));
+    GVariant *changes = changelog_test_since(changelog, start, &current,
+                                             &resync, &count);
+    g_assert_true(resync);
+    g_assert_cmpuint(count, ==, 0);
+    g_variant_unref(changes);
+
+    changes = changelog_test_since(changelog, start + 1, &current,
+                                   &resync, &count);
+    g_assert_cmpuint(current, ==, start + 5);
+    g_assert_false(resync);
+    g_assert_cmpuint(count, ==, 4);
+    g_variant_unref(changes);
+
+    /* Partially dropped generation must not be reported as complete */
+    changelog_advance(changelog);
+    changelog_add(changelog, "test-app", (uid_t)-1, 0x1);
+    changelog_add(changelog, "test-app", 100000, 0x4);
+    changelog_add(changelog, "test-app", 100001, 0x4);
+    changelog_add(changelog, "test-app", 100002, 0x4);
+    changelog_advance(changelog);
+    changelog_add(changelog, "test-app", (uid_t)-1, 0x1);
+    g_assert_false(changelog_covers(changelog, start + 5));
+    g_assert_true(changelog_covers(changelog, start + 6));
+
+    changelog_delete(changelog);
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/sailjaild/changelog/create_and_delete", test_changelog_create_delete);
+    g_test_add_func("/sailjaild/changelog/since", test_changelog_since);
+    g_test_add_func("/sailjaild/changelog/wrap", test_changelog_wrap);
+
+    return g_test_run();
+}
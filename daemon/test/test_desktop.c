@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "desktop.h"
+#include "util.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glob.h>
+#include <locale.h>
+#include <string.h>
+
+/* ========================================================================= *
+ * UTILITY
+ * ========================================================================= */
+
+/* Text presentation of the keyfile content that sailjaild uses */
+static gchar *
+desktop_test_dump(GKeyFile *ini)
+{
+    GString *text = g_string_new(NULL);
+    size_t count = 0;
+    const desktop_group_t *groups = desktop_groups(&count);
+    for( size_t i = 0; i < count; ++i ) {
+        if( !g_key_file_has_group(ini, groups[i].dgr_group) )
+            continue;
+        g_string_append_printf(text, "[%s]\n", groups[i].dgr_group);
+        for( size_t j = 0; groups[i].dgr_keys[j]; ++j ) {
+            gchar *val = g_key_file_get_value(ini, groups[i].dgr_group,
+                                              groups[i].dgr_keys[j], NULL);
+            if( val )
+                g_string_append_printf(text, "%s=%s\n",
+                                       groups[i].dgr_keys[j], val);
+            g_free(val);
+        }
+    }
+    return g_string_free(text, false);
+}
+
+/* Equivalent of keyfile_merge() for data in memory */
+static bool
+desktop_test_reference_parse(GKeyFile *ini, const char *data)
+{
+    GKeyFile *tmp = g_key_file_new();
+    bool ack = g_key_file_load_from_data(tmp, data, -1, G_KEY_FILE_NONE, NULL);
+    if( ack ) {
+        gchar **groups = g_key_file_get_groups(tmp, NULL);
+        for( size_t i = 0; groups[i]; ++i ) {
+            gchar **keys = g_key_file_get_keys(tmp, groups[i], NULL, NULL);
+            for( size_t j = 0; keys && keys[j]; ++j ) {
+                gchar *val = g_key_file_get_value(tmp, groups[i], keys[j], NULL);
+                g_key_file_set_value(ini, groups[i], keys[j], val);
+                g_free(val);
+            }
+            g_strfreev(keys);
+        }
+        g_strfreev(groups);
+    }
+    g_key_file_unref(tmp);
+    return ack;
+}
+
+static gchar **
+desktop_test_application_files(void)
+{
+    glob_t gl = {};
+    GPtrArray *paths = g_ptr_array_new();
+    if( glob(APPLICATIONS_DIRECTORY "/" APPLICATIONS_PATTERN, 0, 0, &gl) == 0 ) {
+        for( size_t i = 0; i < gl.gl_pathc; ++i )
+            g_ptr_array_add(paths, g_strdup(gl.gl_pathv[i]));
+    }
+    globfree(&gl);
+    g_ptr_array_add(paths, NULL);
+    return (gchar **)g_ptr_array_free(paths, false);
+}
+
+/* ========================================================================= *
+ * DESKTOP TESTS
+ * ========================================================================= */
+
+void test_desktop_applications()
+{
+    gchar **paths = desktop_test_application_files();
+    g_assert_nonnull(paths[0]);
+
+    for( size_t i = 0; paths[i]; ++i ) {
+        GKeyFile *expected = g_key_file_new();
+        GKeyFile *parsed   = g_key_file_new();
+        g_assert_true(keyfile_merge(expected, paths[i]));
+        g_assert_true(desktop_merge(parsed, paths[i]));
+        gchar *text1 = desktop_test_dump(expected);
+        gchar *text2 = desktop_test_dump(parsed);
+        g_assert_cmpstr(text2, ==, text1);
+        g_free(text1);
+        g_free(text2);
+        g_key_file_unref(expected);
+        g_key_file_unref(parsed);
+    }
+
+    GKeyFile *ini = g_key_file_new();
+    g_assert_false(desktop_merge(ini, APPLICATIONS_DIRECTORY "/test-not-an-app.desktop"));
+    g_key_file_unref(ini);
+
+    g_strfreev(paths);
+}
+
+void test_desktop_syntax()
+{
+    static const char * const inputs[] = {
+        /* valid */
+        "",
+        "\n\n# comment\n",
+        "[Desktop Entry]\nName=Test\nType=Application\nExec=/usr/bin/true",
+        "[Desktop Entry]\r\nName=Test\r\nExec=/usr/bin/true\r\n",
+        "  [Desktop Entry]  \n  Name  =  Spaced Value  \n",
+        "[Desktop Entry]\nName=First\nName=Second\n",
+        "[Desktop Entry]\nName=Escaped\\sname\\n\\t\\\\\nExec=a\\;b\n",
+        "[Desktop Entry]\nName[fi]=Testi\nName=Test\n",
+        "[Desktop Entry]\nEncoding=UTF-8\nName=Test\n",
+        "[Desktop Entry]\nName=Test\n[X-Sailjail]\nPermissions=Audio;Internet;\n",
+        "[Desktop Entry]\nName=Test\n[Sailjail]\nPermissions = Audio ; Internet\n",
+        "[Desktop Entry]\nName=Test\n[X-Sailjail]\n",
+        "[Desktop Entry]\nName=Test\n[X-Sailjail]\nUnknown=x\n",
+        "[Desktop Entry]\nName=Test\n[Other]\nName=Other\n[Desktop Entry]\nIcon=test\n",
+        "[Desktop Entry]\nName=Test\n[X-Sailjail]\nSandboxing=Disabled\n[X-Sailjail]\nSandboxing=Enabled\n",
+        "[Desktop Entry]\nX-Maemo-Service=org.example\nX-Nemo-Single-Instance=no\n",
+        "[Desktop Entry]\nName=\n",
+        /* invalid */
+        "Name=Test\n[Desktop Entry]\n",
+        "[Desktop Entry]\nName\n",
+        "[Desktop Entry]\n=Test\n",
+        "[Desktop Entry\nName=Test\n",
+        "[Desktop Entry] x\nName=Test\n",
+        "[Desktop Entry]\nName[fi=Testi\n",
+        "[Desktop Entry]\nEncoding=Latin-1\n",
+        "[]\nName=Test\n",
+    };
+
+    for( size_t i = 0; i < G_N_ELEMENTS(inputs); ++i ) {
+        GKeyFile *expected = g_key_file_new();
+        GKeyFile *parsed   = g_key_file_new();
+        bool ack1 = desktop_test_reference_parse(expected, inputs[i]);
+        bool ack2 = desktop_parse(parsed, "test", inputs[i], strlen(inputs[i]));
+        g_assert_cmpint(ack2, ==, ack1);
+        gchar *text1 = desktop_test_dump(expected);
+        gchar *text2 = desktop_test_dump(parsed);
+        g_assert_cmpstr(text2, ==, text1);
+        g_free(text1);
+        g_free(text2);
+        g_key_file_unref(expected);
+        g_key_file_unref(parsed);
+    }
+}
+
+void test_desktop_merge()
+{
+    static const char main_file[] =
+        "[Desktop Entry]\nName=Test\nExec=/usr/bin/true\n"
+        "[X-Sailjail]\nPermissions=Audio\n";
+    static const char alt_file[] =
+        "[Desktop Entry]\nExec=/usr/bin/false\n"
+        "[X-Sailjail]\nPermissions=Internet;Audio\n";
+
+    GKeyFile *ini = g_key_file_new();
+    g_assert_true(desktop_parse(ini, "main", main_file, strlen(main_file)));
+    g_assert_true(desktop_parse(ini, "alt", alt_file, strlen(alt_file)));
+
+    /* Invalid data does not modify the keyfile */
+    static const char bad_file[] = "[X-Sailjail]\nIcon=x\nbad\n";
+    g_assert_false(desktop_parse(ini, "bad", bad_file, strlen(bad_file)));
+
+    gchar *name = keyfile_get_string(ini, DESKTOP_SECTION, DESKTOP_KEY_NAME, NULL);
+    gchar *exec = keyfile_get_string(ini, DESKTOP_SECTION, DESKTOP_KEY_EXEC, NULL);
+    g_assert_cmpstr(name, ==, "Test");
+    g_assert_cmpstr(exec, ==, "/usr/bin/false");
+    g_assert_false(g_key_file_has_key(ini, SAILJAIL_SECTION_PRIMARY, DESKTOP_KEY_ICON, NULL));
+    gsize count = 0;
+    gchar **permissions = g_key_file_get_string_list(ini, SAILJAIL_SECTION_PRIMARY,
+                                                     SAILJAIL_KEY_PERMISSIONS,
+                                                     &count, NULL);
+    g_assert_cmpint(count, ==, 2);
+    g_assert_cmpstr(permissions[0], ==, "Internet");
+    g_assert_cmpstr(permissions[1], ==, "Audio");
+
+    g_strfreev(permissions);
+    g_free(name);
+    g_free(exec);
+    g_key_file_unref(ini);
+}
+
+void test_desktop_load_all()
+{
+    gchar **paths = desktop_test_application_files();
+    guint files = g_strv_length(paths);
+    g_assert_cmpuint(files, >, 1);
+
+    /* Each job merges one file, plus a missing file at the end of the
+     * list to make one of the jobs fail.
+     */
+    desktop_load_t *jobs = g_new0(desktop_load_t, files + 1);
+    for( guint i = 0; i <= files; ++i ) {
+        jobs[i].dld_count = 2;
+        jobs[i].dld_paths = g_new0(gchar *, jobs[i].dld_count);
+        jobs[i].dld_paths[1] = g_strdup(paths[i] ?: APPLICATIONS_DIRECTORY "/test-not-an-app.desktop");
+    }
+
+    desktop_load_all(jobs, files + 1, 4);
+
+    for( guint i = 0; i < files; ++i ) {
+        GKeyFile *ini = g_key_file_new();
+        g_assert_true(desktop_merge(ini, paths[i]));
+        g_assert_nonnull(jobs[i].dld_ini);
+        gchar *expected = desktop_test_dump(ini);
+        gchar *actual = desktop_test_dump(jobs[i].dld_ini);
+        g_assert_cmpstr(actual, ==, expected);
+        g_free(actual);
+        g_free(expected);
+        g_key_file_unref(ini);
+    }
+    g_assert_null(jobs[files].dld_ini);
+
+    for( guint i = 0; i <= files; ++i ) {
+        desktop_load_clear(&jobs[i]);
+        g_assert_null(jobs[i].dld_paths);
+        g_assert_null(jobs[i].dld_ini);
+    }
+    g_free(jobs);
+    g_strfreev(paths);
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/sailjaild/desktop/applications", test_desktop_applications);
+    g_test_add_func("/sailjaild/desktop/syntax", test_desktop_syntax);
+    g_test_add_func("/sailjaild/desktop/merge", test_desktop_merge);
+    g_test_add_func("/sailjaild/desktop/load_all", test_desktop_load_all);
+
+    return g_test_run();
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "intern.h"
+
+#include <glib.h>
+#include <locale.h>
+
+/* ========================================================================= *
+ * INTERN TESTS
+ * ========================================================================= */
+
+void test_intern_acquire_release()
+{
+    intern_stats_t stats;
+
+    g_assert_null(intern_acquire(NULL));
+    intern_release(NULL);
+
+    gchar *copy = g_strdup("test-app");
+    const gchar *str1 = intern_acquire("test-app");
+    const gchar *str2 = intern_acquire(copy);
+    g_free(copy);
+    g_assert_cmpstr(str1, ==, "test-app");
+    g_assert_true(str1 == str2);
+    g_assert_true(intern_equal(str1, str2));
+
+    const gchar *str3 = intern_acquire("other-app");
+    g_assert_false(intern_equal(str1, str3));
+
+    intern_get_stats(&stats);
+    g_assert_cmpint(stats.ist_strings, ==, 2);
+    g_assert_cmpint(stats.ist_references, ==, 3);
+
+    intern_release(str2);
+    intern_release_at(&str3);
+    g_assert_null(str3);
+    intern_get_stats(&stats);
+    g_assert_cmpint(stats.ist_strings, ==, 1);
+    g_assert_cmpint(stats.ist_references, ==, 1);
+
+    /* Releasing unpooled strings is ignored */
+    intern_release("test-app");
+    intern_get_stats(&stats);
+    g_assert_cmpint(stats.ist_references, ==, 1);
+
+    intern_release(str1);
+    intern_get_stats(&stats);
+    g_assert_cmpint(stats.ist_strings, ==, 0);
+    g_assert_cmpint(stats.ist_pooled_bytes, ==, 0);
+}
+
+void test_intern_change()
+{
+    const gchar *str = NULL;
+    g_assert_true(intern_change(&str, "test-app"));
+    g_assert_false(intern_change(&str, "test-app"));
+    g_assert_cmpstr(str, ==, "test-app");
+    g_assert_true(intern_change(&str, "other-app"));
+    g_assert_cmpstr(str, ==, "other-app");
+    g_assert_true(intern_change(&str, NULL));
+    g_assert_null(str);
+
+    intern_stats_t stats;
+    intern_get_stats(&stats);
+    g_assert_cmpint(stats.ist_strings, ==, 0);
+}
+
+void test_intern_hash_table()
+{
+    GHashTable *lut = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            intern_release_cb, NULL);
+    g_hash_table_replace(lut, (gpointer)intern_acquire("test-app"), NULL);
+    g_hash_table_replace(lut, (gpointer)intern_acquire("test-app"), NULL);
+    g_assert_true(g_hash_table_contains(lut, "test-app"));
+
+    intern_stats_t stats;
+    intern_get_stats(&stats);
+    g_assert_cmpint(stats.ist_references, ==, 1);
+
+    g_hash_table_unref(lut);
+    intern_get_stats(&stats);
+    g_assert_cmpint(stats.ist_strings, ==, 0);
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/sailjaild/intern/acquire_release", test_intern_acquire_release);
+    g_test_add_func("/sailjaild/intern/change", test_intern_change);
+    g_test_add_func("/sailjaild/intern/hash_table", test_intern_hash_table);
+
+    return g_test_run();
+}
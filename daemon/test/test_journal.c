@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "journal.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+
+/* ========================================================================= *
+ * MOCK DATA
+ * ========================================================================= */
+
+#define RECORD_TYPE "(sias)"
+#define RECORD_MAX  4
+
+typedef struct {
+    gchar *mck_directory;
+    gchar *mck_path;
+    guint  mck_count;                 // number of records replayed
+    gint   mck_values[RECORD_MAX + 1]; // integer members of replayed records
+} journal_test_mock_t;
+
+static void
+journal_test_mock_reset(journal_test_mock_t *mock)
+{
+    mock->mck_count = 0;
+    for( size_t i = 0; i < G_N_ELEMENTS(mock->mck_values); ++i )
+        mock->mck_values[i] = -1;
+}
+
+static void
+journal_test_replay_cb(GVariant *record, gpointer aptr)
+{
+    journal_test_mock_t *mock = aptr;
+    gint value = -1;
+    g_variant_get(record, "(&sias)", NULL, &value, NULL);
+    if( mock->mck_count < G_N_ELEMENTS(mock->mck_values) )
+        mock->mck_values[mock->mck_count] = value;
+    mock->mck_count += 1;
+}
+
+static GVariant *
+journal_test_record(gint value)
+{
+    const gchar *tags[] = { "Audio", "Internet", "it's \"quoted\"\n", NULL };
+    return g_variant_new("(si^as)", "test-app", value, tags);
+}
+
+static guint
+journal_test_replay(journal_test_mock_t *mock)
+{
+    journal_test_mock_reset(mock);
+    journal_t *journal = journal_create(mock->mck_path, RECORD_TYPE);
+    guint count = journal_replay(journal, journal_test_replay_cb, mock);
+    journal_delete(journal);
+    g_assert_cmpuint(count, ==, mock->mck_count);
+    return count;
+}
+
+/* ========================================================================= *
+ * JOURNAL TESTS
+ * ========================================================================= */
+
+void test_journal_create_delete(gconstpointer user_data)
+{
+    const journal_test_mock_t *mock = user_data;
+    journal_t *journal = journal_create(mock->mck_path, RECORD_TYPE);
+    g_assert_nonnull(journal);
+    g_assert_cmpstr(journal_path(journal), ==, mock->mck_path);
+    journal_delete_at(&journal);
+    g_assert_null(journal);
+    journal_delete_at(&journal);
+    g_assert_null(journal);
+}
+
+void test_journal_append(gconstpointer user_data)
+{
+    journal_test_mock_t *mock = (journal_test_mock_t *)user_data;
+    journal_t *journal = journal_create(mock->mck_path, RECORD_TYPE);
+    g_assert_true(journal_reset(journal));
+    g_assert_cmpuint(journal_size(journal), ==, 0);
+
+    /* Records are buffered until sync */
+    for( gint i = 0; i < RECORD_MAX; ++i )
+        g_assert_true(journal_append(journal, journal_test_record(i)));
+    g_assert_false(journal_append(journal, g_variant_new("(s)", "bogus")));
+    g_assert_cmpuint(journal_pending(journal), ==, RECORD_MAX);
+    g_assert_cmpuint(journal_test_replay(mock), ==, 0);
+
+    g_assert_true(journal_sync(journal));
+    g_assert_cmpuint(journal_pending(journal), ==, 0);
+    g_assert_cmpuint(journal_size(journal), >, 0);
+
+    g_assert_cmpuint(journal_test_replay(mock), ==, RECORD_MAX);
+    for( gint i = 0; i < RECORD_MAX; ++i )
+        g_assert_cmpint(mock->mck_values[i], ==, i);
+
+    /* Reset discards both synced and pending records */
+    g_assert_true(journal_append(journal, journal_test_record(0)));
+    g_assert_true(journal_reset(journal));
+    g_assert_cmpuint(journal_pending(journal), ==, 0);
+    g_assert_cmpuint(journal_size(journal), ==, 0);
+    g_assert_cmpuint(journal_test_replay(mock), ==, 0);
+
+    journal_delete(journal);
+}
+
+void test_journal_truncated(gconstpointer user_data)
+{
+    journal_test_mock_t *mock = (journal_test_mock_t *)user_data;
+
+    /* Write records one at a time and remember where each one ends */
+    gsize ends[RECORD_MAX];
+    journal_t *journal = journal_create(mock->mck_path, RECORD_TYPE);
+    g_assert_true(journal_reset(journal));
+    for( gint i = 0; i < RECORD_MAX; ++i ) {
+        g_assert_true(journal_append(journal, journal_test_record(i)));
+        g_assert_true(journal_sync(journal));
+        ends[i] = journal_size(journal);
+    }
+    journal_delete(journal);
+
+    gchar *data = NULL;
+    gsize  size = 0;
+    g_assert_true(g_file_get_contents(mock->mck_path, &data, &size, NULL));
+    g_assert_cmpuint(size, ==, ends[RECORD_MAX - 1]);
+
+    /* Simulate crash after writing any number of bytes */
+    for( gsize offset = 0; offset <= size; ++offset ) {
+        guint expect = 0;
+        while( expect < RECORD_MAX && ends[expect] <= offset )
+            ++expect;
+        gsize valid = expect ? ends[expect - 1] : 0;
+
+        g_assert_true(g_file_set_contents(mock->mck_path, data, offset, NULL));
+
+        /* Only complete records are replayed, torn tail is dropped */
+        journal_test_mock_reset(mock);
+        journal = journal_create(mock->mck_path, RECORD_TYPE);
+        g_assert_cmpuint(journal_replay(journal, journal_test_replay_cb, mock),
+                         ==, expect);
+        g_assert_cmpuint(journal_size(journal), ==, valid);
+        for( guint i = 0; i < expect; ++i )
+            g_assert_cmpint(mock->mck_values[i], ==, (gint)i);
+
+        /* Appending after recovery must yield parseable journal */
+        g_assert_true(journal_append(journal, journal_test_record(RECORD_MAX)));
+        g_assert_true(journal_sync(journal));
+        journal_delete(journal);
+
+        g_assert_cmpuint(journal_test_replay(mock), ==, expect + 1);
+        g_assert_cmpint(mock->mck_values[expect], ==, RECORD_MAX);
+    }
+
+    g_free(data);
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    journal_test_mock_t mock;
+    mock.mck_directory = g_dir_make_tmp("test_journal-XXXXXX", NULL);
+    g_assert_nonnull(mock.mck_directory);
+    mock.mck_path = g_build_filename(mock.mck_directory, "test.journal", NULL);
+    journal_test_mock_reset(&mock);
+
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_data_func("/sailjaild/journal/create_and_delete", &mock, test_journal_create_delete);
+    g_test_add_data_func("/sailjaild/journal/append", &mock, test_journal_append);
+    g_test_add_data_func("/sailjaild/journal/truncated", &mock, test_journal_truncated);
+
+    int rc = g_test_run();
+
+    g_unlink(mock.mck_path);
+    g_rmdir(mock.mck_directory);
+    g_free(mock.mck_path);
+    g_free(mock.mck_directory);
+
+    return rc;
+}
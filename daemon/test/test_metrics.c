@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "metrics.h"
+
+#include <glib.h>
+#include <locale.h>
+#include <string.h>
+
+/* ========================================================================= *
+ * METRICS TESTS
+ * ========================================================================= */
+
+void test_metrics_create_delete()
+{
+    metrics_t *metrics = metrics_create();
+    g_assert_nonnull(metrics);
+    metrics_delete_at(&metrics);
+    g_assert_null(metrics);
+    metrics_delete_at(&metrics);
+    g_assert_null(metrics);
+}
+
+void test_metrics_calls()
+{
+    metrics_t *metrics = metrics_create();
+
+    metrics_record_call(metrics, ":1.1", "GetAppInfo");
+    metrics_record_reply(metrics, "GetAppInfo", METRICS_REPLY_OK, 0);
+    metrics_record_call(metrics, ":1.1", "GetAppInfo");
+    metrics_record_reply(metrics, "GetAppInfo", METRICS_REPLY_OK, 100);
+    metrics_record_call(metrics, ":1.2", "GetAppInfo");
+    metrics_record_reply(metrics, "GetAppInfo", G_DBUS_ERROR_INVALID_ARGS, 3);
+    metrics_record_call(metrics, ":1.2", "PromptLaunch");
+
+    gchar *report = metrics_report(metrics);
+    g_assert_nonnull(strstr(report, "  GetAppInfo: calls=3 pending=0\n"));
+    g_assert_nonnull(strstr(report, "    ok: n=2 avg=50 max=100 us: 0-1:1 64-127:1\n"));
+    g_assert_nonnull(strstr(report, "    org.freedesktop.DBus.Error.InvalidArgs: n=1 avg=3 max=3 us: 2-3:1\n"));
+    g_assert_nonnull(strstr(report, "  PromptLaunch: calls=1 pending=1\n"));
+    g_assert_nonnull(strstr(report, "  :1.1: calls=2\n"));
+    g_assert_nonnull(strstr(report, "  :1.2: calls=2\n"));
+    g_free(report);
+
+    metrics_delete(metrics);
+}
+
+void test_metrics_queue()
+{
+    metrics_t *metrics = metrics_create();
+
+    metrics_record_push(metrics, 1);
+    metrics_record_push(metrics, 2);
+    metrics_record_pop(metrics, 1, 1000);
+    metrics_record_pop(metrics, 0, 5000000);
+
+    gchar *report = metrics_report(metrics);
+    g_assert_nonnull(strstr(report, "prompter queue: depth=0 max=2 queued=2\n"));
+    g_assert_nonnull(strstr(report, "    wait: n=2 avg=2500500 max=5000000 us: 512-1023:1 4194304-8388607:1\n"));
+    g_free(report);
+
+    metrics_delete(metrics);
+}
+
+void test_metrics_senders()
+{
+    metrics_t *metrics = metrics_create();
+
+    /* One busy client and a lot of one-shot ones */
+    for( int i = 0; i < 10; ++i )
+        metrics_record_call(metrics, ":1.0", "GetApplications");
+    for( int i = 1; i <= METRICS_SENDERS_MAX * 2; ++i ) {
+        gchar *sender = g_strdup_printf(":1.%d", i);
+        metrics_record_call(metrics, sender, "GetApplications");
+        g_free(sender);
+    }
+
+    gchar *report = metrics_report(metrics);
+    g_assert_nonnull(strstr(report, "  :1.0: calls=10\n"));
+    g_assert_nonnull(strstr(report, "  (other): calls=65\n"));
+    g_free(report);
+
+    metrics_delete(metrics);
+}
+
+void test_metrics_signals()
+{
+    metrics_t *metrics = metrics_create();
+
+    metrics_record_signal(metrics, "ApplicationChanged", 12);
+    metrics_record_signal(metrics, "ApplicationChanged", 20);
+    metrics_record_signal(metrics, "ApplicationsChanged", 100);
+
+    gchar *report = metrics_report(metrics);
+    g_assert_nonnull(strstr(report, "signals:\n"
+                            "  ApplicationChanged: count=2 bytes=32\n"
+                            "  ApplicationsChanged: count=1 bytes=100\n"));
+    g_free(report);
+
+    metrics_delete(metrics);
+}
+
+void test_metrics_null()
+{
+    /* Recording without metrics object is a no-op */
+    metrics_record_call(NULL, ":1.1", "GetAppInfo");
+    metrics_record_reply(NULL, "GetAppInfo", METRICS_REPLY_OK, 0);
+    metrics_record_push(NULL, 1);
+    metrics_record_pop(NULL, 0, 0);
+    metrics_record_signal(NULL, "ApplicationChanged", 0);
+    metrics_call_begin(NULL, NULL);
+    metrics_call_end(NULL, NULL, METRICS_REPLY_OK);
+    metrics_queue_enter(NULL, NULL, 0);
+    metrics_queue_leave(NULL, NULL, 0);
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/sailjaild/metrics/create_and_delete", test_metrics_create_delete);
+    g_test_add_func("/sailjaild/metrics/calls", test_metrics_calls);
+    g_test_add_func("/sailjaild/metrics/queue", test_metrics_queue);
+    g_test_add_func("/sailjaild/metrics/senders", test_metrics_senders);
+    g_test_add_func("/sailjaild/metrics/signals", test_metrics_signals);
+    g_test_add_func("/sailjaild/metrics/null", test_metrics_null);
+
+    return g_test_run();
+}
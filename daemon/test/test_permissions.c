@@ -49,6 +49,8 @@
 
 typedef struct {
     bool mck_change_signaled;
+    stringset_t *mck_added;
+    stringset_t *mck_removed;
     GMainLoop *main_loop;
 } permissions_test_mock_t;
 
@@ -56,6 +58,8 @@ void
 permissions_test_mock_init(permissions_test_mock_t *mock)
 {
     mock->mck_change_signaled = false;
+    mock->mck_added = stringset_create();
+    mock->mck_removed = stringset_create();
     mock->main_loop = g_main_loop_new(NULL, TRUE);
 }
 
@@ -64,10 +68,13 @@ permissions_test_mock_init(permissions_test_mock_t *mock)
  * ========================================================================= */
 
 void
-__wrap_control_on_permissions_change(control_t *self)
+__wrap_control_on_permissions_change(control_t *self, const stringset_t *added,
+                                     const stringset_t *removed)
 {
     permissions_test_mock_t *mock = (permissions_test_mock_t *)self;
     mock->mck_change_signaled = true;
+    stringset_assign(mock->mck_added, added);
+    stringset_assign(mock->mck_removed, removed);
     g_main_loop_quit(mock->main_loop);
 }
 
@@ -138,6 +145,9 @@ void test_permissions_changed(gconstpointer user_data)
     g_assert_cmpint(fclose(file), ==, 0);
     g_main_loop_run(mock->main_loop);
     g_assert_true(mock->mck_change_signaled);
+    g_assert_cmpuint(stringset_size(mock->mck_added), ==, 1);
+    g_assert_true(stringset_has_item(mock->mck_added, "Test"));
+    g_assert_true(stringset_empty(mock->mck_removed));
     available = permissions_available(permissions);
     g_assert_true(stringset_has_item(available, "Test"));
     /* Second test removing a permission */
@@ -146,6 +156,9 @@ void test_permissions_changed(gconstpointer user_data)
     g_assert_cmpint(unlink(PERMISSIONS_DIRECTORY "/Test.permission"), ==, 0);
     g_main_loop_run(mock->main_loop);
     g_assert_true(mock->mck_change_signaled);
+    g_assert_true(stringset_empty(mock->mck_added));
+    g_assert_cmpuint(stringset_size(mock->mck_removed), ==, 1);
+    g_assert_true(stringset_has_item(mock->mck_removed, "Test"));
     available = permissions_available(permissions);
     g_assert_false(stringset_has_item(available, "Test"));
     permissions_delete(permissions);
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "permset.h"
+#include "stringset.h"
+
+#include <glib.h>
+#include <locale.h>
+
+/* ========================================================================= *
+ * PERMSET TESTS
+ * ========================================================================= */
+
+void test_permset_registry()
+{
+    guint audio = permset_intern("Audio");
+    guint camera = permset_intern("Camera");
+    g_assert_cmpuint(audio, <, PERMSET_MAX);
+    g_assert_cmpuint(camera, <, PERMSET_MAX);
+    g_assert_cmpuint(audio, !=, camera);
+    g_assert_cmpuint(permset_intern("Audio"), ==, audio);
+    g_assert_cmpuint(permset_lookup("Camera"), ==, camera);
+    g_assert_cmpuint(permset_lookup("NotRegistered"), ==, PERMSET_INVALID);
+    g_assert_cmpuint(permset_lookup(NULL), ==, PERMSET_INVALID);
+    g_assert_cmpstr(permset_name(audio), ==, "Audio");
+    g_assert_null(permset_name(PERMSET_INVALID));
+    g_assert_cmpuint(permset_count(), >=, 2);
+
+    /* Name based helpers do not register names */
+    permset_t set;
+    permset_init(&set);
+    g_assert_false(permset_add_name(&set, "NotRegistered"));
+    g_assert_true(permset_empty(&set));
+    g_assert_cmpuint(permset_lookup("NotRegistered"), ==, PERMSET_INVALID);
+}
+
+void test_permset_items()
+{
+    permset_intern("Audio");
+
+    permset_t set;
+    permset_init(&set);
+    g_assert_true(permset_empty(&set));
+    g_assert_cmpuint(permset_size(&set), ==, 0);
+    g_assert_cmpuint(permset_next(&set, 0), ==, PERMSET_MAX);
+
+    g_assert_true(permset_add_name(&set, "Audio"));
+    g_assert_false(permset_add_name(&set, "Audio"));
+    g_assert_true(permset_add(&set, 70));
+    g_assert_true(permset_add(&set, PERMSET_MAX - 1));
+    g_assert_false(permset_add(&set, PERMSET_INVALID));
+    g_assert_cmpuint(permset_size(&set), ==, 3);
+    g_assert_true(permset_has_name(&set, "Audio"));
+    g_assert_false(permset_has_name(&set, "NotRegistered"));
+    g_assert_true(permset_has(&set, 70));
+    g_assert_false(permset_has(&set, 71));
+
+    /* Iteration visits ids in ascending order */
+    guint id = permset_next(&set, permset_lookup("Audio") + 1);
+    g_assert_cmpuint(id, ==, 70);
+    id = permset_next(&set, id + 1);
+    g_assert_cmpuint(id, ==, PERMSET_MAX - 1);
+    g_assert_cmpuint(permset_next(&set, id + 1), ==, PERMSET_MAX);
+
+    g_assert_true(permset_remove(&set, 70));
+    g_assert_false(permset_remove(&set, 70));
+    g_assert_false(permset_remove_name(&set, "NotRegistered"));
+    g_assert_cmpuint(permset_size(&set), ==, 2);
+    g_assert_true(permset_clear(&set));
+    g_assert_false(permset_clear(&set));
+    g_assert_true(permset_empty(&set));
+}
+
+void test_permset_operations()
+{
+    permset_intern("Audio");
+    permset_intern("Camera");
+    permset_intern("Contacts");
+
+    permset_t set, mask;
+    permset_init(&set);
+    permset_init(&mask);
+    permset_add_name(&set, "Audio");
+    permset_add_name(&set, "Camera");
+    permset_add_name(&mask, "Camera");
+    permset_add_name(&mask, "Contacts");
+
+    permset_t temp = set;
+    g_assert_true(permset_equal(&temp, &set));
+    g_assert_true(permset_mask(&temp, &mask));
+    g_assert_false(permset_mask(&temp, &mask));
+    g_assert_cmpuint(permset_size(&temp), ==, 1);
+    g_assert_true(permset_has_name(&temp, "Camera"));
+
+    temp = set;
+    g_assert_true(permset_unmask(&temp, &mask));
+    g_assert_false(permset_unmask(&temp, &mask));
+    g_assert_cmpuint(permset_size(&temp), ==, 1);
+    g_assert_true(permset_has_name(&temp, "Audio"));
+
+    temp = set;
+    g_assert_true(permset_extend(&temp, &mask));
+    g_assert_false(permset_extend(&temp, &mask));
+    g_assert_cmpuint(permset_size(&temp), ==, 3);
+
+    g_assert_false(permset_equal(&temp, &set));
+    g_assert_true(permset_assign(&temp, &set));
+    g_assert_false(permset_assign(&temp, &set));
+    g_assert_true(permset_equal(&temp, &set));
+}
+
+void test_permset_conversions()
+{
+    permset_intern("Audio");
+    permset_intern("Camera");
+
+    stringset_t *input = stringset_create();
+    stringset_add_item(input, "Audio");
+    stringset_add_item(input, "Camera");
+
+    permset_t set;
+    permset_from_stringset(&set, input);
+    g_assert_cmpuint(permset_size(&set), ==, 2);
+
+    stringset_t *output = permset_to_stringset(&set);
+    g_assert_true(stringset_equal(input, output));
+    stringset_delete(output);
+
+    gchar **vector = permset_to_strv(&set);
+    g_assert_cmpuint(g_strv_length(vector), ==, 2);
+    permset_t copy;
+    permset_from_strv(&copy, vector);
+    g_assert_true(permset_equal(&copy, &set));
+    g_strfreev(vector);
+
+    gchar *string = permset_to_string(&set);
+    g_assert_cmpstr(string, ==, "Audio,Camera");
+    g_free(string);
+
+    GVariant *variant = permset_to_variant(&set);
+    g_assert_cmpstr(g_variant_get_type_string(variant), ==, "as");
+    g_assert_cmpuint(g_variant_n_children(variant), ==, 2);
+    g_variant_unref(g_variant_ref_sink(variant));
+
+    stringset_delete(input);
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/sailjaild/permset/registry", test_permset_registry);
+    g_test_add_func("/sailjaild/permset/items", test_permset_items);
+    g_test_add_func("/sailjaild/permset/operations", test_permset_operations);
+    g_test_add_func("/sailjaild/permset/conversions", test_permset_conversions);
+
+    return g_test_run();
+}
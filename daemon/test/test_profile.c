@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "profile.h"
+#include "stringset.h"
+#include "util.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+
+/* ========================================================================= *
+ * Utility
+ * ========================================================================= */
+
+static gchar *
+profile_test_write(const gchar *dir, const gchar *name, const gchar *text)
+{
+    gchar *path = g_build_filename(dir, name, NULL);
+    g_assert_true(g_file_set_contents(path, text, -1, NULL));
+    return path;
+}
+
+static void
+profile_test_cleanup(const gchar *dir)
+{
+    GDir *handle = g_dir_open(dir, 0, NULL);
+    g_assert_nonnull(handle);
+    const gchar *name;
+    while( (name = g_dir_read_name(handle)) ) {
+        gchar *path = g_build_filename(dir, name, NULL);
+        if( g_file_test(path, G_FILE_TEST_IS_DIR) )
+            profile_test_cleanup(path);
+        else
+            g_unlink(path);
+        g_free(path);
+    }
+    g_dir_close(handle);
+    g_rmdir(dir);
+}
+
+/* ========================================================================= *
+ * PROFILE TESTS
+ * ========================================================================= */
+
+void test_profile_flatten()
+{
+    gchar *dir = g_dir_make_tmp("test_profile-XXXXXX", NULL);
+    g_assert_nonnull(dir);
+
+    gchar *common = g_build_filename(dir, "common.inc", NULL);
+    gchar *text = g_strdup_printf("# comment\n"
+                                  "  whitelist ${HOME}/common  \n"
+                                  "include %s/First.permission\n", dir);
+    g_free(profile_test_write(dir, "common.inc", text));
+    g_free(text);
+
+    text = g_strdup_printf("include %s\n"
+                           "include relative.inc\n"
+                           "include ${HOME}/.config/macro.inc\n"
+                           "include /nonexistent/missing.inc\n"
+                           "\n"
+                           "whitelist ${HOME}/first\n", common);
+    gchar *first = profile_test_write(dir, "First.permission", text);
+    g_free(text);
+
+    text = g_strdup_printf("include %s\n"
+                           "whitelist ${HOME}/second\n", common);
+    gchar *second = profile_test_write(dir, "Second.permission", text);
+    g_free(text);
+
+    stringset_t *profiles = stringset_create();
+    stringset_add_item(profiles, first);
+    stringset_add_item(profiles, second);
+    stringset_add_item_fmt(profiles, "%s/Missing.permission", dir);
+
+    /* Absolute includes are resolved once, cycles are cut, and whatever
+     * firejail needs to resolve at launch time is passed through */
+    GHashTable *sources = profile_sources_create();
+    gchar *flat = profile_flatten(profiles, sources);
+    gchar *expected = g_strdup_printf("# Generated by sailjaild, do not edit\n"
+                                      "# %s/First.permission\n"
+                                      "# %s/common.inc\n"
+                                      "whitelist ${HOME}/common\n"
+                                      "# %s/First.permission: already included\n"
+                                      "include relative.inc\n"
+                                      "include ${HOME}/.config/macro.inc\n"
+                                      "include /nonexistent/missing.inc\n"
+                                      "whitelist ${HOME}/first\n"
+                                      "# %s/Second.permission\n"
+                                      "# %s/common.inc: already included\n"
+                                      "whitelist ${HOME}/second\n"
+                                      "include %s/Missing.permission\n",
+                                      dir, dir, dir, dir, dir, dir);
+    g_assert_cmpstr(flat, ==, expected);
+    g_free(expected);
+
+    /* Only files that were inlined are tracked */
+    g_assert_cmpuint(g_hash_table_size(sources), ==, 3);
+    g_assert_true(g_hash_table_contains(sources, common));
+    g_assert_false(profile_sources_changed(sources));
+
+    /* Written file matches flattened text */
+    gchar *path = g_build_filename(dir, "100000", "app-0123.profile", NULL);
+    g_assert_true(profile_write(path, profiles, NULL));
+    gchar *saved = NULL;
+    g_assert_true(g_file_get_contents(path, &saved, NULL, NULL));
+    g_assert_cmpstr(saved, ==, flat);
+    g_free(saved);
+    g_free(path);
+
+    /* Editing an included file is detected */
+    g_free(profile_test_write(dir, "common.inc", "whitelist ${HOME}/edited\n"));
+    g_assert_true(profile_sources_changed(sources));
+    g_hash_table_unref(sources);
+
+    g_free(flat);
+    stringset_delete(profiles);
+    g_free(second);
+    g_free(first);
+    g_free(common);
+    profile_test_cleanup(dir);
+    g_free(dir);
+}
+
+void test_profile_path()
+{
+    gchar *path1 = profile_path(100000, "app", "Audio,Camera");
+    gchar *path2 = profile_path(100000, "app", "Audio");
+    gchar *path3 = profile_path(100001, "app", "Audio");
+    g_assert_true(g_str_has_prefix(path1, RUNTIME_PROFILES_DIRECTORY "/100000/app-"));
+    g_assert_true(g_str_has_suffix(path1, ".profile"));
+    g_assert_cmpstr(path1, !=, path2);
+    g_assert_true(g_str_has_prefix(path3, RUNTIME_PROFILES_DIRECTORY "/100001/app-"));
+    g_free(path3);
+    g_free(path2);
+    g_free(path1);
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/sailjaild/profile/flatten", test_profile_flatten);
+    g_test_add_func("/sailjaild/profile/path", test_profile_path);
+
+    return g_test_run();
+}
@@ -36,10 +36,16 @@
 
 #include "settings.h"
 #include "appinfo.h"
+#include "appcache.h"
+#include "permset.h"
 #include "stringset.h"
+#include "journal.h"
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <locale.h>
+#include <stdio.h>
+#include <unistd.h>
 
 /* ========================================================================= *
  * MOCK DATA
@@ -51,6 +57,9 @@
 
 typedef struct {
     bool mck_guest_valid;
+    uid_t mck_max_user;
+    uid_t mck_current_user;
+    gint mck_resident_limit;
     const gchar *mck_allowlist_value;
     stringset_t *mck_ctl_available_permissions;
     stringset_t *mck_ctl_valid_applications;
@@ -60,6 +69,9 @@ void
 settings_test_mock_init(settings_test_mock_t *mock)
 {
     mock->mck_guest_valid = true;
+    mock->mck_max_user = MAX_USER;
+    mock->mck_current_user = MIN_USER;
+    mock->mck_resident_limit = 0;
     mock->mck_allowlist_value = NULL;
     mock->mck_ctl_available_permissions = stringset_create();
     stringset_add_item(mock->mck_ctl_available_permissions, "Audio");
@@ -85,8 +97,15 @@ __wrap_control_min_user(const control_t *self)
 uid_t
 __wrap_control_max_user(const control_t *self)
 {
-    (void)self; // unused
-    return MAX_USER;
+    const settings_test_mock_t *mock = (const settings_test_mock_t *)self;
+    return mock->mck_max_user;
+}
+
+uid_t
+__wrap_control_current_user(const control_t *self)
+{
+    const settings_test_mock_t *mock = (const settings_test_mock_t *)self;
+    return mock->mck_current_user;
 }
 
 bool
@@ -96,13 +115,23 @@ __wrap_control_user_is_guest(const control_t *self, uid_t uid)
     return uid == GUEST_USER;
 }
 
+GList *
+__wrap_control_user_list(const control_t *self)
+{
+    const settings_test_mock_t *mock = (const settings_test_mock_t *)self;
+    GList *list = NULL;
+    for( uid_t uid = mock->mck_max_user; uid >= MIN_USER; --uid )
+        list = g_list_prepend(list, GUINT_TO_POINTER(uid));
+    return list;
+}
+
 bool
 __wrap_control_valid_user(const control_t *self, uid_t uid)
 {
     const settings_test_mock_t *mock = (const settings_test_mock_t *)self;
     if( uid == GUEST_USER )
         return mock->mck_guest_valid;
-    return uid >= MIN_USER && uid <= MAX_USER;
+    return uid >= MIN_USER && uid <= mock->mck_max_user;
 }
 
 bool
@@ -116,6 +145,12 @@ const stringset_t *
 __wrap_control_available_permissions(const control_t *self)
 {
     const settings_test_mock_t *mock = (const settings_test_mock_t *)self;
+
+    /* Available permissions are registered by permissions module */
+    for( const GList *iter = stringset_list(mock->mck_ctl_available_permissions);
+         iter; iter = iter->next )
+        permset_intern(iter->data);
+
     return mock->mck_ctl_available_permissions;
 }
 
@@ -161,6 +196,16 @@ __wrap_config_stringset(config_t *self, const gchar *sec, const gchar *key)
     return set;
 }
 
+gint
+__wrap_config_integer(const config_t *self, const gchar *sec, const gchar *key, gint def)
+{
+    const settings_test_mock_t *mock = (const settings_test_mock_t *)self;
+    if( !g_strcmp0(sec, "Settings") &&
+        !g_strcmp0(key, "ResidentLimit") )
+        return mock->mck_resident_limit;
+    return def;
+}
+
 bool
 __wrap_config_boolean(config_t *self, const gchar *sec, const gchar *key, bool def)
 {
@@ -177,12 +222,40 @@ test_settings_user_path(void)
     return g_strdup_printf(SHAREDSTATEDIR "/sailjail/settings/user-1000.settings");
 }
 
+static gchar *
+test_settings_journal_path(void)
+{
+    return g_strdup_printf(SHAREDSTATEDIR "/sailjail/settings/user-1000.journal");
+}
+
+static void
+test_settings_remove_journal(void)
+{
+    gchar *path = test_settings_journal_path();
+    g_unlink(path);
+    g_free(path);
+}
+
 static void
 test_settings_write_user_data(const gchar *data)
 {
     gchar *path = test_settings_user_path();
     g_assert_true(g_file_set_contents(path, data, -1, NULL));
     g_free(path);
+    test_settings_remove_journal();
+}
+
+static void
+test_settings_remove_uid_data(uid_t uid)
+{
+    gchar *path = g_strdup_printf(SHAREDSTATEDIR "/sailjail/settings/user-%u.settings",
+                                  (unsigned)uid);
+    g_unlink(path);
+    g_free(path);
+    path = g_strdup_printf(SHAREDSTATEDIR "/sailjail/settings/user-%u.journal",
+                           (unsigned)uid);
+    g_unlink(path);
+    g_free(path);
 }
 
 static gchar *
@@ -213,6 +286,13 @@ __wrap_applications_config(applications_t *self)
     return (config_t *)mock;
 }
 
+appcache_t *
+__wrap_applications_appcache(const applications_t *self)
+{
+    (void)self; // unused
+    return NULL;
+}
+
 /* ========================================================================= *
  * MOCK MIGRATOR FUNCTIONS
  * ========================================================================= */
@@ -259,9 +339,43 @@ void test_settings_load(gconstpointer user_data)
     g_assert_nonnull(appsettings);
     g_assert_cmpint(appsettings_get_allowed(appsettings), ==, APP_ALLOWED_ALWAYS);
     g_assert_cmpint(appsettings_get_agreed(appsettings), ==, APP_ALLOWED_UNSET);
-    const stringset_t *granted = appsettings_get_granted(appsettings);
-    g_assert_cmpint(stringset_size(granted), ==, 1);
-    g_assert_true(stringset_has_item(granted, "Internet"));
+    const permset_t *granted = appsettings_get_granted(appsettings);
+    g_assert_cmpint(permset_size(granted), ==, 1);
+    g_assert_true(permset_has_name(granted, "Internet"));
+    settings_delete(settings);
+}
+
+void test_settings_rethink_users(gconstpointer user_data)
+{
+    settings_test_mock_t *mock = (settings_test_mock_t *)user_data;
+    settings_t *settings = settings_create((config_t *)user_data, (control_t *)user_data);
+    GHashTable *added = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GHashTable *removed = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_assert_nonnull(settings_get_usersettings(settings, 1000));
+
+    /* Guest settings are not loaded when guest user appears */
+    g_hash_table_add(added, GUINT_TO_POINTER(GUEST_USER));
+    settings_rethink_users(settings, added, removed);
+    g_assert_null(settings_get_usersettings(settings, GUEST_USER));
+    g_hash_table_remove_all(added);
+
+    /* Settings of still valid users are kept */
+    g_assert_nonnull(settings_add_usersettings(settings, GUEST_USER));
+    g_hash_table_add(removed, GUINT_TO_POINTER(1000));
+    g_hash_table_add(removed, GUINT_TO_POINTER(GUEST_USER));
+    settings_rethink_users(settings, added, removed);
+    g_assert_nonnull(settings_get_usersettings(settings, 1000));
+    g_assert_nonnull(settings_get_usersettings(settings, GUEST_USER));
+
+    /* Settings of removed users are dropped, others left as is */
+    mock->mck_guest_valid = false;
+    settings_rethink_users(settings, added, removed);
+    g_assert_nonnull(settings_get_usersettings(settings, 1000));
+    g_assert_null(settings_get_usersettings(settings, GUEST_USER));
+    mock->mck_guest_valid = true;
+
+    g_hash_table_unref(removed);
+    g_hash_table_unref(added);
     settings_delete(settings);
 }
 
@@ -276,12 +390,38 @@ void test_settings_allowlist_launch(gconstpointer user_data)
     appsettings_t *appsettings = settings_add_appsettings(settings, 1000, "test-app");
     g_assert_nonnull(appsettings);
     g_assert_cmpint(appsettings_get_allowed(appsettings), ==, APP_ALLOWED_ALWAYS);
-    g_assert_true(stringset_has_item(appsettings_get_granted(appsettings), "Internet"));
+    g_assert_true(permset_has_name(appsettings_get_granted(appsettings), "Internet"));
 
     settings_delete(settings);
     mock->mck_allowlist_value = NULL;
 }
 
+void test_settings_take_changes(gconstpointer user_data)
+{
+    settings_t *settings = settings_create((config_t *)user_data, (control_t *)user_data);
+    appsettings_t *appsettings = settings_add_appsettings(settings, 1000, "test-app");
+    g_assert_nonnull(appsettings);
+    g_variant_unref(g_variant_ref_sink(settings_take_changes(settings, "test-app")));
+
+    appsettings_set_allowed(appsettings, APP_ALLOWED_ALWAYS);
+    appsettings_set_agreed(appsettings, APP_AGREED_YES);
+
+    GVariant *changes = g_variant_ref_sink(settings_take_changes(settings, "test-app"));
+    g_assert_cmpint(g_variant_n_children(changes), ==, 1);
+    guint32 uid = 0, mask = 0;
+    g_variant_get_child(changes, 0, "(uu)", &uid, &mask);
+    g_assert_cmpuint(uid, ==, 1000);
+    g_assert_cmpuint(mask, ==, APP_CHANGE_ALLOWED | APP_CHANGE_AGREED | APP_CHANGE_GRANTED);
+    g_variant_unref(changes);
+
+    /* Changes are reported only once */
+    changes = g_variant_ref_sink(settings_take_changes(settings, "test-app"));
+    g_assert_cmpint(g_variant_n_children(changes), ==, 0);
+    g_variant_unref(changes);
+
+    settings_delete(settings);
+}
+
 void test_settings_compatibility_permissions_persist(gconstpointer user_data)
 {
     settings_t *settings = settings_create((config_t *)user_data, (control_t *)user_data);
@@ -317,7 +457,7 @@ void test_settings_mode_transition_compatibility(gconstpointer user_data)
     appsettings_t *appsettings = settings_get_appsettings(settings, 1000, "default-app");
     g_assert_nonnull(appsettings);
     g_assert_cmpint(appsettings_get_allowed(appsettings), ==, APP_ALLOWED_UNSET);
-    g_assert_cmpint(stringset_size(appsettings_get_granted(appsettings)), ==, 0);
+    g_assert_cmpint(permset_size(appsettings_get_granted(appsettings)), ==, 0);
 
     settings_delete(settings);
 }
@@ -339,9 +479,163 @@ void test_settings_mode_transition_none(gconstpointer user_data)
     appsettings_t *appsettings = settings_get_appsettings(settings, 1000, "disabled-app");
     g_assert_nonnull(appsettings);
     g_assert_cmpint(appsettings_get_allowed(appsettings), ==, APP_ALLOWED_UNSET);
-    g_assert_cmpint(stringset_size(appsettings_get_granted(appsettings)), ==, 0);
+    g_assert_cmpint(permset_size(appsettings_get_granted(appsettings)), ==, 0);
+
+    settings_delete(settings);
+}
+
+void test_settings_journal_replay(gconstpointer user_data)
+{
+    test_settings_write_user_data(
+        "[test-app]\n"
+        "Allowed=1\n"
+        "Agreed=0\n"
+        "Autogrant=0\n"
+        "Granted=Internet\n"
+        "Permissions=Internet\n");
+
+    /* Journal two successive changes to the same application */
+    const gchar *granted[] = { "Internet", NULL };
+    const app_agreed_t agreed[] = { APP_AGREED_YES, APP_AGREED_NO };
+    gsize ends[G_N_ELEMENTS(agreed)];
+    gchar *path = test_settings_journal_path();
+    journal_t *journal = journal_create(path, "(siiiiasas)");
+    for( size_t i = 0; i < G_N_ELEMENTS(agreed); ++i ) {
+        GVariant *record = g_variant_new("(siiii^as^as)", "test-app",
+                                         APP_ALLOWED_ALWAYS, agreed[i],
+                                         APP_GRANT_DEFAULT, APP_MODE_NORMAL,
+                                         granted, granted);
+        g_assert_true(journal_append(journal, record));
+        g_assert_true(journal_sync(journal));
+        ends[i] = journal_size(journal);
+    }
+    journal_delete(journal);
+
+    gchar *data = NULL;
+    gsize  size = 0;
+    g_assert_true(g_file_get_contents(path, &data, &size, NULL));
+
+    /* Simulate crash after writing any number of bytes */
+    for( gsize offset = 0; offset <= size; ++offset ) {
+        app_agreed_t expect = APP_AGREED_UNSET;
+        for( size_t i = 0; i < G_N_ELEMENTS(agreed) && ends[i] <= offset; ++i )
+            expect = agreed[i];
+
+        g_assert_true(g_file_set_contents(path, data, offset, NULL));
+
+        settings_t *settings = settings_create((config_t *)user_data, (control_t *)user_data);
+        appsettings_t *appsettings = settings_get_appsettings(settings, 1000, "test-app");
+        g_assert_nonnull(appsettings);
+        g_assert_cmpint(appsettings_get_agreed(appsettings), ==, expect);
+        g_assert_cmpint(appsettings_get_allowed(appsettings), ==, APP_ALLOWED_ALWAYS);
+        g_assert_true(permset_has_name(appsettings_get_granted(appsettings), "Internet"));
+        settings_delete(settings);
+    }
+
+    /* Compaction folds journal into settings file */
+    settings_t *settings = settings_create((config_t *)user_data, (control_t *)user_data);
+    settings_save_user(settings, 1000);
+    settings_delete(settings);
+    gchar *saved = test_settings_read_user_data();
+    g_assert_nonnull(g_strstr_len(saved, -1, "Agreed=2"));
+    g_free(saved);
+    gchar *journaled = NULL;
+    g_assert_true(g_file_get_contents(path, &journaled, &size, NULL));
+    g_assert_cmpuint(size, ==, 0);
+    g_free(journaled);
+
+    test_settings_remove_journal();
+    g_free(data);
+    g_free(path);
+}
+
+void test_settings_evict(gconstpointer user_data)
+{
+    settings_test_mock_t *mock = (settings_test_mock_t *)user_data;
+    const uid_t other = MIN_USER + 1;
+    mock->mck_max_user = other;
+    mock->mck_resident_limit = 1;
+    test_settings_remove_uid_data(other);
+
+    /* Only session user settings are loaded at startup */
+    settings_t *settings = settings_create((config_t *)mock, (control_t *)mock);
+    g_assert_nonnull(settings_get_usersettings(settings, MIN_USER));
+    g_assert_null(settings_get_usersettings(settings, other));
+
+    /* Other users are loaded on first access */
+    appsettings_t *appsettings = settings_appsettings(settings, other, "test-app");
+    g_assert_nonnull(appsettings);
+    g_assert_nonnull(settings_get_usersettings(settings, other));
+
+    /* Changes that have not been broadcast yet keep user resident */
+    appsettings_set_allowed(appsettings, APP_ALLOWED_NEVER);
+    settings_evict_now(settings);
+    g_assert_nonnull(settings_get_usersettings(settings, other));
+
+    /* Over limit users are evicted, session user is pinned */
+    g_variant_unref(g_variant_ref_sink(settings_take_changes(settings, "test-app")));
+    settings_evict_now(settings);
+    g_assert_null(settings_get_usersettings(settings, other));
+    g_assert_nonnull(settings_get_usersettings(settings, MIN_USER));
+
+    /* Unsaved changes were stored before eviction */
+    appsettings = settings_appsettings(settings, other, "test-app");
+    g_assert_nonnull(appsettings);
+    g_assert_cmpint(appsettings_get_allowed(appsettings), ==, APP_ALLOWED_NEVER);
+
+    settings_delete(settings);
+    test_settings_remove_uid_data(other);
+    mock->mck_resident_limit = 0;
+    mock->mck_max_user = MAX_USER;
+}
+
+void test_settings_evict_rethink(gconstpointer user_data)
+{
+    settings_test_mock_t *mock = (settings_test_mock_t *)user_data;
+    const uid_t other = MIN_USER + 1;
+    mock->mck_max_user = other;
+    mock->mck_resident_limit = 1;
+    test_settings_remove_uid_data(other);
+
+    gchar *path = g_strdup_printf(SHAREDSTATEDIR "/sailjail/settings/user-%u.settings",
+                                  (unsigned)other);
+    g_assert_true(g_file_set_contents(path,
+                                      "[test-app]\n"
+                                      "Allowed=1\n"
+                                      "Agreed=0\n"
+                                      "Autogrant=0\n"
+                                      "Granted=Internet\n"
+                                      "Permissions=Internet\n", -1, NULL));
+    g_free(path);
+
+    settings_t *settings = settings_create((config_t *)mock, (control_t *)mock);
+    appsettings_t *appsettings = settings_appsettings(settings, other, "test-app");
+    g_assert_nonnull(appsettings);
+    g_assert_true(permset_has_name(appsettings_get_granted(appsettings), "Internet"));
+
+    g_variant_unref(g_variant_ref_sink(settings_take_changes(settings, "test-app")));
+    settings_evict_now(settings);
+    g_assert_null(settings_get_usersettings(settings, other));
 
+    /* Loading and evicting unchanged settings does not journal */
+    path = g_strdup_printf(SHAREDSTATEDIR "/sailjail/settings/user-%u.journal",
+                           (unsigned)other);
+    g_assert_false(g_file_test(path, G_FILE_TEST_EXISTS));
+    g_free(path);
+
+    /* Application permissions change while user is not resident */
+    stringset_remove_item(mock->mck_ctl_available_permissions, "Internet");
+
+    /* Reloaded settings are re-evaluated against current permissions */
+    appsettings = settings_appsettings(settings, other, "test-app");
+    g_assert_nonnull(appsettings);
+    g_assert_false(permset_has_name(appsettings_get_granted(appsettings), "Internet"));
+
+    stringset_add_item(mock->mck_ctl_available_permissions, "Internet");
     settings_delete(settings);
+    test_settings_remove_uid_data(other);
+    mock->mck_resident_limit = 0;
+    mock->mck_max_user = MAX_USER;
 }
 
 /* ========================================================================= *
@@ -359,10 +653,15 @@ int main(int argc, char **argv)
 
     g_test_add_data_func("/sailjaild/settings/settings/create_and_delete", &mock, test_settings_create_delete);
     g_test_add_data_func("/sailjaild/settings/settings/load", &mock, test_settings_load);
+    g_test_add_data_func("/sailjaild/settings/settings/rethink_users", &mock, test_settings_rethink_users);
     g_test_add_data_func("/sailjaild/settings/settings/allowlist_launch", &mock, test_settings_allowlist_launch);
+    g_test_add_data_func("/sailjaild/settings/settings/take_changes", &mock, test_settings_take_changes);
     g_test_add_data_func("/sailjaild/settings/settings/compatibility_permissions_persist", &mock, test_settings_compatibility_permissions_persist);
     g_test_add_data_func("/sailjaild/settings/settings/mode_transition_compatibility", &mock, test_settings_mode_transition_compatibility);
     g_test_add_data_func("/sailjaild/settings/settings/mode_transition_none", &mock, test_settings_mode_transition_none);
+    g_test_add_data_func("/sailjaild/settings/settings/journal_replay", &mock, test_settings_journal_replay);
+    g_test_add_data_func("/sailjaild/settings/settings/evict", &mock, test_settings_evict);
+    g_test_add_data_func("/sailjaild/settings/settings/evict_rethink", &mock, test_settings_evict_rethink);
 
     return g_test_run();
 }
@@ -104,6 +104,35 @@ void test_stringset_remove_item(stringset_test_data_t *data, gconstpointer user_
     g_assert_cmpint(stringset_size(data->set), ==, 1);
 }
 
+void test_stringset_remove_order(stringset_test_data_t *data, gconstpointer user_data)
+{
+    (void)user_data; // unused
+    g_assert_true(stringset_remove_item(data->set, "bar"));
+    g_assert_true(stringset_add_item(data->set, "bar"));
+    gchar *str = stringset_to_string(data->set);
+    g_assert_cmpstr(str, ==, "foo,baz,bar");
+    g_free(str);
+    g_assert_true(stringset_remove_item(data->set, "bar"));
+    g_assert_true(stringset_remove_item(data->set, "foo"));
+    str = stringset_to_string(data->set);
+    g_assert_cmpstr(str, ==, "baz");
+    g_free(str);
+    g_assert_true(stringset_clear(data->set));
+    g_assert_null(stringset_list(data->set));
+    g_assert_false(stringset_clear(data->set));
+}
+
+void test_stringset_add_item_steal()
+{
+    stringset_t *set = stringset_create();
+    g_assert_true(stringset_add_item_steal(set, g_strdup("foo")));
+    g_assert_false(stringset_add_item_steal(set, g_strdup("foo")));
+    g_assert_true(stringset_add_item_fmt(set, "%s-%d", "bar", 1));
+    g_assert_true(stringset_has_item(set, "bar-1"));
+    g_assert_cmpint(stringset_size(set), ==, 2);
+    stringset_delete(set);
+}
+
 void test_stringset_size(stringset_test_data_t *data, gconstpointer user_data)
 {
     (void)user_data; // unused
@@ -238,6 +267,9 @@ int main(int argc, char **argv)
     g_test_add_func("/sailjaild/stringset/add_item", test_stringset_add_item);
     g_test_add("/sailjaild/stringset/remove_item", stringset_test_data_t, NULL,
                stringset_test_set_up, test_stringset_remove_item, stringset_test_tear_down);
+    g_test_add("/sailjaild/stringset/remove_order", stringset_test_data_t, NULL,
+               stringset_test_set_up, test_stringset_remove_order, stringset_test_tear_down);
+    g_test_add_func("/sailjaild/stringset/add_item_steal", test_stringset_add_item_steal);
     g_test_add("/sailjaild/stringset/size", stringset_test_data_t, NULL,
                stringset_test_set_up, test_stringset_size, stringset_test_tear_down);
     g_test_add("/sailjaild/stringset/empty", stringset_test_data_t, NULL,
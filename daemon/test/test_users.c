@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "users.h"
+#include "config.h"
+#include "control.h"
+#include "util.h"
+
+#include <glib.h>
+#include <locale.h>
+#include <pwd.h>
+#include <string.h>
+
+/* ========================================================================= *
+ * MOCK DATA
+ * ========================================================================= */
+
+typedef struct {
+    gint        mck_uid_min;
+    gint        mck_uid_max;
+    gint        mck_uid_guest;
+    GArray     *mck_passwd;
+    guint       mck_passwd_pos;
+    GHashTable *mck_added;
+    GHashTable *mck_removed;
+    guint       mck_notifies;
+    void      (*mck_monitor_cb)(const gchar *name, gpointer aptr);
+    gpointer    mck_monitor_aptr;
+} users_test_mock_t;
+
+static users_test_mock_t mock;
+
+static void
+users_test_mock_init(gint uid_min, gint uid_max, gint uid_guest)
+{
+    mock.mck_uid_min = uid_min;
+    mock.mck_uid_max = uid_max;
+    mock.mck_uid_guest = uid_guest;
+    mock.mck_passwd = g_array_new(false, true, sizeof(struct passwd));
+    mock.mck_passwd_pos = 0;
+    mock.mck_added = g_hash_table_new(g_direct_hash, g_direct_equal);
+    mock.mck_removed = g_hash_table_new(g_direct_hash, g_direct_equal);
+    mock.mck_notifies = 0;
+    mock.mck_monitor_cb = NULL;
+    mock.mck_monitor_aptr = NULL;
+}
+
+static void
+users_test_mock_quit(void)
+{
+    g_array_free(mock.mck_passwd, true);
+    g_hash_table_unref(mock.mck_added);
+    g_hash_table_unref(mock.mck_removed);
+}
+
+static void
+users_test_add_passwd(uid_t uid)
+{
+    struct passwd pw = {
+        .pw_name = "user",
+        .pw_uid  = uid,
+        .pw_gid  = uid,
+        .pw_dir  = "/home/user",
+    };
+    g_array_append_val(mock.mck_passwd, pw);
+}
+
+static void
+users_test_remove_passwd(uid_t uid)
+{
+    for( guint i = 0; i < mock.mck_passwd->len; ++i ) {
+        if( g_array_index(mock.mck_passwd, struct passwd, i).pw_uid == uid ) {
+            g_array_remove_index(mock.mck_passwd, i);
+            break;
+        }
+    }
+}
+
+/* Simulate passwd change and flush the resulting rescan */
+static void
+users_test_passwd_changed(users_t *users)
+{
+    g_hash_table_remove_all(mock.mck_added);
+    g_hash_table_remove_all(mock.mck_removed);
+    mock.mck_notifies = 0;
+    g_assert_nonnull(mock.mck_monitor_cb);
+    mock.mck_monitor_cb(USERS_PATTERN, mock.mck_monitor_aptr);
+    g_list_free(users_user_list(users));
+}
+
+/* ========================================================================= *
+ * MOCK FUNCTIONS
+ * ========================================================================= */
+
+void
+__wrap_setpwent(void)
+{
+    mock.mck_passwd_pos = 0;
+}
+
+struct passwd *
+__wrap_getpwent(void)
+{
+    if( mock.mck_passwd_pos >= mock.mck_passwd->len )
+        return NULL;
+    return &g_array_index(mock.mck_passwd, struct passwd, mock.mck_passwd_pos++);
+}
+
+void
+__wrap_endpwent(void)
+{
+}
+
+const config_t *
+__wrap_control_config(const control_t *self)
+{
+    return (const config_t *)self;
+}
+
+gint
+__wrap_config_integer(const config_t *self, const gchar *sec,
+                      const gchar *key, gint def)
+{
+    (void)self; // unused
+    if( g_strcmp0(sec, "Users") )
+        return def;
+    if( !g_strcmp0(key, "UidMin") )
+        return mock.mck_uid_min;
+    if( !g_strcmp0(key, "UidMax") )
+        return mock.mck_uid_max;
+    if( !g_strcmp0(key, "GuestUid") )
+        return mock.mck_uid_guest;
+    return def;
+}
+
+void
+__wrap_control_on_users_changed(control_t *self, GHashTable *added,
+                                GHashTable *removed)
+{
+    (void)self; // unused
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, added);
+    while( g_hash_table_iter_next(&iter, &key, NULL) )
+        g_hash_table_add(mock.mck_added, key);
+    g_hash_table_iter_init(&iter, removed);
+    while( g_hash_table_iter_next(&iter, &key, NULL) )
+        g_hash_table_add(mock.mck_removed, key);
+    mock.mck_notifies += 1;
+}
+
+guint
+__wrap_watcher_add(const gchar *dir, const gchar *pattern,
+                   void (*notify)(const gchar *name, gpointer aptr),
+                   gpointer aptr)
+{
+    (void)dir; // unused
+    (void)pattern; // unused
+    mock.mck_monitor_cb = notify;
+    mock.mck_monitor_aptr = aptr;
+    return 1;
+}
+
+void
+__wrap_watcher_remove_at(guint *pid)
+{
+    *pid = 0;
+    mock.mck_monitor_cb = NULL;
+    mock.mck_monitor_aptr = NULL;
+}
+
+/* ========================================================================= *
+ * USERS TESTS
+ * ========================================================================= */
+
+void test_users_range()
+{
+    users_test_mock_init(100000, 100999, 105000);
+    const uid_t uids[] = { 0, 1000, 100000, 100500, 100999, 101000, 105000 };
+    for( size_t i = 0; i < G_N_ELEMENTS(uids); ++i )
+        users_test_add_passwd(uids[i]);
+
+    users_t *users = users_create((control_t *)&mock);
+    g_assert_cmpuint(users_first_user(users), ==, 100000);
+    g_assert_cmpuint(users_last_user(users), ==, 100999);
+    g_assert_true(users_user_is_guest(users, 105000));
+    g_assert_false(users_user_is_guest(users, 100000));
+
+    g_assert_false(users_user_exists(users, 0));
+    g_assert_false(users_user_exists(users, 1000));
+    g_assert_true(users_user_exists(users, 100000));
+    g_assert_true(users_user_exists(users, 100500));
+    g_assert_false(users_user_exists(users, 100501));
+    g_assert_true(users_user_exists(users, 100999));
+    g_assert_false(users_user_exists(users, 101000));
+    g_assert_true(users_user_exists(users, 105000));
+
+    /* Only existing users, in ascending order */
+    const uid_t expected[] = { 100000, 100500, 100999, 105000 };
+    GList *list = users_user_list(users);
+    g_assert_cmpuint(g_list_length(list), ==, G_N_ELEMENTS(expected));
+    size_t i = 0;
+    for( GList *iter = list; iter; iter = iter->next )
+        g_assert_cmpuint(GPOINTER_TO_UINT(iter->data), ==, expected[i++]);
+    g_list_free(list);
+
+    users_delete(users);
+    users_test_mock_quit();
+}
+
+void test_users_invalid_range()
+{
+    /* Falls back to defaults */
+    users_test_mock_init(100999, 100000, -1);
+    users_t *users = users_create((control_t *)&mock);
+    g_assert_cmpuint(users_first_user(users), ==, 100000);
+    g_assert_cmpuint(users_last_user(users), ==, 100007);
+    g_assert_true(users_user_is_guest(users, 105000));
+    users_delete(users);
+    users_test_mock_quit();
+}
+
+void test_users_changed()
+{
+    users_test_mock_init(100000, 100999, 105000);
+    users_test_add_passwd(100000);
+    users_test_add_passwd(100500);
+    users_t *users = users_create((control_t *)&mock);
+
+    /* Only the difference gets notified */
+    users_test_remove_passwd(100500);
+    users_test_add_passwd(100700);
+    users_test_passwd_changed(users);
+    g_assert_cmpuint(mock.mck_notifies, ==, 1);
+    g_assert_cmpuint(g_hash_table_size(mock.mck_added), ==, 1);
+    g_assert_true(g_hash_table_contains(mock.mck_added, GUINT_TO_POINTER(100700)));
+    g_assert_cmpuint(g_hash_table_size(mock.mck_removed), ==, 1);
+    g_assert_true(g_hash_table_contains(mock.mck_removed, GUINT_TO_POINTER(100500)));
+    g_assert_false(users_user_exists(users, 100500));
+    g_assert_true(users_user_exists(users, 100700));
+
+    /* No notification without changes */
+    users_test_passwd_changed(users);
+    g_assert_cmpuint(mock.mck_notifies, ==, 0);
+
+    users_delete(users);
+    users_test_mock_quit();
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/sailjaild/users/range", test_users_range);
+    g_test_add_func("/sailjaild/users/invalid_range", test_users_invalid_range);
+    g_test_add_func("/sailjaild/users/changed", test_users_changed);
+
+    return g_test_run();
+}
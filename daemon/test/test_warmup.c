@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "warmup.h"
+#include "appinfo.h"
+#include "control.h"
+#include "prompter.h"
+#include "session.h"
+#include "settings.h"
+#include "stringset.h"
+
+#include <glib.h>
+#include <locale.h>
+
+/* ========================================================================= *
+ * MOCK DATA
+ * ========================================================================= */
+
+#define WARMUP_TEST_USER  100000
+#define WARMUP_TEST_APPS  40
+
+typedef struct {
+    uid_t        mck_current_user;
+    stringset_t *mck_applications;
+    stringset_t *mck_allowed;
+    bool         mck_prewarm;
+    guint        mck_preloads;
+    uid_t        mck_preload_uid;
+    guint        mck_variants;
+    guint        mck_jail_args;
+    guint        mck_appservices;
+    guint        mck_prewarms;
+} warmup_test_mock_t;
+
+static warmup_test_mock_t mock;
+
+static void
+warmup_test_mock_init(void)
+{
+    mock.mck_current_user = WARMUP_TEST_USER;
+    mock.mck_applications = stringset_create();
+    for( guint i = 0; i < WARMUP_TEST_APPS; ++i )
+        stringset_add_item_fmt(mock.mck_applications, "test-app-%u", i);
+    mock.mck_allowed = stringset_create();
+    stringset_add_item(mock.mck_allowed, "test-app-0");
+    stringset_add_item(mock.mck_allowed, "test-app-1");
+    mock.mck_prewarm = true;
+}
+
+static void
+warmup_test_mock_reset(void)
+{
+    mock.mck_current_user = WARMUP_TEST_USER;
+    mock.mck_prewarm = true;
+    mock.mck_preloads = 0;
+    mock.mck_preload_uid = 0;
+    mock.mck_variants = 0;
+    mock.mck_jail_args = 0;
+    mock.mck_appservices = 0;
+    mock.mck_prewarms = 0;
+}
+
+/* ========================================================================= *
+ * MOCK CONTROL FUNCTIONS
+ * ========================================================================= */
+
+uid_t
+__wrap_control_current_user(const control_t *self)
+{
+    (void)self; // unused
+    return mock.mck_current_user;
+}
+
+settings_t *
+__wrap_control_settings(const control_t *self)
+{
+    return (settings_t *)self;
+}
+
+service_t *
+__wrap_control_service(const control_t *self)
+{
+    return (service_t *)self;
+}
+
+appservices_t *
+__wrap_control_appservices(const control_t *self)
+{
+    return (appservices_t *)self;
+}
+
+const stringset_t *
+__wrap_control_available_applications(const control_t *self)
+{
+    (void)self; // unused
+    return mock.mck_applications;
+}
+
+appinfo_t *
+__wrap_control_appinfo(const control_t *self, const char *appname)
+{
+    (void)appname; // unused
+    return (appinfo_t *)self;
+}
+
+const stringset_t *
+__wrap_control_jail_args(const control_t *self, const appinfo_t *appinfo,
+                         const permset_t *granted)
+{
+    (void)self; // unused
+    (void)appinfo; // unused
+    (void)granted; // unused
+    mock.mck_jail_args += 1;
+    return NULL;
+}
+
+/* ========================================================================= *
+ * MOCK SETTINGS FUNCTIONS
+ * ========================================================================= */
+
+bool
+__wrap_settings_preload_user(settings_t *self, uid_t uid)
+{
+    (void)self; // unused
+    mock.mck_preloads += 1;
+    mock.mck_preload_uid = uid;
+    return true;
+}
+
+appsettings_t *
+__wrap_settings_get_appsettings(const settings_t *self, uid_t uid,
+                                const char *appname)
+{
+    (void)uid; // unused
+    if( !stringset_has_item(mock.mck_allowed, appname) )
+        return NULL;
+    return (appsettings_t *)self;
+}
+
+app_allowed_t
+__wrap_appsettings_get_allowed(const appsettings_t *self)
+{
+    (void)self; // unused
+    return APP_ALLOWED_ALWAYS;
+}
+
+const permset_t *
+__wrap_appsettings_get_granted(appsettings_t *self)
+{
+    (void)self; // unused
+    return NULL;
+}
+
+/* ========================================================================= *
+ * MOCK OTHER FUNCTIONS
+ * ========================================================================= */
+
+prompter_t *
+__wrap_service_prompter(service_t *self)
+{
+    return (prompter_t *)self;
+}
+
+bool
+__wrap_prompter_prewarm(prompter_t *self)
+{
+    (void)self; // unused
+    mock.mck_prewarms += 1;
+    return mock.mck_prewarm;
+}
+
+bool
+__wrap_appinfo_valid(const appinfo_t *self)
+{
+    (void)self; // unused
+    return true;
+}
+
+GVariant *
+__wrap_appinfo_to_variant(const appinfo_t *self)
+{
+    (void)self; // unused
+    mock.mck_variants += 1;
+    return g_variant_ref_sink(g_variant_new_boolean(true));
+}
+
+void
+__wrap_appservices_rethink(appservices_t *self)
+{
+    (void)self; // unused
+    mock.mck_appservices += 1;
+}
+
+/* ========================================================================= *
+ * Utility
+ * ========================================================================= */
+
+static void
+warmup_test_run_stages(void)
+{
+    /* Stages run from idle callbacks, appservices sync is the last one */
+    while( !mock.mck_appservices && g_main_context_iteration(NULL, FALSE) )
+        ;
+}
+
+/* ========================================================================= *
+ * WARMUP TESTS
+ * ========================================================================= */
+
+void test_warmup_create_delete(void)
+{
+    warmup_t *warmup = warmup_create((control_t *)&mock);
+    g_assert_nonnull(warmup);
+    g_assert_false(warmup_pending(warmup));
+    warmup_delete_at(&warmup);
+    g_assert_null(warmup);
+    warmup_delete_at(&warmup);
+    g_assert_null(warmup);
+}
+
+void test_warmup_pipeline(void)
+{
+    warmup_test_mock_reset();
+    warmup_t *warmup = warmup_create((control_t *)&mock);
+
+    /* Nothing is done synchronously */
+    warmup_start(warmup, WARMUP_TEST_USER);
+    g_assert_true(warmup_pending(warmup));
+    g_assert_cmpuint(mock.mck_preloads, ==, 0);
+
+    warmup_test_run_stages();
+    g_assert_cmpuint(mock.mck_preloads, ==, 1);
+    g_assert_cmpuint(mock.mck_preload_uid, ==, WARMUP_TEST_USER);
+    g_assert_cmpuint(mock.mck_prewarms, ==, 1);
+    g_assert_cmpuint(mock.mck_variants, ==, WARMUP_TEST_APPS);
+    g_assert_cmpuint(mock.mck_jail_args, ==, stringset_size(mock.mck_allowed));
+    g_assert_cmpuint(mock.mck_appservices, ==, 1);
+
+    /* Finished only after user bus connection is made */
+    g_assert_true(warmup_pending(warmup));
+    warmup_prompter_ready(warmup, true);
+    g_assert_false(warmup_pending(warmup));
+
+    warmup_delete(warmup);
+}
+
+void test_warmup_no_prewarm(void)
+{
+    warmup_test_mock_reset();
+    mock.mck_prewarm = false;
+    warmup_t *warmup = warmup_create((control_t *)&mock);
+
+    /* Already connected or no bus: nothing to wait for */
+    warmup_start(warmup, WARMUP_TEST_USER);
+    warmup_test_run_stages();
+    g_assert_cmpuint(mock.mck_appservices, ==, 1);
+    g_assert_false(warmup_pending(warmup));
+
+    /* Unrelated connection notifications are ignored */
+    warmup_prompter_ready(warmup, true);
+    g_assert_false(warmup_pending(warmup));
+
+    warmup_delete(warmup);
+}
+
+void test_warmup_session_changed(void)
+{
+    warmup_test_mock_reset();
+    warmup_t *warmup = warmup_create((control_t *)&mock);
+
+    /* No user, nothing to warm */
+    warmup_start(warmup, SESSION_UID_UNDEFINED);
+    g_assert_false(warmup_pending(warmup));
+
+    /* Warmup for a user who is no longer in session is abandoned */
+    warmup_start(warmup, WARMUP_TEST_USER);
+    g_assert_true(g_main_context_iteration(NULL, FALSE));
+    g_assert_cmpuint(mock.mck_preloads, ==, 1);
+    mock.mck_current_user = WARMUP_TEST_USER + 1;
+    while( warmup_pending(warmup) && g_main_context_iteration(NULL, FALSE) )
+        ;
+    g_assert_false(warmup_pending(warmup));
+    g_assert_cmpuint(mock.mck_prewarms, ==, 0);
+    g_assert_cmpuint(mock.mck_appservices, ==, 0);
+
+    /* Restart for the new user */
+    warmup_start(warmup, mock.mck_current_user);
+    warmup_test_run_stages();
+    g_assert_cmpuint(mock.mck_preloads, ==, 2);
+    g_assert_cmpuint(mock.mck_preload_uid, ==, WARMUP_TEST_USER + 1);
+    g_assert_cmpuint(mock.mck_appservices, ==, 1);
+
+    warmup_delete(warmup);
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    warmup_test_mock_init();
+
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/sailjaild/warmup/create_and_delete", test_warmup_create_delete);
+    g_test_add_func("/sailjaild/warmup/pipeline", test_warmup_pipeline);
+    g_test_add_func("/sailjaild/warmup/no_prewarm", test_warmup_no_prewarm);
+    g_test_add_func("/sailjaild/warmup/session_changed", test_warmup_session_changed);
+
+    return g_test_run();
+}
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "watcher.h"
+#include "stringset.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+
+/* ========================================================================= *
+ * MOCK DATA
+ * ========================================================================= */
+
+typedef struct {
+    stringset_t *mck_names;
+    guint        mck_notifies;
+    bool         mck_rescan;
+    GMainLoop   *mck_main_loop;
+} watcher_test_mock_t;
+
+static void
+watcher_test_mock_init(watcher_test_mock_t *mock)
+{
+    mock->mck_names = stringset_create();
+    mock->mck_notifies = 0;
+    mock->mck_rescan = false;
+    mock->mck_main_loop = g_main_loop_new(NULL, FALSE);
+}
+
+static void
+watcher_test_mock_quit(watcher_test_mock_t *mock)
+{
+    stringset_delete(mock->mck_names);
+    g_main_loop_unref(mock->mck_main_loop);
+}
+
+static void
+watcher_test_mock_reset(watcher_test_mock_t *mock)
+{
+    stringset_clear(mock->mck_names);
+    mock->mck_notifies = 0;
+    mock->mck_rescan = false;
+}
+
+/* ========================================================================= *
+ * Utility
+ * ========================================================================= */
+
+static void
+watcher_test_notify_cb(const gchar *name, gpointer aptr)
+{
+    watcher_test_mock_t *mock = aptr;
+    ++mock->mck_notifies;
+    if( name )
+        stringset_add_item(mock->mck_names, name);
+    else
+        mock->mck_rescan = true;
+    g_main_loop_quit(mock->mck_main_loop);
+}
+
+static gboolean
+watcher_test_timeout_cb(gpointer aptr)
+{
+    watcher_test_mock_t *mock = aptr;
+    g_main_loop_quit(mock->mck_main_loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+watcher_test_run(watcher_test_mock_t *mock, guint ms)
+{
+    guint timeout = g_timeout_add(ms, watcher_test_timeout_cb, mock);
+    g_main_loop_run(mock->mck_main_loop);
+    g_source_remove(timeout);
+}
+
+static void
+watcher_test_settle(watcher_test_mock_t *mock, guint ms)
+{
+    /* Keep dispatching until no events arrive for a while */
+    guint notifies;
+    do {
+        notifies = mock->mck_notifies;
+        watcher_test_run(mock, ms);
+    } while( notifies != mock->mck_notifies );
+}
+
+static gchar *
+watcher_test_write(const gchar *dir, const gchar *name)
+{
+    gchar *path = g_build_filename(dir, name, NULL);
+    g_assert_true(g_file_set_contents(path, "test\n", -1, NULL));
+    return path;
+}
+
+/* ========================================================================= *
+ * WATCHER TESTS
+ * ========================================================================= */
+
+void test_watcher_filter()
+{
+    watcher_test_mock_t mock;
+    watcher_test_mock_init(&mock);
+
+    gchar *dir = g_dir_make_tmp("test_watcher-XXXXXX", NULL);
+    g_assert_nonnull(dir);
+
+    guint id = watcher_add(dir, "*.test", watcher_test_notify_cb, &mock);
+    g_assert_cmpuint(id, !=, 0);
+
+    /* Only matching basenames are reported */
+    gchar *path1 = watcher_test_write(dir, "match.test");
+    gchar *path2 = watcher_test_write(dir, "other.file");
+    watcher_test_run(&mock, 10000);
+    watcher_test_settle(&mock, 100);
+    g_assert_true(stringset_has_item(mock.mck_names, "match.test"));
+    g_assert_false(stringset_has_item(mock.mck_names, "other.file"));
+    g_assert_false(mock.mck_rescan);
+
+    /* Removal is reported too */
+    watcher_test_mock_reset(&mock);
+    g_assert_cmpint(g_unlink(path1), ==, 0);
+    watcher_test_run(&mock, 10000);
+    g_assert_true(stringset_has_item(mock.mck_names, "match.test"));
+
+    /* Nothing is reported after removing the watch */
+    watcher_remove_at(&id);
+    g_assert_cmpuint(id, ==, 0);
+    watcher_test_mock_reset(&mock);
+    g_free(path1), path1 = watcher_test_write(dir, "match.test");
+    watcher_test_run(&mock, 200);
+    g_assert_cmpuint(mock.mck_notifies, ==, 0);
+
+    g_unlink(path1);
+    g_unlink(path2);
+    g_rmdir(dir);
+    g_free(path1);
+    g_free(path2);
+    g_free(dir);
+    watcher_test_mock_quit(&mock);
+}
+
+void test_watcher_shared()
+{
+    watcher_test_mock_t mock1, mock2;
+    watcher_test_mock_init(&mock1);
+    watcher_test_mock_init(&mock2);
+
+    gchar *dir = g_dir_make_tmp("test_watcher-XXXXXX", NULL);
+    g_assert_nonnull(dir);
+
+    /* Two watches for the same directory */
+    guint id1 = watcher_add(dir, "*.one", watcher_test_notify_cb, &mock1);
+    guint id2 = watcher_add(dir, "*.two", watcher_test_notify_cb, &mock2);
+    g_assert_cmpuint(id1, !=, id2);
+
+    gchar *path1 = watcher_test_write(dir, "file.one");
+    gchar *path2 = watcher_test_write(dir, "file.two");
+    watcher_test_run(&mock2, 10000);
+    watcher_test_settle(&mock2, 100);
+    g_assert_true(stringset_has_item(mock1.mck_names, "file.one"));
+    g_assert_false(stringset_has_item(mock1.mck_names, "file.two"));
+    g_assert_true(stringset_has_item(mock2.mck_names, "file.two"));
+    g_assert_false(stringset_has_item(mock2.mck_names, "file.one"));
+
+    /* Removing one must not affect the other */
+    watcher_remove_at(&id1);
+    watcher_test_mock_reset(&mock2);
+    g_assert_cmpint(g_unlink(path2), ==, 0);
+    watcher_test_run(&mock2, 10000);
+    g_assert_true(stringset_has_item(mock2.mck_names, "file.two"));
+    watcher_remove_at(&id2);
+
+    g_unlink(path1);
+    g_rmdir(dir);
+    g_free(path1);
+    g_free(path2);
+    g_free(dir);
+    watcher_test_mock_quit(&mock1);
+    watcher_test_mock_quit(&mock2);
+}
+
+void test_watcher_missing()
+{
+    watcher_test_mock_t mock;
+    watcher_test_mock_init(&mock);
+
+    gchar *dir = g_dir_make_tmp("test_watcher-XXXXXX", NULL);
+    gchar *sub = g_build_filename(dir, "missing", NULL);
+    g_assert_nonnull(dir);
+
+    /* Appearing directory requests a rescan */
+    guint id = watcher_add(sub, "*.test", watcher_test_notify_cb, &mock);
+    g_assert_cmpint(g_mkdir(sub, 0755), ==, 0);
+    watcher_test_run(&mock, 10000);
+    g_assert_true(mock.mck_rescan);
+
+    /* As does removing it */
+    watcher_test_mock_reset(&mock);
+    g_assert_cmpint(g_rmdir(sub), ==, 0);
+    watcher_test_run(&mock, 10000);
+    g_assert_true(mock.mck_rescan);
+
+    watcher_remove(id);
+    g_rmdir(dir);
+    g_free(sub);
+    g_free(dir);
+    watcher_test_mock_quit(&mock);
+}
+
+/* ========================================================================= *
+ * MAIN
+ * ========================================================================= */
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/sailjaild/watcher/filter", test_watcher_filter);
+    g_test_add_func("/sailjaild/watcher/shared", test_watcher_shared);
+    g_test_add_func("/sailjaild/watcher/missing", test_watcher_missing);
+
+    return g_test_run();
+}
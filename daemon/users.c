@@ -38,20 +38,31 @@
 
 #include "logging.h"
 #include "util.h"
+#include "config.h"
 #include "control.h"
+#include "watcher.h"
 
 #include <pwd.h>
-#include <fnmatch.h>
-
-#include <gio/gio.h>
 
 /* ========================================================================= *
  * CONSTANTS
  * ========================================================================= */
 
-#define USERS_UID_MIN 100000
-#define USERS_UID_MAX 100007
-#define USERS_UID_GUEST 105000
+/* Defaults, can be overridden via config:
+ *
+ *   [Users]
+ *   UidMin=100000
+ *   UidMax=100007
+ *   GuestUid=105000
+ */
+#define USERS_UID_MIN_DEFAULT   100000
+#define USERS_UID_MAX_DEFAULT   100007
+#define USERS_UID_GUEST_DEFAULT 105000
+
+#define USERS_SECTION           "Users"
+#define USERS_KEY_UID_MIN       "UidMin"
+#define USERS_KEY_UID_MAX       "UidMax"
+#define USERS_KEY_UID_GUEST     "GuestUid"
 
 /* ========================================================================= *
  * Types
@@ -76,28 +87,33 @@ void         users_delete_cb(void *self);
  * USERS_ATTRIBUTES
  * ------------------------------------------------------------------------- */
 
-static control_t *users_control(const users_t *self);
+static control_t *users_control    (const users_t *self);
+static void       users_load_config(users_t *self);
 
 /* ------------------------------------------------------------------------- *
  * USERS_USER
  * ------------------------------------------------------------------------- */
 
-uid_t users_first_user   (const users_t *self);
-uid_t users_last_user    (const users_t *self);
-bool  users_user_exists  (users_t *self, uid_t uid);
-bool  users_user_is_guest(const users_t *self, uid_t uid);
+static gint users_compare_uid  (gconstpointer a, gconstpointer b);
+uid_t       users_first_user   (const users_t *self);
+uid_t       users_last_user    (const users_t *self);
+bool        users_user_exists  (users_t *self, uid_t uid);
+bool        users_user_is_guest(const users_t *self, uid_t uid);
+GList      *users_user_list    (users_t *self);
 
 /* ------------------------------------------------------------------------- *
  * USERS_NOTIFY
  * ------------------------------------------------------------------------- */
 
-static void users_notify_changed(users_t *self);
+static void users_notify_changed(users_t *self, GHashTable *added, GHashTable *removed);
 
 /* ------------------------------------------------------------------------- *
  * USERS_SCAN
  * ------------------------------------------------------------------------- */
 
-static bool     users_scan_now     (users_t *self);
+static bool     users_scan_now     (users_t *self, GHashTable *added, GHashTable *removed);
+static void     users_rescan_notify(users_t *self);
+static void     users_rescan_flush (users_t *self);
 static gboolean users_rescan_cb    (gpointer aptr);
 static void     users_rescan_later (users_t *self);
 static bool     users_cancel_rescan(users_t *self);
@@ -108,8 +124,7 @@ static bool     users_cancel_rescan(users_t *self);
 
 static void users_start_monitor(users_t *self);
 static void users_stop_monitor (users_t *self);
-static bool users_monitor_p    (const gchar *path);
-static void users_monitor_cb   (GFileMonitor *mon, GFile *file1, GFile *file2, GFileMonitorEvent event, gpointer aptr);
+static void users_monitor_cb   (const gchar *name, gpointer aptr);
 
 /* ========================================================================= *
  * USERS
@@ -120,8 +135,11 @@ struct users_t
     bool              usr_initialized;
     control_t        *usr_control;
     GHashTable       *usr_current;
+    uid_t             usr_uid_min;
+    uid_t             usr_uid_max;
+    uid_t             usr_uid_guest;
     guint             usr_rescan_id;
-    GFileMonitor     *usr_monitor_obj;
+    guint             usr_monitor_id;
 };
 
 static void
@@ -132,12 +150,16 @@ users_ctor(users_t *self, control_t *control)
     self->usr_initialized = false;
     self->usr_control     = control;
     self->usr_current     = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self->usr_uid_min     = USERS_UID_MIN_DEFAULT;
+    self->usr_uid_max     = USERS_UID_MAX_DEFAULT;
+    self->usr_uid_guest   = USERS_UID_GUEST_DEFAULT;
     self->usr_rescan_id   = 0;
-    self->usr_monitor_obj = NULL;
+    self->usr_monitor_id  = 0;
 
     /* Get initial state */
+    users_load_config(self);
     users_start_monitor(self);
-    users_scan_now(self);
+    users_scan_now(self, NULL, NULL);
 
     /* Enable notifications */
     self->usr_initialized = true;
@@ -199,27 +221,67 @@ users_control(const users_t *self)
     return self->usr_control;
 }
 
+static void
+users_load_config(users_t *self)
+{
+    const config_t *config = control_config(users_control(self));
+
+    gint min_uid   = config_integer(config, USERS_SECTION, USERS_KEY_UID_MIN,
+                                    USERS_UID_MIN_DEFAULT);
+    gint max_uid   = config_integer(config, USERS_SECTION, USERS_KEY_UID_MAX,
+                                    USERS_UID_MAX_DEFAULT);
+    gint guest_uid = config_integer(config, USERS_SECTION, USERS_KEY_UID_GUEST,
+                                    USERS_UID_GUEST_DEFAULT);
+
+    if( min_uid <= 0 || max_uid < min_uid ) {
+        log_warning("invalid user uid range %d-%d; using defaults",
+                    min_uid, max_uid);
+        min_uid = USERS_UID_MIN_DEFAULT;
+        max_uid = USERS_UID_MAX_DEFAULT;
+    }
+
+    if( guest_uid <= 0 ) {
+        log_warning("invalid guest uid %d; using default", guest_uid);
+        guest_uid = USERS_UID_GUEST_DEFAULT;
+    }
+
+    self->usr_uid_min   = (uid_t)min_uid;
+    self->usr_uid_max   = (uid_t)max_uid;
+    self->usr_uid_guest = (uid_t)guest_uid;
+
+    log_info("user uid range: %u-%u, guest uid: %u",
+             (unsigned)self->usr_uid_min, (unsigned)self->usr_uid_max,
+             (unsigned)self->usr_uid_guest);
+}
+
 /* ========================================================================= *
  * USERS_USER
  * ========================================================================= */
 
+static gint
+users_compare_uid(gconstpointer a, gconstpointer b)
+{
+    guint uid_a = GPOINTER_TO_UINT(a);
+    guint uid_b = GPOINTER_TO_UINT(b);
+    return (uid_a > uid_b) - (uid_a < uid_b);
+}
+
 uid_t
 users_first_user(const users_t *self)
 {
-    return USERS_UID_MIN;
+    return self->usr_uid_min;
 }
 
 uid_t
 users_last_user(const users_t *self)
 {
-    return USERS_UID_MAX;
+    return self->usr_uid_max;
 }
 
 bool
 users_user_exists(users_t *self, uid_t uid)
 {
-    if( users_cancel_rescan(self) )
-        users_scan_now(self);
+    users_rescan_flush(self);
 
     return g_hash_table_contains(self->usr_current, GINT_TO_POINTER(uid));
 }
@@ -227,8 +289,26 @@ users_user_exists(users_t *self, uid_t uid)
 bool
 users_user_is_guest(const users_t *self, uid_t uid)
 {
-    (void)self; // unused
-    return uid == USERS_UID_GUEST;
+    return uid == self->usr_uid_guest;
+}
+
+/** Get existing users
+ *
+ * Per-user loops should use this instead of iterating over the whole
+ * uid range, most of which is usually not in use.
+ *
+ * @param self  users object
+ *
+ * @return list of GUINT_TO_POINTER() uids in ascending order,
+ *         release with g_list_free()
+ */
+GList *
+users_user_list(users_t *self)
+{
+    users_rescan_flush(self);
+
+    GList *list = g_hash_table_get_keys(self->usr_current);
+    return g_list_sort(list, users_compare_uid);
 }
 
 /* ========================================================================= *
@@ -236,11 +316,11 @@ users_user_is_guest(const users_t *self, uid_t uid)
  * ========================================================================= */
 
 static void
-users_notify_changed(users_t *self)
+users_notify_changed(users_t *self, GHashTable *added, GHashTable *removed)
 {
     if( self->usr_initialized ) {
         log_info("USERS NOTIFY");
-        control_on_users_changed(users_control(self));
+        control_on_users_changed(users_control(self), added, removed);
     }
 }
 
@@ -249,7 +329,7 @@ users_notify_changed(users_t *self)
  * ========================================================================= */
 
 static bool
-users_scan_now(users_t *self)
+users_scan_now(users_t *self, GHashTable *added, GHashTable *removed)
 {
     users_cancel_rescan(self);
     log_info("USERS RESCAN: executing");
@@ -261,8 +341,8 @@ users_scan_now(users_t *self)
 
     setpwent();
     while( (pw = getpwent()) ) {
-        if( (pw->pw_uid >= USERS_UID_MIN && pw->pw_uid <= USERS_UID_MAX) ||
-            pw->pw_uid == USERS_UID_GUEST ) {
+        if( (pw->pw_uid >= self->usr_uid_min && pw->pw_uid <= self->usr_uid_max) ||
+            pw->pw_uid == self->usr_uid_guest ) {
             g_hash_table_add(scanned, GINT_TO_POINTER(pw->pw_uid));
         }
     }
@@ -274,6 +354,8 @@ users_scan_now(users_t *self)
     while( g_hash_table_iter_next(&iter, &key, &value) ) {
         if( !g_hash_table_contains(self->usr_current, key) ) {
             log_info("UID(%u) added", GPOINTER_TO_UINT(key));
+            if( added )
+                g_hash_table_add(added, key);
             changed = true;
         }
     }
@@ -281,6 +363,8 @@ users_scan_now(users_t *self)
     while( g_hash_table_iter_next(&iter, &key, &value) ) {
         if( !g_hash_table_contains(scanned, key) ) {
             log_info("UID(%u) removed", GPOINTER_TO_UINT(key));
+            if( removed )
+                g_hash_table_add(removed, key);
             changed = true;
         }
     }
@@ -291,6 +375,27 @@ users_scan_now(users_t *self)
     return changed;
 }
 
+static void
+users_rescan_notify(users_t *self)
+{
+    GHashTable *added   = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GHashTable *removed = g_hash_table_new(g_direct_hash, g_direct_equal);
+    if( users_scan_now(self, added, removed) )
+        users_notify_changed(self, added, removed);
+    g_hash_table_unref(removed);
+    g_hash_table_unref(added);
+}
+
+static void
+users_rescan_flush(users_t *self)
+{
+    /* Pending changes are applied and notified right away, so that
+     * listeners do not miss them when the scheduled rescan gets canceled.
+     */
+    if( users_cancel_rescan(self) )
+        users_rescan_notify(self);
+}
+
 static gboolean
 users_rescan_cb(gpointer aptr)
 {
@@ -299,8 +404,7 @@ users_rescan_cb(gpointer aptr)
     self->usr_rescan_id = 0;
 
     log_info("USERS RESCAN: triggered");
-    if( users_scan_now(self) )
-        users_notify_changed(self);
+    users_rescan_notify(self);
 
     return G_SOURCE_REMOVE;
 }
@@ -337,51 +441,25 @@ users_start_monitor(users_t *self)
 {
     users_stop_monitor(self);
 
-    GFileMonitorFlags flags = G_FILE_MONITOR_WATCH_MOVES;
-    GFile *file = g_file_new_for_path(USERS_DIRECTORY);
-    if( file ) {
-        if( (self->usr_monitor_obj = g_file_monitor_directory(file, flags, 0, 0)) ) {
-            g_signal_connect(self->usr_monitor_obj, "changed",
-                             G_CALLBACK(users_monitor_cb), self);
-            log_info("USERS MONITOR: started");
-        }
-        g_object_unref(file);
-    }
+    self->usr_monitor_id = watcher_add(USERS_DIRECTORY, USERS_PATTERN,
+                                       users_monitor_cb, self);
+    log_info("USERS MONITOR: started");
 }
 
 static void
 users_stop_monitor(users_t *self)
 {
-    if( self->usr_monitor_obj ) {
+    if( self->usr_monitor_id ) {
         log_info("USERS MONITOR: stopped");
-        g_object_unref(self->usr_monitor_obj),
-            self->usr_monitor_obj = NULL;
+        watcher_remove_at(&self->usr_monitor_id);
     }
 }
 
-static bool
-users_monitor_p(const gchar *path)
-{
-    path = path_basename(path);
-    return path && fnmatch(USERS_PATTERN, path, FNM_PATHNAME) == 0;
-}
-
 static void
-users_monitor_cb(GFileMonitor      *mon,
-                 GFile             *file1,
-                 GFile             *file2,
-                 GFileMonitorEvent  event,
-                 gpointer           aptr)
+users_monitor_cb(const gchar *name, gpointer aptr)
 {
     users_t *self = aptr;
 
-    const char *path1 = file1 ? g_file_peek_path(file1) : NULL;
-    const char *path2 = file2 ? g_file_peek_path(file2) : NULL;
-    bool trigger = (users_monitor_p(path1) ||
-                    users_monitor_p(path2));
-
-    if( trigger ) {
-        log_info("USERS MONITOR: triggers @ %s %s", path1, path2);
-        users_rescan_later(self);
-    }
+    log_info("USERS MONITOR: triggers @ %s", name ?: "*");
+    users_rescan_later(self);
 }
@@ -67,10 +67,11 @@ void     users_delete_cb(void *self);
  * USERS_USER
  * ------------------------------------------------------------------------- */
 
-uid_t users_first_user   (const users_t *self);
-uid_t users_last_user    (const users_t *self);
-bool  users_user_exists  (users_t *self, uid_t uid);
-bool  users_user_is_guest(const users_t *self, uid_t uid);
+uid_t  users_first_user   (const users_t *self);
+uid_t  users_last_user    (const users_t *self);
+bool   users_user_exists  (users_t *self, uid_t uid);
+bool   users_user_is_guest(const users_t *self, uid_t uid);
+GList *users_user_list    (users_t *self);
 
 G_END_DECLS
 
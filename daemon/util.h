@@ -88,6 +88,9 @@ G_BEGIN_DECLS
 # define PERMISSIONS_PATTERN            "[A-Z]*" PERMISSIONS_EXTENSION
 # define PROFILES_EXTENSION             ".profile"
 
+/* Flattened firejail profiles in: /run/sailjail/profiles/<uid>/ */
+# define RUNTIME_PROFILES_DIRECTORY     "/run/sailjail/profiles"
+
 /* Applications from: *.desktop */
 # define APPLICATIONS_DIRECTORY         DATADIR "/applications"
 # define APPLICATIONS_EXTENSION         ".desktop"
@@ -106,6 +109,11 @@ G_BEGIN_DECLS
 # define SETTINGS_DIRECTORY             SHAREDSTATEDIR "/sailjail/settings"
 # define SETTINGS_EXTENSION             ".settings"
 # define SETTINGS_PATTERN               "*" SETTINGS_EXTENSION
+# define SETTINGS_JOURNAL_EXTENSION     ".journal"
+
+/* Cached desktop data */
+# define APPCACHE_DIRECTORY             SHAREDSTATEDIR "/sailjail"
+# define APPCACHE_PATH                  APPCACHE_DIRECTORY "/appinfo.cache"
 
 /* Booster binaries in: /usr/libexec/mapplauncherd/ */
 # define BOOSTER_DIRECTORY              "/usr/libexec/mapplauncherd"
@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "warmup.h"
+
+#include "appinfo.h"
+#include "appservices.h"
+#include "control.h"
+#include "logging.h"
+#include "prompter.h"
+#include "service.h"
+#include "session.h"
+#include "settings.h"
+#include "stringset.h"
+#include "util.h"
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+/* Session switch pipeline: everything the first application launch
+ * after login would otherwise have to do on demand.
+ */
+typedef enum warmup_stage_t {
+    WARMUP_STAGE_IDLE,
+    WARMUP_STAGE_SETTINGS,      // load user settings
+    WARMUP_STAGE_PROMPTER,      // start connecting to user bus
+    WARMUP_STAGE_APPLICATIONS,  // GetAppInfo replies and launch options
+    WARMUP_STAGE_APPSERVICES,   // sync D-Bus activation files
+    WARMUP_STAGE_FINISHED,
+    WARMUP_STAGE_COUNT
+} warmup_stage_t;
+
+/* Applications handled per main loop iteration */
+#define WARMUP_APPLICATIONS_BATCH 16
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * WARMUP_STAGE
+ * ------------------------------------------------------------------------- */
+
+static const char *warmup_stage_repr(warmup_stage_t stage);
+
+/* ------------------------------------------------------------------------- *
+ * WARMUP
+ * ------------------------------------------------------------------------- */
+
+static void  warmup_ctor     (warmup_t *self, control_t *control);
+static void  warmup_dtor     (warmup_t *self);
+warmup_t    *warmup_create   (control_t *control);
+void         warmup_delete   (warmup_t *self);
+void         warmup_delete_at(warmup_t **pself);
+void         warmup_delete_cb(void *self);
+
+/* ------------------------------------------------------------------------- *
+ * WARMUP_PIPELINE
+ * ------------------------------------------------------------------------- */
+
+void            warmup_start            (warmup_t *self, uid_t uid);
+void            warmup_cancel           (warmup_t *self);
+bool            warmup_pending          (const warmup_t *self);
+void            warmup_prompter_ready   (warmup_t *self, bool connected);
+static gboolean warmup_step_cb          (gpointer aptr);
+static bool     warmup_step             (warmup_t *self);
+static void     warmup_step_application (warmup_t *self, const gchar *appname);
+static void     warmup_report           (warmup_t *self);
+
+/* ========================================================================= *
+ * WARMUP_STAGE
+ * ========================================================================= */
+
+static const char *
+warmup_stage_repr(warmup_stage_t stage)
+{
+    static const char * const lut[] = {
+        [WARMUP_STAGE_IDLE]         = "IDLE",
+        [WARMUP_STAGE_SETTINGS]     = "SETTINGS",
+        [WARMUP_STAGE_PROMPTER]     = "PROMPTER",
+        [WARMUP_STAGE_APPLICATIONS] = "APPLICATIONS",
+        [WARMUP_STAGE_APPSERVICES]  = "APPSERVICES",
+        [WARMUP_STAGE_FINISHED]     = "FINISHED",
+    };
+    return lut[stage];
+}
+
+/* ========================================================================= *
+ * WARMUP
+ * ========================================================================= */
+
+struct warmup_t
+{
+    control_t      *wup_control;
+    uid_t           wup_uid;
+    warmup_stage_t  wup_stage;
+    guint           wup_step_id;
+    gchar         **wup_apps;           // snapshot of applications to warm
+    guint           wup_apps_done;
+    guint           wup_apps_launchable;
+    bool            wup_bus_pending;
+    bool            wup_bus_connected;
+    gint64          wup_started;
+    gint64          wup_spent[WARMUP_STAGE_COUNT];
+    gint64          wup_bus_elapsed;
+};
+
+static void
+warmup_ctor(warmup_t *self, control_t *control)
+{
+    log_info("warmup() create");
+    self->wup_control = control;
+    self->wup_uid     = SESSION_UID_UNDEFINED;
+    self->wup_stage   = WARMUP_STAGE_IDLE;
+    self->wup_step_id = 0;
+    self->wup_apps    = NULL;
+}
+
+static void
+warmup_dtor(warmup_t *self)
+{
+    log_info("warmup() delete");
+    warmup_cancel(self);
+    self->wup_control = NULL;
+}
+
+warmup_t *
+warmup_create(control_t *control)
+{
+    warmup_t *self = g_malloc0(sizeof *self);
+    warmup_ctor(self, control);
+    return self;
+}
+
+void
+warmup_delete(warmup_t *self)
+{
+    if( self ) {
+        warmup_dtor(self);
+        g_free(self);
+    }
+}
+
+void
+warmup_delete_at(warmup_t **pself)
+{
+    warmup_delete(*pself), *pself = NULL;
+}
+
+void
+warmup_delete_cb(void *self)
+{
+    warmup_delete(self);
+}
+
+/* ========================================================================= *
+ * WARMUP_PIPELINE
+ * ========================================================================= */
+
+/** Start preparing state of a new session user
+ *
+ * Stages are executed one step per low priority main loop iteration,
+ * so that D-Bus method calls are served in between. Any warmup still
+ * in progress for the previous user is abandoned.
+ *
+ * @param self  warmup object
+ * @param uid   session user
+ */
+void
+warmup_start(warmup_t *self, uid_t uid)
+{
+    warmup_cancel(self);
+
+    if( uid == SESSION_UID_UNDEFINED )
+        return;
+
+    log_info("warmup(uid=%d) started", (int)uid);
+    self->wup_uid             = uid;
+    self->wup_stage           = WARMUP_STAGE_SETTINGS;
+    self->wup_apps            = NULL;
+    self->wup_apps_done       = 0;
+    self->wup_apps_launchable = 0;
+    self->wup_bus_pending     = false;
+    self->wup_bus_connected   = false;
+    self->wup_started         = g_get_monotonic_time();
+    self->wup_bus_elapsed     = 0;
+    for( size_t i = 0; i < G_N_ELEMENTS(self->wup_spent); ++i )
+        self->wup_spent[i] = 0;
+
+    self->wup_step_id = g_idle_add_full(G_PRIORITY_LOW, warmup_step_cb,
+                                        self, NULL);
+}
+
+void
+warmup_cancel(warmup_t *self)
+{
+    if( warmup_pending(self) )
+        log_info("warmup(uid=%d) canceled at %s", (int)self->wup_uid,
+                 warmup_stage_repr(self->wup_stage));
+
+    change_timer(&self->wup_step_id, 0);
+    g_strfreev(self->wup_apps),
+        self->wup_apps = NULL;
+    self->wup_bus_pending = false;
+    self->wup_stage = WARMUP_STAGE_IDLE;
+    self->wup_uid = SESSION_UID_UNDEFINED;
+}
+
+bool
+warmup_pending(const warmup_t *self)
+{
+    return (self->wup_stage != WARMUP_STAGE_IDLE &&
+            (self->wup_stage != WARMUP_STAGE_FINISHED || self->wup_bus_pending));
+}
+
+/** Notify warmup that user bus connection attempt has finished
+ *
+ * @param self       warmup object
+ * @param connected  true if prompter is now connected to user bus
+ */
+void
+warmup_prompter_ready(warmup_t *self, bool connected)
+{
+    if( self->wup_bus_pending ) {
+        self->wup_bus_pending   = false;
+        self->wup_bus_connected = connected;
+        self->wup_bus_elapsed   = g_get_monotonic_time() - self->wup_started;
+        if( self->wup_stage == WARMUP_STAGE_FINISHED )
+            warmup_report(self);
+    }
+}
+
+static gboolean
+warmup_step_cb(gpointer aptr)
+{
+    warmup_t *self = aptr;
+
+    if( warmup_step(self) )
+        return G_SOURCE_CONTINUE;
+
+    self->wup_step_id = 0;
+    if( self->wup_stage == WARMUP_STAGE_FINISHED && !self->wup_bus_pending )
+        warmup_report(self);
+    return G_SOURCE_REMOVE;
+}
+
+static bool
+warmup_step(warmup_t *self)
+{
+    control_t      *control = self->wup_control;
+    warmup_stage_t  stage   = self->wup_stage;
+    gint64          started = g_get_monotonic_time();
+
+    /* Session might have changed without us being told yet */
+    if( control_current_user(control) != self->wup_uid ) {
+        warmup_cancel(self);
+        return false;
+    }
+
+    switch( stage ) {
+    case WARMUP_STAGE_SETTINGS:
+        settings_preload_user(control_settings(control), self->wup_uid);
+        self->wup_stage = WARMUP_STAGE_PROMPTER;
+        break;
+
+    case WARMUP_STAGE_PROMPTER:
+        /* Connection is made asynchronously, other stages proceed
+         * while it is in progress -> warmup_prompter_ready() */
+        self->wup_bus_pending =
+            prompter_prewarm(service_prompter(control_service(control)));
+        self->wup_apps = stringset_to_strv(control_available_applications(control));
+        self->wup_stage = WARMUP_STAGE_APPLICATIONS;
+        break;
+
+    case WARMUP_STAGE_APPLICATIONS:
+        for( guint i = 0; i < WARMUP_APPLICATIONS_BATCH; ++i ) {
+            const gchar *appname = self->wup_apps[self->wup_apps_done];
+            if( !appname ) {
+                self->wup_stage = WARMUP_STAGE_APPSERVICES;
+                break;
+            }
+            warmup_step_application(self, appname);
+            self->wup_apps_done += 1;
+        }
+        break;
+
+    case WARMUP_STAGE_APPSERVICES:
+        appservices_rethink(control_appservices(control));
+        self->wup_stage = WARMUP_STAGE_FINISHED;
+        break;
+
+    default:
+        break;
+    }
+
+    self->wup_spent[stage] += g_get_monotonic_time() - started;
+    return self->wup_stage != WARMUP_STAGE_FINISHED;
+}
+
+static void
+warmup_step_application(warmup_t *self, const gchar *appname)
+{
+    control_t *control = self->wup_control;
+    appinfo_t *appinfo = control_appinfo(control, appname);
+
+    if( !appinfo || !appinfo_valid(appinfo) )
+        return;
+
+    /* GetAppInfo() reply is cached within appinfo */
+    g_variant_unref(appinfo_to_variant(appinfo));
+
+    /* Launch options can be determined in advance only for applications
+     * user has already allowed. Lookup only, no settings are created. */
+    appsettings_t *appsettings =
+        settings_get_appsettings(control_settings(control), self->wup_uid,
+                                 appname);
+    if( appsettings && appsettings_get_allowed(appsettings) == APP_ALLOWED_ALWAYS ) {
+        control_jail_args(control, appinfo, appsettings_get_granted(appsettings));
+        self->wup_apps_launchable += 1;
+    }
+}
+
+static void
+warmup_report(warmup_t *self)
+{
+    gint64 total = g_get_monotonic_time() - self->wup_started;
+
+    log_notice("warmup(uid=%d) finished in %.1f ms: settings %.1f ms, "
+               "%u apps (%u launchable) %.1f ms, appservices %.1f ms, "
+               "user bus %s after %.1f ms",
+               (int)self->wup_uid, total / 1000.0,
+               self->wup_spent[WARMUP_STAGE_SETTINGS] / 1000.0,
+               self->wup_apps_done, self->wup_apps_launchable,
+               self->wup_spent[WARMUP_STAGE_APPLICATIONS] / 1000.0,
+               self->wup_spent[WARMUP_STAGE_APPSERVICES] / 1000.0,
+               self->wup_bus_connected ? "connected" : "not connected",
+               self->wup_bus_elapsed / 1000.0);
+
+    self->wup_stage = WARMUP_STAGE_IDLE;
+}
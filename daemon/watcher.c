@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2021 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "watcher.h"
+
+#include "logging.h"
+#include "util.h"
+
+#include <errno.h>
+#include <fnmatch.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/inotify.h>
+
+/* ========================================================================= *
+ * CONSTANTS
+ * ========================================================================= */
+
+/* Changes within watched directories */
+#define WATCHER_EVENT_MASK (IN_CREATE | IN_DELETE | IN_MODIFY |\
+                            IN_CLOSE_WRITE | IN_ATTRIB |\
+                            IN_MOVED_FROM | IN_MOVED_TO |\
+                            IN_MOVE_SELF | IN_ONLYDIR)
+
+/* How often to check whether missing directories have appeared */
+#define WATCHER_RETRY_DELAY 4000 // [ms]
+
+/* ========================================================================= *
+ * Types
+ * ========================================================================= */
+
+typedef struct watcher_watch_t watcher_watch_t;
+
+/* ========================================================================= *
+ * Prototypes
+ * ========================================================================= */
+
+/* ------------------------------------------------------------------------- *
+ * WATCHER_WATCH
+ * ------------------------------------------------------------------------- */
+
+static watcher_watch_t *watcher_watch_create(guint id, const gchar *directory, const gchar *pattern, watcher_notify_fn notify, gpointer aptr);
+static void             watcher_watch_delete(watcher_watch_t *self);
+static bool             watcher_watch_start (watcher_watch_t *self);
+static void             watcher_watch_stop  (watcher_watch_t *self);
+static void             watcher_watch_notify(watcher_watch_t *self, const gchar *name);
+
+/* ------------------------------------------------------------------------- *
+ * WATCHER_INOTIFY
+ * ------------------------------------------------------------------------- */
+
+static bool     watcher_open          (void);
+static void     watcher_close         (void);
+static gboolean watcher_io_cb         (GIOChannel *chn, GIOCondition cnd, gpointer aptr);
+static void     watcher_handle_event  (const struct inotify_event *eve);
+static void     watcher_purge         (void);
+static void     watcher_schedule_retry(void);
+static gboolean watcher_retry_cb      (gpointer aptr);
+
+/* ------------------------------------------------------------------------- *
+ * WATCHER
+ * ------------------------------------------------------------------------- */
+
+guint watcher_add      (const gchar *directory, const gchar *pattern, watcher_notify_fn notify, gpointer aptr);
+void  watcher_remove   (guint id);
+void  watcher_remove_at(guint *pid);
+void  watcher_get_stats(watcher_stats_t *stats);
+
+/* ========================================================================= *
+ * State
+ * ========================================================================= */
+
+/* Applications, permissions and users trackers all share one inotify
+ * fd. Events are read and filtered in the main thread, and callbacks
+ * get basenames of matching files without any further allocations.
+ *
+ * The watcher is used only from the main thread.
+ */
+static int             watcher_fd          = -1;
+static guint           watcher_io_id       = 0;
+static guint           watcher_retry_id    = 0;
+static guint           watcher_last_id     = 0;
+static guint           watcher_dispatching = 0;
+static GQueue          watcher_watches     = G_QUEUE_INIT;
+static watcher_stats_t watcher_stats       = {};
+
+/* ========================================================================= *
+ * WATCHER_WATCH
+ * ========================================================================= */
+
+struct watcher_watch_t
+{
+    guint              wch_id;        // 0 after watcher_remove()
+    int                wch_wd;        // -1 while not watching
+    gchar             *wch_directory;
+    gchar             *wch_pattern;   // NULL -> all files
+    watcher_notify_fn  wch_notify;
+    gpointer           wch_aptr;
+};
+
+static watcher_watch_t *
+watcher_watch_create(guint id, const gchar *directory, const gchar *pattern,
+                     watcher_notify_fn notify, gpointer aptr)
+{
+    watcher_watch_t *self = g_malloc0(sizeof *self);
+    self->wch_id        = id;
+    self->wch_wd        = -1;
+    self->wch_directory = g_strdup(directory);
+    self->wch_pattern   = g_strdup(pattern);
+    self->wch_notify    = notify;
+    self->wch_aptr      = aptr;
+    return self;
+}
+
+static void
+watcher_watch_delete(watcher_watch_t *self)
+{
+    if( self ) {
+        watcher_watch_stop(self);
+        g_free(self->wch_directory);
+        g_free(self->wch_pattern);
+        g_free(self);
+    }
+}
+
+static bool
+watcher_watch_start(watcher_watch_t *self)
+{
+    if( self->wch_wd == -1 && watcher_open() ) {
+        self->wch_wd = inotify_add_watch(watcher_fd, self->wch_directory,
+                                         WATCHER_EVENT_MASK);
+        if( self->wch_wd == -1 ) {
+            log_debug("WATCHER: %s: %m", self->wch_directory);
+            watcher_schedule_retry();
+        }
+        else {
+            log_info("WATCHER: started: %s", self->wch_directory);
+        }
+    }
+    return self->wch_wd != -1;
+}
+
+static void
+watcher_watch_stop(watcher_watch_t *self)
+{
+    if( self->wch_wd == -1 )
+        return;
+
+    /* Adding a watch for the same directory twice yields the
+     * same watch descriptor -> remove only when not shared.
+     */
+    bool shared = false;
+    for( GList *iter = watcher_watches.head; iter; iter = iter->next ) {
+        watcher_watch_t *that = iter->data;
+        if( that != self && that->wch_id && that->wch_wd == self->wch_wd )
+            shared = true;
+    }
+    if( !shared && watcher_fd != -1 )
+        inotify_rm_watch(watcher_fd, self->wch_wd);
+
+    log_info("WATCHER: stopped: %s", self->wch_directory);
+    self->wch_wd = -1;
+}
+
+static void
+watcher_watch_notify(watcher_watch_t *self, const gchar *name)
+{
+    if( !self->wch_id )
+        return;
+
+    if( name && self->wch_pattern &&
+        fnmatch(self->wch_pattern, name, FNM_PATHNAME) != 0 )
+        return;
+
+    watcher_stats.wst_notifies++;
+    self->wch_notify(name, self->wch_aptr);
+}
+
+/* ========================================================================= *
+ * WATCHER_INOTIFY
+ * ========================================================================= */
+
+static bool
+watcher_open(void)
+{
+    if( watcher_fd != -1 )
+        goto EXIT;
+
+    if( (watcher_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1 ) {
+        log_err("WATCHER: inotify_init: %m");
+        goto EXIT;
+    }
+
+    if( !(watcher_io_id = gutil_add_watch(watcher_fd, G_IO_IN,
+                                          watcher_io_cb, NULL)) ) {
+        log_err("WATCHER: failed to add io watch");
+        close(watcher_fd), watcher_fd = -1;
+        goto EXIT;
+    }
+
+    log_info("WATCHER: opened");
+
+EXIT:
+    return watcher_fd != -1;
+}
+
+static void
+watcher_close(void)
+{
+    if( watcher_retry_id ) {
+        g_source_remove(watcher_retry_id),
+            watcher_retry_id = 0;
+    }
+
+    if( watcher_io_id ) {
+        g_source_remove(watcher_io_id),
+            watcher_io_id = 0;
+    }
+
+    if( watcher_fd != -1 ) {
+        log_info("WATCHER: closed");
+        close(watcher_fd), watcher_fd = -1;
+    }
+
+    for( GList *iter = watcher_watches.head; iter; iter = iter->next ) {
+        watcher_watch_t *watch = iter->data;
+        watch->wch_wd = -1;
+    }
+}
+
+static gboolean
+watcher_io_cb(GIOChannel *chn, GIOCondition cnd, gpointer aptr)
+{
+    (void)chn;
+    (void)aptr;
+
+    gboolean result = G_SOURCE_REMOVE;
+    char     buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    watcher_stats.wst_wakeups++;
+
+    if( cnd & ~G_IO_IN )
+        goto EXIT;
+
+    ++watcher_dispatching;
+    for( ;; ) {
+        ssize_t rc = read(watcher_fd, buf, sizeof buf);
+        if( rc == -1 ) {
+            if( errno == EINTR )
+                continue;
+            if( errno == EAGAIN || errno == EWOULDBLOCK )
+                result = G_SOURCE_CONTINUE;
+            else
+                log_err("WATCHER: read: %m");
+            break;
+        }
+        if( rc == 0 )
+            break;
+
+        for( const char *pos = buf; pos < buf + rc; ) {
+            const struct inotify_event *eve = (const struct inotify_event *)pos;
+            watcher_handle_event(eve);
+            pos += sizeof *eve + eve->len;
+        }
+    }
+    --watcher_dispatching;
+
+    watcher_purge();
+
+EXIT:
+    if( result == G_SOURCE_REMOVE && watcher_io_id ) {
+        log_crit("WATCHER: disabled");
+        watcher_io_id = 0;
+        watcher_close();
+    }
+
+    return result;
+}
+
+static void
+watcher_handle_event(const struct inotify_event *eve)
+{
+    watcher_stats.wst_events++;
+
+    if( eve->mask & IN_Q_OVERFLOW ) {
+        /* Events were lost -> everything needs to be rescanned */
+        log_warning("WATCHER: event queue overflow");
+        for( GList *iter = watcher_watches.head; iter; iter = iter->next )
+            watcher_watch_notify(iter->data, NULL);
+        return;
+    }
+
+    if( eve->mask & IN_MOVE_SELF ) {
+        /* Stop following the directory, IN_IGNORED follows */
+        inotify_rm_watch(watcher_fd, eve->wd);
+        return;
+    }
+
+    const gchar *name = eve->len ? eve->name : NULL;
+
+    for( GList *iter = watcher_watches.head; iter; iter = iter->next ) {
+        watcher_watch_t *watch = iter->data;
+        if( watch->wch_wd != eve->wd )
+            continue;
+
+        if( eve->mask & IN_IGNORED ) {
+            /* Directory was removed / unmounted / moved away */
+            log_info("WATCHER: lost: %s", watch->wch_directory);
+            watch->wch_wd = -1;
+            watcher_schedule_retry();
+            watcher_watch_notify(watch, NULL);
+        }
+        else if( name ) {
+            watcher_watch_notify(watch, name);
+        }
+    }
+}
+
+static void
+watcher_purge(void)
+{
+    if( watcher_dispatching )
+        return;
+
+    for( GList *iter = watcher_watches.head; iter; ) {
+        GList *next = iter->next;
+        watcher_watch_t *watch = iter->data;
+        if( !watch->wch_id ) {
+            g_queue_delete_link(&watcher_watches, iter);
+            watcher_watch_delete(watch);
+        }
+        iter = next;
+    }
+
+    if( g_queue_is_empty(&watcher_watches) )
+        watcher_close();
+}
+
+static void
+watcher_schedule_retry(void)
+{
+    if( !watcher_retry_id )
+        watcher_retry_id = g_timeout_add(WATCHER_RETRY_DELAY,
+                                         watcher_retry_cb, NULL);
+}
+
+static gboolean
+watcher_retry_cb(gpointer aptr)
+{
+    (void)aptr;
+
+    watcher_retry_id = 0;
+
+    ++watcher_dispatching;
+    for( GList *iter = watcher_watches.head; iter; iter = iter->next ) {
+        watcher_watch_t *watch = iter->data;
+        if( watch->wch_id && watch->wch_wd == -1 ) {
+            /* Directory appeared -> contents need to be scanned */
+            if( watcher_watch_start(watch) )
+                watcher_watch_notify(watch, NULL);
+        }
+    }
+    --watcher_dispatching;
+
+    watcher_purge();
+
+    return G_SOURCE_REMOVE;
+}
+
+/* ========================================================================= *
+ * WATCHER
+ * ========================================================================= */
+
+/** Start watching changes in a directory
+ *
+ * Missing directories are checked periodically, and once the
+ * directory appears notify is called with NULL name.
+ *
+ * @param directory  path to directory
+ * @param pattern    fnmatch() pattern for basenames, or NULL for all
+ * @param notify     callback to call on changes
+ * @param aptr       user data to pass to callback
+ *
+ * @return watch id to pass to watcher_remove()
+ */
+guint
+watcher_add(const gchar *directory, const gchar *pattern,
+            watcher_notify_fn notify, gpointer aptr)
+{
+    guint id = ++watcher_last_id ?: ++watcher_last_id;
+    watcher_watch_t *watch = watcher_watch_create(id, directory, pattern,
+                                                  notify, aptr);
+    g_queue_push_tail(&watcher_watches, watch);
+    watcher_watch_start(watch);
+    return id;
+}
+
+void
+watcher_remove(guint id)
+{
+    if( !id )
+        return;
+
+    for( GList *iter = watcher_watches.head; iter; iter = iter->next ) {
+        watcher_watch_t *watch = iter->data;
+        if( watch->wch_id == id ) {
+            /* Actual removal is delayed while dispatching events */
+            watcher_watch_stop(watch);
+            watch->wch_id = 0;
+            break;
+        }
+    }
+
+    watcher_purge();
+}
+
+void
+watcher_remove_at(guint *pid)
+{
+    watcher_remove(*pid), *pid = 0;
+}
+
+void
+watcher_get_stats(watcher_stats_t *stats)
+{
+    *stats = watcher_stats;
+}
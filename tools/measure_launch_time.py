@@ -38,6 +38,7 @@ import dataclasses
 import datetime
 import itertools
 import re
+import statistics
 import time
 import subprocess
 
@@ -60,6 +61,9 @@ MATCHER = re.compile(r"""^
     re.VERBOSE
 )
 
+# Phase timing line written by sailjail --timing=FILE
+TIMING_MATCHER = re.compile(r"^(?:.*\s)?sailjail-timing:\s+(?P<fields>.*)$")
+
 @dataclasses.dataclass
 class Measured:
     name: str
@@ -165,14 +169,71 @@ parsers = {
 full_line_parsers = [
     # Firejail doesn't use prefixes on its logging
     FilteredLogParser(r"^(Child process initialized) in .*$", "firejail"),
+    # Sailjail client logs one line per launch info query it makes, so
+    # single-call PromptLaunch and the older two-call sequence of
+    # PromptLaunchPermissions + GetAppInfo can be told apart
+    FilteredLogParser(r"^(?:[A-Z]: )?(obtained .* via \w+)$", "sailjail"),
+    FilteredLogParser(r"^(?:[A-Z]: )?(Launching) '.*' via sailjailclient\.\.\.$",
+                      "sailjail"),
 ]
 
+class PhaseTimings:
+    """Collects sailjail launch phase timings and reports statistics.
+
+    Each timing line holds the application name, the status in which the
+    client ended (exec, dry-run, failed, done) and milliseconds spent in
+    each phase since the previous one. Phases are reported in the order
+    they were first seen, followed by the total.
+    """
+    def __init__(self):
+        self.phases = {}
+        self.launches = 0
+
+    @staticmethod
+    def parse_line(line):
+        match = TIMING_MATCHER.match(line)
+        if not match:
+            return None
+        fields = {}
+        for field in match.group("fields").split():
+            key, sep, value = field.partition("=")
+            if sep:
+                fields[key] = value
+        return fields
+
+    def add(self, fields):
+        self.launches += 1
+        for key, value in fields.items():
+            if key in ("app", "status"):
+                continue
+            try:
+                self.phases.setdefault(key, []).append(float(value))
+            except ValueError:
+                pass
+
+    def report(self, output=stdout):
+        print(f"phase; count; min; median; mean; max  "
+              f"({self.launches} launches, ms)", file=output)
+        # Total is always last, no matter which phases were seen first
+        phases = sorted(self.phases.items(), key=lambda item: item[0] == "total")
+        for phase, values in phases:
+            print(f"{phase}; {len(values)}; {min(values):.3f}; "
+                  f"{statistics.median(values):.3f}; "
+                  f"{statistics.mean(values):.3f}; {max(values):.3f}",
+                  file=output)
+
+phase_timings = PhaseTimings()
+
 def print_title(output=stdout):
     print("timer; reason; time; difference", file=output)
 
 title_printed = False
 
 def parse(line, output=stdout, timestamp=None):
+    fields = PhaseTimings.parse_line(line)
+    if fields is not None:
+        phase_timings.add(fields)
+        return True
     match = MATCHER.match(line)
     if match:
         measured = None
@@ -202,7 +263,7 @@ def get_environment(with_logging_rules=True, with_logging_to_console=True):
 
 SAILJAIL_BINARIES = ("sailjail", "/usr/bin/sailjail")
 
-def append_sailjail_arguments(args):
+def append_sailjail_arguments(args, with_phases=False):
     """Append arguments for sailjail to enable sufficient logging"""
     sailjail_arg = None
     for i, arg in enumerate(args):
@@ -218,11 +279,13 @@ def append_sailjail_arguments(args):
     else:
         args.insert(i+1, "-v")
     args.insert(i+1, "--output=stderr")
+    if with_phases:
+        args.insert(i+1, "--timing=-")
 
 def run(args):
     for var, value in get_environment().items():
         putenv(var, value)
-    append_sailjail_arguments(args.args)
+    append_sailjail_arguments(args.args, args.with_phases)
     if not args.without_start_time:
         parse("[general] starting process", args.output, time.time())
     p = subprocess.Popen(args.args, stderr=subprocess.PIPE)
@@ -238,6 +301,8 @@ def run(args):
                 stderr.buffer.flush()
     if args.with_end_time:
         parse("[general] ended process", args.output, time.time())
+    if phase_timings.launches:
+        phase_timings.report(args.output)
 
 def print_env(args):
     for var, value in get_environment(args.with_logging_rules,
@@ -253,6 +318,17 @@ def print_rules(args):
 def parse_file(args):
     for line in args.file:
         parse(line, args.output)
+    if phase_timings.launches:
+        phase_timings.report(args.output)
+
+def aggregate_phases(args):
+    for file in args.files:
+        for line in file:
+            fields = PhaseTimings.parse_line(line.rstrip())
+            if fields is not None and (args.status is None or
+                                       fields.get("status") == args.status):
+                phase_timings.add(fields)
+    phase_timings.report(args.output)
 
 def main():
     parser = argparse.ArgumentParser(description="Measure launching time",
@@ -308,6 +384,9 @@ for sailjail to measure time correctly.
     run_parser.add_argument('--output', '-o', metavar="FILE",
         type=argparse.FileType('w'), default=stderr,
         help="File to write. Overwritten. Writes to stderr by default")
+    run_parser.add_argument('--with-phases', action='store_true',
+        default=False, help="Make sailjail report time spent in each "
+        "launch phase and print it after the run")
     run_parser.set_defaults(func=run)
     env_parser = subparsers.add_parser('env',
         help="Print environment variables for manual measurement")
@@ -341,6 +420,20 @@ for sailjail to measure time correctly.
         type=argparse.FileType('w'), default=stdout,
         help="File to write. Overwritten. Writes to stdout by default")
     parse_parser.set_defaults(func=parse_file)
+    phases_parser = subparsers.add_parser('phases',
+        help="Aggregate sailjail launch phase timings",
+        epilog="""Launch applications with 'sailjail --timing=FILE ...' to
+            collect timings of multiple launches to FILE, then use this
+            subcommand to get per phase statistics.""")
+    phases_parser.add_argument('files', nargs='*', metavar="FILE",
+        type=argparse.FileType(), default=[stdin],
+        help="Files to read. Reads stdin if omitted")
+    phases_parser.add_argument('--status', metavar="STATUS", default=None,
+        help="Include only launches that ended with STATUS, e.g. exec")
+    phases_parser.add_argument('--output', '-o', metavar="FILE",
+        type=argparse.FileType('w'), default=stdout,
+        help="File to write. Overwritten. Writes to stdout by default")
+    phases_parser.set_defaults(func=aggregate_phases)
     args = parser.parse_args()
     args.func(args)
 